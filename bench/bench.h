@@ -0,0 +1,50 @@
+/**
+ * @file
+ * Benchmark entry points, selected by name from bench/main.c
+ * */
+
+#ifndef SN_BENCH_H_
+#define SN_BENCH_H_
+
+/**
+ * A benchmark body. Gets the arguments following the benchmark name.
+ * @return 0 if OK, -1 otherwise
+ * */
+typedef int (*sn_bench_t)(int argc, char* argv[]);
+
+/**
+ * Hosts thousands of nodes on a runtime and measures creation time and routed msg/s
+ * */
+int sn_bench_runtime(int argc, char* argv[]);
+
+/**
+ * Measures round trips through a relay node with the blocking and the busy polling loops
+ * */
+int sn_bench_busypoll(int argc, char* argv[]);
+
+/**
+ * Measures routing table row serialization and the join replies a gateway node sends for bursts of joins
+ * */
+int sn_bench_join(int argc, char* argv[]);
+
+/**
+ * Compares hop counts, lookup latency and churn resilience of the routing geometries on the same workload
+ * */
+int sn_bench_geometry(int argc, char* argv[]);
+
+/**
+ * Measures the memory, owner lookups and updates of a one-hop membership, and how gossip spreads a change
+ * */
+int sn_bench_members(int argc, char* argv[]);
+
+/**
+ * Measures the bare key-value store, and the put and get latency and throughput of nodes replicating it
+ * */
+int sn_bench_store(int argc, char* argv[]);
+
+/**
+ * Measures the GB/s of erasure coding and decoding with every Galois field kernel the CPU supports
+ * */
+int sn_bench_erasure(int argc, char* argv[]);
+
+#endif/*SN_BENCH_H_*/
@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "callbacks.h"
+#include "net/packet.h"
+#include "sndnet.h"
+#include "util/hist.h"
+#include "util/time.h"
+
+/*
+A client sends packets one at a time to a relay node, which forwards them back to the client.
+Round trips are measured with the relay blocking and busy polling.
+*/
+
+static int busypoll_run(const char* mode, unsigned int idle_us, size_t msgs) {
+    sn_net_addr_t relay_addr, client_addr;
+    sn_io_naddr_t any, relay_naddr, client_naddr;
+    sn_io_sock_t relay_sock, client_sock;
+    sn_util_closure_t silent;
+    sn_node_stats_t stats;
+    sn_util_hist_t rtt;
+    sn_net_packet_t* packet;
+    sn_node_t relay;
+    unsigned char raw[SN_NET_ADDR_LEN];
+    char payload[64];
+    size_t i;
+    int ret = -1;
+
+    memset(raw, 0, sizeof(raw));
+    raw[0] = 0xa3;
+    sn_net_addr_init(&relay_addr, raw);
+    raw[0] = 0xb6;
+    sn_net_addr_init(&client_addr, raw);
+
+    sn_io_naddr_ipv4(&any, "127.0.0.1", 0);
+
+    if((relay_sock = sn_io_sock_named(&any)) == SN_IO_SOCK_INVALID)
+        return -1;
+
+    if((client_sock = sn_io_sock_named(&any)) == SN_IO_SOCK_INVALID) {
+        sn_io_sock_close(relay_sock);
+        return -1;
+    }
+
+    sn_io_sock_get_name(relay_sock, &relay_naddr);
+    sn_io_sock_get_name(client_sock, &client_naddr);
+
+    if(sn_node_at_socket(&relay, NULL, (sn_crypto_sign_pubkey_t*)&relay_addr, relay_sock, 0) != 0) {
+        sn_io_sock_close(relay_sock);
+        sn_io_sock_close(client_sock);
+        return -1;
+    }
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+    sn_node_set_log_callback(&relay, &silent);
+    sn_net_router_add(&relay.router, &client_addr, &client_naddr);
+
+    if(idle_us && sn_node_set_busy_poll(&relay, idle_us) != 0)
+        goto end;
+
+    memset(payload, 0, sizeof(payload));
+
+    if((packet = sn_net_packet_pack(&client_addr, &relay_addr, 0, sizeof(payload), payload)) == NULL)
+        goto end;
+    sn_util_hist_init(&rtt);
+
+    for(i = 0; i < msgs; ++i) {
+        sn_net_packet_t* echo;
+        uint64_t start = sn_util_time_ns();
+
+        packet->header.ttl = SN_NET_PACKET_DEFAULT_TTL;
+
+        if(sn_net_packet_send(packet, client_sock, &relay_naddr) != 0)
+            break;
+
+        if((echo = sn_net_packet_recv(client_sock, NULL)) == NULL)
+            break;
+
+        sn_util_hist_record(&rtt, sn_util_time_ns() - start);
+        free(echo);
+    }
+
+    free(packet);
+
+    sn_node_get_stats(&relay, &stats);
+
+    printf("busypoll: %-8s rtt p50 %6.1fus p99 %6.1fus | relay forward p50 %6.1fus p99 %6.1fus (%lu msgs)\n",
+        mode,
+        (double)sn_util_hist_quantile(&rtt, 0.5)/1e3, (double)sn_util_hist_quantile(&rtt, 0.99)/1e3,
+        (double)sn_util_hist_quantile(&stats.forward_ns, 0.5)/1e3, (double)sn_util_hist_quantile(&stats.forward_ns, 0.99)/1e3,
+        (unsigned long)rtt.count);
+
+    ret = rtt.count == msgs ? 0 : -1;
+
+end:
+    sn_node_destroy(&relay);
+    sn_io_sock_close(client_sock);
+
+    return ret;
+}
+
+int sn_bench_busypoll(int argc, char* argv[]) {
+    size_t msgs = argc > 0 ? (size_t)atol(argv[0]) : 20000;
+    unsigned int idle_us = argc > 1 ? (unsigned int)atoi(argv[1]) : 1000;
+
+    if(sn_init() == -1 || idle_us == 0)
+        return -1;
+
+    if(busypoll_run("blocking", 0, msgs) != 0)
+        return -1;
+
+    return busypoll_run("busy", idle_us, msgs);
+}
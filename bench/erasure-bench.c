@@ -0,0 +1,107 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sodium.h>
+
+#include "bench.h"
+#include "common.h"
+#include "data/erasure.h"
+#include "sndnet.h"
+#include "util/time.h"
+
+/*
+Every kernel the CPU supports encodes the same fragments, and then decodes them with as many data
+fragments lost as there are parity ones, the worst case. Rates count the object bytes(the data
+fragments) coded per second.
+*/
+
+static const char* kernel_names[SN_DATA_ERASURE_KERNELS] = { "scalar", "ssse3", "avx2" };
+
+static double elapsed_s(uint64_t start_ns) {
+    return (double)(sn_util_time_ns() - start_ns)/1e9;
+}
+
+int sn_bench_erasure(int argc, char* argv[]) {
+    unsigned int data = argc > 0 ? (unsigned int)strtoul(argv[0], NULL, 10) : 4;
+    unsigned int parity = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 10) : 2;
+    size_t len = argc > 2 ? (size_t)strtoull(argv[2], NULL, 10) : 1 << 20;
+    size_t rounds = argc > 3 ? (size_t)strtoull(argv[3], NULL, 10) : 200;
+    const unsigned char* frags[SN_DATA_ERASURE_MAX_DATA + SN_DATA_ERASURE_MAX_PARITY];
+    const unsigned char* got[SN_DATA_ERASURE_MAX_DATA];
+    unsigned char* parities[SN_DATA_ERASURE_MAX_PARITY];
+    unsigned char* outs[SN_DATA_ERASURE_MAX_DATA];
+    unsigned int indexes[SN_DATA_ERASURE_MAX_DATA];
+    unsigned char *buf, *out;
+    sn_data_erasure_t code;
+    double encode_s, decode_s;
+    uint64_t start;
+    size_t r;
+    unsigned int i;
+    int kernel, ret = -1;
+
+    if(sn_init() == -1 || len == 0 || rounds == 0 || sn_data_erasure_init(&code, data, parity) != 0)
+        return -1;
+
+    buf = (unsigned char*)malloc((data + parity)*len);
+    out = (unsigned char*)malloc(data*len);
+
+    if(buf == NULL || out == NULL)
+        goto end;
+
+    randombytes_buf(buf, data*len);
+
+    for(i = 0; i < data + parity; ++i)
+        frags[i] = buf + i*len;
+
+    for(i = 0; i < parity; ++i)
+        parities[i] = buf + (data + i)*len;
+
+    /* The last data fragments are the lost ones */
+
+    for(i = 0; i < data; ++i) {
+        indexes[i] = i < data - SN_MIN(data, parity) ? i : i + SN_MIN(data, parity);
+        got[i] = frags[indexes[i]];
+        outs[i] = out + i*len;
+    }
+
+    printf("erasure: %u data + %u parity fragments of %zu bytes, %zu rounds\n", data, parity, len, rounds);
+
+    for(kernel = 0; kernel < SN_DATA_ERASURE_KERNELS; ++kernel) {
+        if(sn_data_erasure_set_kernel(&code, kernel) != 0) {
+            printf("  %-8s not supported\n", kernel_names[kernel]);
+            continue;
+        }
+
+        start = sn_util_time_ns();
+
+        for(r = 0; r < rounds; ++r)
+            sn_data_erasure_encode(&code, frags, parities, len);
+
+        encode_s = elapsed_s(start);
+        start = sn_util_time_ns();
+
+        for(r = 0; r < rounds; ++r)
+            if(sn_data_erasure_decode(&code, got, indexes, outs, len) != 0)
+                goto end;
+
+        decode_s = elapsed_s(start);
+
+        if(memcmp(out, buf, data*len) != 0) {
+            fprintf(stderr, "erasure: %s decoded wrong data\n", kernel_names[kernel]);
+            goto end;
+        }
+
+        printf("  %-8s encode %7.2f GB/s  decode %7.2f GB/s\n", kernel_names[kernel],
+               (double)(data*len*rounds)/encode_s/1e9, (double)(data*len*rounds)/decode_s/1e9);
+    }
+
+    ret = 0;
+
+end:
+    free(buf);
+    free(out);
+
+    return ret;
+}
@@ -0,0 +1,318 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sodium.h>
+
+#include "bench.h"
+#include "net/geometry.h"
+#include "sndnet.h"
+#include "util/time.h"
+
+#define GEOMETRY_BENCH_NEIGHBORS 4
+#define GEOMETRY_BENCH_PEERS 24
+#define GEOMETRY_BENCH_XOR_NEIGHBORS 8
+#define GEOMETRY_BENCH_XOR_WINDOW 32
+#define GEOMETRY_BENCH_REFRESH_BITS 24
+#define GEOMETRY_BENCH_MAX_HOPS 64
+
+/*
+Both geometries are fed the same contacts and route the same pairs, hop by hop through the
+node states without sockets. Every node knows its closest nodes by both metrics and a node
+sharing each prefix length with it, as a join with either geometry(and Kademlia bucket
+refreshes) would leave it, and random peers. Routes are counted as lost when they end on a node other than
+the destination or, after churn, reach a dead node. Churn is measured twice: right after the
+failures(static resilience) and once the live nodes have dropped the dead contacts, as the
+failure detector would.
+*/
+
+typedef struct {
+    sn_net_addr_t* addrs; /* Node addresses, sorted */
+    size_t nodes; /* Number of nodes */
+    size_t* links; /* Contacts, pairs of node indexes */
+    size_t links_len; /* Number of pairs */
+    size_t* pairs; /* Routed source and destination indexes, before and after churn */
+    size_t routes; /* Routes on each phase */
+    unsigned char* dead; /* Nodes failing on churn */
+    double hop_ms; /* Network latency of each hop, for the lookup latency estimate */
+} geometry_workload_t;
+
+static int addr_cmp(const void* a, const void* b) {
+    return sn_net_addr_cmp((const sn_net_addr_t*)a, (const sn_net_addr_t*)b);
+}
+
+static size_t node_index(const geometry_workload_t* w, const sn_net_addr_t* addr) {
+    const sn_net_addr_t* found = (const sn_net_addr_t*)bsearch(addr, w->addrs, w->nodes, sizeof(sn_net_addr_t), addr_cmp);
+
+    return found ? (size_t)(found - w->addrs) : w->nodes;
+}
+
+static void xor_neighbors(const geometry_workload_t* w, size_t i, size_t* out) {
+    sn_net_addr_t dists[GEOMETRY_BENCH_XOR_NEIGHBORS];
+    sn_net_addr_t dist;
+    size_t found = 0, j, k;
+    long d;
+
+    /* The closest nodes by XOR share the longest prefix, so they are close on the address order too */
+
+    for(d = -GEOMETRY_BENCH_XOR_WINDOW; d <= GEOMETRY_BENCH_XOR_WINDOW; ++d) {
+        j = (i + w->nodes + (size_t)(d%(long)w->nodes))%w->nodes;
+
+        if(j == i)
+            continue;
+
+        sn_net_addr_xor(&w->addrs[i], &w->addrs[j], &dist);
+
+        for(k = found; k > 0 && sn_net_addr_cmp(&dist, &dists[k - 1]) < 0; --k) {
+            if(k < GEOMETRY_BENCH_XOR_NEIGHBORS) {
+                dists[k] = dists[k - 1];
+                out[k] = out[k - 1];
+            }
+        }
+
+        if(k < GEOMETRY_BENCH_XOR_NEIGHBORS) {
+            dists[k] = dist;
+            out[k] = j;
+            found += found < GEOMETRY_BENCH_XOR_NEIGHBORS;
+        }
+    }
+
+    for(; found < GEOMETRY_BENCH_XOR_NEIGHBORS; ++found)
+        out[found] = i;
+}
+
+static size_t prefix_neighbors(const geometry_workload_t* w, size_t i, size_t* out) {
+    size_t found = 0, lo, hi, mid, c;
+    unsigned int b;
+    int k;
+
+    /* Nodes sharing b bits are a range of the address order, around our address with bit b flipped */
+
+    for(b = 0; b < GEOMETRY_BENCH_REFRESH_BITS; ++b) {
+        sn_net_addr_t target = w->addrs[i];
+
+        target.key[b/8] ^= (unsigned char)(0x80 >> (b%8));
+        randombytes_buf(target.key + b/8 + 1, SN_NET_ADDR_LEN - b/8 - 1);
+
+        for(lo = 0, hi = w->nodes; lo < hi;) {
+            mid = lo + (hi - lo)/2;
+
+            if(sn_net_addr_cmp(&w->addrs[mid], &target) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        for(k = -1; k <= 0; ++k) {
+            sn_net_addr_t dist;
+
+            if((c = lo + (size_t)k) >= w->nodes)
+                continue;
+
+            sn_net_addr_xor(&w->addrs[c], &target, &dist);
+
+            if((dist.key[b/8] & (0xff00 >> (b%8 + 1))) == 0 && memcmp(dist.key, "\0\0\0\0", b/8) == 0) {
+                out[found++] = c;
+                break;
+            }
+        }
+    }
+
+    return found;
+}
+
+static size_t pick(const geometry_workload_t* w, int live) {
+    size_t i;
+
+    do {
+        i = randombytes_uniform((uint32_t)w->nodes);
+    } while(live && w->dead[i]);
+
+    return i;
+}
+
+static void route_phase(const sn_net_geometry_t* geometry, const geometry_workload_t* w, unsigned char* states, const size_t* pairs, const char* phase) {
+    uint64_t hops_count[GEOMETRY_BENCH_MAX_HOPS + 1];
+    uint64_t start, delivered = 0, hops_sum = 0, acc = 0;
+    size_t r, p50 = GEOMETRY_BENCH_MAX_HOPS, p99 = GEOMETRY_BENCH_MAX_HOPS;
+    double t;
+
+    memset(hops_count, 0, sizeof(hops_count));
+    start = sn_util_time_ns();
+
+    for(r = 0; r < w->routes; ++r) {
+        size_t cur = pairs[2*r], dst = pairs[2*r + 1];
+        sn_net_entry_t nexthop;
+        size_t hops;
+
+        for(hops = 0; hops <= GEOMETRY_BENCH_MAX_HOPS; ++hops) {
+            geometry->nexthop(states + cur*geometry->state_size, &w->addrs[dst], &nexthop);
+
+            if(!nexthop.is_set || (cur = node_index(w, &nexthop.addr)) == w->nodes || w->dead[cur])
+                break;
+        }
+
+        if(!nexthop.is_set && cur == dst) {
+            ++delivered;
+            hops_sum += hops;
+            ++hops_count[hops];
+        }
+    }
+
+    t = (double)(sn_util_time_ns() - start)/1e9;
+
+    for(r = 0; r <= GEOMETRY_BENCH_MAX_HOPS; ++r) {
+        acc += hops_count[r];
+
+        if(p50 == GEOMETRY_BENCH_MAX_HOPS && acc*2 >= delivered)
+            p50 = r;
+
+        if(p99 == GEOMETRY_BENCH_MAX_HOPS && acc*100 >= delivered*99)
+            p99 = r;
+    }
+
+    printf("geometry: %-8s %-9s delivered %6.2f%%, hops mean %.2f p50 %zu p99 %zu, %.2fus/route, latency ~%.1fms at %.0fms/hop\n",
+        geometry->name, phase, 100.0*(double)delivered/(double)w->routes,
+        delivered ? (double)hops_sum/(double)delivered : 0.0, p50, p99,
+        t*1e6/(double)w->routes, delivered ? w->hop_ms*(double)hops_sum/(double)delivered : 0.0, w->hop_ms);
+}
+
+static int geometry_run(const sn_net_geometry_t* geometry, const geometry_workload_t* w) {
+    unsigned char* states;
+    sn_io_naddr_t naddr;
+    uint64_t start;
+    size_t i;
+
+    if((states = (unsigned char*)malloc(w->nodes*geometry->state_size)) == NULL)
+        return -1;
+
+    sn_io_naddr_ipv4(&naddr, "127.0.0.1", 1);
+
+    start = sn_util_time_ns();
+
+    for(i = 0; i < w->nodes; ++i)
+        geometry->init(states + i*geometry->state_size, &w->addrs[i], &naddr);
+
+    for(i = 0; i < w->links_len; ++i)
+        geometry->add(states + w->links[2*i]*geometry->state_size, &w->addrs[w->links[2*i + 1]], &naddr);
+
+    printf("geometry: %-8s built %zu nodes in %.3fs\n", geometry->name, w->nodes, (double)(sn_util_time_ns() - start)/1e9);
+
+    memset(w->dead, 0, w->nodes);
+    route_phase(geometry, w, states, w->pairs, "stable");
+
+    /* Same victims for every geometry, routes between live nodes */
+
+    for(i = 0; i < w->nodes; ++i)
+        w->dead[i] = w->dead[w->nodes + i];
+
+    route_phase(geometry, w, states, w->pairs + 2*w->routes, "churn");
+
+    for(i = 0; i < w->links_len; ++i) {
+        if(!w->dead[w->links[2*i]] && w->dead[w->links[2*i + 1]])
+            geometry->remove(states + w->links[2*i]*geometry->state_size, &w->addrs[w->links[2*i + 1]]);
+    }
+
+    route_phase(geometry, w, states, w->pairs + 2*w->routes, "repaired");
+
+    for(i = 0; i < w->nodes; ++i)
+        geometry->destroy(states + i*geometry->state_size);
+
+    free(states);
+
+    return 0;
+}
+
+int sn_bench_geometry(int argc, char* argv[]) {
+    const sn_net_geometry_t* geometries[] = { &sn_net_geometry_pastry, &sn_net_geometry_kademlia };
+    size_t nodes = argc > 0 ? (size_t)atol(argv[0]) : 1000;
+    size_t routes = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+    unsigned int churn = argc > 2 ? (unsigned int)atoi(argv[2]) : 10;
+    geometry_workload_t w;
+    size_t i, j, n = 0;
+    int ret = 0;
+
+    if(nodes < 2 || routes == 0 || churn >= 100 || sn_init() == -1)
+        return -1;
+
+    w.nodes = nodes;
+    w.routes = routes;
+    w.hop_ms = argc > 3 ? atof(argv[3]) : 20.0;
+    w.addrs = (sn_net_addr_t*)malloc(nodes*sizeof(sn_net_addr_t));
+    w.links = (size_t*)malloc(2*nodes*(2*GEOMETRY_BENCH_NEIGHBORS + GEOMETRY_BENCH_XOR_NEIGHBORS + GEOMETRY_BENCH_REFRESH_BITS + GEOMETRY_BENCH_PEERS)*sizeof(size_t));
+    w.pairs = (size_t*)malloc(4*routes*sizeof(size_t));
+    w.dead = (unsigned char*)calloc(2, nodes);
+
+    if(w.addrs == NULL || w.links == NULL || w.pairs == NULL || w.dead == NULL) {
+        ret = -1;
+        goto end;
+    }
+
+    for(i = 0; i < nodes; ++i) {
+        unsigned char raw[SN_NET_ADDR_LEN];
+
+        randombytes_buf(raw, sizeof(raw));
+        sn_net_addr_init(&w.addrs[i], raw);
+    }
+
+    qsort(w.addrs, nodes, sizeof(sn_net_addr_t), addr_cmp);
+
+    for(i = 0; i < nodes; ++i) {
+        size_t near[GEOMETRY_BENCH_XOR_NEIGHBORS + GEOMETRY_BENCH_REFRESH_BITS];
+        size_t near_len;
+
+        xor_neighbors(&w, i, near);
+        near_len = GEOMETRY_BENCH_XOR_NEIGHBORS + prefix_neighbors(&w, i, near + GEOMETRY_BENCH_XOR_NEIGHBORS);
+
+        for(j = 0; j < near_len; ++j) {
+            w.links[2*n] = i;
+            w.links[2*n++ + 1] = near[j];
+        }
+
+        for(j = 1; j <= GEOMETRY_BENCH_NEIGHBORS; ++j) {
+            w.links[2*n] = i;
+            w.links[2*n++ + 1] = (i + j)%nodes;
+            w.links[2*n] = i;
+            w.links[2*n++ + 1] = (i + nodes - j)%nodes;
+        }
+
+        for(j = 0; j < GEOMETRY_BENCH_PEERS; ++j) {
+            w.links[2*n] = i;
+            w.links[2*n++ + 1] = randombytes_uniform((uint32_t)nodes);
+        }
+    }
+
+    w.links_len = n;
+
+    /* Churn victims are kept after the stable phase flags */
+
+    for(i = 0; i < nodes*churn/100; ++i)
+        w.dead[nodes + pick(&w, 0)] = 1;
+
+    for(i = 0; i < routes; ++i) {
+        w.pairs[2*i] = pick(&w, 0);
+        w.pairs[2*i + 1] = pick(&w, 0);
+    }
+
+    memcpy(w.dead, w.dead + nodes, nodes);
+
+    for(i = routes; i < 2*routes; ++i) {
+        w.pairs[2*i] = pick(&w, 1);
+        w.pairs[2*i + 1] = pick(&w, 1);
+    }
+
+    printf("geometry: %zu nodes, %.1f contacts each, %zu routes, %u%% churn\n",
+        nodes, (double)n/(double)nodes, routes, churn);
+
+    for(i = 0; i < sizeof(geometries)/sizeof(geometries[0]) && ret == 0; ++i)
+        ret = geometry_run(geometries[i], &w);
+
+end:
+    free(w.addrs);
+    free(w.links);
+    free(w.pairs);
+    free(w.dead);
+
+    return ret;
+}
@@ -0,0 +1,206 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sodium.h>
+
+#include "bench.h"
+#include "callbacks.h"
+#include "net/packet.h"
+#include "sndnet.h"
+#include "util/time.h"
+#include "wire.h"
+
+#define JOIN_BENCH_PEERS 256
+#define JOIN_BENCH_WINDOW 32
+#define JOIN_BENCH_IDLE_NS 100000000
+
+/*
+Rows are serialized for join replies. The first part compares serializing a row for every
+query with the router cache, the second one sends bursts of joins to a gateway node.
+*/
+
+static double elapsed_s(uint64_t start_ns) {
+    return (double)(sn_util_time_ns() - start_ns)/1e9;
+}
+
+static void fill_router(sn_net_router_t* router, const sn_io_naddr_t* naddr) {
+    unsigned char raw[SN_NET_ADDR_LEN];
+    sn_net_addr_t addr;
+    size_t i;
+
+    for(i = 0; i < JOIN_BENCH_PEERS; ++i) {
+        randombytes_buf(raw, sizeof(raw));
+        sn_net_addr_init(&addr, raw);
+        sn_net_router_add(router, &addr, naddr);
+    }
+}
+
+static int join_rows(size_t rows) {
+    sn_net_router_t router;
+    sn_net_router_query_ser_t* query;
+    const sn_net_router_query_ser_t* cached;
+    unsigned char raw[SN_NET_ADDR_LEN];
+    sn_net_addr_t self;
+    sn_io_naddr_t naddr;
+    uint64_t start, entries = 0;
+    size_t i, len;
+    double t;
+
+    randombytes_buf(raw, sizeof(raw));
+    sn_net_addr_init(&self, raw);
+    sn_io_naddr_ipv4(&naddr, "127.0.0.1", 1);
+
+    sn_net_router_init(&router, &self, &naddr);
+    fill_router(&router, &naddr);
+
+    start = sn_util_time_ns();
+
+    for(i = 0; i < rows; ++i) {
+        if(sn_net_router_query_table(&router, (uint16_t)(i%2), (uint16_t)(i%2), &query) == 0)
+            break;
+
+        entries += query->entries_len;
+        free(query);
+    }
+
+    t = elapsed_s(start);
+    printf("join: serialized rows %10.0f rows/s (%.1f entries/row)\n", (double)i/t, (double)entries/(double)i);
+
+    entries = 0;
+    start = sn_util_time_ns();
+
+    for(i = 0; i < rows; ++i) {
+        if((cached = sn_net_router_cached_row(&router, (uint16_t)(i%2), &len)) == NULL)
+            break;
+
+        entries += cached->entries_len;
+    }
+
+    t = elapsed_s(start);
+    printf("join: cached rows     %10.0f rows/s (%.1f entries/row)\n", (double)i/t, (double)entries/(double)i);
+
+    sn_net_router_destroy(&router);
+
+    return i == rows ? 0 : -1;
+}
+
+static int join_burst(size_t joins) {
+    sn_io_naddr_t any, gw_naddr, client_naddr;
+    sn_io_sock_t gw_sock, client_sock;
+    sn_util_closure_t silent;
+    sn_wire_join_msg_t join;
+    sn_net_addr_t gw_addr;
+    sn_node_t gw;
+    unsigned char raw[SN_NET_ADDR_LEN];
+    uint8_t got[JOIN_BENCH_WINDOW];
+    uint64_t start, replies = 0;
+    size_t done = 0, lost = 0, i;
+    int ret = -1;
+
+    randombytes_buf(raw, sizeof(raw));
+    sn_net_addr_init(&gw_addr, raw);
+
+    sn_io_naddr_ipv4(&any, "127.0.0.1", 0);
+
+    if((gw_sock = sn_io_sock_named(&any)) == SN_IO_SOCK_INVALID)
+        return -1;
+
+    if((client_sock = sn_io_sock_named(&any)) == SN_IO_SOCK_INVALID) {
+        sn_io_sock_close(gw_sock);
+        return -1;
+    }
+
+    sn_io_sock_get_name(gw_sock, &gw_naddr);
+    sn_io_sock_get_name(client_sock, &client_naddr);
+    sn_io_sock_set_nonblocking(client_sock, 1);
+
+    if(sn_node_at_socket(&gw, NULL, (sn_crypto_sign_pubkey_t*)&gw_addr, gw_sock, 0) != 0) {
+        sn_io_sock_close(gw_sock);
+        sn_io_sock_close(client_sock);
+        return -1;
+    }
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+    sn_node_set_log_callback(&gw, &silent);
+
+    /* Joins forwarded to the peers come back to the client too, and are dropped */
+
+    fill_router(&gw.router, &client_naddr);
+    sn_io_naddr_ser(&client_naddr, &join.net_addr);
+
+    start = sn_util_time_ns();
+
+    while(done < joins) {
+        size_t window = SN_MIN(joins - done, JOIN_BENCH_WINDOW), complete = 0;
+        uint64_t idle;
+
+        for(i = 0; i < window; ++i) {
+            sn_net_packet_t* packet;
+            sn_net_addr_t joiner;
+
+            randombytes_buf(raw, sizeof(raw));
+            sn_net_addr_init(&joiner, raw);
+
+            join.reply_to = (uint32_t)i;
+            got[i] = 0;
+
+            if((packet = sn_net_packet_pack(&joiner, &joiner, SN_WIRE_NET_TYPE_JOIN, sizeof(join), (const char*)&join)) == NULL)
+                goto end;
+
+            sn_net_packet_send(packet, client_sock, &gw_naddr);
+            free(packet);
+        }
+
+        for(idle = sn_util_time_ns(); complete < window && sn_util_time_ns() - idle < JOIN_BENCH_IDLE_NS;) {
+            const sn_wire_reply_header_t* reply;
+            const sn_wire_join_reply_header_t* header;
+            sn_net_packet_t* packet;
+
+            if((packet = sn_net_packet_recv(client_sock, NULL)) == NULL)
+                continue;
+
+            reply = (const sn_wire_reply_header_t*)packet->payload;
+            header = (const sn_wire_join_reply_header_t*)(reply + 1);
+
+            if(packet->header.type == SN_WIRE_NET_TYPE_REPLY && packet->header.len >= sizeof(*reply) + sizeof(*header) &&
+                    reply->reply_id < window) {
+                if(++got[reply->reply_id] == header->parts)
+                    ++complete;
+
+                ++replies;
+                idle = sn_util_time_ns();
+            }
+
+            free(packet);
+        }
+
+        lost += window - complete;
+        done += window;
+    }
+
+    printf("join: %zu joins(%zu incomplete) in %.3fs, %.0f joins/s %.0f replies/s\n",
+        joins, lost, elapsed_s(start), (double)joins/elapsed_s(start), (double)replies/elapsed_s(start));
+
+    ret = 0;
+
+end:
+    sn_node_destroy(&gw);
+    sn_io_sock_close(client_sock);
+
+    return ret;
+}
+
+int sn_bench_join(int argc, char* argv[]) {
+    size_t rows = argc > 0 ? (size_t)atol(argv[0]) : 1000000;
+    size_t joins = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+
+    if(sn_init() == -1 || rows == 0)
+        return -1;
+
+    if(join_rows(rows) != 0)
+        return -1;
+
+    return join_burst(joins);
+}
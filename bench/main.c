@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+typedef struct {
+    const char* name;
+    sn_bench_t body;
+    const char* usage;
+} sn_bench_entry_t;
+
+static const sn_bench_entry_t benches[] = {
+    { "runtime", sn_bench_runtime, "[nodes=10000] [workers=4] [msgs=100000]" },
+    { "busypoll", sn_bench_busypoll, "[msgs=20000] [idle_us=1000]" },
+    { "join", sn_bench_join, "[rows=1000000] [joins=20000]" },
+    { "geometry", sn_bench_geometry, "[nodes=1000] [routes=20000] [churn_pct=10] [hop_ms=20]" },
+    { "members", sn_bench_members, "[members=10000] [updates=100000]" },
+    { "store", sn_bench_store, "[nodes=16] [ops=20000] [value_len=100]" },
+    { "erasure", sn_bench_erasure, "[data=4] [parity=2] [len=1048576] [rounds=200]" },
+};
+
+int main(int argc, char* argv[]) {
+    size_t i;
+
+    if(argc >= 2) {
+        for(i = 0; i < sizeof(benches)/sizeof(benches[0]); ++i)
+            if(strcmp(argv[1], benches[i].name) == 0)
+                return benches[i].body(argc - 2, argv + 2) == 0 ? 0 : 1;
+    }
+
+    fprintf(stderr, "Usage: %s <bench> [args]\n", argv[0]);
+
+    for(i = 0; i < sizeof(benches)/sizeof(benches[0]); ++i)
+        fprintf(stderr, "    %s %s\n", benches[i].name, benches[i].usage);
+
+    return 1;
+}
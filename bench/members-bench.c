@@ -0,0 +1,218 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sodium.h>
+
+#include "bench.h"
+#include "net/members.h"
+#include "net/router.h"
+#include "node.h"
+#include "sndnet.h"
+#include "util/time.h"
+
+#define MEMBERS_BENCH_LOOKUPS 1000000
+#define MEMBERS_BENCH_TRIALS 20
+
+/*
+The membership is built in random order, looked up and churned in place. Gossip is simulated
+in rounds(maintenance periods) with the node fanout and retransmit limit: every member that
+heard a change pushes it to random members on each period until its budget runs out.
+*/
+
+static double elapsed_ns(uint64_t start_ns) {
+    return (double)(sn_util_time_ns() - start_ns);
+}
+
+static void random_addr(sn_net_addr_t* addr) {
+    unsigned char raw[SN_NET_ADDR_LEN];
+
+    randombytes_buf(raw, sizeof(raw));
+    sn_net_addr_init(addr, raw);
+}
+
+static unsigned int gossip_budget(size_t members) {
+    unsigned int sends = 0;
+    size_t n = members + 1;
+
+    while(n) {
+        sends += SN_NODE_GOSSIP_REPEAT;
+        n >>= 1;
+    }
+
+    return sends;
+}
+
+static int simulate_gossip(size_t members, unsigned int* out_rounds, unsigned int* out_quiet, size_t* out_msgs, size_t* out_informed) {
+    unsigned int* sends_left = (unsigned int*)calloc(members, sizeof(unsigned int));
+    unsigned char* heard = (unsigned char*)calloc(members, 1);
+    unsigned int budget = gossip_budget(members - 1), rounds = 0, reached = 0;
+    size_t informed = 1, active = 1, msgs = 0, i, j;
+
+    if(sends_left == NULL || heard == NULL) {
+        free(sends_left);
+        free(heard);
+        return -1;
+    }
+
+    heard[0] = 1;
+    sends_left[0] = budget;
+
+    while(active) {
+        /* Pushes of this round are heard on the next one */
+
+        unsigned char* fresh = (unsigned char*)calloc(members, 1);
+
+        if(fresh == NULL)
+            break;
+
+        for(i = 0; i < members; ++i) {
+            if(sends_left[i] == 0)
+                continue;
+
+            for(j = 0; j < SN_NODE_GOSSIP_FANOUT; ++j) {
+                size_t peer = randombytes_uniform((uint32_t)members);
+
+                if(peer == i)
+                    continue;
+
+                ++msgs;
+
+                if(!heard[peer])
+                    fresh[peer] = 1;
+            }
+
+            if(--sends_left[i] == 0)
+                --active;
+        }
+
+        for(i = 0; i < members; ++i) {
+            if(fresh[i] && !heard[i]) {
+                heard[i] = 1;
+                sends_left[i] = budget;
+                ++informed;
+                ++active;
+            }
+        }
+
+        free(fresh);
+        ++rounds;
+
+        if(!reached && informed == members)
+            reached = rounds;
+    }
+
+    *out_rounds = reached ? reached : rounds;
+    *out_quiet = rounds;
+    *out_msgs = msgs;
+    *out_informed = informed;
+
+    free(sends_left);
+    free(heard);
+
+    return 0;
+}
+
+int sn_bench_members(int argc, char* argv[]) {
+    size_t members = argc > 0 ? (size_t)atol(argv[0]) : 10000;
+    size_t updates = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+    sn_net_members_t m;
+    sn_net_addr_t self, *addrs, dst;
+    sn_net_entry_t nexthop;
+    sn_io_naddr_t naddr;
+    uint64_t start, sum = 0;
+    size_t i, msgs, informed, total_msgs = 0, min_informed = SIZE_MAX;
+    unsigned int rounds, quiet, max_rounds = 0, total_rounds = 0, total_quiet = 0;
+    double ns;
+
+    if(members < 2 || sn_init() == -1)
+        return -1;
+
+    if((addrs = (sn_net_addr_t*)malloc(members*sizeof(sn_net_addr_t))) == NULL)
+        return -1;
+
+    random_addr(&self);
+    sn_io_naddr_ipv4(&naddr, "127.0.0.1", 31337);
+
+    for(i = 0; i < members; ++i)
+        random_addr(&addrs[i]);
+
+    sn_net_members_init(&m, &self, &naddr);
+
+    /* Build */
+
+    start = sn_util_time_ns();
+
+    for(i = 0; i < members; ++i) {
+        if(sn_net_members_add(&m, &addrs[i], &naddr) == -1) {
+            sn_net_members_destroy(&m);
+            free(addrs);
+            return -1;
+        }
+    }
+
+    ns = elapsed_ns(start);
+
+    printf("members: %zu members built in %.3fms (%.0fns/insert)\n", members, ns/1e6, ns/(double)members);
+    printf("members: %zu bytes allocated (%.1f bytes/member), the pastry router is %zu bytes\n",
+        sn_net_members_memory(&m), (double)sn_net_members_memory(&m)/(double)members, sizeof(sn_net_router_t));
+
+    /* Owner lookups */
+
+    start = sn_util_time_ns();
+
+    for(i = 0; i < MEMBERS_BENCH_LOOKUPS; ++i) {
+        dst = addrs[i%members];
+        dst.key[SN_NET_ADDR_LEN - 1] ^= 1;
+
+        sn_net_members_nexthop(&m, &dst, &nexthop);
+        sum += nexthop.is_set;
+    }
+
+    ns = elapsed_ns(start);
+
+    printf("members: %d owner lookups in %.3fms (%.0fns/lookup, %.1f%% remote)\n",
+        MEMBERS_BENCH_LOOKUPS, ns/1e6, ns/MEMBERS_BENCH_LOOKUPS, 100.0*(double)sum/MEMBERS_BENCH_LOOKUPS);
+
+    /* Churn, a member leaving and another joining per update */
+
+    start = sn_util_time_ns();
+
+    for(i = 0; i < updates; ++i) {
+        size_t victim = randombytes_uniform((uint32_t)members);
+
+        sn_net_members_remove(&m, &addrs[victim]);
+        random_addr(&addrs[victim]);
+        sn_net_members_add(&m, &addrs[victim], &naddr);
+    }
+
+    ns = elapsed_ns(start);
+
+    printf("members: %zu updates in %.3fms (%.0fns/update, %zu members)\n",
+        updates, ns/1e6, updates ? ns/(double)updates : 0.0, sn_net_members_size(&m));
+
+    sn_net_members_destroy(&m);
+    free(addrs);
+
+    /* Spreading one change */
+
+    for(i = 0; i < MEMBERS_BENCH_TRIALS; ++i) {
+        if(simulate_gossip(members, &rounds, &quiet, &msgs, &informed) != 0)
+            return -1;
+
+        total_rounds += rounds;
+        total_quiet += quiet;
+        max_rounds = rounds > max_rounds ? rounds : max_rounds;
+        total_msgs += msgs;
+        min_informed = informed < min_informed ? informed : min_informed;
+    }
+
+    printf("gossip: fanout %d, %u periods pushing, everyone reached in %.1f periods on average(%u max), %.3f%% at worst\n",
+        SN_NODE_GOSSIP_FANOUT, gossip_budget(members - 1), (double)total_rounds/MEMBERS_BENCH_TRIALS, max_rounds,
+        100.0*(double)min_informed/(double)members);
+    printf("gossip: quiet after %.1f periods, %.1f msgs/member per change\n",
+        (double)total_quiet/MEMBERS_BENCH_TRIALS, (double)total_msgs/MEMBERS_BENCH_TRIALS/(double)members);
+
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <sodium.h>
+#define asm __asm
+#include <mintomic/mintomic.h>
+
+#include "bench.h"
+#include "callbacks.h"
+#include "common.h"
+#include "io/runtime.h"
+#include "sndnet.h"
+#include "util/time.h"
+
+#define RUNTIME_BENCH_NEIGHBORS 4
+#define RUNTIME_BENCH_PEERS 24
+
+typedef struct {
+    sn_net_addr_t addr;
+    sn_io_naddr_t naddr;
+    size_t idx;
+} bench_peer_t;
+
+static mint_atomic32_t delivered;
+
+static int count_upcall(const unsigned char msg[], unsigned long long msg_len) {
+    (void)msg;
+    (void)msg_len;
+
+    mint_fetch_add_32_relaxed(&delivered, 1);
+
+    return 0;
+}
+
+static int peer_cmp(const void* a, const void* b) {
+    return sn_net_addr_cmp(&((const bench_peer_t*)a)->addr, &((const bench_peer_t*)b)->addr);
+}
+
+static double elapsed_s(uint64_t start_ns) {
+    return (double)(sn_util_time_ns() - start_ns)/1e9;
+}
+
+int sn_bench_runtime(int argc, char* argv[]) {
+    size_t nodes = argc > 0 ? (size_t)atol(argv[0]) : 10000;
+    unsigned int workers = argc > 1 ? (unsigned int)atoi(argv[1]) : 4;
+    size_t msgs = argc > 2 ? (size_t)atol(argv[2]) : 100000;
+    struct timespec pause = { 0, 10000000 };
+    struct rlimit nofile;
+    sn_io_runtime_t* rt;
+    sn_node_t* sns;
+    bench_peer_t* peers;
+    sn_util_closure_t silent;
+    uint32_t last = 0;
+    uint64_t start, end;
+    size_t i, j, created = 0, sent = 0;
+    int ret = -1;
+
+    if(nodes < 2 || workers == 0)
+        return -1;
+
+    /* One socket per node */
+
+    if(getrlimit(RLIMIT_NOFILE, &nofile) == 0 && nofile.rlim_cur < nodes + 64) {
+        nofile.rlim_cur = SN_MIN(nofile.rlim_max, (rlim_t)(nodes + 64));
+        setrlimit(RLIMIT_NOFILE, &nofile);
+    }
+
+    if(sn_init() == -1)
+        return -1;
+
+    rt = (sn_io_runtime_t*)malloc(sizeof(sn_io_runtime_t));
+    sns = (sn_node_t*)malloc(nodes*sizeof(sn_node_t));
+    peers = (bench_peer_t*)malloc(nodes*sizeof(bench_peer_t));
+
+    if(rt == NULL || sns == NULL || peers == NULL || sn_io_runtime_init(rt, workers) != 0)
+        goto end;
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+    mint_store_32_relaxed(&delivered, 0);
+
+    /* Creation */
+
+    start = sn_util_time_ns();
+
+    for(created = 0; created < nodes; ++created) {
+        unsigned char raw[SN_NET_ADDR_LEN];
+        sn_io_naddr_t any;
+        sn_io_sock_t socket;
+
+        randombytes_buf(raw, sizeof(raw));
+        sn_net_addr_init(&peers[created].addr, raw);
+        peers[created].idx = created;
+
+        sn_io_naddr_ipv4(&any, "127.0.0.1", 0);
+
+        if((socket = sn_io_sock_named(&any)) == SN_IO_SOCK_INVALID) {
+            fprintf(stderr, "socket %zu failed, raise the open files limit\n", created);
+            goto destroy;
+        }
+
+        if(sn_io_sock_get_name(socket, &peers[created].naddr) != 0 ||
+                sn_node_at_runtime(&sns[created], rt, NULL, (sn_crypto_sign_pubkey_t*)&peers[created].addr, socket, 0) != 0) {
+            sn_io_sock_close(socket);
+            goto destroy;
+        }
+
+        sn_node_set_log_callback(&sns[created], &silent);
+        sn_node_set_upcall(&sns[created], count_upcall);
+    }
+
+    printf("runtime: %zu nodes on %u workers created in %.3fs (%.1fus/node)\n",
+        nodes, workers, elapsed_s(start), elapsed_s(start)*1e6/(double)nodes);
+
+    /* Tables, address-order neighbors and random peers */
+
+    qsort(peers, nodes, sizeof(bench_peer_t), peer_cmp);
+
+    for(i = 0; i < nodes; ++i) {
+        sn_net_router_t* router = &sns[peers[i].idx].router;
+
+        for(j = 1; j <= RUNTIME_BENCH_NEIGHBORS; ++j) {
+            const bench_peer_t* right = &peers[(i + j)%nodes];
+            const bench_peer_t* left = &peers[(i + nodes - j)%nodes];
+
+            sn_net_router_add(router, &right->addr, &right->naddr);
+            sn_net_router_add(router, &left->addr, &left->naddr);
+        }
+
+        for(j = 0; j < RUNTIME_BENCH_PEERS; ++j) {
+            const bench_peer_t* peer = &peers[randombytes_uniform((uint32_t)nodes)];
+
+            if(peer != &peers[i])
+                sn_net_router_add(router, &peer->addr, &peer->naddr);
+        }
+    }
+
+    /* Routed messages between random nodes */
+
+    start = sn_util_time_ns();
+
+    for(sent = 0; sent < msgs; ++sent) {
+        const bench_peer_t* src = &peers[randombytes_uniform((uint32_t)nodes)];
+        const bench_peer_t* dst = &peers[randombytes_uniform((uint32_t)nodes)];
+
+        if(sn_node_send(&sns[src->idx], &dst->addr, 5, "Hola") != 0)
+            break;
+    }
+
+    /* Until everything arrived or nothing moved for 100ms */
+
+    end = sn_util_time_ns();
+
+    for(i = 0; last < sent && i < 10; ++i) {
+        nanosleep(&pause, NULL);
+
+        if(mint_load_32_relaxed(&delivered) != last) {
+            last = mint_load_32_relaxed(&delivered);
+            end = sn_util_time_ns();
+            i = 0;
+        }
+    }
+
+    printf("runtime: %zu msgs sent, %u delivered in %.3fs (%.0f msg/s)\n",
+        sent, last, (double)(end - start)/1e9, (double)last*1e9/(double)(end - start));
+
+    ret = 0;
+
+destroy:
+    start = sn_util_time_ns();
+
+    for(i = 0; i < created; ++i)
+        sn_node_destroy(&sns[i]);
+
+    printf("runtime: %zu nodes destroyed in %.3fs\n", created, elapsed_s(start));
+
+    sn_io_runtime_destroy(rt);
+end:
+    free(peers);
+    free(sns);
+    free(rt);
+
+    return ret;
+}
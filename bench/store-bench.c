@@ -0,0 +1,273 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sodium.h>
+
+#include "bench.h"
+#include "callbacks.h"
+#include "data/store.h"
+#include "sndnet.h"
+#include "util/hist.h"
+#include "util/time.h"
+
+#define STORE_BENCH_WINDOW 64
+#define STORE_BENCH_TIMEOUT 2000
+
+/*
+The bare store is filled, read and rewritten in place first. Then nodes on loopback sockets, all
+knowing each other, store the keys of a client: it puts and gets them one at a time for the
+latencies, and then with STORE_BENCH_WINDOW requests in flight for the throughput.
+*/
+
+typedef struct {
+    pthread_mutex_t mut;
+    pthread_cond_t cond;
+    size_t done; /* Answers and timeouts */
+    size_t failed; /* Timeouts, and gets of keys not found */
+} bench_wait_t;
+
+static void on_bench_done(int argc, void* argv[]) {
+    bench_wait_t* w = (bench_wait_t*)argv[0];
+
+    (void)argc;
+
+    /* The version of a put or the value of a get, NULL if it failed */
+
+    pthread_mutex_lock(&w->mut);
+    w->failed += argv[1] == NULL;
+    ++w->done;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->mut);
+}
+
+static void bench_wait(bench_wait_t* w, size_t done) {
+    pthread_mutex_lock(&w->mut);
+
+    while(w->done < done)
+        pthread_cond_wait(&w->cond, &w->mut);
+
+    pthread_mutex_unlock(&w->mut);
+}
+
+static double elapsed_s(uint64_t start_ns) {
+    return (double)(sn_util_time_ns() - start_ns)/1e9;
+}
+
+static int store_bare(size_t keys, size_t value_len) {
+    sn_data_store_t store;
+    sn_data_store_item_t item;
+    sn_net_addr_t* addrs;
+    char* value;
+    uint64_t start;
+    double put_s, get_s, rewrite_s;
+    size_t i, found = 0;
+    int ret = -1;
+
+    addrs = (sn_net_addr_t*)malloc(keys*sizeof(sn_net_addr_t));
+    value = (char*)malloc(value_len + 1);
+
+    if(addrs == NULL || value == NULL || sn_data_store_init(&store, sizeof(sn_net_addr_t)) != 0) {
+        free(addrs);
+        free(value);
+        return -1;
+    }
+
+    randombytes_buf(addrs, keys*sizeof(sn_net_addr_t));
+    memset(value, 'v', value_len);
+
+    start = sn_util_time_ns();
+
+    for(i = 0; i < keys; ++i)
+        if(sn_data_store_put(&store, &addrs[i], value, value_len, 1) != 0)
+            goto end;
+
+    put_s = elapsed_s(start);
+    start = sn_util_time_ns();
+
+    for(i = 0; i < keys; ++i)
+        found += sn_data_store_get(&store, &addrs[i], &item) == 0 && item.len == value_len;
+
+    get_s = elapsed_s(start);
+    start = sn_util_time_ns();
+
+    /* Every value replaced once, which compacts the arena along the way */
+
+    for(i = 0; i < keys; ++i)
+        if(sn_data_store_put(&store, &addrs[i], value, value_len, 2) != 0)
+            goto end;
+
+    rewrite_s = elapsed_s(start);
+
+    printf("store: bare  %lu keys of %lu bytes | put %6.2f Mops/s get %6.2f Mops/s rewrite %6.2f Mops/s | arena %lu KiB for %lu KiB live\n",
+        (unsigned long)keys, (unsigned long)value_len,
+        keys/put_s/1e6, keys/get_s/1e6, keys/rewrite_s/1e6,
+        (unsigned long)(sn_data_arena_used(&store.arena)/1024), (unsigned long)(store.live/1024));
+
+    ret = found == keys ? 0 : -1;
+
+end:
+    sn_data_store_destroy(&store);
+    free(addrs);
+    free(value);
+
+    return ret;
+}
+
+static int store_network(size_t nodes, size_t ops, size_t value_len) {
+    sn_node_t* sns;
+    sn_net_addr_t* addrs;
+    sn_net_addr_t* keys;
+    sn_io_naddr_t* naddrs;
+    sn_io_naddr_t any;
+    sn_util_closure_t silent, done;
+    sn_util_hist_t put_ns, get_ns;
+    bench_wait_t w;
+    char* value;
+    uint64_t start, replicas = 0, gets = 0;
+    double put_s, get_s;
+    size_t i, j, created = 0;
+    int ret = -1;
+
+    sns = (sn_node_t*)malloc(nodes*sizeof(sn_node_t));
+    addrs = (sn_net_addr_t*)malloc(nodes*sizeof(sn_net_addr_t));
+    naddrs = (sn_io_naddr_t*)malloc(nodes*sizeof(sn_io_naddr_t));
+    keys = (sn_net_addr_t*)malloc(ops*sizeof(sn_net_addr_t));
+    value = (char*)malloc(value_len + 1);
+
+    pthread_mutex_init(&w.mut, NULL);
+    pthread_cond_init(&w.cond, NULL);
+    w.done = w.failed = 0;
+
+    if(sns == NULL || addrs == NULL || naddrs == NULL || keys == NULL || value == NULL)
+        goto end;
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+    sn_util_closure_init_curried_once(&done, on_bench_done, &w);
+    sn_io_naddr_ipv4(&any, "127.0.0.1", 0);
+
+    randombytes_buf(addrs, nodes*sizeof(sn_net_addr_t));
+    randombytes_buf(keys, ops*sizeof(sn_net_addr_t));
+    memset(value, 'v', value_len);
+
+    for(created = 0; created < nodes; ++created) {
+        sn_io_sock_t sock;
+
+        if((sock = sn_io_sock_named(&any)) == SN_IO_SOCK_INVALID)
+            goto end;
+
+        sn_io_sock_get_name(sock, &naddrs[created]);
+
+        if(sn_node_at_socket(&sns[created], NULL, (sn_crypto_sign_pubkey_t*)&addrs[created], sock, 0) != 0) {
+            sn_io_sock_close(sock);
+            goto end;
+        }
+
+        sn_node_set_log_callback(&sns[created], &silent);
+        sn_node_set_failure_detection(&sns[created], 0);
+    }
+
+    for(i = 0; i < nodes; ++i)
+        for(j = 0; j < nodes; ++j)
+            if(i != j)
+                sn_node_add_route(&sns[i], &addrs[j], &naddrs[j]);
+
+    /* One at a time */
+
+    sn_util_hist_init(&put_ns);
+    sn_util_hist_init(&get_ns);
+
+    for(i = 0; i < ops; ++i) {
+        start = sn_util_time_ns();
+
+        if(sn_node_put(&sns[0], &keys[i], value_len, value, STORE_BENCH_TIMEOUT, &done) != 0)
+            goto end;
+
+        bench_wait(&w, i + 1);
+        sn_util_hist_record(&put_ns, sn_util_time_ns() - start);
+    }
+
+    for(i = 0; i < ops; ++i) {
+        start = sn_util_time_ns();
+
+        if(sn_node_get(&sns[0], &keys[i], STORE_BENCH_TIMEOUT, &done) != 0)
+            goto end;
+
+        bench_wait(&w, ops + i + 1);
+        sn_util_hist_record(&get_ns, sn_util_time_ns() - start);
+    }
+
+    /* Then with a window in flight */
+
+    start = sn_util_time_ns();
+
+    for(i = 0; i < ops; ++i) {
+        bench_wait(&w, 2*ops + (i >= STORE_BENCH_WINDOW ? i - STORE_BENCH_WINDOW + 1 : 0));
+
+        if(sn_node_put(&sns[0], &keys[i], value_len, value, STORE_BENCH_TIMEOUT, &done) != 0)
+            goto end;
+    }
+
+    bench_wait(&w, 3*ops);
+    put_s = elapsed_s(start);
+    start = sn_util_time_ns();
+
+    for(i = 0; i < ops; ++i) {
+        bench_wait(&w, 3*ops + (i >= STORE_BENCH_WINDOW ? i - STORE_BENCH_WINDOW + 1 : 0));
+
+        if(sn_node_get(&sns[0], &keys[i], STORE_BENCH_TIMEOUT, &done) != 0)
+            goto end;
+    }
+
+    bench_wait(&w, 4*ops);
+    get_s = elapsed_s(start);
+
+    for(i = 0; i < nodes; ++i) {
+        sn_node_stats_t stats;
+
+        sn_node_get_stats(&sns[i], &stats);
+        replicas += stats.store_replicas;
+        gets += stats.store_gets;
+    }
+
+    printf("store: %lu nodes %lu ops of %lu bytes | put p50 %6.1fus p99 %6.1fus get p50 %6.1fus p99 %6.1fus\n",
+        (unsigned long)nodes, (unsigned long)ops, (unsigned long)value_len,
+        (double)sn_util_hist_quantile(&put_ns, 0.5)/1e3, (double)sn_util_hist_quantile(&put_ns, 0.99)/1e3,
+        (double)sn_util_hist_quantile(&get_ns, 0.5)/1e3, (double)sn_util_hist_quantile(&get_ns, 0.99)/1e3);
+    printf("store: window %d | put %8.0f ops/s get %8.0f ops/s | %lu replica copies, %lu gets answered, %lu failed\n",
+        STORE_BENCH_WINDOW, ops/put_s, ops/get_s,
+        (unsigned long)replicas, (unsigned long)gets, (unsigned long)w.failed);
+
+    ret = w.failed == 0 ? 0 : -1;
+
+end:
+    for(i = 0; i < created; ++i)
+        sn_node_destroy(&sns[i]);
+
+    pthread_cond_destroy(&w.cond);
+    pthread_mutex_destroy(&w.mut);
+
+    free(sns);
+    free(addrs);
+    free(naddrs);
+    free(keys);
+    free(value);
+
+    return ret;
+}
+
+int sn_bench_store(int argc, char* argv[]) {
+    size_t nodes = argc > 0 ? (size_t)atol(argv[0]) : 16;
+    size_t ops = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+    size_t value_len = argc > 2 ? (size_t)atol(argv[2]) : 100;
+
+    if(sn_init() == -1 || nodes < 2 || ops == 0 || value_len > 1024)
+        return -1;
+
+    if(store_bare(10*ops, value_len) != 0)
+        return -1;
+
+    return store_network(nodes, ops, value_len);
+}
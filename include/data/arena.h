@@ -0,0 +1,43 @@
+#ifndef SN_DATA_ARENA_H_
+#define SN_DATA_ARENA_H_
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Bytes per arena chunk, larger allocations get a chunk of their own
+ * */
+#define SN_DATA_ARENA_CHUNK 65536
+
+/**
+ * Bump allocator over chunks, whose allocations are only freed all at once
+ * */
+typedef struct sn_data_arena_t_ sn_data_arena_t;
+
+typedef struct sn_data_arena_chunk_t_ sn_data_arena_chunk_t;
+
+void sn_data_arena_init(sn_data_arena_t* arena);
+void sn_data_arena_destroy(sn_data_arena_t* arena);
+void* sn_data_arena_alloc(sn_data_arena_t* arena, size_t size);
+size_t sn_data_arena_used(const sn_data_arena_t* arena);
+
+struct sn_data_arena_chunk_t_ {
+    sn_data_arena_chunk_t* next; /**< Chunk filled before this one */
+    size_t size; /**< Usable bytes */
+    size_t used; /**< Bytes given */
+};
+
+struct sn_data_arena_t_ {
+    sn_data_arena_chunk_t* head; /**< Chunk being filled, NULL if none */
+    size_t used; /**< Bytes given, padding included */
+    size_t reserved; /**< Usable bytes of every chunk */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_DATA_ARENA_H_*/
@@ -0,0 +1,49 @@
+#ifndef SN_DATA_CACHE_H_
+#define SN_DATA_CACHE_H_
+
+#include "data/hmap.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Versioned values by fixed size key, at most a given number of them, each one until it expires.
+ * A full cache evicts by CLOCK: the hand goes round the slots clearing the reference bit of the
+ * values read since it last passed, and evicts the first value not read it finds.
+ * */
+typedef struct sn_data_cache_t_ sn_data_cache_t;
+
+/**
+ * A cached value. Its bytes are valid until the cache is next modified.
+ * */
+typedef struct {
+    const char* value; /**< Value bytes */
+    size_t len; /**< Value length */
+    uint64_t version; /**< Value version */
+} sn_data_cache_item_t;
+
+int sn_data_cache_init(sn_data_cache_t* cache, size_t key_size, size_t capacity);
+void sn_data_cache_destroy(sn_data_cache_t* cache);
+size_t sn_data_cache_size(const sn_data_cache_t* cache);
+int sn_data_cache_get(sn_data_cache_t* cache, const void* key, uint64_t now, sn_data_cache_item_t* out);
+int sn_data_cache_put(sn_data_cache_t* cache, const void* key, const char* value, size_t len, uint64_t version, uint64_t expires);
+int sn_data_cache_remove(sn_data_cache_t* cache, const void* key);
+
+struct sn_data_cache_t_ {
+    sn_data_hmap_t index; /**< Key to its slot */
+    struct sn_data_cache_slot_t_* slots; /**< Values */
+    char* keys; /**< Key of each slot */
+    size_t key_size; /**< Bytes of a key */
+    size_t capacity; /**< Slots */
+    size_t hand; /**< Next slot the CLOCK hand looks at */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_DATA_CACHE_H_*/
@@ -0,0 +1,53 @@
+#ifndef SN_DATA_ERASURE_H_
+#define SN_DATA_ERASURE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Most data fragments of a code
+ * */
+#define SN_DATA_ERASURE_MAX_DATA 16
+
+/**
+ * Most parity fragments of a code
+ * */
+#define SN_DATA_ERASURE_MAX_PARITY 16
+
+/**
+ * Multiplication kernels, the nibble table lookups done a byte, 16 bytes(SSSE3) or 32 bytes(AVX2) at a time
+ * */
+#define SN_DATA_ERASURE_KERNEL_SCALAR 0
+#define SN_DATA_ERASURE_KERNEL_SSSE3 1
+#define SN_DATA_ERASURE_KERNEL_AVX2 2
+#define SN_DATA_ERASURE_KERNELS 3
+
+/**
+ * Systematic Reed-Solomon code over GF(2^8): data fragments are kept as they are and parity fragments
+ * combine them by the rows of a Cauchy matrix, so any data fragments out of the data + parity ones
+ * give the others back. Initialized with the fastest kernel the CPU supports.
+ * */
+typedef struct sn_data_erasure_t_ sn_data_erasure_t;
+
+int sn_data_erasure_init(sn_data_erasure_t* code, unsigned int data, unsigned int parity);
+int sn_data_erasure_set_kernel(sn_data_erasure_t* code, int kernel);
+void sn_data_erasure_encode(const sn_data_erasure_t* code, const unsigned char* const* data, unsigned char* const* parity, size_t len);
+int sn_data_erasure_decode(const sn_data_erasure_t* code, const unsigned char* const* fragments, const unsigned int* indexes, unsigned char* const* out, size_t len);
+
+struct sn_data_erasure_t_ {
+    unsigned int data; /**< Data fragments */
+    unsigned int parity; /**< Parity fragments */
+    int kernel; /**< SN_DATA_ERASURE_KERNEL_* used */
+    unsigned char matrix[SN_DATA_ERASURE_MAX_PARITY][SN_DATA_ERASURE_MAX_DATA]; /**< Parity rows of the coding matrix */
+    unsigned char tables[SN_DATA_ERASURE_MAX_PARITY][SN_DATA_ERASURE_MAX_DATA][32]; /**< Products of the coefficients by the low and high nibbles */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_DATA_ERASURE_H_*/
@@ -0,0 +1,38 @@
+#ifndef SN_DATA_HMAP_H_
+#define SN_DATA_HMAP_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Open addressing(linear probing) hash map with fixed size keys and values, compared bytewise
+ * */
+typedef struct sn_data_hmap_t_ sn_data_hmap_t;
+
+int sn_data_hmap_init(sn_data_hmap_t* map, size_t key_size, size_t value_size);
+void sn_data_hmap_destroy(sn_data_hmap_t* map);
+size_t sn_data_hmap_size(const sn_data_hmap_t* map);
+int sn_data_hmap_get(const sn_data_hmap_t* map, const void* key, void* out);
+int sn_data_hmap_put(sn_data_hmap_t* map, const void* key, const void* value);
+int sn_data_hmap_remove(sn_data_hmap_t* map, const void* key, void* out);
+int sn_data_hmap_next(const sn_data_hmap_t* map, size_t* iter, void* out_key, void* out_value);
+uint64_t sn_data_hmap_hash(const void* key, size_t key_size);
+
+struct sn_data_hmap_t_ {
+    size_t key_size; /**< Key size */
+    size_t value_size; /**< Value size */
+    size_t slot_size; /**< Used flag, key and value */
+    size_t size; /**< Entries */
+    size_t capacity; /**< Slots, a power of two */
+    char* slots;
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_DATA_HMAP_H_*/
@@ -0,0 +1,50 @@
+#ifndef SN_DATA_MERKLE_H_
+#define SN_DATA_MERKLE_H_
+
+#include "data/hmap.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Children of each tree node, one per hex digit of the keys
+ * */
+#define SN_DATA_MERKLE_FANOUT 16
+
+/**
+ * Levels below the root, leaves hold the keys sharing their first SN_DATA_MERKLE_DEPTH hex digits
+ * */
+#define SN_DATA_MERKLE_DEPTH 4
+
+/**
+ * Bytes of a node digest
+ * */
+#define SN_DATA_MERKLE_DIGEST_LEN 16
+
+/**
+ * Merkle tree over the key prefixes of a set of items. Leaf digests combine the digests of their
+ * items(so items are added and removed in any order), inner ones hash the digests of their children
+ * and are recomputed when asked for. Empty subtrees have a zero digest and take no memory.
+ * */
+typedef struct sn_data_merkle_t_ sn_data_merkle_t;
+
+int sn_data_merkle_init(sn_data_merkle_t* tree);
+void sn_data_merkle_destroy(sn_data_merkle_t* tree);
+int sn_data_merkle_toggle(sn_data_merkle_t* tree, const unsigned char* key, const unsigned char digest[SN_DATA_MERKLE_DIGEST_LEN]);
+void sn_data_merkle_digest(sn_data_merkle_t* tree, unsigned int level, uint32_t index, unsigned char out[SN_DATA_MERKLE_DIGEST_LEN]);
+uint32_t sn_data_merkle_index(const unsigned char* key, unsigned int level);
+void sn_data_merkle_item(const unsigned char* key, size_t key_len, uint64_t version, const char* value, size_t len, unsigned char out[SN_DATA_MERKLE_DIGEST_LEN]);
+
+struct sn_data_merkle_t_ {
+    sn_data_hmap_t nodes; /**< Non-empty nodes(level << 24 | index) to their digest and a stale flag */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_DATA_MERKLE_H_*/
@@ -0,0 +1,47 @@
+#ifndef SN_DATA_STORE_H_
+#define SN_DATA_STORE_H_
+
+#include "data/arena.h"
+#include "data/hmap.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Versioned values by fixed size key, indexed by an open addressing map and copied to an arena.
+ * Replaced and removed values are reclaimed by compacting the arena, once they take half of it.
+ * */
+typedef struct sn_data_store_t_ sn_data_store_t;
+
+/**
+ * A stored value. Its bytes are valid until the store is next modified.
+ * */
+typedef struct {
+    const char* value; /**< Value bytes */
+    size_t len; /**< Value length */
+    uint64_t version; /**< Value version */
+} sn_data_store_item_t;
+
+int sn_data_store_init(sn_data_store_t* store, size_t key_size);
+void sn_data_store_destroy(sn_data_store_t* store);
+size_t sn_data_store_size(const sn_data_store_t* store);
+int sn_data_store_get(const sn_data_store_t* store, const void* key, sn_data_store_item_t* out);
+int sn_data_store_put(sn_data_store_t* store, const void* key, const char* value, size_t len, uint64_t version);
+int sn_data_store_remove(sn_data_store_t* store, const void* key);
+int sn_data_store_next(const sn_data_store_t* store, size_t* iter, void* out_key, sn_data_store_item_t* out);
+
+struct sn_data_store_t_ {
+    sn_data_hmap_t index; /**< Key to its sn_data_store_item_t */
+    sn_data_arena_t arena; /**< Value bytes */
+    size_t live; /**< Arena bytes of the current values */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_DATA_STORE_H_*/
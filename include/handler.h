@@ -10,6 +10,10 @@
 extern "C" {
 #endif
 
+/**
+ * Called on the packets of a type before they are forwarded. Clearing the nexthop delivers the packet here.
+ * @return 0 to go on, 1 if the handler answered the packet itself, -1 to drop it
+ * */
 typedef int (*sn_forward_handler_t)(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop);
 typedef int (*sn_deliver_handler_t)(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
 
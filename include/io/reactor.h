@@ -0,0 +1,207 @@
+/**
+ * @file
+ * Provides an event loop multiplexing sockets, timers and wakeups(epoll, timerfd and eventfd)
+ * */
+
+#ifndef SN_IO_REACTOR_H_
+#define SN_IO_REACTOR_H_
+
+#include "util/closure.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#define asm __asm
+#include <mintomic/mintomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Holds an event loop.
+ * Should NOT be used directly.
+ * */
+typedef struct sn_io_reactor_t_ sn_io_reactor_t;
+
+/**
+ * A file descriptor watched by a reactor. Owned by the caller, must outlive its registration.
+ * */
+typedef struct sn_io_reactor_source_t_ sn_io_reactor_source_t;
+
+/**
+ * A timer managed by a reactor. Owned by the caller, must outlive its registration.
+ * */
+typedef struct sn_io_reactor_timer_t_ sn_io_reactor_timer_t;
+
+/**
+ * A closure queued with sn_io_reactor_post
+ * */
+typedef struct sn_io_reactor_post_t_ sn_io_reactor_post_t;
+
+/**
+ * Initializes a reactor
+ * @param r Reactor to be initialized(must be already allocated)
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_io_reactor_init(sn_io_reactor_t* r);
+
+/**
+ * Initializes a reactor whose loop is driven by several threads with
+ * sn_io_reactor_wait and sn_io_reactor_dispatch. Each ready source is handed to
+ * a single thread and is not watched again until it has been dispatched.
+ * @param r Reactor to be initialized(must be already allocated)
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_io_reactor_init_shared(sn_io_reactor_t* r);
+
+/**
+ * Destroys a reactor. The loop must not be running. Posted closures not yet run are dropped.
+ * @param r Reactor to be destroyed(but not deallocated)
+ * */
+void sn_io_reactor_destroy(sn_io_reactor_t* r);
+
+/**
+ * Watches a file descriptor for readability
+ * @param r Reactor
+ * @param src Source to be registered
+ * @param fd File descriptor. Should be non-blocking.
+ * @param on_ready Closure(copied) called from the loop with argv = { src } when fd is readable
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_io_reactor_add(sn_io_reactor_t* r, sn_io_reactor_source_t* src, int fd, const sn_util_closure_t* on_ready);
+
+/**
+ * Stops watching a source
+ * @param r Reactor
+ * @param src Registered source
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_io_reactor_remove(sn_io_reactor_t* r, sn_io_reactor_source_t* src);
+
+/**
+ * Initializes an inactive timer
+ * @param t Timer to be initialized(must be already allocated)
+ * */
+void sn_io_reactor_timer_init(sn_io_reactor_timer_t* t);
+
+/**
+ * Starts(or restarts) a timer
+ * @param r Reactor
+ * @param t Timer
+ * @param delay_ms Milliseconds until the first expiration
+ * @param period_ms Milliseconds between expirations. 0 for one-shot timers.
+ * @param on_expire Closure(copied) called from the loop with argv = { t }
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_io_reactor_timer_start(sn_io_reactor_t* r, sn_io_reactor_timer_t* t, uint64_t delay_ms, uint64_t period_ms, const sn_util_closure_t* on_expire);
+
+/**
+ * Stops a timer. Once it returns the closure is not running and will not be called again.
+ * @param r Reactor
+ * @param t Timer. Stopping an inactive timer does nothing.
+ * */
+void sn_io_reactor_timer_stop(sn_io_reactor_t* r, sn_io_reactor_timer_t* t);
+
+/**
+ * Runs a closure on the loop thread, waking the loop up. Thread safe.
+ * @param r Reactor
+ * @param closure Closure(copied) called with argc = 0
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_io_reactor_post(sn_io_reactor_t* r, const sn_util_closure_t* closure);
+
+/**
+ * Runs the loop until sn_io_reactor_stop is called
+ * @param r Reactor
+ * @return 0 if stopped, -1 if ERROR
+ * */
+int sn_io_reactor_run(sn_io_reactor_t* r);
+
+/**
+ * Runs a single loop iteration
+ * @param r Reactor
+ * @param timeout_ms Maximum wait in milliseconds, 0 to only run what is ready, -1 to wait forever
+ * @return Number of sources dispatched, -1 if ERROR
+ * */
+int sn_io_reactor_run_once(sn_io_reactor_t* r, int timeout_ms);
+
+/**
+ * Waits for ready sources without running them(shared reactors)
+ * @param r Reactor
+ * @param[out] out_srcs Ready sources, to be passed to sn_io_reactor_dispatch
+ * @param max Size of out_srcs
+ * @param timeout_ms Maximum wait in milliseconds, -1 to wait forever
+ * @return Number of ready sources, -1 if ERROR
+ * */
+int sn_io_reactor_wait(sn_io_reactor_t* r, sn_io_reactor_source_t* out_srcs[], int max, int timeout_ms);
+
+/**
+ * Runs a ready source and, on shared reactors, watches it again
+ * @param r Reactor
+ * @param src Source given by sn_io_reactor_wait
+ * */
+void sn_io_reactor_dispatch(sn_io_reactor_t* r, sn_io_reactor_source_t* src);
+
+/**
+ * Keeps the reactor wakeup pending, so every thread waiting on it returns at once, until
+ * a matching sn_io_reactor_wake_end. Thread safe.
+ * @param r Reactor
+ * */
+void sn_io_reactor_wake_begin(sn_io_reactor_t* r);
+
+/**
+ * Ends a sn_io_reactor_wake_begin
+ * @param r Reactor
+ * */
+void sn_io_reactor_wake_end(sn_io_reactor_t* r);
+
+/**
+ * Tells if sn_io_reactor_stop was called
+ * @param r Reactor
+ * @return 1 if stopping, 0 otherwise
+ * */
+int sn_io_reactor_stopping(sn_io_reactor_t* r);
+
+/**
+ * Makes sn_io_reactor_run return after the current iteration. Closures posted before stopping are run first. Thread safe.
+ * @param r Reactor
+ * */
+void sn_io_reactor_stop(sn_io_reactor_t* r);
+
+struct sn_io_reactor_source_t_ {
+    int fd; /**< Watched file descriptor */
+    sn_util_closure_t on_ready; /**< Readiness closure */
+    mint_atomic32_t refs; /**< Dispatches in flight, managed by the threads driving a shared reactor */
+};
+
+struct sn_io_reactor_timer_t_ {
+    uint64_t deadline; /**< Next expiration(sn_util_time_ms clock) */
+    uint64_t period; /**< Period in milliseconds, 0 if one-shot */
+    size_t heap_idx; /**< Position on the reactor timer heap */
+    int active; /**< Is it on the heap? */
+    sn_util_closure_t on_expire; /**< Expiration closure */
+};
+
+struct sn_io_reactor_t_ {
+    int epoll_fd; /**< epoll instance */
+    sn_io_reactor_source_t timer_src; /**< timerfd armed to the earliest timer */
+    sn_io_reactor_source_t wake_src; /**< eventfd for posts and stopping */
+    pthread_mutex_t mut; /**< Protects timers, posts and stopping */
+    sn_io_reactor_timer_t** heap; /**< Timer min-heap by deadline */
+    size_t heap_len; /**< Timers on the heap */
+    size_t heap_cap; /**< Heap capacity */
+    sn_io_reactor_post_t* posts; /**< Queued posts(LIFO, reversed when run) */
+    int stopping; /**< Set by sn_io_reactor_stop */
+    int shared; /**< Are sources one-shot for multithreaded loops? */
+    int wake_holds; /**< Active sn_io_reactor_wake_begin calls */
+    pthread_cond_t timer_cond; /**< Signaled when a timer closure returns */
+    sn_io_reactor_timer_t* running_timer; /**< Timer whose closure is running, if any */
+    pthread_t running_thread; /**< Thread running running_timer */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_IO_REACTOR_H_*/
@@ -0,0 +1,115 @@
+/**
+ * @file
+ * Provides a pool of worker threads driving a shared reactor, so many sockets(and nodes)
+ * can be hosted without a thread each
+ * */
+
+#ifndef SN_IO_RUNTIME_H_
+#define SN_IO_RUNTIME_H_
+
+#include "io/reactor.h"
+#include "util/closure.h"
+
+#include <stddef.h>
+#include <pthread.h>
+#define asm __asm
+#include <mintomic/mintomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Maximum number of runtime worker threads
+ * */
+#define SN_IO_RUNTIME_MAX_WORKERS 64
+
+/**
+ * Capacity of each worker run queue
+ * */
+#define SN_IO_RUNTIME_QUEUE_LEN 64
+
+/**
+ * Maximum number of ready sources a worker takes from the reactor at once.
+ * The rest are left for the other workers.
+ * */
+#define SN_IO_RUNTIME_BATCH 16
+
+/**
+ * Milliseconds an idle worker blocks on the reactor before trying to steal again
+ * */
+#define SN_IO_RUNTIME_IDLE_MS 10
+
+/**
+ * Holds a runtime.
+ * Should NOT be used directly.
+ * */
+typedef struct sn_io_runtime_t_ sn_io_runtime_t;
+
+/**
+ * A worker thread and its run queue
+ * */
+typedef struct sn_io_runtime_worker_t_ sn_io_runtime_worker_t;
+
+/**
+ * Initializes a runtime and starts its workers
+ * @param rt Runtime to be initialized(must be already allocated)
+ * @param workers Number of worker threads. Between 1 and SN_IO_RUNTIME_MAX_WORKERS.
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_io_runtime_init(sn_io_runtime_t* rt, unsigned int workers);
+
+/**
+ * Stops the workers and destroys the runtime. Every source must be detached first.
+ * @param rt Runtime to be destroyed(but not deallocated)
+ * */
+void sn_io_runtime_destroy(sn_io_runtime_t* rt);
+
+/**
+ * Gets the shared reactor, for timers and posts. Its closures run on any worker.
+ * @param rt Runtime
+ * @return The runtime reactor
+ * */
+sn_io_reactor_t* sn_io_runtime_reactor(sn_io_runtime_t* rt);
+
+/**
+ * Watches a file descriptor. on_ready never runs on two workers at once.
+ * @param rt Runtime
+ * @param src Source to be registered
+ * @param fd File descriptor. Should be non-blocking.
+ * @param on_ready Closure(copied) called from a worker with argv = { src } when fd is readable
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_io_runtime_attach(sn_io_runtime_t* rt, sn_io_reactor_source_t* src, int fd, const sn_util_closure_t* on_ready);
+
+/**
+ * Stops watching a source. Once it returns on_ready is not running and will not be called again.
+ * Must not be called from the source own closure.
+ * @param rt Runtime
+ * @param src Attached source
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_io_runtime_detach(sn_io_runtime_t* rt, sn_io_reactor_source_t* src);
+
+struct sn_io_runtime_worker_t_ {
+    sn_io_runtime_t* rt; /**< Owner runtime */
+    pthread_t thrd; /**< Worker thread */
+    pthread_mutex_t mut; /**< Protects the run queue */
+    sn_io_reactor_source_t* queue[SN_IO_RUNTIME_QUEUE_LEN]; /**< Ready sources(ring). The owner pops the newest, thieves the oldest. */
+    size_t head; /**< Oldest queued source */
+    size_t len; /**< Queued sources */
+    mint_atomic32_t queued; /**< Copy of len stored under mut, peeked by thieves without it */
+    mint_atomic32_t wseq; /**< Odd while the worker waits on the reactor and has not counted the sources yet */
+};
+
+struct sn_io_runtime_t_ {
+    sn_io_reactor_t reactor; /**< Shared reactor */
+    unsigned int workers_len; /**< Number of workers */
+    sn_io_runtime_worker_t workers[SN_IO_RUNTIME_MAX_WORKERS]; /**< Workers */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_IO_RUNTIME_H_*/
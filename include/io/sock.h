@@ -8,6 +8,8 @@
 
 #include "naddr.h"
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -22,6 +24,20 @@ typedef int sn_io_sock_t;
  * */
 #define SN_IO_SOCK_INVALID -1
 
+/**
+ * Maximum number of datagrams moved by a single batched syscall
+ * */
+#define SN_IO_SOCK_BATCH_LEN 64
+
+/**
+ * Kernel information about a received datagram
+ * */
+typedef struct {
+    uint64_t stamp_ns; /**< When the kernel queued the datagram(sn_util_time_real_ns clock), 0 if not reported */
+    uint32_t drops; /**< Datagrams dropped by the socket since its creation, 0 if none or not reported */
+    uint8_t drops_reported; /**< Did drops come with the datagram? The kernel leaves them out while there are none */
+} sn_io_sock_rx_info_t;
+
 /**
  * Creates a socket binded to a name
  * @param name Netaddress that is the name the socket should have
@@ -36,6 +52,14 @@ sn_io_sock_t sn_io_sock_named(const sn_io_naddr_t* name);
  * */
 void sn_io_sock_close(sn_io_sock_t socket);
 
+/**
+ * Changes the blocking mode of a socket
+ * @param socket Socket
+ * @param nonblocking If set reads and writes fail with EAGAIN instead of blocking
+ * @return 0 if ok, -1 if error
+ * */
+int sn_io_sock_set_nonblocking(sn_io_sock_t socket, int nonblocking);
+
 /**
  * Gets the name of a socket, that is, the binding address of that socket.
  * @param socket Socket
@@ -44,6 +68,32 @@ void sn_io_sock_close(sn_io_sock_t socket);
  * */
 int sn_io_sock_get_name(sn_io_sock_t socket, sn_io_naddr_t* out_name);
 
+/**
+ * Asks the kernel to busy poll the device queue on blocking receives(SO_BUSY_POLL)
+ * @param socket Socket
+ * @param usec Microseconds to busy poll, 0 to disable
+ * @return 0 if OK, -1 if ERROR or not supported
+ * */
+int sn_io_sock_set_busy_poll(sn_io_sock_t socket, unsigned int usec);
+
+/**
+ * Sets the kernel receive buffer size(SO_RCVBUF)
+ * @param socket Socket
+ * @param bytes Requested size, the kernel may round it
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_io_sock_set_rcvbuf(sn_io_sock_t socket, size_t bytes);
+
+/**
+ * Asks the kernel to report, with each received datagram, when it was queued(SO_TIMESTAMPNS)
+ * and how many datagrams the socket has dropped because its queue was full(SO_RXQ_OVFL).
+ * Read with sn_io_sock_recv_info or sn_io_sock_recv_many.
+ * @param socket Socket
+ * @param enable 1 to enable, 0 to disable
+ * @return 0 if OK, -1 if ERROR or not supported(drop counts are best effort)
+ * */
+int sn_io_sock_set_rx_info(sn_io_sock_t socket, int enable);
+
 /**
  * Sends some data using a socket
  * @param socket Socket
@@ -54,6 +104,17 @@ int sn_io_sock_get_name(sn_io_sock_t socket, sn_io_naddr_t* out_name);
  * */
 ssize_t sn_io_sock_send(sn_io_sock_t socket, const void* buf, size_t len, const sn_io_naddr_t* dst);
 
+/**
+ * Sends a batch of datagrams using as few syscalls as possible(sendmmsg where available)
+ * @param socket Socket
+ * @param bufs Data buffers
+ * @param lens Data buffer lengths
+ * @param dsts Destination netaddresses
+ * @param count Number of datagrams
+ * @return Number of datagrams sent(the first ones of the batch) or -1 if error
+ * */
+ssize_t sn_io_sock_send_many(sn_io_sock_t socket, const void* const bufs[], const size_t lens[], const sn_io_naddr_t* const dsts[], size_t count);
+
 /**
  * Receives some data from a socket
  * @param socket Socket
@@ -64,6 +125,31 @@ ssize_t sn_io_sock_send(sn_io_sock_t socket, const void* buf, size_t len, const
  * */
 ssize_t sn_io_sock_recv(sn_io_sock_t socket, void* buf, size_t len, sn_io_naddr_t* src);
 
+/**
+ * Receives some data from a socket along with its reception info(see sn_io_sock_set_rx_info)
+ * @param socket Socket
+ * @param[out] buf Data buffer
+ * @param len Data buffer length
+ * @param[out] src Place to store source netaddress. Can be NULL.
+ * @param[out] out_info Place to store the reception info. Zeroed if not reported.
+ * @return Bytes received or -1 if error.
+ * */
+ssize_t sn_io_sock_recv_info(sn_io_sock_t socket, void* buf, size_t len, sn_io_naddr_t* src, sn_io_sock_rx_info_t* out_info);
+
+/**
+ * Receives a batch of datagrams using as few syscalls as possible(recvmmsg where available).
+ * Does not block waiting for the batch to fill.
+ * @param socket Socket
+ * @param[out] bufs Data buffers
+ * @param cap Capacity of each buffer
+ * @param[out] lens Received length of each datagram
+ * @param[out] srcs Source netaddress of each datagram. Can be NULL.
+ * @param[out] infos Reception info of each datagram(see sn_io_sock_set_rx_info). Can be NULL.
+ * @param count Number of buffers
+ * @return Number of datagrams received or -1 if error(errno EAGAIN if none was queued)
+ * */
+ssize_t sn_io_sock_recv_many(sn_io_sock_t socket, void* const bufs[], size_t cap, size_t lens[], sn_io_naddr_t srcs[], sn_io_sock_rx_info_t infos[], size_t count);
+
 /**
  * Receives some data from a socket but KEEPS it on the queue for subsequent readings.
  * @param socket Socket
@@ -87,6 +87,14 @@ int sn_net_addr_cmp(const sn_net_addr_t* a, const sn_net_addr_t* b);
  * */
 void sn_net_addr_dist(const sn_net_addr_t* a, const sn_net_addr_t* b, sn_net_addr_t* dist);
 
+/**
+ * Returns the XOR distance between two addresses, comparable with sn_net_addr_cmp
+ * @param a Some address
+ * @param b Other address
+ * @param[out] dist The distance
+ * */
+void sn_net_addr_xor(const sn_net_addr_t* a, const sn_net_addr_t* b, sn_net_addr_t* dist);
+
 /**
  * Calculates the number of matching hex-chars from the beggining
  * between the two address and the first different hex of the second address.
@@ -0,0 +1,136 @@
+/**
+ * @file
+ * Provides an accrual failure detector for the routing table neighbors. Every packet received
+ * from a neighbor is a heartbeat, quiet neighbors are probed and silent ones are reported dead.
+ * */
+
+#ifndef SN_NET_DETECTOR_H_
+#define SN_NET_DETECTOR_H_
+
+#include "net/addr.h"
+#include "net/entry.h"
+#include "net/router.h"
+#include "io/naddr.h"
+#include "data/hmap.h"
+#include "data/vec.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Suspicion level a neighbor is probed at
+ * */
+#define SN_NET_DETECTOR_PHI_PROBE 1.0
+
+/**
+ * Suspicion level a neighbor is reported dead at, once it missed SN_NET_DETECTOR_PROBES probes too.
+ * Unanswered probes are the stronger evidence, so it is lower than usual for accrual detectors.
+ * */
+#define SN_NET_DETECTOR_PHI_DEAD 3.0
+
+/**
+ * Unanswered probes before a neighbor is reported dead
+ * */
+#define SN_NET_DETECTOR_PROBES 3
+
+/**
+ * Milliseconds between probes to the same neighbor
+ * */
+#define SN_NET_DETECTOR_PROBE_INTERVAL 1000
+
+/**
+ * Mean heartbeat interval(milliseconds) assumed for new neighbors
+ * */
+#define SN_NET_DETECTOR_INITIAL_MEAN 1000
+
+/**
+ * Lowest mean heartbeat interval(milliseconds), so bursts of traffic do not make neighbors suspicious
+ * right after they end
+ * */
+#define SN_NET_DETECTOR_MIN_MEAN 100
+
+/**
+ * Holds a failure detector.
+ * Should NOT be used directly.
+ * */
+typedef struct sn_net_detector_t_ sn_net_detector_t;
+
+/**
+ * A watched neighbor, by network address
+ * */
+typedef struct sn_net_detector_peer_t_ sn_net_detector_peer_t;
+
+/**
+ * Initializes a failure detector watching nobody
+ * @param d Detector to be initialized(must be already allocated)
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_net_detector_init(sn_net_detector_t* d);
+
+/**
+ * Destroys a failure detector
+ * @param d Detector to be destroyed(but not deallocated)
+ * */
+void sn_net_detector_destroy(sn_net_detector_t* d);
+
+/**
+ * Records a heartbeat. Packets from addresses not watched are ignored.
+ * @param d Detector
+ * @param net_addr Network address the packet came from
+ * @param now Current time(sn_util_time_ms clock)
+ * */
+void sn_net_detector_heard(sn_net_detector_t* d, const sn_io_naddr_t* net_addr, uint64_t now);
+
+/**
+ * Watches the network addresses of every table and leafset entry and forgets the rest.
+ * Does nothing if the router has not changed since the last call.
+ * @param d Detector
+ * @param snr Router
+ * @param now Current time(sn_util_time_ms clock), the first heartbeat of new neighbors
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_net_detector_sync(sn_net_detector_t* d, const sn_net_router_t* snr, uint64_t now);
+
+/**
+ * Gets the suspicion level of a neighbor, phi = -log10(P(still alive)) assuming exponentially
+ * distributed heartbeat intervals with the observed mean
+ * @param d Detector
+ * @param net_addr Neighbor network address
+ * @param now Current time(sn_util_time_ms clock)
+ * @return Suspicion level, negative if not watched
+ * */
+double sn_net_detector_phi(const sn_net_detector_t* d, const sn_io_naddr_t* net_addr, uint64_t now);
+
+/**
+ * Checks every neighbor. Only quiet neighbors cost anything but the check.
+ * @param d Detector
+ * @param now Current time(sn_util_time_ms clock)
+ * @param[out] probes Vector of sn_net_entry_t, gets the neighbors to be pinged
+ * @param[out] dead Vector of sn_net_entry_t, gets the neighbors given up on(no longer watched)
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_net_detector_check(sn_net_detector_t* d, uint64_t now, sn_data_vec_t* probes, sn_data_vec_t* dead);
+
+struct sn_net_detector_peer_t_ {
+    sn_net_entry_t entry; /**< An entry at the network address, the one probed */
+    uint64_t last; /**< Last heartbeat */
+    double mean; /**< Moving average of the heartbeat intervals(milliseconds) */
+    uint64_t probed; /**< Last probe */
+    uint32_t probes; /**< Probes sent since the last heartbeat */
+    uint32_t gen; /**< Last sync it was seen at */
+};
+
+struct sn_net_detector_t_ {
+    sn_data_hmap_t peers; /**< Serialized network address to sn_net_detector_peer_t */
+    uint32_t router_version; /**< Router version at the last sync */
+    uint32_t gen; /**< Sync generation */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_NET_DETECTOR_H_*/
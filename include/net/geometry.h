@@ -0,0 +1,54 @@
+/**
+ * @file
+ * Provides routing geometries: the routing state a node picks its nexthops with, behind a common interface
+ * */
+
+#ifndef SN_NET_GEOMETRY_H_
+#define SN_NET_GEOMETRY_H_
+
+#include "net/addr.h"
+#include "net/entry.h"
+#include "io/naddr.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Routing geometry operations. Every state function gets a state of state_size bytes initialized with init.
+ * */
+typedef struct sn_net_geometry_t_ sn_net_geometry_t;
+
+/**
+ * Prefix table and leafset(sn_net_router_t), numerically closest nodes own addresses
+ * */
+extern const sn_net_geometry_t sn_net_geometry_pastry;
+
+/**
+ * XOR metric k-buckets(sn_net_kbucket_t), closest nodes by XOR distance own addresses
+ * */
+extern const sn_net_geometry_t sn_net_geometry_kademlia;
+
+/**
+ * Full sorted membership(sn_net_members_t), one hop to the numerically closest node. For small, stable networks.
+ * */
+extern const sn_net_geometry_t sn_net_geometry_onehop;
+
+struct sn_net_geometry_t_ {
+    const char* name; /**< Geometry name */
+    size_t state_size; /**< Bytes to be allocated for a state */
+    void (*init)(void* state, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr); /**< Initializes a state */
+    void (*destroy)(void* state); /**< Destroys(but does not deallocate) a state */
+    void (*add)(void* state, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr); /**< Adds an entry */
+    void (*remove)(void* state, const sn_net_addr_t* addr); /**< Removes an entry */
+    void (*nexthop)(const void* state, const sn_net_addr_t* dst, sn_net_entry_t* nexthop); /**< Tells the best nexthop, is_set = 0 if we own dst */
+    void (*nexthop_alt)(const void* state, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop); /**< Tells the best nexthop making progress other than exclude */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_NET_GEOMETRY_H_*/
@@ -0,0 +1,97 @@
+/**
+ * @file
+ * Provides Kademlia-style routing state: contacts kept in k-buckets by XOR distance
+ * */
+
+#ifndef SN_NET_KBUCKET_H_
+#define SN_NET_KBUCKET_H_
+
+#include "net/addr.h"
+#include "net/entry.h"
+#include "io/naddr.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Number of buckets, one for each length of the prefix shared with us */
+#define SN_NET_KBUCKET_COUNT (SN_NET_ADDR_LEN*8)
+
+/** Contacts kept on each bucket */
+#define SN_NET_KBUCKET_K 8
+
+/**
+ * Holds k-bucket routing state.
+ * Should NOT be used directly.
+ * */
+typedef struct sn_net_kbucket_t_ sn_net_kbucket_t;
+
+/**
+ * Initializes k-bucket routing state
+ * @param snk State to be initialized(must be already allocated)
+ * @param self_addr Routing node address
+ * @param self_net_addr Routing node network address(can be NULL)
+ * */
+void sn_net_kbucket_init(sn_net_kbucket_t* snk, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr);
+
+/**
+ * Frees the buckets
+ * @param snk State to be destroyed(but not deallocated)
+ * */
+void sn_net_kbucket_destroy(sn_net_kbucket_t* snk);
+
+/**
+ * Adds a contact, or moves it to the tail of its bucket if already known. Full buckets keep their
+ * older contacts, the longer a node has been up the longer it is likely to stay.
+ * @param snk State
+ * @param addr Second Net address
+ * @param net_addr Underlying network address(can be NULL)
+ * */
+void sn_net_kbucket_add(sn_net_kbucket_t* snk, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr);
+
+/**
+ * Removes a contact
+ * @param snk State
+ * @param addr Second Net address
+ * */
+void sn_net_kbucket_remove(sn_net_kbucket_t* snk, const sn_net_addr_t* addr);
+
+/**
+ * Tells the contact closest to the destination by XOR distance
+ * @param snk State
+ * @param dst Destination address
+ * @param[out] nexthop Entry to store the result(is_set = 0 if no contact is closer than us)
+ * */
+void sn_net_kbucket_nexthop(const sn_net_kbucket_t* snk, const sn_net_addr_t* dst, sn_net_entry_t* nexthop);
+
+/**
+ * Tells the closest contact other than the given one that is still closer to the destination than us
+ * @param snk State
+ * @param dst Destination address
+ * @param exclude Address of the contact to be avoided(usually the best one)
+ * @param[out] nexthop Entry to store the result(is_set = 0 if there is no alternative)
+ * */
+void sn_net_kbucket_nexthop_alt(const sn_net_kbucket_t* snk, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop);
+
+/**
+ * Gets the number of contacts
+ * @param snk State
+ * @return Number of contacts
+ * */
+size_t sn_net_kbucket_size(const sn_net_kbucket_t* snk);
+
+struct sn_net_kbucket_t_ {
+    sn_net_entry_t self; /**< Our address */
+    sn_net_entry_t* buckets[SN_NET_KBUCKET_COUNT]; /**< Contacts by shared prefix bits, least recently seen first. NULL until used. */
+    uint8_t lens[SN_NET_KBUCKET_COUNT]; /**< Contacts on each bucket */
+    size_t size; /**< Number of contacts */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_NET_KBUCKET_H_*/
@@ -0,0 +1,117 @@
+/**
+ * @file
+ * Provides one-hop routing state: the full membership of a small network, sorted by address
+ * */
+
+#ifndef SN_NET_MEMBERS_H_
+#define SN_NET_MEMBERS_H_
+
+#include "net/addr.h"
+#include "net/entry.h"
+#include "io/naddr.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Holds the membership.
+ * Should NOT be used directly.
+ * */
+typedef struct sn_net_members_t_ sn_net_members_t;
+
+/**
+ * Initializes an empty membership
+ * @param snm Membership to be initialized(must be already allocated)
+ * @param self_addr Routing node address
+ * @param self_net_addr Routing node network address(can be NULL)
+ * */
+void sn_net_members_init(sn_net_members_t* snm, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr);
+
+/**
+ * Frees the membership arrays
+ * @param snm Membership to be destroyed(but not deallocated)
+ * */
+void sn_net_members_destroy(sn_net_members_t* snm);
+
+/**
+ * Adds a member, or updates its network address if already known
+ * @param snm Membership
+ * @param addr Second Net address
+ * @param net_addr Underlying network address(can be NULL)
+ * @return 1 if added, 0 if already known(or ourselves), -1 if ERROR
+ * */
+int sn_net_members_add(sn_net_members_t* snm, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr);
+
+/**
+ * Removes a member
+ * @param snm Membership
+ * @param addr Second Net address
+ * @return 0 if removed, -1 if not a member
+ * */
+int sn_net_members_remove(sn_net_members_t* snm, const sn_net_addr_t* addr);
+
+/**
+ * Finds a member
+ * @param snm Membership
+ * @param addr Second Net address
+ * @param[out] out_idx Member position, or where it would be inserted(can be NULL)
+ * @return 0 if found, -1 otherwise
+ * */
+int sn_net_members_find(const sn_net_members_t* snm, const sn_net_addr_t* addr, size_t* out_idx);
+
+/**
+ * Returns a read-only pointer to a member
+ * @param snm Membership
+ * @param idx Position, members are sorted by address
+ * @return The member entry, NULL if out of range
+ * */
+const sn_net_entry_t* sn_net_members_at(const sn_net_members_t* snm, size_t idx);
+
+/**
+ * Gets the number of members(ourselves excluded)
+ * @param snm Membership
+ * @return Number of members
+ * */
+size_t sn_net_members_size(const sn_net_members_t* snm);
+
+/**
+ * Tells the owner of an address, the numerically closest member(or ourselves), with a single search
+ * @param snm Membership
+ * @param dst Destination address
+ * @param[out] nexthop Entry to store the result(is_set = 0 if we own dst)
+ * */
+void sn_net_members_nexthop(const sn_net_members_t* snm, const sn_net_addr_t* dst, sn_net_entry_t* nexthop);
+
+/**
+ * Tells the closest member to the destination other than the given one that is still closer than us
+ * @param snm Membership
+ * @param dst Destination address
+ * @param exclude Address of the member to be avoided(usually the owner)
+ * @param[out] nexthop Entry to store the result(is_set = 0 if there is no alternative)
+ * */
+void sn_net_members_nexthop_alt(const sn_net_members_t* snm, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop);
+
+/**
+ * Gets the bytes allocated for the membership
+ * @param snm Membership
+ * @return Allocated bytes
+ * */
+size_t sn_net_members_memory(const sn_net_members_t* snm);
+
+struct sn_net_members_t_ {
+    sn_net_entry_t self; /**< Our address */
+    uint64_t* prefixes; /**< First 8 key bytes of each member(big endian), searched before the entries */
+    sn_net_entry_t* entries; /**< Members sorted by address */
+    size_t len; /**< Number of members */
+    size_t cap; /**< Allocated members */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_NET_MEMBERS_H_*/
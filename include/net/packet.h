@@ -28,6 +28,11 @@ extern "C" {
  * */
 #define SN_NET_PACKET_MAX_LEN 1000
 
+/**
+ * Size of a buffer holding any message, plus the trailing zero added on reception
+ * */
+#define SN_NET_PACKET_BUF_LEN (sizeof(sn_wire_net_header_t) + SN_NET_PACKET_MAX_LEN + 1)
+
 #define SN_NET_PACKET_PRINTABLE_LEN (25 + 3*5 + 2*SN_NET_ADDR_PRINTABLE_LEN)
 
 /**
@@ -43,6 +48,15 @@ typedef struct sn_net_packet_t_ sn_net_packet_t;
  */
 sn_net_packet_t* sn_net_packet_recv(sn_io_sock_t socket, sn_io_naddr_t* src_addr);
 
+/**
+ * Reads a message from a given socket along with its reception info(see sn_io_sock_set_rx_info). Allocates memory.
+ * @param socket Socket
+ * @param[out] src_addr For storage of the sender network address.
+ * @param[out] out_info For storage of the reception info
+ * @return A new message(must be freed) or NULL if error
+ */
+sn_net_packet_t* sn_net_packet_recv_info(sn_io_sock_t socket, sn_io_naddr_t* src_addr, sn_io_sock_rx_info_t* out_info);
+
 /**
  * Creates a message ready for sending
  * @param dst SecondNet destination address(copied)
@@ -77,6 +91,27 @@ int sn_net_packet_check_sign(const sn_net_packet_t* packet);
  * */
 int sn_net_packet_send(const sn_net_packet_t* packet, sn_io_sock_t socket, const sn_io_naddr_t* dst_addr);
 
+/**
+ * Receives a batch of messages into caller-owned buffers(low-level). Malformed datagrams are dropped.
+ * @param socket Socket
+ * @param[in,out] packets Buffers of SN_NET_PACKET_BUF_LEN bytes each. Received messages are moved to the front.
+ * @param[out] src_addrs Source address of each message. Can be NULL.
+ * @param[out] infos Reception info of each message. Can be NULL.
+ * @param count Number of buffers
+ * @return Number of messages received or -1 if ERROR(errno EAGAIN if none was queued)
+ * */
+int sn_net_packet_recv_many(sn_io_sock_t socket, sn_net_packet_t* packets[], sn_io_naddr_t src_addrs[], sn_io_sock_rx_info_t infos[], size_t count);
+
+/**
+ * Sends a batch of messages(low-level)
+ * @param packets The messages to be sent
+ * @param socket Socket
+ * @param dst_addrs Destination address of each message
+ * @param count Number of messages
+ * @return Number of messages sent(the first ones of the batch) or -1 if ERROR
+ * */
+int sn_net_packet_send_many(const sn_net_packet_t* const packets[], sn_io_sock_t socket, const sn_io_naddr_t* const dst_addrs[], size_t count);
+
 /**
  * Gets the message destination
  * @param packet Message
@@ -36,6 +36,11 @@ typedef struct sn_net_entry_t_ sn_net_entry_t;
  * */
 typedef struct sn_net_router_t_ sn_net_router_t;
 
+/**
+ * A serialized routing table row or leafset half, see sn_net_router_cached_row
+ * */
+typedef struct sn_net_router_cache_t_ sn_net_router_cache_t;
+
 /**
  * Initializes routing state
  * @param snr Router uninitialized state
@@ -44,6 +49,12 @@ typedef struct sn_net_router_t_ sn_net_router_t;
  * */
 void sn_net_router_init(sn_net_router_t* snr, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr);
 
+/**
+ * Frees the serialized row caches
+ * @param snr Router state to be destroyed(but not deallocated)
+ * */
+void sn_net_router_destroy(sn_net_router_t* snr);
+
 /**
  * Adds an entry to the routing info
  * @param snr Router state
@@ -67,6 +78,30 @@ void sn_net_router_remove(sn_net_router_t* snr, const sn_net_addr_t* addr);
  * */
 void sn_net_router_nexthop(const sn_net_router_t* snr, const sn_net_addr_t* dst, sn_net_entry_t* nexthop);
 
+/**
+ * Tells the best nexthop other than the given one that is still closer to the destination than us
+ * @param snr Router state
+ * @param dst Destination address
+ * @param exclude Address of the nexthop to be avoided(usually the best one)
+ * @param[out] nexthop Entry to store the result(is_set = 0 if there is no alternative)
+ * */
+void sn_net_router_nexthop_alt(const sn_net_router_t* snr, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop);
+
+/**
+ * Splits a broadcast across the table(El-Ansary et al.). Each entry of a level at or below the given one
+ * stands for the addresses sharing one more digit with it than with us, and gets a copy to split further
+ * from the next level. With complete tables every node of the range gets a single copy.
+ * @param snr Router state
+ * @param level Level the copy we got is split from, 0 at the broadcast origin
+ * @param lo Lowest address of the range
+ * @param hi Highest address of the range
+ * @param[out] out_entries Entries to send copies to, those covering part of the range
+ * @param[out] out_levels Level each copy is split from on its receiver
+ * @param max Capacity of out_entries and out_levels
+ * @return Number of entries
+ * */
+size_t sn_net_router_split(const sn_net_router_t* snr, unsigned int level, const sn_net_addr_t* lo, const sn_net_addr_t* hi, sn_net_entry_t out_entries[], uint8_t out_levels[], size_t max);
+
 /**
  * Gets an string representation of the routing info
  * @param snr Router state
@@ -127,6 +162,16 @@ typedef struct sn_net_router_query_ser_t_ {
     sn_net_router_entry_ser_t entries[0];
 } sn_net_router_query_ser_t;
 
+/**
+ * Position of a query streamed into caller buffers, see sn_net_router_query_next
+ * */
+typedef struct {
+    int is_table; /**< Table or leafset query? */
+    int32_t first; /**< First level or position */
+    int32_t last; /**< Last level or position */
+    uint32_t next; /**< Next slot to be serialized, counted from the first one */
+} sn_net_router_cursor_t;
+
 /**
  * Queries entries from the table. Query result serialized and saved in *out_query. Should be freed.
  * @param snr Router state
@@ -147,11 +192,166 @@ size_t sn_net_router_query_table(const sn_net_router_t* snr, uint16_t l_min, uin
  * */
 size_t sn_net_router_query_leafset(const sn_net_router_t* snr, int32_t p_min, int32_t p_max, sn_net_router_query_ser_t** out_query);
 
+/**
+ * Starts a table query streamed with sn_net_router_query_next
+ * @param[out] cur Cursor to be initialized
+ * @param l_min Minimum level.
+ * @param l_max Maximum level.
+ * @return 0 if OK, -1 if the range is not valid
+ * */
+int sn_net_router_cursor_table(sn_net_router_cursor_t* cur, uint16_t l_min, uint16_t l_max);
+
+/**
+ * Starts a leafset query streamed with sn_net_router_query_next
+ * @param[out] cur Cursor to be initialized
+ * @param p_min Minimum position.
+ * @param p_max Maximum position.
+ * @return 0 if OK, -1 if the range is not valid
+ * */
+int sn_net_router_cursor_leafset(sn_net_router_cursor_t* cur, int32_t p_min, int32_t p_max);
+
+/**
+ * Serializes the next entries of a query into a caller buffer(as a packet payload), without allocating.
+ * Call again with the same cursor, until sn_net_router_cursor_done, for queries not fitting in one buffer.
+ * @param snr Router state
+ * @param cur Query cursor, advanced past the serialized entries
+ * @param[out] buf Buffer for a sn_net_router_query_ser_t
+ * @param cap Buffer size. Must fit at least one entry.
+ * @return 0 if ERROR; size of the query result otherwise
+ * */
+size_t sn_net_router_query_next(const sn_net_router_t* snr, sn_net_router_cursor_t* cur, void* buf, size_t cap);
+
+/**
+ * Tells if every entry of a query has been serialized
+ * @param cur Query cursor
+ * @return 1 if done, 0 otherwise
+ * */
+int sn_net_router_cursor_done(const sn_net_router_cursor_t* cur);
+
+/**
+ * Delta record flag, the entry is a table one(a leafset one otherwise)
+ * */
+#define SN_NET_ROUTER_DELTA_TABLE 1
+
+/**
+ * Delta record flag, the entry was removed and comes without network address
+ * */
+#define SN_NET_ROUTER_DELTA_REMOVED 2
+
+/**
+ * Largest delta record: flags, level or position, column, shared key bytes, key suffix and network address
+ * */
+#define SN_NET_ROUTER_DELTA_RECORD_MAX (4 + SN_NET_ADDR_LEN + sizeof(sn_io_naddr_ser_t))
+
+/**
+ * Position of a delta streamed with sn_net_router_delta_next
+ * */
+typedef struct {
+    uint32_t since; /**< Changes after this router version are sent */
+    uint32_t version; /**< Router version when the delta was started */
+    uint32_t next; /**< Next table slot(then leafset position) to be checked */
+} sn_net_router_delta_cursor_t;
+
+/**
+ * A serialized delta. Records are packed back to back:
+ * flags(1), level or position(1), column(1), shared(1), key[shared..SN_NET_ADDR_LEN), net_addr(if not removed).
+ * The first shared key bytes are the ones of the sender address.
+ * */
+typedef struct sn_net_router_delta_ser_t_ {
+    uint32_t version; /**< Sender router version, the since of the next delta */
+    uint32_t since; /**< Version the delta starts at */
+    uint32_t records_len; /**< Number of records */
+    unsigned char records[0]; /**< Records */
+} sn_net_router_delta_ser_t;
+
+/**
+ * Starts a delta with the changes made to the router after a version.
+ * Every table entry keeps the router version it was last changed at, adding an entry again
+ * with the same network address is no change. No node message carries deltas yet: join replies
+ * go to nodes holding no version of ours and repair replies carry a single slot, so both still
+ * send full sn_net_router_query_ser_t records. Deltas are for protocols keeping the version they
+ * last got from each peer.
+ * @param snr Router state
+ * @param[out] cur Cursor to be initialized
+ * @param since Router version the peer already has(0 for everything)
+ * */
+void sn_net_router_cursor_delta(const sn_net_router_t* snr, sn_net_router_delta_cursor_t* cur, uint32_t since);
+
+/**
+ * Encodes the next changes of a delta into a caller buffer, without allocating.
+ * Call again with the same cursor, until sn_net_router_delta_done, for deltas not fitting in one buffer.
+ * @param snr Router state
+ * @param cur Delta cursor, advanced past the encoded changes
+ * @param[out] buf Buffer for a sn_net_router_delta_ser_t
+ * @param cap Buffer size. Must fit at least SN_NET_ROUTER_DELTA_RECORD_MAX after the header.
+ * @return 0 if ERROR; size of the delta otherwise
+ * */
+size_t sn_net_router_delta_next(const sn_net_router_t* snr, sn_net_router_delta_cursor_t* cur, void* buf, size_t cap);
+
+/**
+ * Tells if every change of a delta has been encoded
+ * @param cur Delta cursor
+ * @return 1 if done, 0 otherwise
+ * */
+int sn_net_router_delta_done(const sn_net_router_delta_cursor_t* cur);
+
+/**
+ * Applies a delta received from another router. Entries are added as sn_net_router_add does, but
+ * never replace another live entry on their table slot, and removed ones are dropped only if they
+ * are the entry we have on their slot. Applying a delta twice changes nothing the second time.
+ * @param snr Router state
+ * @param from Address of the sender router
+ * @param buf Serialized delta
+ * @param len Delta size
+ * @param[out] out_version Sender version, to ask for the changes since then next time(can be NULL)
+ * @return 0 if OK, -1 if the delta is malformed
+ * */
+int sn_net_router_delta_apply(sn_net_router_t* snr, const sn_net_addr_t* from, const void* buf, size_t len, uint32_t* out_version);
+
+/**
+ * Gets a routing table row serialized like sn_net_router_query_table does. It is kept and only
+ * serialized again after the row changes, so answering many queries costs one serialization.
+ * @param snr Router state
+ * @param level Table level
+ * @param[out] out_len Size of the query result
+ * @return The query result(owned by the router, valid until it changes) or NULL if ERROR
+ * */
+const sn_net_router_query_ser_t* sn_net_router_cached_row(sn_net_router_t* snr, uint16_t level, size_t* out_len);
+
+/**
+ * Gets half of the leafset serialized like sn_net_router_query_leafset does, cached as sn_net_router_cached_row
+ * @param snr Router state
+ * @param right 1 for positions 0(ourselves) to SN_NET_ROUTER_LEAFSET_SIZE, 0 for the negative ones
+ * @param[out] out_len Size of the query result
+ * @return The query result(owned by the router, valid until it changes) or NULL if ERROR
+ * */
+const sn_net_router_query_ser_t* sn_net_router_cached_leafset(sn_net_router_t* snr, int right, size_t* out_len);
+
+/**
+ * Gets the router version, increased by every change
+ * @param snr Router state
+ * @return Router version
+ * */
+uint32_t sn_net_router_version(const sn_net_router_t* snr);
+
+struct sn_net_router_cache_t_ {
+    int built; /**< Has query been serialized? */
+    uint32_t version; /**< Row(or leafset) version query was serialized at */
+    sn_net_router_query_ser_t* query; /**< Serialized entries, allocated along the cache */
+};
+
 struct sn_net_router_t_ {
     sn_net_entry_t self; /**< Our address */
     sn_net_entry_t table[SN_NET_ROUTER_LEVELS][SN_NET_ROUTER_COLUMNS]; /**< Routing table */
     sn_net_entry_t left_leafset[SN_NET_ROUTER_LEAFSET_SIZE]; /**< Leafset */
     sn_net_entry_t right_leafset[SN_NET_ROUTER_LEAFSET_SIZE]; /**< Leafset */
+    uint32_t version; /**< Increased by every change */
+    uint32_t row_versions[SN_NET_ROUTER_LEVELS]; /**< Increased by every change to each table row */
+    uint32_t leafset_version; /**< Increased by every leafset change */
+    uint32_t table_stamps[SN_NET_ROUTER_LEVELS][SN_NET_ROUTER_COLUMNS]; /**< Router version each table entry was last changed at */
+    uint32_t leafset_stamp; /**< Router version the leafset was last changed at */
+    sn_net_router_cache_t* row_cache[SN_NET_ROUTER_LEVELS]; /**< Serialized rows, NULL until asked for */
+    sn_net_router_cache_t* leafset_cache[2]; /**< Serialized left and right leafset halves, NULL until asked for */
 };
 
 #ifdef __cplusplus
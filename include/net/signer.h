@@ -0,0 +1,84 @@
+/**
+ * @file
+ * Provides a pool of worker threads that sign packets off the caller's thread
+ * */
+
+#ifndef SN_NET_SIGNER_H_
+#define SN_NET_SIGNER_H_
+
+#include "net/packet.h"
+#include "crypto/sign.h"
+#include "util/closure.h"
+
+#include <stddef.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Maximum number of signer worker threads
+ * */
+#define SN_NET_SIGNER_MAX_WORKERS 64
+
+/**
+ * Holds a signer pool.
+ * Should NOT be used directly.
+ * */
+typedef struct sn_net_signer_t_ sn_net_signer_t;
+
+/**
+ * A queued signing job
+ * */
+typedef struct sn_net_signer_job_t_ sn_net_signer_job_t;
+
+/**
+ * Initializes a signer pool and starts its workers
+ * @param signer Pool to be initialized(must be already allocated)
+ * @param key Private sign key(copied)
+ * @param workers Number of worker threads. Between 1 and SN_NET_SIGNER_MAX_WORKERS.
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_net_signer_init(sn_net_signer_t* signer, const sn_crypto_sign_key_t* key, unsigned int workers);
+
+/**
+ * Finishes the pending jobs, stops the workers and destroys the pool
+ * @param signer Pool to be destroyed(but not deallocated)
+ * */
+void sn_net_signer_destroy(sn_net_signer_t* signer);
+
+/**
+ * Queues a packet for signing. Returns immediately.
+ * @param signer Pool
+ * @param packet Packet to be signed. Must not be touched until done is called.
+ * @param done Completion closure(copied). Called from a worker thread with argv = { packet }.
+ * @return 0 if queued, -1 if ERROR
+ * */
+int sn_net_signer_submit(sn_net_signer_t* signer, sn_net_packet_t* packet, const sn_util_closure_t* done);
+
+/**
+ * Signs a batch of packets in parallel. The calling thread signs a share of the batch too.
+ * @param signer Pool
+ * @param packets Packets to be signed
+ * @param count Number of packets
+ * @return 0 when all the packets are signed, -1 if ERROR(no packet is left half-processed)
+ * */
+int sn_net_signer_sign_many(sn_net_signer_t* signer, sn_net_packet_t* packets[], size_t count);
+
+struct sn_net_signer_t_ {
+    sn_crypto_sign_key_t key; /**< Private sign key */
+    unsigned int workers_len; /**< Number of running workers */
+    pthread_t workers[SN_NET_SIGNER_MAX_WORKERS]; /**< Worker threads */
+    pthread_mutex_t mut; /**< Protects the queue */
+    pthread_cond_t cond; /**< Signaled when a job is queued or the pool is stopping */
+    sn_net_signer_job_t* head; /**< First queued job */
+    sn_net_signer_job_t* tail; /**< Last queued job */
+    int stopping; /**< Set when the pool is being destroyed */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_NET_SIGNER_H_*/
@@ -7,11 +7,22 @@
 #define SN_NODE_H_
 
 #include "net/addr.h"
+#include "net/detector.h"
+#include "net/geometry.h"
 #include "net/router.h"
+#include "net/signer.h"
 #include "io/sock.h"
+#include "io/reactor.h"
+#include "io/runtime.h"
 #include "util/closure.h"
 #include "crypto/sign.h"
 #include "data/vec.h"
+#include "data/hmap.h"
+#include "data/cache.h"
+#include "data/erasure.h"
+#include "data/merkle.h"
+#include "data/store.h"
+#include "util/hist.h"
 
 #include <stdint.h>
 #include <pthread.h>
@@ -22,17 +33,330 @@
 extern "C" {
 #endif
 
+/**
+ * Milliseconds between runs of the node maintenance
+ * */
+#define SN_NODE_MAINTENANCE_PERIOD 1000
+
+/**
+ * Maximum number of packets read from the socket on each loop wakeup
+ * */
+#define SN_NODE_RECV_BUDGET 64
+
+/**
+ * SO_BUSY_POLL microseconds asked for the socket of busy polling nodes
+ * */
+#define SN_NODE_BUSY_POLL_SOCK_US 50
+
+/**
+ * Milliseconds sn_node_join waits for the replies of the nodes on the route
+ * */
+#define SN_NODE_JOIN_TIMEOUT 5000
+
+/**
+ * Nodes asked for a dead table entry by each repair round
+ * */
+#define SN_NODE_REPAIR_FANOUT 3
+
+/**
+ * Repair rounds before a table slot is left empty
+ * */
+#define SN_NODE_REPAIR_ATTEMPTS 3
+
+/**
+ * Minimum milliseconds between the repair rounds of a table slot
+ * */
+#define SN_NODE_REPAIR_INTERVAL 1000
+
+/**
+ * Maximum number of table slots being repaired at once
+ * */
+#define SN_NODE_REPAIR_MAX_PENDING 64
+
+/**
+ * Verification pings a learning node sends every maintenance period
+ * */
+#define SN_NODE_LEARN_RATE 16
+
+/**
+ * Maximum number of learnt entries waiting for their verification ping
+ * */
+#define SN_NODE_LEARN_MAX_PENDING 64
+
+/**
+ * Milliseconds a learnt entry waits for its verification ping reply
+ * */
+#define SN_NODE_LEARN_TIMEOUT 2000
+
+/**
+ * Milliseconds a shortcut is used without hearing straight from its destination
+ * */
+#define SN_NODE_SHORTCUT_TTL 10000
+
+/**
+ * Maximum number of shortcuts(and pending offers)
+ * */
+#define SN_NODE_SHORTCUT_MAX 256
+
+/**
+ * Shortcut offers a node sends every maintenance period
+ * */
+#define SN_NODE_SHORTCUT_OFFER_RATE 16
+
+/**
+ * Minimum milliseconds between shortcut offers to the same node
+ * */
+#define SN_NODE_SHORTCUT_OFFER_INTERVAL 5000
+
+/**
+ * Milliseconds the second copy of a hedged message waits until enough replies were seen
+ * */
+#define SN_NODE_HEDGE_DEFAULT_DELAY 50
+
+/**
+ * Bounds of the hedging delay in milliseconds
+ * */
+#define SN_NODE_HEDGE_MIN_DELAY 1
+#define SN_NODE_HEDGE_MAX_DELAY 1000
+
+/**
+ * Reply latency quantile used as the hedging delay
+ * */
+#define SN_NODE_HEDGE_QUANTILE 0.95
+
+/**
+ * Replies between hedging delay updates
+ * */
+#define SN_NODE_HEDGE_MIN_SAMPLES 16
+
+/**
+ * Replies after which older latencies are forgotten
+ * */
+#define SN_NODE_HEDGE_WINDOW 1024
+
+/**
+ * Maximum number of hedged messages waiting for their second copy or reply
+ * */
+#define SN_NODE_HEDGE_MAX_PENDING 256
+
+/**
+ * Milliseconds a hedged message waits for its reply
+ * */
+#define SN_NODE_HEDGE_REPLY_WAIT 10000
+
+/**
+ * Hedged messages and publications remembered to drop their duplicates
+ * */
+#define SN_NODE_DEDUP_LEN 256
+
+/**
+ * Closest contacts kept by an iterative lookup
+ * */
+#define SN_NODE_LOOKUP_SHORTLIST 16
+
+/**
+ * Milliseconds after which a lookup query stops counting as in flight
+ * */
+#define SN_NODE_LOOKUP_RPC_TIMEOUT 200
+
+/**
+ * Milliseconds between the timeout checks of running lookups
+ * */
+#define SN_NODE_LOOKUP_TICK 20
+
+/**
+ * Members each membership change is pushed to per maintenance period(one-hop geometry)
+ * */
+#define SN_NODE_GOSSIP_FANOUT 3
+
+/**
+ * Maintenance periods a membership change is pushed for, times the bits of the member count
+ * */
+#define SN_NODE_GOSSIP_REPEAT 2
+
+/**
+ * Membership changes being spread at most. A later one takes the place of the one closest to being spread
+ * everywhere(the oldest of them on ties).
+ * */
+#define SN_NODE_GOSSIP_MAX_RUMORS 256
+
+/**
+ * Milliseconds a member that left is remembered, so older news of it being alive are ignored
+ * */
+#define SN_NODE_GOSSIP_FORGET_AFTER 60000
+
+/**
+ * Milliseconds between the subscriptions a topic tree member renews with its parent
+ * */
+#define SN_NODE_TOPIC_REFRESH 5000
+
+/**
+ * Milliseconds a topic tree child is kept without renewing its subscription
+ * */
+#define SN_NODE_TOPIC_CHILD_TTL (3*SN_NODE_TOPIC_REFRESH)
+
+/**
+ * Milliseconds each aggregation tree level keeps for sending its result up, taken off the budget of its children
+ * */
+#define SN_NODE_AGGREGATE_HOP_MARGIN 50
+
+/**
+ * Milliseconds between the deadline checks of pending aggregations
+ * */
+#define SN_NODE_AGGREGATE_TICK 10
+
+/**
+ * Buckets of aggregated histograms, one per power of two
+ * */
+#define SN_NODE_AGGREGATE_BUCKETS 64
+
+/**
+ * Closest leafset entries on each side of a key owner holding a replica of its values
+ * */
+#define SN_NODE_STORE_REPLICAS 2
+
+/**
+ * Milliseconds between the reconciliations of the values a node owns with its replicas
+ * */
+#define SN_NODE_SYNC_PERIOD 10000
+
+/**
+ * Data fragments objects are split in, any SN_NODE_OBJECT_DATA fragments(data or parity) rebuild the object
+ * */
+#define SN_NODE_OBJECT_DATA 4
+
+/**
+ * Parity fragments added to the data ones, as many holders may be lost
+ * */
+#define SN_NODE_OBJECT_PARITY 2
+
+/**
+ * Most bytes of a fragment carried by a packet, longer fragments are split in parts
+ * */
+#define SN_NODE_OBJECT_PART_MAX 912
+
+/**
+ * Most parts of a fragment
+ * */
+#define SN_NODE_OBJECT_PARTS 16
+
+/**
+ * Most bytes of a fragment
+ * */
+#define SN_NODE_OBJECT_FRAGMENT_MAX (SN_NODE_OBJECT_PARTS*SN_NODE_OBJECT_PART_MAX)
+
+/**
+ * Most bytes of an object
+ * */
+#define SN_NODE_OBJECT_MAX_LEN (SN_NODE_OBJECT_DATA*SN_NODE_OBJECT_FRAGMENT_MAX)
+
+/**
+ * Object packets sent per SN_NODE_OBJECT_TICK, the rest wait so the parts do not flood their receivers
+ * */
+#define SN_NODE_OBJECT_BURST 4
+
+/**
+ * Milliseconds between bursts of object packets
+ * */
+#define SN_NODE_OBJECT_TICK 1
+
+/**
+ * Values a relay keeps in its path cache
+ * */
+#define SN_NODE_CACHE_SLOTS 256
+
+/**
+ * Milliseconds a relay answers gets with a value it cached
+ * */
+#define SN_NODE_CACHE_TTL 2000
+
+/**
+ * Gets a relay remembers forwarding, only their answers are cached
+ * */
+#define SN_NODE_CACHE_GETS 256
+
 /**
  * Holds the state of a node.
  * Should NOT be modified directly.
  * */
 typedef struct sn_node_t_ sn_node_t;
 
+/**
+ * Holds a socket shared by many node identities.
+ * Should NOT be modified directly.
+ * */
+typedef struct sn_node_mux_t_ sn_node_mux_t;
+
 /**
  * Upcall callback type. Called when a message is received.
  * */
 typedef int (*sn_upcall_t)(const unsigned char msg[], unsigned long long msg_len);
 
+/**
+ * Node counters, see sn_node_get_stats
+ * */
+typedef struct {
+    uint64_t received; /**< Packets read from the socket(or handed by a mux) */
+    uint64_t rejected; /**< Packets dropped because of a bad signature */
+    sn_util_hist_t forward_ns; /**< Nanoseconds from reading a packet to having forwarded or delivered it */
+    sn_util_hist_t queue_ns; /**< Nanoseconds packets waited on the socket queue, with receive telemetry enabled */
+    uint64_t kernel_drops; /**< Packets the kernel dropped because the socket queue was full, with receive telemetry enabled. Counted from the first report the node sees, for the whole socket if shared */
+    uint64_t probes; /**< Pings sent to quiet neighbors by the failure detector */
+    uint64_t failures; /**< Neighbors removed by the failure detector */
+    uint64_t repairs; /**< Table slots refilled by repairs */
+    uint64_t learned; /**< Table slots filled from observed traffic */
+    uint64_t shortcut_lookups; /**< Own user packets and replies looked up on the shortcuts */
+    uint64_t shortcut_hits; /**< Own user packets and replies sent straight to their destination */
+    uint64_t shortcut_hops_saved; /**< Overlay hops saved by shortcuts, for the ones whose route length is known */
+    uint64_t hedges_sent; /**< Second copies of hedged messages sent */
+    uint64_t hedges_avoided; /**< Hedged messages answered before their second copy was due */
+    uint64_t duplicates; /**< Copies of hedged messages and publications dropped as duplicates */
+    uint64_t tree_copies; /**< Publications sent down topic trees */
+    uint64_t broadcast_copies; /**< Broadcast copies sent, ours and relayed */
+    uint64_t store_puts; /**< Values stored as their key owner */
+    uint64_t store_replicas; /**< Replicas sent to the leafset, and taken from the owner */
+    uint64_t store_gets; /**< Gets answered, by the owner or by a replica on the way */
+    uint64_t sync_digests; /**< Merkle tree digests sent to reconcile replicas */
+    uint64_t sync_items; /**< Values sent to a replica because it lacked them */
+    uint64_t object_fragments; /**< Object fragments kept whole as their holder */
+    uint64_t object_decodes; /**< Own object gets rebuilt from parity fragments */
+    uint64_t cache_fills; /**< Values cached as they went back through us */
+    uint64_t cache_hits; /**< Gets answered from the path cache */
+} sn_node_stats_t;
+
+/**
+ * Per node values aggregated by sn_node_aggregate
+ * */
+typedef enum {
+    SN_NODE_METRIC_NODES = 0, /**< 1, its count and sum are the number of nodes */
+    SN_NODE_METRIC_RECEIVED = 1, /**< Packets received */
+    SN_NODE_METRIC_FORWARDED = 2, /**< Packets forwarded or delivered */
+    SN_NODE_METRIC_KERNEL_DROPS = 3, /**< Packets dropped by the kernel, with receive telemetry enabled */
+    SN_NODE_METRIC_QUEUE_NS = 4, /**< Longest wait on the socket queue, with receive telemetry enabled */
+    SN_NODE_METRICS
+} sn_node_metric_t;
+
+/**
+ * A network-wide aggregate, see sn_node_aggregate
+ * */
+typedef struct {
+    uint64_t count; /**< Nodes that answered */
+    uint64_t sum; /**< Sum of their values */
+    uint64_t min; /**< Smallest value(UINT64_MAX if none answered) */
+    uint64_t max; /**< Largest value */
+    uint32_t hist[SN_NODE_AGGREGATE_BUCKETS]; /**< Nodes per power of two, bucket i counting values with i significant bits */
+} sn_node_aggregate_t;
+
+/**
+ * A message to be sent with sn_node_send_many
+ * */
+typedef struct sn_node_msg_t_ {
+    const sn_net_addr_t* dst; /**< Destination address */
+    uint8_t type; /**< Message type */
+    size_t len; /**< Message length */
+    const char* payload; /**< Message payload */
+} sn_node_msg_t;
+
 /**
  * Initializes a node
  * @param sns State to be initialized(must be already allocated)
@@ -44,6 +368,47 @@ typedef int (*sn_upcall_t)(const unsigned char msg[], unsigned long long msg_len
  * */
 int sn_node_at_socket(sn_node_t* sns, const sn_crypto_sign_key_t* sk, const sn_crypto_sign_pubkey_t* pk, const sn_io_sock_t socket, int check_sign);
 
+/**
+ * Initializes a node hosted on a runtime. No thread is started, the node socket and
+ * timers are run by the runtime workers.
+ * @param sns State to be initialized(must be already allocated)
+ * @param rt Runtime. Must outlive the node.
+ * @param sk Node secret key
+ * @param pk Node public key and SecondNet address
+ * @param socket Listening socket
+ * @param check_sign If set messages not signed will be rejected
+ * @return 0 if OK, -1 otherwise
+ * */
+int sn_node_at_runtime(sn_node_t* sns, sn_io_runtime_t* rt, const sn_crypto_sign_key_t* sk, const sn_crypto_sign_pubkey_t* pk, const sn_io_sock_t socket, int check_sign);
+
+/**
+ * Initializes a shared socket. Received packets are handed to the local identity
+ * matching their destination, or to the first identity(which forwards them) if none does.
+ * @param mux Mux to be initialized(must be already allocated)
+ * @param rt Runtime running the socket. Must outlive the mux.
+ * @param socket Listening socket(the mux takes ownership)
+ * @return 0 if OK, -1 otherwise
+ * */
+int sn_node_mux_init(sn_node_mux_t* mux, sn_io_runtime_t* rt, const sn_io_sock_t socket);
+
+/**
+ * Destroys a shared socket and closes it. Every identity must be destroyed first.
+ * @param mux Mux to be destroyed(but not deallocated)
+ * */
+void sn_node_mux_destroy(sn_node_mux_t* mux);
+
+/**
+ * Initializes a node identity on a shared socket. Packets between identities of the same mux
+ * never reach the network.
+ * @param sns State to be initialized(must be already allocated)
+ * @param mux Shared socket. Must outlive the node.
+ * @param sk Node secret key
+ * @param pk Node public key and SecondNet address. Unique within the mux.
+ * @param check_sign If set messages not signed will be rejected
+ * @return 0 if OK, -1 otherwise
+ * */
+int sn_node_at_mux(sn_node_t* sns, sn_node_mux_t* mux, const sn_crypto_sign_key_t* sk, const sn_crypto_sign_pubkey_t* pk, int check_sign);
+
 /**
  * Initializes a node from a string address and a listening port
  * @param sns State to be initialized(must be already allocated)
@@ -106,7 +471,8 @@ void sn_node_set_forward_callback(sn_node_t* sns, sn_util_closure_t* cb);
 void sn_node_set_deliver_callback(sn_node_t* sns, sn_util_closure_t* cb);
 
 /**
- * Sends a message
+ * Sends a message. Thread safe, the routes are read under task_mut like the node loop changes them,
+ * so it must not be called from the node loop(handlers, callbacks and reply closures).
  * @param sns Node state
  * @param dst Destination address
  * @param len Message length
@@ -116,7 +482,7 @@ void sn_node_set_deliver_callback(sn_node_t* sns, sn_util_closure_t* cb);
 int sn_node_send(sn_node_t* sns, const sn_net_addr_t* dst, size_t len, const char* payload);
 
 /**
- * Sends a typed message
+ * Sends a typed message. Thread safe like sn_node_send, not from the node loop.
  * @param sns Node state
  * @param dst Destination address
  * @aram type Message type
@@ -127,7 +493,537 @@ int sn_node_send(sn_node_t* sns, const sn_net_addr_t* dst, size_t len, const cha
 int sn_node_send_typed(sn_node_t* sns, const sn_net_addr_t* dst, uint8_t type, size_t len, const char* payload);
 
 /**
- * Joins a SecondNet network using a know gateway
+ * Sends a typed message from the node loop, where task_mut is already held. Used by the handlers.
+ * @param sns Node state
+ * @param dst Destination address
+ * @param type Message type
+ * @param len Message length
+ * @param payload Message payload
+ * @return -1 if error
+ */
+int sn_node_send_typed_locked(sn_node_t* sns, const sn_net_addr_t* dst, uint8_t type, size_t len, const char* payload);
+
+/**
+ * Sends a typed message straight to a network address, without routing it
+ * @param sns Node state
+ * @param dst Destination address
+ * @param net_addr Destination network address
+ * @param type Message type
+ * @param len Message length
+ * @param payload Message payload
+ * @return 0 if OK, -1 if error
+ */
+int sn_node_send_direct(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* net_addr, uint8_t type, size_t len, const char* payload);
+
+/**
+ * Starts a pool of signer threads so sends do not sign on the caller's thread.
+ * Not thread safe with respect to sends.
+ * @param sns Node state
+ * @param workers Number of signer threads. 0 stops the pool and signs on the caller's thread again.
+ * @return 0 if OK, -1 otherwise
+ * */
+int sn_node_set_signers(sn_node_t* sns, unsigned int workers);
+
+/**
+ * Sends a typed message asynchronously. The message is signed and routed by a signer thread(under task_mut).
+ * Without signer threads the message is sent before returning. Thread safe, not from the node loop.
+ * @param sns Node state
+ * @param dst Destination address
+ * @param type Message type
+ * @param len Message length
+ * @param payload Message payload(copied)
+ * @param done Optional completion closure(copied). Called with argv = { int* status }, status is 0 if sent, -1 if error.
+ * @return -1 if the message could not be queued(done is not called then)
+ * */
+int sn_node_send_async(sn_node_t* sns, const sn_net_addr_t* dst, uint8_t type, size_t len, const char* payload, const sn_util_closure_t* done);
+
+/**
+ * Sends a batch of messages. Messages are signed in parallel by the signer threads and
+ * the ones going to the network are transmitted with batched syscalls. Thread safe, not from the node loop.
+ * @param sns Node state
+ * @param msgs Messages
+ * @param count Number of messages
+ * @return Number of messages sent, -1 if error
+ * */
+int sn_node_send_many(sn_node_t* sns, const sn_node_msg_t msgs[], size_t count);
+
+/**
+ * Switches the node loop between blocking and busy polling. A busy polling loop spins on non-blocking
+ * batched reads and only blocks after idle_us without traffic, until the next packet. Trades a core
+ * for lower latency. Only for nodes with their own thread.
+ * @param sns Node state
+ * @param idle_us Microseconds without traffic before blocking, 0 for the blocking loop
+ * @return 0 if OK, -1 otherwise
+ * */
+int sn_node_set_busy_poll(sn_node_t* sns, unsigned int idle_us);
+
+/**
+ * Enables kernel receive telemetry on the node socket: the time each packet waited on the socket
+ * queue and the packets dropped because it was full end up in the node counters. Nodes sharing a
+ * mux share its socket, so it is enabled for all of them.
+ * @param sns Node state
+ * @param enable 1 to enable, 0 to disable
+ * @return 0 if OK, -1 if ERROR or not supported
+ * */
+int sn_node_set_rx_telemetry(sn_node_t* sns, int enable);
+
+/**
+ * Removes a table entry found dead and refills its slot without rejoining. The nodes on the same
+ * row(then the next one) are asked for their entry at level and column, right away and again every
+ * SN_NODE_REPAIR_INTERVAL until one answers. Dead entries found by the failure detector are repaired too.
+ * Repairs of the same slot are coalesced, and slots holding another entry are left alone.
+ * @param sns Node state
+ * @param level Table level
+ * @param column Table column
+ * @param dead Address of the entry found dead
+ * @return 0 if OK, -1 if ERROR or too many repairs are running
+ * */
+int sn_node_repair(sn_node_t* sns, unsigned int level, unsigned int column, const sn_net_addr_t* dead);
+
+/**
+ * Enables or disables table learning(disabled by default). Nodes found sending packets straight
+ * to this one fill its empty table slots once they answer a direct ping. Pings are limited to
+ * SN_NODE_LEARN_RATE per maintenance period.
+ * @param sns Node state
+ * @param enable 1 to enable, 0 to disable
+ * */
+void sn_node_set_learning(sn_node_t* sns, int enable);
+
+/**
+ * Enables or disables direct-path shortcuts(disabled by default). A node receiving user packets or replies
+ * that took several overlay hops offers the source its netaddress, and a source sending straight to a node
+ * teaches it its own. Later user packets and replies to those destinations are sent in one hop while packets
+ * keep coming straight from them(SN_NODE_SHORTCUT_TTL), falling back to the overlay otherwise.
+ * @param sns Node state
+ * @param enable 1 to enable, 0 to disable
+ * */
+void sn_node_set_shortcuts(sn_node_t* sns, int enable);
+
+/**
+ * Adds(or refreshes) a shortcut
+ * @param sns Node state
+ * @param dst Destination
+ * @param net_addr Destination netaddress
+ * @param hops Overlay hops to the destination, 0 if unknown
+ * @return 0 if OK, -1 if ERROR or there are too many shortcuts
+ * */
+int sn_node_add_shortcut(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* net_addr, uint8_t hops);
+
+/**
+ * Sends a message hedged against slow relays. A second copy goes through the best alternative nexthop
+ * unless the reply arrives first, after a delay following the recent reply latencies(SN_NODE_HEDGE_QUANTILE).
+ * The destination delivers only the first copy. The reply listener must be registered by the caller, and
+ * gets the first reply. Thread safe like sn_node_send, not from the node loop.
+ * @param sns Node state
+ * @param dst Destination address
+ * @param type Inner packet type. Types with forward handlers(join) cannot be hedged.
+ * @param len Payload length
+ * @param payload Payload
+ * @param reply_id Reply ID answering the message, 0 if there is none(the second copy is always sent)
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_send_hedged(sn_node_t* sns, const sn_net_addr_t* dst, uint8_t type, size_t len, const char* payload, uint32_t reply_id);
+
+/**
+ * Looks up the owner of an address iteratively. The closest known contacts are asked for closer ones,
+ * alpha of them at once, until one tells it owns the address. Contacts not answering in
+ * SN_NODE_LOOKUP_RPC_TIMEOUT are routed around, their answers are still taken until the lookup ends.
+ * Queries are LOOKUP messages sent straight to each contact, answered with a REPLY.
+ * @param sns Node state
+ * @param target Address to be looked up
+ * @param alpha Queries in flight at most
+ * @param timeout_ms Milliseconds until the lookup fails
+ * @param done Closure(copied) called once with argv = { owner entry(const sn_net_entry_t*, NULL if not found), queries sent(unsigned int*) },
+ * right away if this node owns the address. Otherwise it is called from the node loop and must not start another lookup.
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_lookup(sn_node_t* sns, const sn_net_addr_t* target, unsigned int alpha, uint64_t timeout_ms, const sn_util_closure_t* done);
+
+/**
+ * Picks the routing geometry nexthops are chosen with. Should be called before the node sends or
+ * receives anything. The router keeps every entry for joins, repairs and lookups whatever the
+ * geometry, and the other geometries are seeded with its entries and get the ones added later.
+ * Every node of a network should use the same geometry, they disagree on who owns an address.
+ * @param sns Node state
+ * @param geometry sn_net_geometry_pastry(the default), sn_net_geometry_kademlia, sn_net_geometry_onehop or another geometry
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_set_geometry(sn_node_t* sns, const sn_net_geometry_t* geometry);
+
+/**
+ * Adds an entry to the router and the routing geometry, our own address is ignored.
+ * Thread safe like sn_node_send, not from the node loop.
+ * @param sns Node state
+ * @param addr Second Net address
+ * @param net_addr Underlying network address
+ * */
+void sn_node_add_route(sn_node_t* sns, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr);
+
+/**
+ * Adds an entry like sn_node_add_route from the node loop, where task_mut is already held.
+ * Used by the handlers and the repair, learning, join and gossip code.
+ * @param sns Node state
+ * @param addr Second Net address
+ * @param net_addr Underlying network address
+ * */
+void sn_node_add_route_locked(sn_node_t* sns, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr);
+
+/**
+ * Tells the nexthop the routing geometry picks. The routes are read without locking, so it is for the node loop,
+ * callers holding task_mut or nodes whose routes no longer change.
+ * @param sns Node state
+ * @param dst Destination address
+ * @param[out] nexthop Entry to store the result(is_set = 0 if the node owns dst)
+ * */
+void sn_node_nexthop(const sn_node_t* sns, const sn_net_addr_t* dst, sn_net_entry_t* nexthop);
+
+/**
+ * Applies a membership change heard from a gossip peer and spreads it further if it was news.
+ * Changes about newer member incarnations win, and leaving wins over joining within an incarnation.
+ * Only the one-hop geometry gossips. Used by the members handler.
+ * @param sns Node state
+ * @param e Member(is_set = 1 if it joined, 0 if it left)
+ * @param incarnation Member incarnation, bumped by the member itself when it hears it left
+ * */
+void sn_node_gossip_heard(sn_node_t* sns, const sn_net_entry_t* e, uint32_t incarnation);
+
+/**
+ * Hashes a topic name into the address of its tree root
+ * @param name Topic name
+ * @param[out] topic Topic address
+ * */
+void sn_node_topic(const char* name, sn_net_addr_t* topic);
+
+/**
+ * Subscribes to a topic, joining its multicast tree. Subscribing again replaces the closure.
+ * @param sns Node state
+ * @param topic Topic address
+ * @param on_publish Closure(copied) called from the node loop for every publication with
+ * argv = { topic(const sn_net_addr_t*), msg(const unsigned char*), msg_len(unsigned long long*) }.
+ * It must not subscribe, unsubscribe or publish.
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_subscribe(sn_node_t* sns, const sn_net_addr_t* topic, const sn_util_closure_t* on_publish);
+
+/**
+ * Drops a topic subscription. The node stays on the tree while it has children.
+ * @param sns Node state
+ * @param topic Topic address
+ * @return 0 if OK, -1 if not subscribed
+ * */
+int sn_node_unsubscribe(sn_node_t* sns, const sn_net_addr_t* topic);
+
+/**
+ * Publishes a message to the subscribers of a topic. It is signed once and routed up to the
+ * topic root, the tree nodes on its way sending it down their other branches, one copy per edge.
+ * @param sns Node state
+ * @param topic Topic address
+ * @param len Message length
+ * @param msg Message
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_publish(sn_node_t* sns, const sn_net_addr_t* topic, size_t len, const char* msg);
+
+/**
+ * Adds(or removes) a child of a topic tree, joining the tree if needed. Used by the subscribe handler.
+ * @param sns Node state
+ * @param topic Topic address
+ * @param child Child address
+ * @param net_addr Child network address
+ * @param leave Is the child leaving?
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_topic_heard(sn_node_t* sns, const sn_net_addr_t* topic, const sn_net_addr_t* child, const sn_io_naddr_t* net_addr, int leave);
+
+/**
+ * Sends a publication going up to the topic root down our branches of the tree and to the local
+ * subscription, then signs it as ours if we are on the tree. DOWN copies, addressed to the topic
+ * too, are delivered here instead. Used by the publish handler.
+ * @param sns Node state
+ * @param packet Publication
+ * @param[in,out] nexthop Nexthop the publication goes on to, unset for DOWN copies
+ * @return 0 if it goes on, -1 if it is dropped(malformed or a duplicate)
+ * */
+int sn_node_topic_forward(sn_node_t* sns, sn_net_packet_t* packet, sn_net_entry_t* nexthop);
+
+/**
+ * Sends a publication reaching the topic root, or a DOWN copy sent straight by our parent, down the tree
+ * and to the local subscription. Used by the publish handler.
+ * @param sns Node state
+ * @param packet Publication
+ * @param rem_addr Network address it came from, NULL if it is our own
+ * @return 0 if OK, -1 if ERROR or dropped
+ * */
+int sn_node_topic_deliver(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+
+/**
+ * Sets the closure broadcasts reaching this node are delivered to
+ * @param sns Node state
+ * @param on_broadcast Closure(copied) called under the node loop with argv = { origin address, message, unsigned long long* length }. NULL to stop delivering.
+ * */
+void sn_node_set_broadcast_callback(sn_node_t* sns, const sn_util_closure_t* on_broadcast);
+
+/**
+ * Sends a message to every node, each getting a single copy. It is split across the routing table,
+ * whose entries split it further across their own(see sn_net_router_split).
+ * @param sns Node state
+ * @param len Message length
+ * @param msg Message
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_broadcast(sn_node_t* sns, size_t len, const char* msg);
+
+/**
+ * Sends a message to every node between two addresses, as a broadcast pruned to the subtrees covering the range
+ * @param sns Node state
+ * @param lo Lowest address
+ * @param hi Highest address. Ranges do not wrap around.
+ * @param len Message length
+ * @param msg Message
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_multicast_range(sn_node_t* sns, const sn_net_addr_t* lo, const sn_net_addr_t* hi, size_t len, const char* msg);
+
+/**
+ * Splits a broadcast copy further and delivers it if we are on its range. Used by the broadcast handler.
+ * @param sns Node state
+ * @param packet Broadcast copy
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_broadcast_heard(sn_node_t* sns, const sn_net_packet_t* packet);
+
+/**
+ * Aggregates a value over every node. The query is split across the routing tables like a broadcast
+ * and every node sends a single result up, merging its value with the ones of its subtree, so the
+ * origin only hears from its own table entries.
+ * @param sns Node state
+ * @param metric Value to be aggregated, a sn_node_metric_t
+ * @param timeout_ms Milliseconds until the result is given with the nodes that answered so far.
+ *                   Each tree level takes SN_NODE_AGGREGATE_HOP_MARGIN off the budget of the next.
+ * @param done Closure(copied) called once with argv = { const sn_node_aggregate_t* }, right away if there is no one to ask.
+ *             Otherwise it is called from the node loop and must not start another aggregation.
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_aggregate(sn_node_t* sns, uint8_t metric, uint64_t timeout_ms, const sn_util_closure_t* done);
+
+/**
+ * Splits an aggregation query further, or merges a subtree result. Used by the aggregate handler.
+ * @param sns Node state
+ * @param packet Query or result
+ * @param rem_addr Network address it came from
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_aggregate_heard(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+
+/**
+ * Stores a value on the owner of a key, which replicates it to the SN_NODE_STORE_REPLICAS closest
+ * entries on each side of its leafset. Versions are the owner wall clock(in ns), one more than the
+ * stored one if that is ahead.
+ * @param sns Node state
+ * @param key Key
+ * @param len Value length
+ * @param value Value
+ * @param timeout_ms Milliseconds to wait for the owner acknowledgement
+ * @param done Closure(copied) called once with argv = { const uint64_t* version } when the owner stored it,
+ *             or with a NULL version on timeout. Called from the node loop(or right away if we own the key), where it must not put or get.
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_put(sn_node_t* sns, const sn_net_addr_t* key, size_t len, const char* value, uint64_t timeout_ms, const sn_util_closure_t* done);
+
+/**
+ * Gets the value of a key. The request is routed to the owner and answered by the first node on
+ * its way holding the key, its replicas being the ones closest to the owner.
+ * Replicas may answer with an older version for a while after a put.
+ * @param sns Node state
+ * @param key Key
+ * @param timeout_ms Milliseconds to wait for the answer
+ * @param done Closure(copied) called once with argv = { const char* value, unsigned long long* len, const uint64_t* version },
+ *             value being NULL if the key is not stored or on timeout. Called like the sn_node_put one.
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_get(sn_node_t* sns, const sn_net_addr_t* key, uint64_t timeout_ms, const sn_util_closure_t* done);
+
+/**
+ * Tells if a key is stored here and we are still one of its replicas, copies kept from before
+ * the leafset changed are not. Used by the store handler to answer gets on their way.
+ * @param sns Node state
+ * @param key Key
+ * @return 1 if it is, 0 otherwise
+ * */
+int sn_node_store_holds(sn_node_t* sns, const sn_net_addr_t* key);
+
+/**
+ * Stores, replicates or answers a store message, or passes an answer to its listener. Used by the store handler.
+ * Replicas are only taken from leafset neighbors, for keys this node replicates.
+ * @param sns Node state
+ * @param packet Store message
+ * @param rem_addr Network address it came from, NULL if it is our own
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_store_heard(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+
+/**
+ * Enables or disables the path cache(disabled by default). Values going back to the source of a get
+ * are kept by the relays that forwarded the get, which answer later gets of the same keys for SN_NODE_CACHE_TTL,
+ * so hot keys are served close to their readers instead of by their owner. At most SN_NODE_CACHE_SLOTS
+ * values are kept, the ones not read lately evicted first, and puts going through a relay drop its copy.
+ * Each answer replaces the copy kept, whatever their versions.
+ * @param sns Node state
+ * @param enable 1 to enable, 0 to disable
+ * */
+void sn_node_set_path_cache(sn_node_t* sns, int enable);
+
+/**
+ * Caches a value on its way back, drops a copy a put replaces, or answers a get from the cache.
+ * Used by the store handler on the store messages we forward.
+ * @param sns Node state
+ * @param packet Store message
+ * @param rem_addr Network address it came from, NULL if it is our own
+ * @return 1 if the get was answered, 0 if the message goes on, -1 if ERROR
+ * */
+int sn_node_cache_heard(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+
+/**
+ * Reconciles the values we own with our replicas now, instead of waiting for the next SN_NODE_SYNC_PERIOD.
+ * Both sides compare their Merkle trees top-down over the owned range and only exchange the keys under
+ * differing leaves, each one ending up with the newest version of every value.
+ * @param sns Node state
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_sync(sn_node_t* sns);
+
+/**
+ * Answers a reconciliation message. Used by the sync handler.
+ * @param sns Node state
+ * @param packet Sync message
+ * @param rem_addr Network address it came from
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_sync_heard(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+
+/**
+ * Stores an object erasure coded in SN_NODE_OBJECT_DATA data and SN_NODE_OBJECT_PARITY parity fragments,
+ * each sent in parts of at most SN_NODE_OBJECT_PART_MAX bytes. The owner of the key keeps the first one and
+ * places the others on its leafset, alternating sides(keeping the ones it has no leafset entry for).
+ * Holders move their fragments to the new holder when the leafset changes.
+ * @param sns Node state
+ * @param key Key
+ * @param len Object length, at most SN_NODE_OBJECT_MAX_LEN
+ * @param value Object
+ * @param timeout_ms Milliseconds to wait for every holder acknowledgement
+ * @param done Closure(copied) called once with argv = { const uint64_t* version } when every fragment was stored,
+ *             or with a NULL version on timeout. Called like the sn_node_put one.
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_object_put(sn_node_t* sns, const sn_net_addr_t* key, size_t len, const char* value, uint64_t timeout_ms, const sn_util_closure_t* done);
+
+/**
+ * Gets an object. The owner of the key asks every fragment holder, which answers with every fragment of
+ * the key it has, and the object is rebuilt from the first SN_NODE_OBJECT_DATA fragments of the same
+ * version to arrive whole.
+ * @param sns Node state
+ * @param key Key
+ * @param timeout_ms Milliseconds to wait for the fragments
+ * @param done Closure(copied) called once with argv = { const char* value, unsigned long long* len, const uint64_t* version },
+ *             value being NULL if too few fragments are stored or on timeout. Called like the sn_node_put one.
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_object_get(sn_node_t* sns, const sn_net_addr_t* key, uint64_t timeout_ms, const sn_util_closure_t* done);
+
+/**
+ * Places, keeps or answers for an object fragment, or passes an answer to its listener. Used by the object handler.
+ * @param sns Node state
+ * @param packet Object message
+ * @param rem_addr Network address it came from, NULL if it is our own
+ * @return 0 if OK, -1 if ERROR
+ * */
+int sn_node_object_heard(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+
+/**
+ * Tells if a hedged message(or a publication) was already delivered, remembering it otherwise.
+ * Used by the hedged message and publish handlers.
+ * @param sns Node state
+ * @param src Message source
+ * @param nonce Message nonce
+ * @return 1 if it is a duplicate, 0 otherwise
+ * */
+int sn_node_dedup(sn_node_t* sns, const sn_net_addr_t* src, const unsigned char nonce[8]);
+
+/**
+ * Enables or disables neighbor failure detection(enabled by default). Any packet from a neighbor counts
+ * as a heartbeat, neighbors gone quiet are pinged and the ones not answering are removed from the router.
+ * @param sns Node state
+ * @param enable 1 to enable, 0 to disable
+ * */
+void sn_node_set_failure_detection(sn_node_t* sns, int enable);
+
+/**
+ * Gets a snapshot of the node counters. Thread safe.
+ * @param sns Node state
+ * @param[out] out_stats Where to store the counters
+ * */
+void sn_node_get_stats(sn_node_t* sns, sn_node_stats_t* out_stats);
+
+/**
+ * Clears the node counters. Thread safe.
+ * @param sns Node state
+ * */
+void sn_node_reset_stats(sn_node_t* sns);
+
+/**
+ * Runs a closure on the node loop thread(a runtime worker for hosted nodes). Thread safe.
+ * The closure runs without task_mut held, like a caller thread, so it may call any node function
+ * but it is not serialized with the handlers.
+ * @param sns Node state
+ * @param closure Closure(copied) called with argc = 0
+ * @return 0 if OK, -1 otherwise
+ * */
+int sn_node_post(sn_node_t* sns, const sn_util_closure_t* closure);
+
+/**
+ * Gets a fresh reply ID
+ * @param sns Node state
+ * @return A reply ID not recently used by this node
+ * */
+uint32_t sn_node_new_reply_id(sn_node_t* sns);
+
+/**
+ * Registers a listener for replies with a given ID
+ * @param sns Node state
+ * @param reply_id Reply ID
+ * @param closure Closure(copied). Called with argv = { const char* reply_cnt, unsigned long long* reply_cnt_len, const sn_net_addr_t* src }
+ *                when a reply arrives(src is its sender, NULL if unknown) and with reply_cnt = src = NULL when the listener times out.
+ * @param once If set the listener is removed after the first reply
+ * @param timeout_ms Milliseconds until the listener expires, 0 for listeners that never expire
+ * @return 0 if OK, -1 otherwise
+ * */
+int sn_node_register_reply(sn_node_t* sns, uint32_t reply_id, const sn_util_closure_t* closure, int once, uint64_t timeout_ms);
+
+/**
+ * Removes a reply listener without calling it
+ * @param sns Node state
+ * @param reply_id Reply ID
+ * @return 0 if removed, -1 if there was no such listener
+ * */
+int sn_node_unregister_reply(sn_node_t* sns, uint32_t reply_id);
+
+/**
+ * Calls the listener of a reply
+ * @param sns Node state
+ * @param reply_id Reply ID
+ * @param reply_cnt Reply content
+ * @param reply_cnt_len Reply content length
+ * @param src Address of the node that sent the reply, NULL if unknown
+ * @return 0 if a listener was called, -1 otherwise
+ * */
+int sn_node_call_reply(sn_node_t* sns, uint32_t reply_id, const char* reply_cnt, unsigned long long reply_cnt_len, const sn_net_addr_t* src);
+
+/**
+ * Joins a SecondNet network using a know gateway. A join message is routed from the gateway to our
+ * own address and every node on the route replies at once with its routing table rows(the closest
+ * one with its leafset too), so joining takes about one route traversal. Once every reply is in,
+ * the nodes learned are told about us. Blocks until then or SN_NODE_JOIN_TIMEOUT.
+ * Must not be called from the node loop. The node socket must be bound to an address the others can reach.
  * @param sns Node state
  * @param gateway Network address of the gateway
  * @return 0 if corretly joined, -1 otherwise
@@ -138,11 +1034,69 @@ struct sn_node_t_ {
     /* Background thread state */
     sn_net_addr_t self; /**< Node SecondNet address */
     sn_crypto_sign_key_t sk; /**< Node secret key*/
-    sn_net_router_t router; /**< Routing state */
-    pthread_t bg_thrd; /**< Background thread for routing */
+    sn_net_router_t router; /**< Routing state, protected by task_mut */
+    const sn_net_geometry_t* geometry; /**< Routing geometry picking the nexthops, protected by task_mut */
+    void* geometry_state; /**< Geometry state, the router for sn_net_geometry_pastry, protected by task_mut */
+    pthread_t bg_thrd; /**< Loop thread, unused by hosted nodes */
+    sn_io_reactor_t reactor; /**< Event loop run by bg_thrd, unused by hosted nodes */
+    sn_io_runtime_t* runtime; /**< Hosting runtime, NULL if the node has its own thread */
+    sn_io_reactor_t* loop; /**< Reactor running the node, reactor or the runtime one */
+    pthread_mutex_t task_mut; /**< Serializes the node socket and timer closures, and the sends reading the routes */
+    sn_node_mux_t* mux; /**< Shared socket, NULL if the node owns its socket */
+    mint_atomic32_t busy_idle_us; /**< Busy polling idle threshold, 0 if the loop blocks */
+    sn_net_packet_t** recv_bufs; /**< Batched receive buffers, allocated for busy polling */
+    sn_node_stats_t stats; /**< Counters, protected by task_mut(and shortcut_mut or hedge_mut for the shortcut and hedge ones) */
+    uint32_t rx_drops; /**< Last socket drop count seen, protected by task_mut */
+    int rx_drops_known; /**< Has the socket reported a drop count yet? Protected by task_mut */
+    sn_net_detector_t detector; /**< Neighbor failure detector, protected by task_mut */
+    int detect; /**< Is failure detection active? Protected by task_mut */
+    sn_data_hmap_t repairs; /**< Table slots being repaired(level*SN_NET_ROUTER_COLUMNS + column to their state), protected by task_mut */
+    uint32_t repair_reply_id; /**< Reply ID of the repair answers */
+    int learn; /**< Is table learning active? Protected by task_mut */
+    sn_data_hmap_t learning; /**< Learnt entries being verified(table slot to candidate), protected by task_mut */
+    uint32_t learn_reply_id; /**< Reply ID of the verification pings */
+    uint32_t learn_budget; /**< Verification pings left for this maintenance period, protected by task_mut */
+    int shortcut; /**< Are shortcuts active? Protected by shortcut_mut */
+    sn_data_hmap_t shortcuts; /**< Shortcuts and offers by destination, protected by shortcut_mut */
+    pthread_mutex_t shortcut_mut; /**< Protects the shortcuts and their stats */
+    uint32_t shortcut_budget; /**< Shortcut offers left for this maintenance period, protected by task_mut */
+    sn_data_hmap_t hedges; /**< Hedged messages by reply ID, protected by hedge_mut */
+    pthread_mutex_t hedge_mut; /**< Protects the hedges and their stats */
+    sn_io_reactor_timer_t hedge_timer; /**< Armed to the earliest second copy */
+    sn_util_hist_t hedge_rtt; /**< Reply latencies of hedged messages(ns), protected by hedge_mut */
+    uint64_t hedge_delay; /**< Milliseconds until the second copy, protected by hedge_mut */
+    uint64_t dedup[SN_NODE_DEDUP_LEN]; /**< Keys of the last hedged messages delivered(ring), protected by task_mut */
+    size_t dedup_next; /**< Next dedup slot */
+    sn_data_vec_t lookups; /**< Running lookups(and finished ones waiting for their listeners), protected by task_mut */
+    sn_io_reactor_timer_t lookup_timer; /**< Steps the lookups while there are any */
+    sn_data_hmap_t aggregates; /**< Aggregations waiting for their subtrees(query ID to their state), protected by task_mut */
+    sn_io_reactor_timer_t aggregate_timer; /**< Checks the aggregation deadlines while there are any */
+    sn_data_hmap_t topics; /**< Topic trees we are on(sn_net_addr_t to their state), protected by task_mut */
+    uint32_t publish_seq; /**< Sequence number of our next publication, protected by task_mut */
+    sn_util_closure_t on_broadcast; /**< Broadcast delivery(no body if unset), protected by task_mut */
+    sn_data_store_t store; /**< Values we own or replicate(by sn_net_addr_t key), protected by task_mut */
+    sn_data_merkle_t merkle; /**< Merkle tree over the stored keys and versions, protected by task_mut */
+    uint64_t sync_next; /**< When the owned values are next reconciled, protected by task_mut */
+    sn_data_store_t fragments; /**< Object fragment parts we hold(by key, index and part), protected by task_mut */
+    uint32_t fragments_version; /**< Router version the fragments were last placed for, protected by task_mut */
+    sn_data_vec_t object_out; /**< Object packets waiting for their burst, in order, protected by task_mut */
+    size_t object_out_next; /**< First object packet not sent yet */
+    sn_io_reactor_timer_t object_timer; /**< Sends the waiting object packets while there are any */
+    sn_data_erasure_t code; /**< Object erasure code */
+    int path_cache; /**< Is the path cache active? Protected by task_mut */
+    sn_data_cache_t cache; /**< Values that went back through us(by sn_net_addr_t key), protected by task_mut */
+    uint64_t cache_gets[SN_NODE_CACHE_GETS]; /**< Keys of the last gets we forwarded(ring), protected by task_mut */
+    size_t cache_gets_next; /**< Next cache_gets slot */
+    sn_data_hmap_t rumors; /**< Membership changes being gossiped(sn_net_addr_t to their state), protected by gossip_mut */
+    sn_data_hmap_t heard; /**< Last incarnation and state heard of each member, protected by gossip_mut */
+    uint32_t incarnation; /**< Our incarnation(seconds since the epoch at start), protected by gossip_mut */
+    pthread_mutex_t gossip_mut; /**< Protects the rumors, heard and incarnation */
+    sn_io_reactor_source_t sock_src; /**< Socket registration on the loop */
+    sn_io_reactor_timer_t maint_timer; /**< Maintenance timer */
     sn_io_sock_t socket; /**< Listening socket file descriptor */
     int sign; /**< Are signatures active? */
     int check_sign; /**< Are signature checks active? */
+    sn_net_signer_t* signer; /**< Signer threads, NULL if packets are signed on the caller's thread */
     /* Shared state */
     mint_atomicPtr_t upcall; /**< General upcall, received messages go up using this*/
     /**
@@ -155,10 +1109,30 @@ struct sn_node_t_ {
         //Reply listeners
         pthread_mutex_t reply_mut;
         sn_data_vec_t reply_vec;
+        sn_io_reactor_timer_t reply_timer; /**< Armed to the earliest listener deadline */
+        uint64_t reply_next; /**< Deadline reply_timer is armed to(0 if none), protected by reply_mut */
+        mint_atomic32_t reply_seq; /**< Last reply ID given */
     /* Default closures */
     sn_util_closure_t default_log_closure; /**< Default log closure */
 };
 
+struct sn_node_mux_t_ {
+    sn_io_sock_t socket; /**< Shared socket */
+    sn_io_naddr_t self_net; /**< Socket address, next hops with it are local identities */
+    sn_io_runtime_t* runtime; /**< Runtime running the socket and the identities */
+    sn_io_reactor_source_t sock_src; /**< Socket registration on the runtime */
+    pthread_mutex_t ident_mut; /**< Protects identities, primary, busy and epoch */
+    sn_data_hmap_t identities; /**< Local identities(sn_net_addr_t to sn_node_t*) */
+    sn_node_t* primary; /**< Identity forwarding packets not addressed to a local one */
+    unsigned int busy[2]; /**< Closures processing packets, by the epoch they started in */
+    unsigned int epoch; /**< Flipped by each identity removal, which waits for the previous one to end */
+    pthread_cond_t idle_cond; /**< Signaled when an epoch has no busy closures */
+    pthread_mutex_t local_mut; /**< Protects local and local_posted */
+    sn_data_vec_t local; /**< Packets between local identities waiting to be processed */
+    int local_posted; /**< Is a local drain posted or running? */
+    sn_net_packet_t* bufs[SN_IO_SOCK_BATCH_LEN]; /**< Receive buffers */
+};
+
 #ifdef __cplusplus
 } /*extern "C"*/
 #endif
@@ -0,0 +1,69 @@
+/**
+ * @file
+ * Provides log-linear histograms for latencies and other unsigned measures
+ * */
+
+#ifndef SN_UTIL_HIST_H_
+#define SN_UTIL_HIST_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sub-buckets per power of two, as a power of two. Quantiles are within 1/8 of the true value.
+ * */
+#define SN_UTIL_HIST_SUB_BITS 3
+
+/**
+ * Number of buckets, enough for any uint64_t
+ * */
+#define SN_UTIL_HIST_BUCKETS (64 << SN_UTIL_HIST_SUB_BITS)
+
+/**
+ * Holds a histogram. Not thread safe.
+ * */
+typedef struct sn_util_hist_t_ sn_util_hist_t;
+
+/**
+ * Initializes(or clears) a histogram
+ * @param h Histogram(must be already allocated)
+ * */
+void sn_util_hist_init(sn_util_hist_t* h);
+
+/**
+ * Records a value
+ * @param h Histogram
+ * @param value Value
+ * */
+void sn_util_hist_record(sn_util_hist_t* h, uint64_t value);
+
+/**
+ * Adds every value of a histogram to another
+ * @param h Histogram to be updated
+ * @param other Histogram to be added
+ * */
+void sn_util_hist_merge(sn_util_hist_t* h, const sn_util_hist_t* other);
+
+/**
+ * Gets a quantile
+ * @param h Histogram
+ * @param q Quantile, between 0 and 1(0.5 for the median, 0.99 for p99)
+ * @return Lower bound of the bucket holding the quantile, 0 if the histogram is empty
+ * */
+uint64_t sn_util_hist_quantile(const sn_util_hist_t* h, double q);
+
+struct sn_util_hist_t_ {
+    uint64_t count; /**< Recorded values */
+    uint64_t sum; /**< Sum of the recorded values(wraps around) */
+    uint64_t max; /**< Largest recorded value */
+    uint64_t buckets[SN_UTIL_HIST_BUCKETS]; /**< Count of each bucket */
+};
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_UTIL_HIST_H_*/
@@ -0,0 +1,37 @@
+/**
+ * @file
+ * Provides monotonic(and wall) clock readings
+ * */
+
+#ifndef SN_UTIL_TIME_H_
+#define SN_UTIL_TIME_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reads the monotonic clock
+ * @return Nanoseconds since some unspecified starting point
+ * */
+uint64_t sn_util_time_ns(void);
+
+/**
+ * Reads the monotonic clock
+ * @return Milliseconds since some unspecified starting point
+ * */
+uint64_t sn_util_time_ms(void);
+
+/**
+ * Reads the wall clock, the one kernel receive timestamps use
+ * @return Nanoseconds since the Epoch
+ * */
+uint64_t sn_util_time_real_ns(void);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif/*SN_UTIL_TIME_H_*/
@@ -8,6 +8,7 @@
 
 #include "common.h"
 #include "net/addr.h"
+#include "net/entry.h"
 #include "io/naddr.h"
 #include "crypto/sign.h"
 
@@ -108,6 +109,20 @@ typedef enum {
     SN_WIRE_NET_TYPE_USER = 0,
     SN_WIRE_NET_TYPE_REPLY = 1,
     SN_WIRE_NET_TYPE_PING = 2,
+    SN_WIRE_NET_TYPE_JOIN = 3,
+    SN_WIRE_NET_TYPE_ANNOUNCE = 4,
+    SN_WIRE_NET_TYPE_REPAIR = 5,
+    SN_WIRE_NET_TYPE_SHORTCUT = 6,
+    SN_WIRE_NET_TYPE_HEDGED = 7,
+    SN_WIRE_NET_TYPE_LOOKUP = 8,
+    SN_WIRE_NET_TYPE_MEMBERS = 9,
+    SN_WIRE_NET_TYPE_SUBSCRIBE = 10,
+    SN_WIRE_NET_TYPE_PUBLISH = 11,
+    SN_WIRE_NET_TYPE_BROADCAST = 12,
+    SN_WIRE_NET_TYPE_AGGREGATE = 13,
+    SN_WIRE_NET_TYPE_STORE = 14,
+    SN_WIRE_NET_TYPE_SYNC = 15,
+    SN_WIRE_NET_TYPE_OBJECT = 16,
     SN_WIRE_NET_TYPES
 } sn_wire_net_type_t;
 
@@ -161,4 +176,711 @@ typedef struct {
 
 SN_ASSERT_COMPILE(sizeof(sn_wire_ping_msg_t) == SN_WIRE_PING_MSG_SIZE);
 
+/*******************************************************************
+    join message(routed to the joining node own address)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |                           Reply to                            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                                                               |
+    +                                                               +
+    |              Joining node netaddress(serialized)              |
+    +                                                               +
+ 20 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Every node on the route replies straight to the netaddress, without
+    waiting for the next hops, so all the replies are in flight at once.
+
+*******************************************************************/
+
+#define SN_WIRE_JOIN_MSG_SIZE (4 + 20)
+
+typedef struct {
+    uint32_t reply_to;
+    sn_io_naddr_ser_t net_addr;
+} sn_wire_join_msg_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_join_msg_t) == SN_WIRE_JOIN_MSG_SIZE);
+
+/*******************************************************************
+    join reply header(after the reply header, followed by a
+    net/router query with entries of the replying node)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |      Hop      |     Parts     |     Hops      |     Flags     |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Hop: position of the replying node on the route(0 is the gateway)
+    Parts: number of replies sent by that node
+    Hops: with the ROOT flag, number of nodes on the route minus one
+    Flags: ROOT if sent by the node closest to the joining one
+
+*******************************************************************/
+
+#define SN_WIRE_JOIN_REPLY_HEADER_SIZE 4
+
+#define SN_WIRE_JOIN_REPLY_ROOT 1
+
+typedef struct {
+    uint8_t hop;
+    uint8_t parts;
+    uint8_t hops;
+    uint8_t flags;
+} sn_wire_join_reply_header_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_join_reply_header_t) == SN_WIRE_JOIN_REPLY_HEADER_SIZE);
+
+/*******************************************************************
+    announce message(sent straight to every node the joining one
+    learned about)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |                                                               |
+    +                                                               +
+    |               Sender netaddress(serialized)                   |
+    +                                                               +
+ 16 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+*******************************************************************/
+
+#define SN_WIRE_ANNOUNCE_MSG_SIZE 20
+
+typedef struct {
+    sn_io_naddr_ser_t net_addr;
+} sn_wire_announce_msg_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_announce_msg_t) == SN_WIRE_ANNOUNCE_MSG_SIZE);
+
+/*******************************************************************
+    repair message(sent straight to a node sharing the row, asking
+    for its routing table entry at level and column)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |                           Reply to                            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |     Level     |    Column     |           Reserved            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Any node sharing level nibbles with the asking one has valid
+    entries for its [level][column] slot.
+
+*******************************************************************/
+
+#define SN_WIRE_REPAIR_MSG_SIZE 8
+
+typedef struct {
+    uint32_t reply_to;
+    uint8_t level;
+    uint8_t column;
+    uint16_t reserved;
+} sn_wire_repair_msg_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_repair_msg_t) == SN_WIRE_REPAIR_MSG_SIZE);
+
+/*******************************************************************
+    repair reply header(after the reply header, followed by a
+    net/router query with the entry, if any)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |     Level     |    Column     |           Reserved            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+*******************************************************************/
+
+#define SN_WIRE_REPAIR_REPLY_HEADER_SIZE 4
+
+typedef struct {
+    uint8_t level;
+    uint8_t column;
+    uint16_t reserved;
+} sn_wire_repair_reply_header_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_repair_reply_header_t) == SN_WIRE_REPAIR_REPLY_HEADER_SIZE);
+
+/*******************************************************************
+    shortcut message(routed back to the source of a multi-hop packet)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |     Hops      |                   Reserved                    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                                                               |
+    +                                                               +
+    |            Sending node netaddress(serialized)                |
+    +                                                               +
+ 20 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Hops: overlay hops taken by the packet that triggered the offer
+
+*******************************************************************/
+
+#define SN_WIRE_SHORTCUT_MSG_SIZE (4 + 20)
+
+typedef struct {
+    uint8_t hops;
+    uint8_t reserved[3];
+    sn_io_naddr_ser_t net_addr;
+} sn_wire_shortcut_msg_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_shortcut_msg_t) == SN_WIRE_SHORTCUT_MSG_SIZE);
+
+/*******************************************************************
+    hedged message header(followed by the payload of the inner type)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |     Type      |                   Reserved                    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                                                               |
+    +                             Nonce                             +
+  8 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Both copies of a hedged message are the same packet, signature
+    included. The nonce(with the source) tells duplicates apart
+    from repeated messages at the destination.
+
+*******************************************************************/
+
+#define SN_WIRE_HEDGED_HEADER_SIZE 12
+
+typedef struct {
+    uint8_t type;
+    uint8_t reserved[3];
+    unsigned char nonce[8];
+} sn_wire_hedged_header_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_hedged_header_t) == SN_WIRE_HEDGED_HEADER_SIZE);
+
+/*******************************************************************
+    lookup message(sent straight to a contact of an iterative lookup)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |                           Reply to                            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                                                               |
+    +                                                               +
+    |                    Target SecondNet address                   |
+    +                                                               +
+ 32 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+*******************************************************************/
+
+#define SN_WIRE_LOOKUP_MSG_SIZE (4 + 32)
+
+typedef struct {
+    uint32_t reply_to;
+    sn_net_addr_ser_t target;
+} sn_wire_lookup_msg_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_lookup_msg_t) == SN_WIRE_LOOKUP_MSG_SIZE);
+
+/*******************************************************************
+    lookup reply header(after the reply header, followed by a
+    net/router query with the nexthop of the replying node and its
+    leafset half on the side of the target)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |     Flags     |                   Reserved                    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Flags: OWNER if the replying node has no nexthop for the target
+
+*******************************************************************/
+
+#define SN_WIRE_LOOKUP_REPLY_HEADER_SIZE 4
+
+#define SN_WIRE_LOOKUP_REPLY_OWNER 1
+
+typedef struct {
+    uint8_t flags;
+    uint8_t reserved[3];
+} sn_wire_lookup_reply_header_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_lookup_reply_header_t) == SN_WIRE_LOOKUP_REPLY_HEADER_SIZE);
+
+/*******************************************************************
+    members message header(followed by the records, sent straight to
+    gossip peers)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |         Records length        |           Reserved            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Each record is a member incarnation and a serialized net/entry.
+    Entries with is_set joined the network, the rest left it.
+
+*******************************************************************/
+
+#define SN_WIRE_MEMBERS_HEADER_SIZE 4
+#define SN_WIRE_MEMBERS_RECORD_SIZE 60
+
+typedef struct {
+    uint16_t records_len;
+    uint8_t reserved[2];
+} sn_wire_members_header_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_members_header_t) == SN_WIRE_MEMBERS_HEADER_SIZE);
+
+typedef struct {
+    uint32_t incarnation;
+    sn_net_entry_ser_t entry;
+} sn_wire_members_record_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_members_record_t) == SN_WIRE_MEMBERS_RECORD_SIZE);
+
+/*******************************************************************
+    subscribe message(sent straight to the nexthop towards the topic,
+    which is the packet destination)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |     Flags     |                   Reserved                    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Flags: LEAVE if the sender drops out of the topic tree
+
+    The receiving node makes the sender its child on the tree and,
+    if it was not on the tree yet, subscribes to its own nexthop.
+
+*******************************************************************/
+
+#define SN_WIRE_SUBSCRIBE_MSG_SIZE 4
+
+#define SN_WIRE_SUBSCRIBE_LEAVE 1
+
+typedef struct {
+    uint8_t flags;
+    uint8_t reserved[3];
+} sn_wire_subscribe_msg_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_subscribe_msg_t) == SN_WIRE_SUBSCRIBE_MSG_SIZE);
+
+/*******************************************************************
+    publish header(followed by the message)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |     Flags     |                   Reserved                    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                                                               |
+    +                  Publisher SecondNet address                  +
+ 32 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 36 |                                                               |
+    +                   Ed25519-SHA512 Signature                    +
+ 96 |          (by the publisher, of everything below this)         |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+100 |                                                               |
+    +                     Topic SecondNet address                   +
+128 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+132 |                        Sequence number                        |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Flags: DOWN on the copies sent from a tree node to its children
+
+    Publications are routed up to the topic root. Every tree node
+    on the way(the publisher and the root too) sends a DOWN copy to
+    each of its children but the one the publication came from, and
+    tree nodes sign it again as theirs before passing it up. DOWN
+    copies are addressed to the topic too, signed once by the parent
+    for all its children and sent straight to them. They are taken
+    from the parent only. Nodes handle a publication once, by
+    publisher and sequence number.
+
+*******************************************************************/
+
+#define SN_WIRE_PUBLISH_HEADER_SIZE (4 + 32 + 64 + 32 + 4)
+
+#define SN_WIRE_PUBLISH_DOWN 1
+
+typedef struct {
+    uint8_t flags;
+    uint8_t reserved[3];
+    sn_net_addr_ser_t publisher;
+    sn_crypto_sign_t sign;
+    sn_net_addr_ser_t topic;
+    uint32_t seq;
+} sn_wire_publish_header_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_publish_header_t) == SN_WIRE_PUBLISH_HEADER_SIZE);
+SN_ASSERT_COMPILE(offsetof(sn_wire_publish_header_t, topic) == 100);
+
+/*******************************************************************
+    broadcast header(sent straight to the nodes a copy is split to,
+    followed by the message)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |     Level     |                   Reserved                    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                                                               |
+    +                   Origin SecondNet address                    +
+ 32 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 36 |                                                               |
+    +                   Ed25519-SHA512 Signature                    +
+ 96 |            (by the origin, of everything below this)          |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+100 |                                                               |
+    +                    Lowest SecondNet address                   +
+128 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+132 |                                                               |
+    +                   Highest SecondNet address                   +
+160 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Level: first routing table level the receiver splits the
+    broadcast at(see sn_net_router_split). It changes on every hop,
+    so copies are signed by the relaying node and carry the origin
+    signature of the range and the message.
+
+    Nodes between the lowest and the highest address deliver the
+    message, the whole keyspace for broadcasts.
+
+*******************************************************************/
+
+#define SN_WIRE_BROADCAST_HEADER_SIZE (4 + 32 + 64 + 32 + 32)
+
+typedef struct {
+    uint8_t level;
+    uint8_t reserved[3];
+    sn_net_addr_ser_t origin;
+    sn_crypto_sign_t sign;
+    sn_net_addr_ser_t lo;
+    sn_net_addr_ser_t hi;
+} sn_wire_broadcast_header_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_broadcast_header_t) == SN_WIRE_BROADCAST_HEADER_SIZE);
+SN_ASSERT_COMPILE(offsetof(sn_wire_broadcast_header_t, lo) == 100);
+
+/*******************************************************************
+    aggregate message(sent straight to the nodes a query is split to,
+    and from them straight back with their subtree result)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |     Flags     |     Level     |    Metric     |   Reserved    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                           Query ID                            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  8 |                     Budget(milliseconds)                      |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Flags: RESULT if it carries a subtree result(followed by an
+    aggregate result) to the query ID of the node that asked
+
+    Queries are split across the routing table like broadcasts, from
+    Level on. The receiver answers once its children did, or once
+    the budget is spent, with its own value merged into theirs.
+
+*******************************************************************/
+
+#define SN_WIRE_AGGREGATE_MSG_SIZE 12
+
+#define SN_WIRE_AGGREGATE_RESULT 1
+
+typedef struct {
+    uint8_t flags;
+    uint8_t level;
+    uint8_t metric;
+    uint8_t reserved;
+    uint32_t query_id;
+    uint32_t budget;
+} sn_wire_aggregate_msg_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_aggregate_msg_t) == SN_WIRE_AGGREGATE_MSG_SIZE);
+
+/*******************************************************************
+    aggregate result
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |                                                               |
+    +                        Count(64 bits)                         +
+  4 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  8 |                  Sum, Min and Max(64 bits each)               |
+    +                              ...                              +
+ 28 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 32 |                    Histogram(64 x 32 bits)                    |
+    +                              ...                              +
+284 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Histogram: nodes per power of two, bucket i counting values
+    with i significant bits(the last one every larger value)
+
+*******************************************************************/
+
+#define SN_WIRE_AGGREGATE_BUCKETS 64
+
+#define SN_WIRE_AGGREGATE_RESULT_SIZE (4*8 + SN_WIRE_AGGREGATE_BUCKETS*4)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint32_t hist[SN_WIRE_AGGREGATE_BUCKETS];
+} sn_wire_aggregate_result_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_aggregate_result_t) == SN_WIRE_AGGREGATE_RESULT_SIZE);
+
+/*******************************************************************
+    store message(routed to the owner of a key, straight from the
+    owner to its replicas, and routed back to the source)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |      Op       |                    Reserved                   |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                           Reply to                            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  8 |                                                               |
+    +                        Version(64 bits)                       +
+ 12 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 16 |                                                               |
+    +                          Key(32 bytes)                        +
+    |                              ...                              |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 48 |                      Value(PUT, REPLICA, VALUE)               |
+    +                              ...                              +
+
+    Op: PUT and GET go to the key, GETs are answered by the first
+    replica on their way. The owner stores a PUT with the next
+    version and sends it as REPLICA to its closest leafset entries.
+    ACK(with the version stored), VALUE and MISS go back to the
+    source, to its Reply to ID.
+
+*******************************************************************/
+
+#define SN_WIRE_STORE_MSG_SIZE 48
+
+typedef enum {
+    SN_WIRE_STORE_PUT = 0,
+    SN_WIRE_STORE_GET = 1,
+    SN_WIRE_STORE_REPLICA = 2,
+    SN_WIRE_STORE_ACK = 3,
+    SN_WIRE_STORE_VALUE = 4,
+    SN_WIRE_STORE_MISS = 5,
+    SN_WIRE_STORE_OPS
+} sn_wire_store_op_t;
+
+typedef struct {
+    uint8_t op;
+    uint8_t reserved[3];
+    uint32_t reply_to;
+    uint64_t version;
+    sn_net_addr_ser_t key;
+} sn_wire_store_msg_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_store_msg_t) == SN_WIRE_STORE_MSG_SIZE);
+
+/*******************************************************************
+    sync header(sent straight between a key owner and its replicas,
+    followed by Count digests, items or keys)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |      Op       |   Reserved    |             Count             |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                           Reserved                            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  8 |                      Lowest key(32 bytes)                     |
+    +                              ...                              +
+ 40 |                     Highest key(32 bytes)                     |
+    +                              ...                              +
+
+    Op: DIGESTS of Merkle tree nodes over the keys between Lowest
+    and Highest. The receiver answers the ones differing from its
+    own with the digests of their children, or the ITEMS of their
+    leaves, digests of nodes straddling the range covering only its
+    keys. ITEMS list every key(with its version and value digest) the
+    sender holds in the range. The receiver sends back as store
+    replicas the values the list lacks or has older, and a WANT with
+    the keys it lacks or has older, which are sent back as replicas
+    too. Of two values with the same version, the one with the
+    greater digest is the newer.
+
+*******************************************************************/
+
+#define SN_WIRE_SYNC_HEADER_SIZE 72
+
+typedef enum {
+    SN_WIRE_SYNC_DIGESTS = 0,
+    SN_WIRE_SYNC_ITEMS = 1,
+    SN_WIRE_SYNC_WANT = 2
+} sn_wire_sync_op_t;
+
+typedef struct {
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t count;
+    uint32_t reserved2;
+    sn_net_addr_ser_t lo;
+    sn_net_addr_ser_t hi;
+} sn_wire_sync_header_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_sync_header_t) == SN_WIRE_SYNC_HEADER_SIZE);
+
+/*******************************************************************
+    sync digest
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |     Level     |                   Reserved                    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                             Index                             |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  8 |                        Digest(16 bytes)                       |
+    +                              ...                              +
+
+    Index: the first Level hex digits of the keys under the node
+
+*******************************************************************/
+
+#define SN_WIRE_SYNC_DIGEST_SIZE 24
+
+typedef struct {
+    uint8_t level;
+    uint8_t reserved[3];
+    uint32_t index;
+    unsigned char digest[16];
+} sn_wire_sync_digest_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_sync_digest_t) == SN_WIRE_SYNC_DIGEST_SIZE);
+
+/*******************************************************************
+    sync item
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |                          Key(32 bytes)                        |
+    +                              ...                              +
+ 32 |                                                               |
+    +                        Version(64 bits)                       +
+ 36 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 40 |                        Digest(16 bytes)                       |
+    +                              ...                              +
+
+    Digest: the Merkle tree item digest of the value
+
+*******************************************************************/
+
+#define SN_WIRE_SYNC_ITEM_SIZE 56
+
+typedef struct {
+    sn_net_addr_ser_t key;
+    uint64_t version;
+    unsigned char digest[16];
+} sn_wire_sync_item_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_sync_item_t) == SN_WIRE_SYNC_ITEM_SIZE);
+
+/*******************************************************************
+    object message(routed to the owner of a key, straight from the
+    owner to the fragment holders, and routed from them to Origin)
+
+     0               1               2               3
+     0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  0 |      Op       |     Index     |     Data      |    Parity     |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  4 |                           Reply to                            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  8 |                                                               |
+    +                        Version(64 bits)                       +
+ 12 |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 16 |                         Object length                         |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 20 |                             Part                              |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 24 |                          Key(32 bytes)                        |
+    +                              ...                              +
+ 56 |                        Origin(32 bytes)                       |
+    +                              ...                              +
+ 88 |                   Fragment(STORE, PLACE, FRAGMENT)            |
+    +                              ...                              +
+
+    Op: the Index fragment of an object(coded in Data + Parity
+    fragments) is sent to the key as STORE, and the owner sends it
+    as PLACE to the holder of that index, or keeps it. A FETCH to
+    the key is sent by the owner as GATHER to the holder of every
+    index. Holders answer Origin, to its Reply to ID, with STORED
+    once they have a whole fragment, and a GATHER with a FRAGMENT
+    for every fragment of the key they have(whatever the index
+    asked) followed by a MISSING. A PLACE with a zero Reply to moves
+    a fragment to its new holder, and is not answered.
+
+    Part: fragments longer than a packet are sent in parts of equal
+    size(the last one shorter), numbered from 0.
+
+*******************************************************************/
+
+#define SN_WIRE_OBJECT_MSG_SIZE 88
+
+typedef enum {
+    SN_WIRE_OBJECT_STORE = 0,
+    SN_WIRE_OBJECT_PLACE = 1,
+    SN_WIRE_OBJECT_STORED = 2,
+    SN_WIRE_OBJECT_FETCH = 3,
+    SN_WIRE_OBJECT_GATHER = 4,
+    SN_WIRE_OBJECT_FRAGMENT = 5,
+    SN_WIRE_OBJECT_MISSING = 6,
+    SN_WIRE_OBJECT_OPS
+} sn_wire_object_op_t;
+
+typedef struct {
+    uint8_t op;
+    uint8_t index;
+    uint8_t data;
+    uint8_t parity;
+    uint32_t reply_to;
+    uint64_t version;
+    uint32_t len;
+    uint32_t part;
+    sn_net_addr_ser_t key;
+    sn_net_addr_ser_t origin;
+} sn_wire_object_msg_t;
+
+SN_ASSERT_COMPILE(sizeof(sn_wire_object_msg_t) == SN_WIRE_OBJECT_MSG_SIZE);
+
 #endif/*SN_WIRE_H_*/
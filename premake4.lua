@@ -28,6 +28,15 @@ solution "sndnet"
         includedirs {"include", "third_party/include"}
         files { "prototype/**.c", "third_party/src/**.c" }
 
+    project "bench"
+        location "build/bench"
+        kind "ConsoleApp"
+        language "C"
+        buildoptions { "-D_POSIX_C_SOURCE=200112L -std=c99 -Wall -Wextra -Werror -Wfatal-errors" }
+        links { "sndnet", "pthread", "sodium" }
+        includedirs {"include", "third_party/include"}
+        files { "bench/**.h", "bench/**.c", "third_party/src/**.c" }
+
     project "test"
         location "build/test"
         kind "ConsoleApp"
@@ -0,0 +1,95 @@
+#include "data/arena.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SN_DATA_ARENA_ALIGN 8
+
+#define ALIGN_UP(n) (((n) + SN_DATA_ARENA_ALIGN - 1) & ~(size_t)(SN_DATA_ARENA_ALIGN - 1))
+#define CHUNK_DATA(chunk) ((char*)(chunk) + ALIGN_UP(sizeof(sn_data_arena_chunk_t)))
+
+sn_data_arena_chunk_t* arena_chunk(size_t size);
+
+void sn_data_arena_init(sn_data_arena_t* arena) {
+    assert(arena != NULL);
+
+    arena->head = NULL;
+    arena->used = arena->reserved = 0;
+}
+
+void sn_data_arena_destroy(sn_data_arena_t* arena) {
+    sn_data_arena_chunk_t* chunk;
+
+    assert(arena != NULL);
+
+    while((chunk = arena->head) != NULL) {
+        arena->head = chunk->next;
+        free(chunk);
+    }
+
+    arena->used = arena->reserved = 0;
+}
+
+void* sn_data_arena_alloc(sn_data_arena_t* arena, size_t size) {
+    sn_data_arena_chunk_t* chunk;
+    void* ptr;
+
+    assert(arena != NULL);
+
+    size = ALIGN_UP(size ? size : 1);
+
+    if(size > SN_DATA_ARENA_CHUNK/4) {
+        /* Large ones go behind the chunk being filled, which keeps its free space */
+
+        if((chunk = arena_chunk(size)) == NULL)
+            return NULL;
+
+        arena->reserved += size;
+
+        if(arena->head != NULL) {
+            chunk->next = arena->head->next;
+            arena->head->next = chunk;
+        } else {
+            arena->head = chunk;
+        }
+    } else if(arena->head == NULL || arena->head->size - arena->head->used < size) {
+        if((chunk = arena_chunk(SN_DATA_ARENA_CHUNK)) == NULL)
+            return NULL;
+
+        arena->reserved += SN_DATA_ARENA_CHUNK;
+
+        chunk->next = arena->head;
+        arena->head = chunk;
+    } else {
+        chunk = arena->head;
+    }
+
+    ptr = CHUNK_DATA(chunk) + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+
+    return ptr;
+}
+
+size_t sn_data_arena_used(const sn_data_arena_t* arena) {
+    assert(arena != NULL);
+
+    return arena->used;
+}
+
+/*Private functions*/
+
+sn_data_arena_chunk_t* arena_chunk(size_t size) {
+    sn_data_arena_chunk_t* chunk;
+
+    if((chunk = (sn_data_arena_chunk_t*)malloc(ALIGN_UP(sizeof(sn_data_arena_chunk_t)) + size)) == NULL)
+        return NULL;
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+
+    return chunk;
+}
@@ -0,0 +1,186 @@
+#include "data/cache.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct sn_data_cache_slot_t_ {
+    char* value; /* Value bytes, kept when the slot is reused */
+    size_t len; /* Value length */
+    size_t reserved; /* Bytes allocated for the value */
+    uint64_t version; /* Value version */
+    uint64_t expires; /* When the value stops being returned */
+    unsigned char used; /* Holds a value */
+    unsigned char referenced; /* Read since the hand last passed */
+};
+
+#define SLOT_KEY(cache, i) ((cache)->keys + (i)*(cache)->key_size)
+
+size_t cache_evict(sn_data_cache_t* cache);
+void cache_clear(sn_data_cache_t* cache, size_t i);
+
+int sn_data_cache_init(sn_data_cache_t* cache, size_t key_size, size_t capacity) {
+    assert(cache != NULL);
+    assert(capacity != 0);
+
+    if(sn_data_hmap_init(&cache->index, key_size, sizeof(size_t)) != 0)
+        return -1;
+
+    cache->slots = (struct sn_data_cache_slot_t_*)calloc(capacity, sizeof(struct sn_data_cache_slot_t_));
+    cache->keys = (char*)malloc(capacity*key_size);
+
+    if(cache->slots == NULL || cache->keys == NULL) {
+        free(cache->slots);
+        free(cache->keys);
+        sn_data_hmap_destroy(&cache->index);
+        return -1;
+    }
+
+    cache->key_size = key_size;
+    cache->capacity = capacity;
+    cache->hand = 0;
+
+    return 0;
+}
+
+void sn_data_cache_destroy(sn_data_cache_t* cache) {
+    size_t i;
+
+    assert(cache != NULL);
+
+    for(i = 0; i < cache->capacity; ++i)
+        free(cache->slots[i].value);
+
+    free(cache->slots);
+    free(cache->keys);
+    sn_data_hmap_destroy(&cache->index);
+}
+
+size_t sn_data_cache_size(const sn_data_cache_t* cache) {
+    assert(cache != NULL);
+
+    return sn_data_hmap_size(&cache->index);
+}
+
+int sn_data_cache_get(sn_data_cache_t* cache, const void* key, uint64_t now, sn_data_cache_item_t* out) {
+    struct sn_data_cache_slot_t_* slot;
+    size_t i;
+
+    assert(cache != NULL);
+    assert(key != NULL);
+
+    if(sn_data_hmap_get(&cache->index, key, &i) != 0)
+        return -1;
+
+    slot = &cache->slots[i];
+
+    /* Expired values are dropped when found */
+
+    if(slot->expires <= now) {
+        cache_clear(cache, i);
+        return -1;
+    }
+
+    slot->referenced = 1;
+
+    if(out != NULL) {
+        out->value = slot->value;
+        out->len = slot->len;
+        out->version = slot->version;
+    }
+
+    return 0;
+}
+
+int sn_data_cache_put(sn_data_cache_t* cache, const void* key, const char* value, size_t len, uint64_t version, uint64_t expires) {
+    struct sn_data_cache_slot_t_* slot;
+    char* bytes;
+    size_t i;
+
+    assert(cache != NULL);
+    assert(key != NULL);
+    assert(value != NULL || len == 0);
+
+    if(sn_data_hmap_get(&cache->index, key, &i) == 0) {
+        /* Older versions do not replace newer ones */
+
+        if(cache->slots[i].version > version)
+            return 0;
+    } else {
+        i = cache_evict(cache);
+
+        if(sn_data_hmap_put(&cache->index, key, &i) != 0)
+            return -1;
+
+        memcpy(SLOT_KEY(cache, i), key, cache->key_size);
+        cache->slots[i].used = 1;
+        cache->slots[i].referenced = 0;
+    }
+
+    slot = &cache->slots[i];
+
+    if(len > slot->reserved) {
+        if((bytes = (char*)realloc(slot->value, len)) == NULL) {
+            cache_clear(cache, i);
+            return -1;
+        }
+
+        slot->value = bytes;
+        slot->reserved = len;
+    }
+
+    if(len)
+        memcpy(slot->value, value, len);
+
+    slot->len = len;
+    slot->version = version;
+    slot->expires = expires;
+
+    return 0;
+}
+
+int sn_data_cache_remove(sn_data_cache_t* cache, const void* key) {
+    size_t i;
+
+    assert(cache != NULL);
+    assert(key != NULL);
+
+    if(sn_data_hmap_get(&cache->index, key, &i) != 0)
+        return -1;
+
+    cache_clear(cache, i);
+
+    return 0;
+}
+
+size_t cache_evict(sn_data_cache_t* cache) {
+    struct sn_data_cache_slot_t_* slot;
+    size_t i;
+
+    /* A free slot if any, the hand only goes round a full cache */
+
+    if(sn_data_hmap_size(&cache->index) < cache->capacity) {
+        while(cache->slots[cache->hand].used)
+            cache->hand = (cache->hand + 1)%cache->capacity;
+    } else {
+        while((slot = &cache->slots[cache->hand])->referenced) {
+            slot->referenced = 0;
+            cache->hand = (cache->hand + 1)%cache->capacity;
+        }
+
+        cache_clear(cache, cache->hand);
+    }
+
+    i = cache->hand;
+    cache->hand = (cache->hand + 1)%cache->capacity;
+
+    return i;
+}
+
+void cache_clear(sn_data_cache_t* cache, size_t i) {
+    sn_data_hmap_remove(&cache->index, SLOT_KEY(cache, i), NULL);
+    cache->slots[i].used = 0;
+    cache->slots[i].referenced = 0;
+}
@@ -0,0 +1,334 @@
+#include "data/erasure.h"
+#include "common.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ERASURE_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+Fragments are combined a block at a time, so the parity being built and the data read stay in
+the cache for every coefficient of its row.
+*/
+#define ERASURE_BLOCK 4096
+
+/* x^8 + x^4 + x^3 + x^2 + 1 */
+#define ERASURE_POLY 0x11d
+
+typedef void (*erasure_kernel_t)(unsigned char* dst, const unsigned char* src, const unsigned char* table, size_t len);
+
+unsigned char gf_exp[512];
+unsigned char gf_log[256];
+pthread_once_t gf_once = PTHREAD_ONCE_INIT;
+
+void gf_init(void);
+unsigned char gf_mul(unsigned char a, unsigned char b);
+unsigned char gf_inv(unsigned char a);
+void gf_table(unsigned char c, unsigned char table[32]);
+int gf_invert(unsigned char* m, unsigned char* inv, unsigned int n);
+int erasure_supported(int kernel);
+erasure_kernel_t erasure_kernel(int kernel);
+void mul_add_scalar(unsigned char* dst, const unsigned char* src, const unsigned char* table, size_t len);
+
+#if defined(ERASURE_X86)
+void mul_add_ssse3(unsigned char* dst, const unsigned char* src, const unsigned char* table, size_t len);
+void mul_add_avx2(unsigned char* dst, const unsigned char* src, const unsigned char* table, size_t len);
+#endif
+
+int sn_data_erasure_init(sn_data_erasure_t* code, unsigned int data, unsigned int parity) {
+    unsigned int p, d;
+    int kernel;
+
+    assert(code != NULL);
+
+    if(data == 0 || data > SN_DATA_ERASURE_MAX_DATA || parity > SN_DATA_ERASURE_MAX_PARITY)
+        return -1;
+
+    pthread_once(&gf_once, gf_init);
+
+    code->data = data;
+    code->parity = parity;
+
+    /* Cauchy rows 1/(x_p + y_d), x_p = data + p and y_d = d all distinct: every square submatrix is invertible */
+
+    for(p = 0; p < parity; ++p) {
+        for(d = 0; d < data; ++d) {
+            code->matrix[p][d] = gf_inv((unsigned char)((data + p) ^ d));
+            gf_table(code->matrix[p][d], code->tables[p][d]);
+        }
+    }
+
+    for(kernel = SN_DATA_ERASURE_KERNELS - 1; !erasure_supported(kernel); --kernel);
+
+    code->kernel = kernel;
+
+    return 0;
+}
+
+int sn_data_erasure_set_kernel(sn_data_erasure_t* code, int kernel) {
+    assert(code != NULL);
+
+    if(kernel < 0 || kernel >= SN_DATA_ERASURE_KERNELS || !erasure_supported(kernel))
+        return -1;
+
+    code->kernel = kernel;
+
+    return 0;
+}
+
+void sn_data_erasure_encode(const sn_data_erasure_t* code, const unsigned char* const* data, unsigned char* const* parity, size_t len) {
+    erasure_kernel_t mul_add;
+    size_t off, n;
+    unsigned int p, d;
+
+    assert(code != NULL);
+    assert(data != NULL);
+    assert(parity != NULL || code->parity == 0);
+
+    mul_add = erasure_kernel(code->kernel);
+
+    for(off = 0; off < len; off += ERASURE_BLOCK) {
+        n = SN_MIN(len - off, ERASURE_BLOCK);
+
+        for(p = 0; p < code->parity; ++p) {
+            memset(parity[p] + off, 0, n);
+
+            for(d = 0; d < code->data; ++d)
+                mul_add(parity[p] + off, data[d] + off, code->tables[p][d], n);
+        }
+    }
+}
+
+int sn_data_erasure_decode(const sn_data_erasure_t* code, const unsigned char* const* fragments, const unsigned int* indexes, unsigned char* const* out, size_t len) {
+    unsigned char m[SN_DATA_ERASURE_MAX_DATA*SN_DATA_ERASURE_MAX_DATA];
+    unsigned char inv[SN_DATA_ERASURE_MAX_DATA*SN_DATA_ERASURE_MAX_DATA];
+    unsigned char tables[SN_DATA_ERASURE_MAX_DATA][32];
+    int present[SN_DATA_ERASURE_MAX_DATA];
+    erasure_kernel_t mul_add;
+    const unsigned int k = code->data;
+    unsigned int i, j;
+    size_t off, n;
+
+    assert(code != NULL);
+    assert(fragments != NULL);
+    assert(indexes != NULL);
+    assert(out != NULL);
+
+    /* The rows of the fragments we got, inverted, give the data back */
+
+    memset(m, 0, sizeof(m));
+
+    for(i = 0; i < k; ++i)
+        present[i] = -1;
+
+    for(j = 0; j < k; ++j) {
+        if(indexes[j] >= k + code->parity)
+            return -1;
+
+        if(indexes[j] < k) {
+            if(present[indexes[j]] != -1)
+                return -1;
+
+            present[indexes[j]] = (int)j;
+            m[j*k + indexes[j]] = 1;
+        } else {
+            memcpy(&m[j*k], code->matrix[indexes[j] - k], k);
+        }
+    }
+
+    if(gf_invert(m, inv, k) != 0)
+        return -1;
+
+    mul_add = erasure_kernel(code->kernel);
+
+    for(i = 0; i < k; ++i) {
+        if(present[i] != -1) {
+            memcpy(out[i], fragments[present[i]], len);
+            continue;
+        }
+
+        for(j = 0; j < k; ++j)
+            gf_table(inv[i*k + j], tables[j]);
+
+        for(off = 0; off < len; off += ERASURE_BLOCK) {
+            n = SN_MIN(len - off, ERASURE_BLOCK);
+            memset(out[i] + off, 0, n);
+
+            for(j = 0; j < k; ++j)
+                if(inv[i*k + j] != 0)
+                    mul_add(out[i] + off, fragments[j] + off, tables[j], n);
+        }
+    }
+
+    return 0;
+}
+
+void gf_init(void) {
+    unsigned int i, x = 1;
+
+    for(i = 0; i < 255; ++i) {
+        gf_exp[i] = (unsigned char)x;
+        gf_log[x] = (unsigned char)i;
+
+        x <<= 1;
+
+        if(x & 0x100)
+            x ^= ERASURE_POLY;
+    }
+
+    /* Doubled so products index it without a modulo */
+
+    for(i = 255; i < 512; ++i)
+        gf_exp[i] = gf_exp[i - 255];
+}
+
+unsigned char gf_mul(unsigned char a, unsigned char b) {
+    if(a == 0 || b == 0)
+        return 0;
+
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+unsigned char gf_inv(unsigned char a) {
+    assert(a != 0);
+
+    return gf_exp[255 - gf_log[a]];
+}
+
+void gf_table(unsigned char c, unsigned char table[32]) {
+    unsigned int x;
+
+    for(x = 0; x < 16; ++x) {
+        table[x] = gf_mul(c, (unsigned char)x);
+        table[16 + x] = gf_mul(c, (unsigned char)(x << 4));
+    }
+}
+
+int gf_invert(unsigned char* m, unsigned char* inv, unsigned int n) {
+    unsigned int row, col, r, i;
+    unsigned char f, tmp;
+
+    /* Gauss-Jordan, m is destroyed */
+
+    memset(inv, 0, n*n);
+
+    for(i = 0; i < n; ++i)
+        inv[i*n + i] = 1;
+
+    for(col = 0; col < n; ++col) {
+        for(row = col; row < n && m[row*n + col] == 0; ++row);
+
+        if(row == n)
+            return -1;
+
+        if(row != col) {
+            for(i = 0; i < n; ++i) {
+                tmp = m[row*n + i], m[row*n + i] = m[col*n + i], m[col*n + i] = tmp;
+                tmp = inv[row*n + i], inv[row*n + i] = inv[col*n + i], inv[col*n + i] = tmp;
+            }
+        }
+
+        f = gf_inv(m[col*n + col]);
+
+        for(i = 0; i < n; ++i) {
+            m[col*n + i] = gf_mul(m[col*n + i], f);
+            inv[col*n + i] = gf_mul(inv[col*n + i], f);
+        }
+
+        for(r = 0; r < n; ++r) {
+            if(r == col || (f = m[r*n + col]) == 0)
+                continue;
+
+            for(i = 0; i < n; ++i) {
+                m[r*n + i] ^= gf_mul(m[col*n + i], f);
+                inv[r*n + i] ^= gf_mul(inv[col*n + i], f);
+            }
+        }
+    }
+
+    return 0;
+}
+
+int erasure_supported(int kernel) {
+    switch(kernel) {
+        case SN_DATA_ERASURE_KERNEL_SCALAR:
+            return 1;
+#if defined(ERASURE_X86)
+        case SN_DATA_ERASURE_KERNEL_SSSE3:
+            return __builtin_cpu_supports("ssse3");
+        case SN_DATA_ERASURE_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return 0;
+    }
+}
+
+erasure_kernel_t erasure_kernel(int kernel) {
+    switch(kernel) {
+#if defined(ERASURE_X86)
+        case SN_DATA_ERASURE_KERNEL_SSSE3:
+            return mul_add_ssse3;
+        case SN_DATA_ERASURE_KERNEL_AVX2:
+            return mul_add_avx2;
+#endif
+        default:
+            return mul_add_scalar;
+    }
+}
+
+void mul_add_scalar(unsigned char* dst, const unsigned char* src, const unsigned char* table, size_t len) {
+    size_t i;
+
+    for(i = 0; i < len; ++i)
+        dst[i] ^= table[src[i] & 0x0f] ^ table[16 + (src[i] >> 4)];
+}
+
+#if defined(ERASURE_X86)
+
+/* Each nibble picks its product out of a 16 byte table with a byte shuffle */
+
+__attribute__((target("ssse3")))
+void mul_add_ssse3(unsigned char* dst, const unsigned char* src, const unsigned char* table, size_t len) {
+    const __m128i low = _mm_loadu_si128((const __m128i*)table);
+    const __m128i high = _mm_loadu_si128((const __m128i*)(table + 16));
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i s, p;
+    size_t i;
+
+    for(i = 0; i + 16 <= len; i += 16) {
+        s = _mm_loadu_si128((const __m128i*)(src + i));
+        p = _mm_xor_si128(_mm_shuffle_epi8(low, _mm_and_si128(s, mask)),
+                          _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi64(s, 4), mask)));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(dst + i)), p));
+    }
+
+    mul_add_scalar(dst + i, src + i, table, len - i);
+}
+
+__attribute__((target("avx2")))
+void mul_add_avx2(unsigned char* dst, const unsigned char* src, const unsigned char* table, size_t len) {
+    const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table));
+    const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(table + 16)));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    __m256i s, p;
+    size_t i;
+
+    for(i = 0; i + 32 <= len; i += 32) {
+        s = _mm256_loadu_si256((const __m256i*)(src + i));
+        p = _mm256_xor_si256(_mm256_shuffle_epi8(low, _mm256_and_si256(s, mask)),
+                             _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask)));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(dst + i)), p));
+    }
+
+    mul_add_scalar(dst + i, src + i, table, len - i);
+}
+
+#endif
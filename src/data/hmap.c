@@ -0,0 +1,218 @@
+#include "data/hmap.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SN_DATA_HMAP_DEFAULT_CAPACITY 16
+
+#define SLOT(map, idx) (&(map)->slots[(idx)*(map)->slot_size])
+#define SLOT_KEY(map, slot) ((slot) + 1)
+#define SLOT_VALUE(map, slot) ((slot) + 1 + (map)->key_size)
+
+int hmap_find(const sn_data_hmap_t* map, const void* key, size_t* out_idx);
+int hmap_grow(sn_data_hmap_t* map);
+
+int sn_data_hmap_init(sn_data_hmap_t* map, size_t key_size, size_t value_size) {
+    assert(map != NULL);
+    assert(key_size != 0);
+
+    map->key_size = key_size;
+    map->value_size = value_size;
+    map->slot_size = 1 + key_size + value_size;
+    map->size = 0;
+    map->capacity = SN_DATA_HMAP_DEFAULT_CAPACITY;
+    map->slots = (char*)calloc(map->capacity, map->slot_size);
+
+    if(map->slots == NULL)
+        return -1;
+
+    return 0;
+}
+
+void sn_data_hmap_destroy(sn_data_hmap_t* map) {
+    assert(map != NULL);
+
+    map->size = map->capacity = 0;
+
+    if(map->slots)
+        free(map->slots);
+
+    map->slots = NULL;
+}
+
+size_t sn_data_hmap_size(const sn_data_hmap_t* map) {
+    assert(map != NULL);
+
+    return map->size;
+}
+
+int sn_data_hmap_get(const sn_data_hmap_t* map, const void* key, void* out) {
+    size_t idx;
+
+    assert(map != NULL);
+    assert(key != NULL);
+
+    if(hmap_find(map, key, &idx) != 0)
+        return -1;
+
+    if(out != NULL)
+        memcpy(out, SLOT_VALUE(map, SLOT(map, idx)), map->value_size);
+
+    return 0;
+}
+
+int sn_data_hmap_put(sn_data_hmap_t* map, const void* key, const void* value) {
+    size_t idx;
+    char* slot;
+
+    assert(map != NULL);
+    assert(key != NULL);
+    assert(value != NULL || map->value_size == 0);
+
+    if(hmap_find(map, key, &idx) != 0) {
+        /* Load factor kept under 1/2 */
+
+        if(2*(map->size + 1) > map->capacity) {
+            if(hmap_grow(map) != 0)
+                return -1;
+
+            hmap_find(map, key, &idx);
+        }
+
+        slot = SLOT(map, idx);
+        slot[0] = 1;
+        memcpy(SLOT_KEY(map, slot), key, map->key_size);
+        ++map->size;
+    } else {
+        slot = SLOT(map, idx);
+    }
+
+    memcpy(SLOT_VALUE(map, slot), value, map->value_size);
+
+    return 0;
+}
+
+int sn_data_hmap_remove(sn_data_hmap_t* map, const void* key, void* out) {
+    size_t mask;
+    size_t hole, idx;
+
+    assert(map != NULL);
+    assert(key != NULL);
+
+    if(hmap_find(map, key, &hole) != 0)
+        return -1;
+
+    if(out != NULL)
+        memcpy(out, SLOT_VALUE(map, SLOT(map, hole)), map->value_size);
+
+    /* Backward shift deletion, no tombstones */
+
+    mask = map->capacity - 1;
+
+    for(idx = (hole + 1) & mask; SLOT(map, idx)[0]; idx = (idx + 1) & mask) {
+        size_t home = (size_t)sn_data_hmap_hash(SLOT_KEY(map, SLOT(map, idx)), map->key_size) & mask;
+
+        /* Moves the entry if hole lies between its home and its slot */
+
+        if(((idx - home) & mask) >= ((idx - hole) & mask)) {
+            memcpy(SLOT(map, hole), SLOT(map, idx), map->slot_size);
+            hole = idx;
+        }
+    }
+
+    SLOT(map, hole)[0] = 0;
+    --map->size;
+
+    return 0;
+}
+
+int sn_data_hmap_next(const sn_data_hmap_t* map, size_t* iter, void* out_key, void* out_value) {
+    assert(map != NULL);
+    assert(iter != NULL);
+
+    for(; *iter < map->capacity; ++*iter) {
+        char* slot = SLOT(map, *iter);
+
+        if(slot[0]) {
+            if(out_key != NULL)
+                memcpy(out_key, SLOT_KEY(map, slot), map->key_size);
+
+            if(out_value != NULL)
+                memcpy(out_value, SLOT_VALUE(map, slot), map->value_size);
+
+            ++*iter;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+uint64_t sn_data_hmap_hash(const void* key, size_t key_size) {
+    const unsigned char* bytes = (const unsigned char*)key;
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i;
+
+    /* FNV-1a */
+
+    for(i = 0; i < key_size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/*Private functions*/
+
+int hmap_find(const sn_data_hmap_t* map, const void* key, size_t* out_idx) {
+    size_t mask = map->capacity - 1;
+    size_t idx = (size_t)sn_data_hmap_hash(key, map->key_size) & mask;
+
+    for(;; idx = (idx + 1) & mask) {
+        char* slot = SLOT(map, idx);
+
+        if(!slot[0]) {
+            *out_idx = idx;
+            return -1;
+        }
+
+        if(memcmp(SLOT_KEY(map, slot), key, map->key_size) == 0) {
+            *out_idx = idx;
+            return 0;
+        }
+    }
+}
+
+int hmap_grow(sn_data_hmap_t* map) {
+    char* old_slots = map->slots;
+    size_t old_capacity = map->capacity;
+    size_t i;
+
+    map->slots = (char*)calloc(old_capacity*2, map->slot_size);
+
+    if(map->slots == NULL) {
+        map->slots = old_slots;
+        return -1;
+    }
+
+    map->capacity = old_capacity*2;
+
+    for(i = 0; i < old_capacity; ++i) {
+        char* slot = &old_slots[i*map->slot_size];
+        size_t idx;
+
+        if(!slot[0])
+            continue;
+
+        hmap_find(map, SLOT_KEY(map, slot), &idx);
+        memcpy(SLOT(map, idx), slot, map->slot_size);
+    }
+
+    free(old_slots);
+
+    return 0;
+}
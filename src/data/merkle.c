@@ -0,0 +1,157 @@
+#include "data/merkle.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sodium.h>
+
+#define NODE_ID(level, index) ((uint32_t)(level) << 24 | (uint32_t)(index))
+
+typedef struct {
+    unsigned char digest[SN_DATA_MERKLE_DIGEST_LEN];
+    unsigned char stale; /* Inner node whose children changed since its digest was computed */
+} sn_merkle_node_t;
+
+int merkle_is_zero(const unsigned char digest[SN_DATA_MERKLE_DIGEST_LEN]);
+
+int sn_data_merkle_init(sn_data_merkle_t* tree) {
+    assert(tree != NULL);
+
+    return sn_data_hmap_init(&tree->nodes, sizeof(uint32_t), sizeof(sn_merkle_node_t));
+}
+
+void sn_data_merkle_destroy(sn_data_merkle_t* tree) {
+    assert(tree != NULL);
+
+    sn_data_hmap_destroy(&tree->nodes);
+}
+
+int sn_data_merkle_toggle(sn_data_merkle_t* tree, const unsigned char* key, const unsigned char digest[SN_DATA_MERKLE_DIGEST_LEN]) {
+    sn_merkle_node_t node;
+    uint32_t id;
+    unsigned int level;
+    size_t i;
+
+    assert(tree != NULL);
+    assert(key != NULL);
+    assert(digest != NULL);
+
+    /* Toggled in and out of the leaf, the same item twice leaves it as it was */
+
+    id = NODE_ID(SN_DATA_MERKLE_DEPTH, sn_data_merkle_index(key, SN_DATA_MERKLE_DEPTH));
+
+    if(sn_data_hmap_get(&tree->nodes, &id, &node) != 0)
+        memset(&node, 0, sizeof(node));
+
+    for(i = 0; i < SN_DATA_MERKLE_DIGEST_LEN; ++i)
+        node.digest[i] ^= digest[i];
+
+    if(merkle_is_zero(node.digest))
+        sn_data_hmap_remove(&tree->nodes, &id, NULL);
+    else if(sn_data_hmap_put(&tree->nodes, &id, &node) != 0)
+        return -1;
+
+    /* Ancestors are rehashed when asked for */
+
+    for(level = 0; level < SN_DATA_MERKLE_DEPTH; ++level) {
+        id = NODE_ID(level, sn_data_merkle_index(key, level));
+
+        if(sn_data_hmap_get(&tree->nodes, &id, &node) != 0)
+            memset(&node, 0, sizeof(node));
+
+        node.stale = 1;
+
+        if(sn_data_hmap_put(&tree->nodes, &id, &node) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+void sn_data_merkle_digest(sn_data_merkle_t* tree, unsigned int level, uint32_t index, unsigned char out[SN_DATA_MERKLE_DIGEST_LEN]) {
+    unsigned char children[SN_DATA_MERKLE_FANOUT][SN_DATA_MERKLE_DIGEST_LEN];
+    sn_merkle_node_t node;
+    uint32_t id = NODE_ID(level, index);
+    size_t i;
+
+    assert(tree != NULL);
+    assert(level <= SN_DATA_MERKLE_DEPTH);
+    assert(out != NULL);
+
+    if(sn_data_hmap_get(&tree->nodes, &id, &node) != 0) {
+        memset(out, 0, SN_DATA_MERKLE_DIGEST_LEN);
+        return;
+    }
+
+    if(node.stale) {
+        for(i = 0; i < SN_DATA_MERKLE_FANOUT; ++i)
+            sn_data_merkle_digest(tree, level + 1, index*SN_DATA_MERKLE_FANOUT + (uint32_t)i, children[i]);
+
+        node.stale = 0;
+        memset(node.digest, 0, sizeof(node.digest));
+
+        for(i = 0; i < SN_DATA_MERKLE_FANOUT && merkle_is_zero(children[i]); ++i);
+
+        if(i < SN_DATA_MERKLE_FANOUT)
+            crypto_generichash(node.digest, sizeof(node.digest), &children[0][0], sizeof(children), NULL, 0);
+
+        /* Subtrees emptied by the changes are dropped */
+
+        if(merkle_is_zero(node.digest))
+            sn_data_hmap_remove(&tree->nodes, &id, NULL);
+        else
+            sn_data_hmap_put(&tree->nodes, &id, &node);
+    }
+
+    memcpy(out, node.digest, SN_DATA_MERKLE_DIGEST_LEN);
+}
+
+uint32_t sn_data_merkle_index(const unsigned char* key, unsigned int level) {
+    uint32_t index = 0;
+    unsigned int i;
+
+    assert(key != NULL);
+    assert(level <= SN_DATA_MERKLE_DEPTH);
+
+    /* The first level hex digits, most significant first */
+
+    for(i = 0; i < level; ++i)
+        index = index*SN_DATA_MERKLE_FANOUT + (i%2 ? key[i/2] & 0x0f : key[i/2] >> 4);
+
+    return index;
+}
+
+void sn_data_merkle_item(const unsigned char* key, size_t key_len, uint64_t version, const char* value, size_t len, unsigned char out[SN_DATA_MERKLE_DIGEST_LEN]) {
+    unsigned char hash_key[crypto_generichash_KEYBYTES_MAX];
+    size_t i;
+
+    assert(key != NULL);
+    assert(key_len + 8 <= sizeof(hash_key));
+    assert(value != NULL || len == 0);
+    assert(out != NULL);
+
+    /* The value hashed under its key and version */
+
+    memset(hash_key, 0, sizeof(hash_key));
+    memcpy(hash_key, key, key_len);
+
+    for(i = 0; i < 8; ++i)
+        hash_key[key_len + i] = (unsigned char)(version >> (8*(7 - i)));
+
+    crypto_generichash(out, SN_DATA_MERKLE_DIGEST_LEN, (const unsigned char*)value, len, hash_key, key_len + 8 < crypto_generichash_KEYBYTES_MIN ? crypto_generichash_KEYBYTES_MIN : key_len + 8);
+}
+
+/*Private functions*/
+
+int merkle_is_zero(const unsigned char digest[SN_DATA_MERKLE_DIGEST_LEN]) {
+    size_t i;
+
+    for(i = 0; i < SN_DATA_MERKLE_DIGEST_LEN; ++i)
+        if(digest[i])
+            return 0;
+
+    return 1;
+}
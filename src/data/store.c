@@ -0,0 +1,163 @@
+#include "data/store.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Bytes a value takes on the arena */
+#define ARENA_SIZE(len) ((((len) ? (len) : 1) + 7) & ~(size_t)7)
+
+int store_compact(sn_data_store_t* store);
+
+int sn_data_store_init(sn_data_store_t* store, size_t key_size) {
+    assert(store != NULL);
+
+    if(sn_data_hmap_init(&store->index, key_size, sizeof(sn_data_store_item_t)) != 0)
+        return -1;
+
+    sn_data_arena_init(&store->arena);
+    store->live = 0;
+
+    return 0;
+}
+
+void sn_data_store_destroy(sn_data_store_t* store) {
+    assert(store != NULL);
+
+    sn_data_hmap_destroy(&store->index);
+    sn_data_arena_destroy(&store->arena);
+    store->live = 0;
+}
+
+size_t sn_data_store_size(const sn_data_store_t* store) {
+    assert(store != NULL);
+
+    return sn_data_hmap_size(&store->index);
+}
+
+int sn_data_store_get(const sn_data_store_t* store, const void* key, sn_data_store_item_t* out) {
+    assert(store != NULL);
+    assert(key != NULL);
+
+    return sn_data_hmap_get(&store->index, key, out);
+}
+
+int sn_data_store_put(sn_data_store_t* store, const void* key, const char* value, size_t len, uint64_t version) {
+    sn_data_store_item_t item, old;
+    char* bytes;
+    int found;
+
+    assert(store != NULL);
+    assert(key != NULL);
+    assert(value != NULL || len == 0);
+
+    if((bytes = (char*)sn_data_arena_alloc(&store->arena, len)) == NULL)
+        return -1;
+
+    if(len)
+        memcpy(bytes, value, len);
+
+    item.value = bytes;
+    item.len = len;
+    item.version = version;
+
+    found = sn_data_hmap_get(&store->index, key, &old) == 0;
+
+    if(sn_data_hmap_put(&store->index, key, &item) != 0)
+        return -1;
+
+    if(found)
+        store->live -= ARENA_SIZE(old.len);
+
+    store->live += ARENA_SIZE(len);
+
+    /* A failed compaction keeps every value where it was */
+
+    store_compact(store);
+
+    return 0;
+}
+
+int sn_data_store_remove(sn_data_store_t* store, const void* key) {
+    sn_data_store_item_t old;
+
+    assert(store != NULL);
+    assert(key != NULL);
+
+    if(sn_data_hmap_remove(&store->index, key, &old) != 0)
+        return -1;
+
+    store->live -= ARENA_SIZE(old.len);
+    store_compact(store);
+
+    return 0;
+}
+
+int sn_data_store_next(const sn_data_store_t* store, size_t* iter, void* out_key, sn_data_store_item_t* out) {
+    assert(store != NULL);
+    assert(iter != NULL);
+
+    return sn_data_hmap_next(&store->index, iter, out_key, out);
+}
+
+/*Private functions*/
+
+int store_compact(sn_data_store_t* store) {
+    sn_data_arena_chunk_t* tail;
+    sn_data_store_item_t item;
+    sn_data_arena_t arena;
+    size_t iter = 0;
+    size_t garbage;
+    void* key;
+    char* bytes;
+    int ret = 0;
+
+    /* Only worth it once the garbage is both half the arena and a whole chunk */
+
+    garbage = sn_data_arena_used(&store->arena) - store->live;
+
+    if(garbage < store->live || garbage < SN_DATA_ARENA_CHUNK)
+        return 0;
+
+    if((key = malloc(store->index.key_size)) == NULL)
+        return -1;
+
+    sn_data_arena_init(&arena);
+
+    /* Replacing values of present keys keeps the map layout, and the iteration */
+
+    while(sn_data_hmap_next(&store->index, &iter, key, &item) == 0) {
+        if((bytes = (char*)sn_data_arena_alloc(&arena, item.len)) == NULL) {
+            ret = -1;
+            break;
+        }
+
+        memcpy(bytes, item.value, item.len);
+        item.value = bytes;
+        sn_data_hmap_put(&store->index, key, &item);
+    }
+
+    free(key);
+
+    if(ret != 0) {
+        /* Values already moved point to the new chunks, both sets are kept */
+
+        if(arena.head != NULL) {
+            for(tail = arena.head; tail->next != NULL; tail = tail->next);
+
+            tail->next = store->arena.head;
+            store->arena.head = arena.head;
+            store->arena.used += arena.used;
+            store->arena.reserved += arena.reserved;
+        }
+
+        return -1;
+    }
+
+    sn_data_arena_destroy(&store->arena);
+    store->arena = arena;
+
+    return 0;
+}
@@ -3,17 +3,52 @@
 #include "node.h"
 #include "net/entry.h"
 #include "net/packet.h"
+#include "net/router.h"
 #include "io/naddr.h"
 #include "wire.h"
 #include "common.h"
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Router entries fitting in a join reply next to its headers */
+
+#define JOIN_REPLY_ENTRIES ((SN_NET_PACKET_MAX_LEN - sizeof(sn_wire_reply_header_t) - sizeof(sn_wire_join_reply_header_t) - sizeof(sn_net_router_query_ser_t))/sizeof(sn_net_router_entry_ser_t))
+
+/* A full routing table row(without our own column) goes in a single reply */
+
+SN_ASSERT_COMPILE(JOIN_REPLY_ENTRIES >= SN_NET_ROUTER_COLUMNS - 1);
+
+int join_reply(sn_node_t* sns, const sn_net_packet_t* packet, int root);
 
 //Forward handlers declarations
 
+int forward_join_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop);
+int forward_subscribe_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop);
+int forward_publish_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop);
+int forward_broadcast_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop);
+int forward_aggregate_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop);
+int forward_store_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop);
+int forward_sync_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop);
+
 const sn_forward_handler_t sn_default_forward_handlers[] = {
     NULL,
     NULL,
+    NULL,
+    forward_join_handler,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    forward_subscribe_handler,
+    forward_publish_handler,
+    forward_broadcast_handler,
+    forward_aggregate_handler,
+    forward_store_handler,
+    forward_sync_handler,
     NULL
 };
 
@@ -24,17 +59,162 @@ SN_ASSERT_COMPILE(sizeof(sn_default_forward_handlers) == SN_WIRE_NET_TYPES*sizeo
 int deliver_user_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
 int deliver_reply_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
 int deliver_ping_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_join_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_announce_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_repair_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_shortcut_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_hedged_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_lookup_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_members_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_subscribe_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_publish_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_broadcast_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_aggregate_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_store_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_sync_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
+int deliver_object_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
 
 const sn_deliver_handler_t sn_default_deliver_handlers[] = {
     deliver_user_handler,
     deliver_reply_handler,
-    deliver_ping_handler
+    deliver_ping_handler,
+    deliver_join_handler,
+    deliver_announce_handler,
+    deliver_repair_handler,
+    deliver_shortcut_handler,
+    deliver_hedged_handler,
+    deliver_lookup_handler,
+    deliver_members_handler,
+    deliver_subscribe_handler,
+    deliver_publish_handler,
+    deliver_broadcast_handler,
+    deliver_aggregate_handler,
+    deliver_store_handler,
+    deliver_sync_handler,
+    deliver_object_handler
 };
 
 SN_ASSERT_COMPILE(sizeof(sn_default_deliver_handlers) == SN_WIRE_NET_TYPES*sizeof(sn_deliver_handler_t));
 
 //Forward handlers definitions
 
+int forward_join_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop) {
+    sn_net_addr_t joiner;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    SN_UNUSED(rem_addr);
+
+    sn_net_packet_get_src(packet, &joiner);
+
+    /* A stale entry of the joining node, we are the closest one */
+
+    if(sn_net_addr_cmp(&nexthop->addr, &joiner) == 0) {
+        nexthop->is_set = 0;
+        return 0;
+    }
+
+    /* Replies before forwarding, a failed reply does not stop the join */
+
+    join_reply(sns, packet, 0);
+
+    return 0;
+}
+
+int forward_subscribe_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    /* Every node on the way joins the tree itself, the subscription stops here */
+
+    if(rem_addr != NULL)
+        nexthop->is_set = 0;
+
+    return 0;
+}
+
+int forward_publish_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    SN_UNUSED(rem_addr);
+
+    /* Going up to the root, down our own branches on the way */
+
+    return sn_node_topic_forward(sns, packet, nexthop);
+}
+
+int forward_broadcast_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    SN_UNUSED(rem_addr);
+
+    /* Copies are sent straight to the node splitting them, never routed */
+
+    nexthop->is_set = 0;
+
+    return 0;
+}
+
+int forward_aggregate_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    SN_UNUSED(rem_addr);
+
+    /* Queries and results go straight between tree neighbors */
+
+    nexthop->is_set = 0;
+
+    return 0;
+}
+
+int forward_store_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop) {
+    const sn_wire_store_msg_t* msg = (const sn_wire_store_msg_t*)packet->payload;
+    sn_net_addr_t key;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    SN_UNUSED(rem_addr);
+
+    if(packet->header.len < sizeof(*msg) || sn_net_addr_deser(&key, &msg->key) != 0)
+        return 0;
+
+    /* Gets stop at the first replica on their way */
+
+    if(msg->op == SN_WIRE_STORE_GET && sn_node_store_holds(sns, &key)) {
+        nexthop->is_set = 0;
+        return 0;
+    }
+
+    /* Or at the first relay that cached the value */
+
+    return sn_node_cache_heard(sns, packet, rem_addr);
+}
+
+int forward_sync_handler(sn_node_t* sns, sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    SN_UNUSED(rem_addr);
+
+    /* Exchanged straight between leafset neighbors */
+
+    nexthop->is_set = 0;
+
+    return 0;
+}
+
 //Deliver handlers definitions
 
 int deliver_user_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
@@ -47,14 +227,22 @@ int deliver_user_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn
 }
 
 int deliver_reply_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_reply_header_t* reply = (sn_wire_reply_header_t*)packet->payload;
+    sn_net_addr_t src;
+
     assert(sns != NULL);
     assert(packet != NULL);
 
     SN_UNUSED(rem_addr);
 
-    assert(0);
+    if(packet->header.len < sizeof(sn_wire_reply_header_t))
+        return -1;
+
+    sn_net_packet_get_src(packet, &src);
 
-    return 1;
+    return sn_node_call_reply(sns, reply->reply_id,
+        (const char*)packet->payload + sizeof(sn_wire_reply_header_t),
+        packet->header.len - sizeof(sn_wire_reply_header_t), &src);
 }
 
 int deliver_ping_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
@@ -64,10 +252,403 @@ int deliver_ping_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn
     assert(sns != NULL);
     assert(packet != NULL);
 
+    sn_net_packet_get_src(packet, &src);
+
+    /* Sent straight to us(failure detector probes), answered straight back */
+
+    if(rem_addr != NULL && packet->header.ttl == SN_NET_PACKET_DEFAULT_TTL - 1)
+        return sn_node_send_direct(sns, &src, rem_addr, SN_WIRE_NET_TYPE_REPLY, sizeof(*ping), (const char*)ping);
+
+    return sn_node_send_typed_locked(sns, &src, SN_WIRE_NET_TYPE_REPLY, sizeof(*ping), (const char*)ping);
+}
+
+
+int deliver_join_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    sn_net_addr_t joiner;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    SN_UNUSED(rem_addr);
+
+    sn_net_packet_get_src(packet, &joiner);
+
+    /* Our own join came back */
+
+    if(sn_net_addr_cmp(&joiner, &sns->self) == 0)
+        return -1;
+
+    return join_reply(sns, packet, 1);
+}
+
+int deliver_announce_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_announce_msg_t* announce = (sn_wire_announce_msg_t*)packet->payload;
+    sn_net_addr_t src;
+    sn_io_naddr_t net_addr;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
     SN_UNUSED(rem_addr);
 
+    if(packet->header.len < sizeof(*announce))
+        return -1;
+
+    sn_net_packet_get_src(packet, &src);
+
+    if(sn_net_addr_cmp(&src, &sns->self) == 0 || sn_io_naddr_deser(&net_addr, &announce->net_addr) != 0)
+        return -1;
+
+    sn_node_add_route_locked(sns, &src, &net_addr);
+
+    return 0;
+}
+
+int deliver_repair_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_repair_msg_t* repair = (sn_wire_repair_msg_t*)packet->payload;
+    const sn_net_entry_t* e;
+    sn_wire_reply_header_t* reply;
+    sn_wire_repair_reply_header_t* header;
+    sn_net_router_query_ser_t* query;
+    unsigned char buf[sizeof(*reply) + sizeof(*header) + sizeof(*query) + sizeof(sn_net_router_entry_ser_t)];
+    sn_net_addr_t src;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(packet->header.len < sizeof(*repair) || rem_addr == NULL ||
+            repair->level >= SN_NET_ROUTER_LEVELS || repair->column >= SN_NET_ROUTER_COLUMNS)
+        return -1;
+
+    sn_net_packet_get_src(packet, &src);
+
+    reply = (sn_wire_reply_header_t*)buf;
+    header = (sn_wire_repair_reply_header_t*)(reply + 1);
+    query = (sn_net_router_query_ser_t*)(header + 1);
+
+    reply->reply_id = repair->reply_to;
+    header->level = repair->level;
+    header->column = repair->column;
+    header->reserved = 0;
+    query->entries_len = 0;
+
+    /* Our entry, unless it is the asking node itself */
+
+    e = sn_net_router_table_get(&sns->router, repair->level, repair->column);
+
+    if(e->is_set && sn_net_addr_cmp(&e->addr, &src) != 0 && sn_net_entry_ser(e, &query->entries[0].entry) == 0) {
+        query->entries[0].is_table = 1;
+        query->entries[0].level = repair->level;
+        query->entries[0].column = repair->column;
+        query->entries_len = 1;
+    }
+
+    return sn_node_send_direct(sns, &src, rem_addr, SN_WIRE_NET_TYPE_REPLY,
+        sizeof(*reply) + sizeof(*header) + sizeof(*query) + query->entries_len*sizeof(sn_net_router_entry_ser_t), (const char*)buf);
+}
+
+//Join replies
+
+int join_reply(sn_node_t* sns, const sn_net_packet_t* packet, int root) {
+    const sn_wire_join_msg_t* join = (sn_wire_join_msg_t*)packet->payload;
+    const sn_net_router_query_ser_t* queries[SN_NET_ROUTER_LEVELS + 2];
+    uint32_t lens[SN_NET_ROUTER_LEVELS + 2];
+    sn_wire_reply_header_t* reply;
+    sn_wire_join_reply_header_t* header;
+    sn_net_router_query_ser_t* query;
+    unsigned char buf[SN_NET_PACKET_MAX_LEN];
+    sn_net_addr_t joiner;
+    sn_io_naddr_t joiner_net;
+    unsigned int level, hop, l;
+    size_t total = 0, count = 0, sent, i, j, len;
+    uint8_t parts;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(packet->header.len < sizeof(*join) || packet->header.ttl >= SN_NET_PACKET_DEFAULT_TTL)
+        return -1;
+
+    sn_net_packet_get_src(packet, &joiner);
+
+    if(sn_io_naddr_deser(&joiner_net, &join->net_addr) != 0)
+        return -1;
+
+    /* The joining node sends with the default TTL and every node decreases it before handling */
+
+    hop = SN_NET_PACKET_DEFAULT_TTL - 1 - packet->header.ttl;
+
+    sn_net_addr_index(&sns->self, &joiner, &level, NULL);
+
+    /*
+    Earlier hops already sent the rows below hop, as each hop shares at least one more nibble with
+    the joining node. Rows up to our level are valid rows for it too.
+    Rows come serialized from the router cache, so a burst of joins only copies them.
+    */
+
+    for(l = hop; l <= level && l < SN_NET_ROUTER_LEVELS; ++l) {
+        if((queries[count] = sn_net_router_cached_row(&sns->router, (uint16_t)l, &len)) != NULL) {
+            lens[count] = queries[count]->entries_len;
+            ++count;
+        }
+    }
+
+    /* Ourselves(the first entry of the right half), and the whole leafset from the closest node */
+
+    for(i = root ? 0 : 1; i < 2; ++i) {
+        if((queries[count] = sn_net_router_cached_leafset(&sns->router, (int)i, &len)) != NULL) {
+            lens[count] = root ? queries[count]->entries_len : SN_MIN(queries[count]->entries_len, 1);
+            ++count;
+        }
+    }
+
+    for(i = 0; i < count; ++i)
+        total += lens[i];
+
+    parts = (uint8_t)SN_MIN((total + JOIN_REPLY_ENTRIES - 1)/JOIN_REPLY_ENTRIES, UINT8_MAX);
+
+    reply = (sn_wire_reply_header_t*)buf;
+    header = (sn_wire_join_reply_header_t*)(reply + 1);
+    query = (sn_net_router_query_ser_t*)(header + 1);
+
+    reply->reply_id = join->reply_to;
+    header->hop = (uint8_t)hop;
+    header->parts = parts;
+    header->hops = root ? (uint8_t)hop : 0;
+    header->flags = root ? SN_WIRE_JOIN_REPLY_ROOT : 0;
+
+    /* Queries packed back to back, JOIN_REPLY_ENTRIES per reply */
+
+    for(i = 0, j = 0, sent = 0; sent < parts; ++sent) {
+        for(query->entries_len = 0; i < count && query->entries_len < JOIN_REPLY_ENTRIES;) {
+            size_t run = SN_MIN(lens[i] - j, JOIN_REPLY_ENTRIES - query->entries_len);
+
+            /* Cached entries go straight into the packet, one copy per reply */
+
+            memcpy(&query->entries[query->entries_len], &queries[i]->entries[j], run*sizeof(sn_net_router_entry_ser_t));
+            query->entries_len += (uint32_t)run;
+
+            if((j += run) == lens[i]) {
+                ++i;
+                j = 0;
+            }
+        }
+
+        len = sizeof(*reply) + sizeof(*header) + sizeof(*query) + query->entries_len*sizeof(sn_net_router_entry_ser_t);
+
+        if(sn_node_send_direct(sns, &joiner, &joiner_net, SN_WIRE_NET_TYPE_REPLY, len, (const char*)buf) != 0)
+            ret = -1;
+    }
+
+    return ret;
+}
+
+int deliver_shortcut_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_shortcut_msg_t* msg = (const sn_wire_shortcut_msg_t*)packet->payload;
+    sn_io_naddr_t net_addr;
+    sn_net_addr_t src;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    (void)rem_addr;
+
+    if(packet->header.len < sizeof(*msg) || sn_io_naddr_deser(&net_addr, &msg->net_addr) != 0)
+        return -1;
+
     sn_net_packet_get_src(packet, &src);
 
-    return sn_node_send_typed(sns, &src, SN_WIRE_NET_TYPE_REPLY, sizeof(*ping), (const char*)ping);
+    if(sn_net_addr_cmp(&src, &sns->self) == 0)
+        return -1;
+
+    return sn_node_add_shortcut(sns, &src, &net_addr, msg->hops);
 }
 
+int deliver_hedged_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_hedged_header_t* header = (const sn_wire_hedged_header_t*)packet->payload;
+    sn_deliver_handler_t d_fn;
+    sn_net_packet_t* inner;
+    sn_net_addr_t src;
+    size_t len;
+    int ret;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(packet->header.len < sizeof(*header) || header->type >= SN_WIRE_NET_TYPES || header->type == SN_WIRE_NET_TYPE_HEDGED)
+        return -1;
+
+    sn_net_packet_get_src(packet, &src);
+
+    if(sn_node_dedup(sns, &src, header->nonce))
+        return 0;
+
+    if((d_fn = sn_default_deliver_handlers[header->type]) == NULL)
+        return 0;
+
+    /* Delivered as the inner type */
+
+    len = packet->header.len - sizeof(*header);
+
+    if((inner = (sn_net_packet_t*)malloc(sizeof(sn_wire_net_header_t) + len + 1)) == NULL)
+        return -1;
+
+    inner->header = packet->header;
+    inner->header.type = header->type;
+    inner->header.len = (uint16_t)len;
+    memcpy(inner->payload, header + 1, len);
+    inner->payload[len] = '\0';
+
+    ret = d_fn(sns, inner, rem_addr);
+
+    free(inner);
+
+    return ret;
+}
+
+int deliver_lookup_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_lookup_msg_t* lookup = (sn_wire_lookup_msg_t*)packet->payload;
+    sn_net_router_query_ser_t* leafset = NULL;
+    sn_wire_reply_header_t* reply;
+    sn_wire_lookup_reply_header_t* header;
+    sn_net_router_query_ser_t* query;
+    unsigned char buf[sizeof(*reply) + sizeof(*header) + sizeof(*query) + (SN_NET_ROUTER_LEAFSET_SIZE + 1)*sizeof(sn_net_router_entry_ser_t)];
+    sn_net_entry_t nexthop;
+    sn_net_addr_t target, src;
+    unsigned int level;
+    unsigned char column;
+    size_t leafset_len;
+    int right;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(packet->header.len < sizeof(*lookup) || rem_addr == NULL || lookup->reply_to == 0 ||
+            sn_net_addr_deser(&target, &lookup->target) != 0)
+        return -1;
+
+    sn_net_packet_get_src(packet, &src);
+
+    reply = (sn_wire_reply_header_t*)buf;
+    header = (sn_wire_lookup_reply_header_t*)(reply + 1);
+    query = (sn_net_router_query_ser_t*)(header + 1);
+
+    reply->reply_id = lookup->reply_to;
+    memset(header, 0, sizeof(*header));
+    query->entries_len = 0;
+
+    /* Our nexthop first, none means we own the target */
+
+    sn_node_nexthop(sns, &target, &nexthop);
+
+    if(!nexthop.is_set) {
+        header->flags |= SN_WIRE_LOOKUP_REPLY_OWNER;
+    } else if(sn_net_entry_ser(&nexthop, &query->entries[0].entry) == 0) {
+        sn_net_addr_index(&sns->self, &nexthop.addr, &level, &column);
+
+        query->entries[0].is_table = 1;
+        query->entries[0].level = (uint16_t)level;
+        query->entries[0].column = column;
+        query->entries_len = 1;
+    }
+
+    /* Then the leafset half facing the target */
+
+    right = sn_net_addr_cmp(&target, &sns->self) > 0;
+    leafset_len = right ? sn_net_router_query_leafset(&sns->router, 1, SN_NET_ROUTER_LEAFSET_SIZE, &leafset)
+                        : sn_net_router_query_leafset(&sns->router, -SN_NET_ROUTER_LEAFSET_SIZE, -1, &leafset);
+
+    if(leafset_len && leafset != NULL) {
+        memcpy(&query->entries[query->entries_len], leafset->entries, leafset->entries_len*sizeof(sn_net_router_entry_ser_t));
+        query->entries_len += leafset->entries_len;
+    }
+
+    free(leafset);
+
+    return sn_node_send_direct(sns, &src, rem_addr, SN_WIRE_NET_TYPE_REPLY,
+        sizeof(*reply) + sizeof(*header) + sizeof(*query) + query->entries_len*sizeof(sn_net_router_entry_ser_t), (const char*)buf);
+}
+
+int deliver_members_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_members_header_t* header = (const sn_wire_members_header_t*)packet->payload;
+    const sn_wire_members_record_t* records = (const sn_wire_members_record_t*)(header + 1);
+    sn_net_entry_t e;
+    size_t i;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    (void)rem_addr;
+
+    if(packet->header.len < sizeof(*header) ||
+            packet->header.len < sizeof(*header) + header->records_len*sizeof(*records))
+        return -1;
+
+    for(i = 0; i < header->records_len; ++i) {
+        if(sn_net_entry_deser(&e, &records[i].entry) == 0)
+            sn_node_gossip_heard(sns, &e, records[i].incarnation);
+    }
+
+    return 0;
+}
+
+int deliver_subscribe_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_subscribe_msg_t* msg = (const sn_wire_subscribe_msg_t*)packet->payload;
+    sn_net_addr_t topic, child;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(packet->header.len < sizeof(*msg) || rem_addr == NULL)
+        return -1;
+
+    sn_net_packet_get_dst(packet, &topic);
+    sn_net_packet_get_src(packet, &child);
+
+    return sn_node_topic_heard(sns, &topic, &child, rem_addr, msg->flags & SN_WIRE_SUBSCRIBE_LEAVE);
+}
+
+int deliver_publish_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    return sn_node_topic_deliver(sns, packet, rem_addr);
+}
+
+int deliver_broadcast_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    SN_UNUSED(rem_addr);
+
+    return sn_node_broadcast_heard(sns, packet);
+}
+
+int deliver_aggregate_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    return sn_node_aggregate_heard(sns, packet, rem_addr);
+}
+
+int deliver_store_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    return sn_node_store_heard(sns, packet, rem_addr);
+}
+
+int deliver_sync_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    return sn_node_sync_heard(sns, packet, rem_addr);
+}
+
+int deliver_object_handler(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    return sn_node_object_heard(sns, packet, rem_addr);
+}
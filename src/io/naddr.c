@@ -39,7 +39,7 @@ int sn_io_naddr_local(sn_io_naddr_t* addr, const char* path) {
     memset(unaddr->sun_path, 0, SN_IO_NADDR_MAX_PATH_LEN);
 
     unaddr->sun_path[0] = path[0] == '_' ? '\0' : path[0];
-    strncpy(unaddr->sun_path+1, path+1, SN_IO_NADDR_MAX_PATH_LEN);
+    strncpy(unaddr->sun_path+1, path+1, SN_IO_NADDR_MAX_PATH_LEN - 1);
 
     return 0;
 }
@@ -117,10 +117,15 @@ int sn_io_naddr_ser(const sn_io_naddr_t* addr, sn_io_naddr_ser_t* ser) {
     assert(addr != NULL);
     assert(ser != NULL);
 
+    /* No uninitialized bytes on the wire */
+
+    memset(ser, 0, sizeof(*ser));
+
     switch (addr->sa_family) {
         case AF_INET:
             ser->type = 1;
             ser->inet.ipv4 = ((struct sockaddr_in*)addr)->sin_addr.s_addr;
+            ser->inet.port = ((struct sockaddr_in*)addr)->sin_port;
             break;
         case AF_UNIX:
             ser->type = 2;
@@ -137,6 +142,10 @@ int sn_io_naddr_deser(sn_io_naddr_t* addr, const sn_io_naddr_ser_t* ser) {
     assert(addr != NULL);
     assert(ser != NULL);
 
+    /* Padding is zeroed so sn_io_naddr_cmp works */
+
+    memset(addr, 0, sizeof(*addr));
+
     switch (ser->type) {
         case 1:
             ((struct sockaddr_in*)addr)->sin_family = AF_INET;
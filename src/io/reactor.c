@@ -0,0 +1,552 @@
+#include "io/reactor.h"
+
+#include "common.h"
+#include "util/time.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define SN_IO_REACTOR_EVENTS 64
+
+struct sn_io_reactor_post_t_ {
+    sn_io_reactor_post_t* next;
+    sn_util_closure_t closure;
+};
+
+int reactor_init(sn_io_reactor_t* r, int shared);
+void reactor_watch(sn_io_reactor_t* r, sn_io_reactor_source_t* src);
+void reactor_run_timers(sn_io_reactor_t* r);
+void reactor_run_posts(sn_io_reactor_t* r);
+void reactor_arm(sn_io_reactor_t* r);
+int heap_push(sn_io_reactor_t* r, sn_io_reactor_timer_t* t);
+void heap_remove(sn_io_reactor_t* r, sn_io_reactor_timer_t* t);
+void heap_up(sn_io_reactor_t* r, size_t idx);
+void heap_down(sn_io_reactor_t* r, size_t idx);
+void heap_swap(sn_io_reactor_t* r, size_t a, size_t b);
+
+int sn_io_reactor_init(sn_io_reactor_t* r) {
+    return reactor_init(r, 0);
+}
+
+int sn_io_reactor_init_shared(sn_io_reactor_t* r) {
+    return reactor_init(r, 1);
+}
+
+int reactor_init(sn_io_reactor_t* r, int shared) {
+    struct epoll_event ev;
+
+    assert(r != NULL);
+
+    memset(r, 0, sizeof(sn_io_reactor_t));
+    r->timer_src.fd = r->wake_src.fd = -1;
+    r->shared = shared;
+
+    if(pthread_mutex_init(&r->mut, NULL) != 0)
+        return -1;
+
+    if(pthread_cond_init(&r->timer_cond, NULL) != 0) {
+        pthread_mutex_destroy(&r->mut);
+        return -1;
+    }
+
+    if((r->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+        goto error;
+
+    if((r->timer_src.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+        goto error;
+
+    if((r->wake_src.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+        goto error;
+
+    memset(&ev, 0, sizeof(ev));
+
+    ev.events = shared ? EPOLLIN | EPOLLONESHOT : EPOLLIN;
+    ev.data.ptr = &r->timer_src;
+    if(epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->timer_src.fd, &ev) == -1)
+        goto error;
+
+    /* The wakeup is level-triggered even on shared reactors so it can wake every thread */
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &r->wake_src;
+    if(epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->wake_src.fd, &ev) == -1)
+        goto error;
+
+    return 0;
+
+error:
+    sn_io_reactor_destroy(r);
+    return -1;
+}
+
+void sn_io_reactor_destroy(sn_io_reactor_t* r) {
+    sn_io_reactor_post_t* post;
+
+    assert(r != NULL);
+
+    while((post = r->posts) != NULL) {
+        r->posts = post->next;
+        free(post);
+    }
+
+    free(r->heap);
+    r->heap = NULL;
+    r->heap_len = r->heap_cap = 0;
+
+    if(r->wake_src.fd != -1)
+        close(r->wake_src.fd);
+
+    if(r->timer_src.fd != -1)
+        close(r->timer_src.fd);
+
+    if(r->epoll_fd != -1)
+        close(r->epoll_fd);
+
+    r->epoll_fd = r->timer_src.fd = r->wake_src.fd = -1;
+
+    pthread_cond_destroy(&r->timer_cond);
+    pthread_mutex_destroy(&r->mut);
+}
+
+int sn_io_reactor_add(sn_io_reactor_t* r, sn_io_reactor_source_t* src, int fd, const sn_util_closure_t* on_ready) {
+    struct epoll_event ev;
+
+    assert(r != NULL);
+    assert(src != NULL);
+    assert(fd >= 0);
+    assert(on_ready != NULL);
+
+    src->fd = fd;
+    src->on_ready = *on_ready;
+    mint_store_32_relaxed(&src->refs, 0);
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = r->shared ? EPOLLIN | EPOLLONESHOT : EPOLLIN;
+    ev.data.ptr = src;
+
+    return epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1 ? -1 : 0;
+}
+
+int sn_io_reactor_remove(sn_io_reactor_t* r, sn_io_reactor_source_t* src) {
+    struct epoll_event ev;
+
+    assert(r != NULL);
+    assert(src != NULL);
+
+    memset(&ev, 0, sizeof(ev));
+
+    return epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, src->fd, &ev) == -1 ? -1 : 0;
+}
+
+void sn_io_reactor_timer_init(sn_io_reactor_timer_t* t) {
+    assert(t != NULL);
+
+    memset(t, 0, sizeof(sn_io_reactor_timer_t));
+}
+
+int sn_io_reactor_timer_start(sn_io_reactor_t* r, sn_io_reactor_timer_t* t, uint64_t delay_ms, uint64_t period_ms, const sn_util_closure_t* on_expire) {
+    int ret = 0;
+
+    assert(r != NULL);
+    assert(t != NULL);
+    assert(on_expire != NULL);
+
+    pthread_mutex_lock(&r->mut);
+
+    if(t->active)
+        heap_remove(r, t);
+
+    t->deadline = sn_util_time_ms() + delay_ms;
+    t->period = period_ms;
+    t->on_expire = *on_expire;
+
+    if(heap_push(r, t) != 0)
+        ret = -1;
+    else if(t->heap_idx == 0)
+        reactor_arm(r);
+
+    pthread_mutex_unlock(&r->mut);
+
+    return ret;
+}
+
+void sn_io_reactor_timer_stop(sn_io_reactor_t* r, sn_io_reactor_timer_t* t) {
+    assert(r != NULL);
+    assert(t != NULL);
+
+    pthread_mutex_lock(&r->mut);
+
+    if(t->active)
+        heap_remove(r, t);
+
+    while(r->running_timer == t && !pthread_equal(r->running_thread, pthread_self()))
+        pthread_cond_wait(&r->timer_cond, &r->mut);
+
+    pthread_mutex_unlock(&r->mut);
+}
+
+int sn_io_reactor_post(sn_io_reactor_t* r, const sn_util_closure_t* closure) {
+    sn_io_reactor_post_t* post;
+    uint64_t one = 1;
+
+    assert(r != NULL);
+    assert(closure != NULL);
+
+    post = (sn_io_reactor_post_t*)malloc(sizeof(sn_io_reactor_post_t));
+
+    if(post == NULL)
+        return -1;
+
+    post->closure = *closure;
+
+    pthread_mutex_lock(&r->mut);
+    post->next = r->posts;
+    r->posts = post;
+    pthread_mutex_unlock(&r->mut);
+
+    if(write(r->wake_src.fd, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+        return -1;
+
+    return 0;
+}
+
+int sn_io_reactor_run(sn_io_reactor_t* r) {
+    assert(r != NULL);
+
+    while(!sn_io_reactor_stopping(r)) {
+        if(sn_io_reactor_run_once(r, -1) == -1)
+            return -1;
+    }
+
+    /* Posts queued before stopping still run */
+    reactor_run_posts(r);
+
+    pthread_mutex_lock(&r->mut);
+    r->stopping = 0;
+    pthread_mutex_unlock(&r->mut);
+
+    return 0;
+}
+
+int sn_io_reactor_run_once(sn_io_reactor_t* r, int timeout_ms) {
+    sn_io_reactor_source_t* srcs[SN_IO_REACTOR_EVENTS];
+    int n, i;
+
+    assert(r != NULL);
+
+    if((n = sn_io_reactor_wait(r, srcs, SN_IO_REACTOR_EVENTS, timeout_ms)) == -1)
+        return -1;
+
+    for(i = 0; i < n; ++i)
+        sn_io_reactor_dispatch(r, srcs[i]);
+
+    return n;
+}
+
+void sn_io_reactor_stop(sn_io_reactor_t* r) {
+    uint64_t one = 1;
+
+    assert(r != NULL);
+
+    pthread_mutex_lock(&r->mut);
+    r->stopping = 1;
+    pthread_mutex_unlock(&r->mut);
+
+    if(write(r->wake_src.fd, &one, sizeof(one)) != sizeof(one)) {
+        /* Counter overflow(EAGAIN) means the loop is already awake */
+    }
+}
+
+int sn_io_reactor_stopping(sn_io_reactor_t* r) {
+    int stopping;
+
+    assert(r != NULL);
+
+    pthread_mutex_lock(&r->mut);
+    stopping = r->stopping;
+    pthread_mutex_unlock(&r->mut);
+
+    return stopping;
+}
+
+int sn_io_reactor_wait(sn_io_reactor_t* r, sn_io_reactor_source_t* out_srcs[], int max, int timeout_ms) {
+    struct epoll_event events[SN_IO_REACTOR_EVENTS];
+    int n, i;
+
+    assert(r != NULL);
+    assert(out_srcs != NULL);
+    assert(max > 0);
+
+    n = epoll_wait(r->epoll_fd, events, SN_MIN(max, SN_IO_REACTOR_EVENTS), timeout_ms);
+
+    if(n == -1)
+        return errno == EINTR ? 0 : -1;
+
+    for(i = 0; i < n; ++i)
+        out_srcs[i] = (sn_io_reactor_source_t*)events[i].data.ptr;
+
+    return n;
+}
+
+void sn_io_reactor_dispatch(sn_io_reactor_t* r, sn_io_reactor_source_t* src) {
+    assert(r != NULL);
+    assert(src != NULL);
+
+    if(src == &r->timer_src) {
+        reactor_run_timers(r);
+    } else if(src == &r->wake_src) {
+        reactor_run_posts(r);
+        return;
+    } else {
+        void* argv[] = { src };
+
+        sn_util_closure_call(&src->on_ready, 1, argv);
+    }
+
+    if(r->shared)
+        reactor_watch(r, src);
+}
+
+void sn_io_reactor_wake_begin(sn_io_reactor_t* r) {
+    uint64_t one = 1;
+
+    assert(r != NULL);
+
+    pthread_mutex_lock(&r->mut);
+    ++r->wake_holds;
+    pthread_mutex_unlock(&r->mut);
+
+    if(write(r->wake_src.fd, &one, sizeof(one)) != sizeof(one)) {
+        /* Counter overflow(EAGAIN) means the loop is already awake */
+    }
+}
+
+void sn_io_reactor_wake_end(sn_io_reactor_t* r) {
+    assert(r != NULL);
+
+    pthread_mutex_lock(&r->mut);
+    assert(r->wake_holds > 0);
+    --r->wake_holds;
+    pthread_mutex_unlock(&r->mut);
+}
+
+/*Private functions*/
+
+void reactor_watch(sn_io_reactor_t* r, sn_io_reactor_source_t* src) {
+    struct epoll_event ev;
+
+    assert(r != NULL);
+    assert(src != NULL);
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = src;
+
+    /* Fails harmlessly if the source was removed while being dispatched */
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_MOD, src->fd, &ev);
+}
+
+void reactor_run_timers(sn_io_reactor_t* r) {
+    uint64_t expirations;
+    uint64_t now;
+
+    assert(r != NULL);
+
+    if(read(r->timer_src.fd, &expirations, sizeof(expirations)) != sizeof(expirations) && errno != EAGAIN)
+        return;
+
+    now = sn_util_time_ms();
+
+    do {
+        sn_io_reactor_timer_t* t;
+        sn_util_closure_t on_expire;
+        void* argv[1];
+
+        pthread_mutex_lock(&r->mut);
+
+        if(r->heap_len == 0 || r->heap[0]->deadline > now) {
+            reactor_arm(r);
+            pthread_mutex_unlock(&r->mut);
+            break;
+        }
+
+        t = r->heap[0];
+        on_expire = t->on_expire;
+        heap_remove(r, t);
+
+        if(t->period) {
+            /* Late periodic timers skip the missed expirations */
+            t->deadline += t->period;
+
+            if(t->deadline <= now)
+                t->deadline = now + t->period;
+
+            heap_push(r, t);
+        }
+
+        r->running_timer = t;
+        r->running_thread = pthread_self();
+
+        pthread_mutex_unlock(&r->mut);
+
+        argv[0] = t;
+        sn_util_closure_call(&on_expire, 1, argv);
+
+        pthread_mutex_lock(&r->mut);
+        r->running_timer = NULL;
+        pthread_cond_broadcast(&r->timer_cond);
+        pthread_mutex_unlock(&r->mut);
+    } while(1);
+}
+
+void reactor_run_posts(sn_io_reactor_t* r) {
+    uint64_t count;
+    sn_io_reactor_post_t* posts;
+    sn_io_reactor_post_t* ordered = NULL;
+
+    assert(r != NULL);
+
+    pthread_mutex_lock(&r->mut);
+
+    /* While stopping or held the wakeup stays pending for every waiting thread */
+    if(!r->stopping && r->wake_holds == 0) {
+        if(read(r->wake_src.fd, &count, sizeof(count)) != sizeof(count)) {
+            /* EAGAIN, another thread already consumed it */
+        }
+    }
+
+    posts = r->posts;
+    r->posts = NULL;
+    pthread_mutex_unlock(&r->mut);
+
+    while(posts != NULL) {
+        sn_io_reactor_post_t* next = posts->next;
+
+        posts->next = ordered;
+        ordered = posts;
+        posts = next;
+    }
+
+    while(ordered != NULL) {
+        sn_io_reactor_post_t* next = ordered->next;
+
+        sn_util_closure_call(&ordered->closure, 0, NULL);
+        free(ordered);
+
+        ordered = next;
+    }
+}
+
+void reactor_arm(sn_io_reactor_t* r) {
+    struct itimerspec its;
+
+    assert(r != NULL);
+
+    memset(&its, 0, sizeof(its));
+
+    if(r->heap_len) {
+        uint64_t deadline = r->heap[0]->deadline;
+
+        its.it_value.tv_sec = (time_t)(deadline/1000);
+        its.it_value.tv_nsec = (long)(deadline%1000)*1000000L;
+
+        /* An all-zero it_value disarms the timer */
+        if(its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+            its.it_value.tv_nsec = 1;
+    }
+
+    timerfd_settime(r->timer_src.fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+int heap_push(sn_io_reactor_t* r, sn_io_reactor_timer_t* t) {
+    assert(r != NULL);
+    assert(t != NULL);
+
+    if(r->heap_len == r->heap_cap) {
+        size_t new_cap = r->heap_cap ? r->heap_cap*2 : 8;
+        sn_io_reactor_timer_t** new_heap;
+
+        new_heap = (sn_io_reactor_timer_t**)realloc(r->heap, new_cap*sizeof(sn_io_reactor_timer_t*));
+
+        if(new_heap == NULL)
+            return -1;
+
+        r->heap = new_heap;
+        r->heap_cap = new_cap;
+    }
+
+    t->heap_idx = r->heap_len;
+    t->active = 1;
+    r->heap[r->heap_len++] = t;
+
+    heap_up(r, t->heap_idx);
+
+    return 0;
+}
+
+void heap_remove(sn_io_reactor_t* r, sn_io_reactor_timer_t* t) {
+    size_t idx;
+
+    assert(r != NULL);
+    assert(t != NULL);
+    assert(t->active);
+    assert(r->heap[t->heap_idx] == t);
+
+    idx = t->heap_idx;
+    t->active = 0;
+
+    if(idx != --r->heap_len) {
+        heap_swap(r, idx, r->heap_len);
+        heap_down(r, idx);
+        heap_up(r, idx);
+    }
+}
+
+void heap_up(sn_io_reactor_t* r, size_t idx) {
+    while(idx > 0) {
+        size_t parent = (idx - 1)/2;
+
+        if(r->heap[parent]->deadline <= r->heap[idx]->deadline)
+            break;
+
+        heap_swap(r, parent, idx);
+        idx = parent;
+    }
+}
+
+void heap_down(sn_io_reactor_t* r, size_t idx) {
+    do {
+        size_t smallest = idx;
+        size_t left = 2*idx + 1;
+        size_t right = 2*idx + 2;
+
+        if(left < r->heap_len && r->heap[left]->deadline < r->heap[smallest]->deadline)
+            smallest = left;
+
+        if(right < r->heap_len && r->heap[right]->deadline < r->heap[smallest]->deadline)
+            smallest = right;
+
+        if(smallest == idx)
+            break;
+
+        heap_swap(r, smallest, idx);
+        idx = smallest;
+    } while(1);
+}
+
+void heap_swap(sn_io_reactor_t* r, size_t a, size_t b) {
+    sn_io_reactor_timer_t* tmp = r->heap[a];
+
+    r->heap[a] = r->heap[b];
+    r->heap[b] = tmp;
+    r->heap[a]->heap_idx = a;
+    r->heap[b]->heap_idx = b;
+}
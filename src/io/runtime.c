@@ -0,0 +1,233 @@
+#include "io/runtime.h"
+
+#include "common.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <string.h>
+
+void* runtime_worker(void* arg);
+sn_io_reactor_source_t* runtime_pop(sn_io_runtime_worker_t* w);
+sn_io_reactor_source_t* runtime_steal(sn_io_runtime_worker_t* w);
+void runtime_push(sn_io_runtime_worker_t* w, sn_io_reactor_source_t* srcs[], int count);
+
+SN_ASSERT_COMPILE(SN_IO_RUNTIME_BATCH <= SN_IO_RUNTIME_QUEUE_LEN);
+
+int sn_io_runtime_init(sn_io_runtime_t* rt, unsigned int workers) {
+    unsigned int i;
+
+    assert(rt != NULL);
+
+    if(workers == 0 || workers > SN_IO_RUNTIME_MAX_WORKERS)
+        return -1;
+
+    rt->workers_len = 0;
+
+    if(sn_io_reactor_init_shared(&rt->reactor) != 0)
+        return -1;
+
+    for(i = 0; i < workers; ++i) {
+        sn_io_runtime_worker_t* w = &rt->workers[i];
+
+        w->rt = rt;
+        w->head = w->len = 0;
+        mint_store_32_relaxed(&w->queued, 0);
+        mint_store_32_relaxed(&w->wseq, 0);
+
+        if(pthread_mutex_init(&w->mut, NULL) != 0) {
+            sn_io_runtime_destroy(rt);
+            return -1;
+        }
+
+        if(pthread_create(&w->thrd, NULL, runtime_worker, w) != 0) {
+            pthread_mutex_destroy(&w->mut);
+            sn_io_runtime_destroy(rt);
+            return -1;
+        }
+
+        ++rt->workers_len;
+    }
+
+    return 0;
+}
+
+void sn_io_runtime_destroy(sn_io_runtime_t* rt) {
+    unsigned int i;
+
+    assert(rt != NULL);
+
+    sn_io_reactor_stop(&rt->reactor);
+
+    for(i = 0; i < rt->workers_len; ++i)
+        pthread_join(rt->workers[i].thrd, NULL);
+
+    for(i = 0; i < rt->workers_len; ++i)
+        pthread_mutex_destroy(&rt->workers[i].mut);
+
+    rt->workers_len = 0;
+
+    sn_io_reactor_destroy(&rt->reactor);
+}
+
+sn_io_reactor_t* sn_io_runtime_reactor(sn_io_runtime_t* rt) {
+    assert(rt != NULL);
+
+    return &rt->reactor;
+}
+
+int sn_io_runtime_attach(sn_io_runtime_t* rt, sn_io_reactor_source_t* src, int fd, const sn_util_closure_t* on_ready) {
+    assert(rt != NULL);
+
+    return sn_io_reactor_add(&rt->reactor, src, fd, on_ready);
+}
+
+int sn_io_runtime_detach(sn_io_runtime_t* rt, sn_io_reactor_source_t* src) {
+    uint32_t seqs[SN_IO_RUNTIME_MAX_WORKERS];
+    unsigned int i;
+    int ret;
+
+    assert(rt != NULL);
+    assert(src != NULL);
+
+    ret = sn_io_reactor_remove(&rt->reactor, src);
+
+    /*
+    A worker may have taken src from the reactor before the removal without counting it yet.
+    Wake every waiting worker and wait until they are past that point.
+    */
+
+    mint_thread_fence_seq_cst();
+
+    for(i = 0; i < rt->workers_len; ++i)
+        seqs[i] = mint_load_32_relaxed(&rt->workers[i].wseq);
+
+    sn_io_reactor_wake_begin(&rt->reactor);
+
+    for(i = 0; i < rt->workers_len; ++i) {
+        if(seqs[i] & 1) {
+            while(mint_load_32_relaxed(&rt->workers[i].wseq) == seqs[i])
+                sched_yield();
+        }
+    }
+
+    sn_io_reactor_wake_end(&rt->reactor);
+
+    /* Queued and running dispatches */
+
+    mint_thread_fence_acquire();
+
+    while(mint_load_32_relaxed(&src->refs) != 0)
+        sched_yield();
+
+    mint_thread_fence_acquire();
+
+    return ret;
+}
+
+/*Private functions*/
+
+void* runtime_worker(void* arg) {
+    sn_io_runtime_worker_t* w = (sn_io_runtime_worker_t*)arg;
+    sn_io_reactor_t* r;
+
+    assert(w != NULL);
+
+    r = &w->rt->reactor;
+
+    while(!sn_io_reactor_stopping(r)) {
+        sn_io_reactor_source_t* srcs[SN_IO_RUNTIME_BATCH];
+        sn_io_reactor_source_t* src;
+        int n, i;
+
+        if((src = runtime_pop(w)) != NULL || (src = runtime_steal(w)) != NULL) {
+            sn_io_reactor_dispatch(r, src);
+
+            mint_thread_fence_release();
+            mint_fetch_add_32_relaxed(&src->refs, -1);
+            continue;
+        }
+
+        /* Idle, the queue is empty so the whole batch fits */
+
+        mint_fetch_add_32_relaxed(&w->wseq, 1);
+        mint_thread_fence_seq_cst();
+
+        n = sn_io_reactor_wait(r, srcs, SN_IO_RUNTIME_BATCH, SN_IO_RUNTIME_IDLE_MS);
+
+        for(i = 0; i < n; ++i)
+            mint_fetch_add_32_relaxed(&srcs[i]->refs, 1);
+
+        mint_thread_fence_seq_cst();
+        mint_fetch_add_32_relaxed(&w->wseq, 1);
+
+        if(n > 0)
+            runtime_push(w, srcs, n);
+    }
+
+    return w;
+}
+
+sn_io_reactor_source_t* runtime_pop(sn_io_runtime_worker_t* w) {
+    sn_io_reactor_source_t* src = NULL;
+
+    pthread_mutex_lock(&w->mut);
+
+    if(w->len) {
+        --w->len;
+        src = w->queue[(w->head + w->len)%SN_IO_RUNTIME_QUEUE_LEN];
+        mint_store_32_relaxed(&w->queued, (uint32_t)w->len);
+    }
+
+    pthread_mutex_unlock(&w->mut);
+
+    return src;
+}
+
+sn_io_reactor_source_t* runtime_steal(sn_io_runtime_worker_t* w) {
+    sn_io_runtime_t* rt = w->rt;
+    size_t self = (size_t)(w - rt->workers);
+    unsigned int i;
+
+    for(i = 1; i < rt->workers_len; ++i) {
+        sn_io_runtime_worker_t* victim = &rt->workers[(self + i)%rt->workers_len];
+        sn_io_reactor_source_t* src = NULL;
+
+        /* Unlocked peek of the atomic copy, a stale length only costs a missed or empty steal */
+
+        if(mint_load_32_relaxed(&victim->queued) == 0)
+            continue;
+
+        pthread_mutex_lock(&victim->mut);
+
+        if(victim->len) {
+            src = victim->queue[victim->head];
+            victim->head = (victim->head + 1)%SN_IO_RUNTIME_QUEUE_LEN;
+            --victim->len;
+            mint_store_32_relaxed(&victim->queued, (uint32_t)victim->len);
+        }
+
+        pthread_mutex_unlock(&victim->mut);
+
+        if(src != NULL)
+            return src;
+    }
+
+    return NULL;
+}
+
+void runtime_push(sn_io_runtime_worker_t* w, sn_io_reactor_source_t* srcs[], int count) {
+    int i;
+
+    pthread_mutex_lock(&w->mut);
+
+    assert(w->len + (size_t)count <= SN_IO_RUNTIME_QUEUE_LEN);
+
+    for(i = 0; i < count; ++i)
+        w->queue[(w->head + w->len++)%SN_IO_RUNTIME_QUEUE_LEN] = srcs[i];
+
+    mint_store_32_relaxed(&w->queued, (uint32_t)w->len);
+
+    pthread_mutex_unlock(&w->mut);
+}
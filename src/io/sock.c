@@ -1,12 +1,31 @@
+#define _GNU_SOURCE
+
 #include "io/sock.h"
 
+#include "common.h"
+
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stddef.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+/* Room for a timestamp and a drop counter */
+
+#define SOCK_RX_CTRL_LEN (CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t)))
+
+typedef union {
+    struct cmsghdr align; /**< Forces cmsghdr alignment */
+    char buf[SOCK_RX_CTRL_LEN]; /**< Control data */
+} sock_rx_ctrl_t;
+
+void sock_parse_rx_info(struct msghdr* msg, sn_io_sock_rx_info_t* out_info);
+
 sn_io_sock_t sn_io_sock_named(const sn_io_naddr_t* name) {
     int fd;
 
@@ -35,6 +54,68 @@ void sn_io_sock_close(sn_io_sock_t socket) {
     } while(ret == -1 && errno == EINTR);
 }
 
+int sn_io_sock_set_nonblocking(sn_io_sock_t socket, int nonblocking) {
+    int flags;
+
+    assert(socket != SN_IO_SOCK_INVALID);
+
+    if((flags = fcntl(socket, F_GETFL, 0)) == -1)
+        return -1;
+
+    flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+
+    return fcntl(socket, F_SETFL, flags) == -1 ? -1 : 0;
+}
+
+int sn_io_sock_set_busy_poll(sn_io_sock_t socket, unsigned int usec) {
+    assert(socket != SN_IO_SOCK_INVALID);
+
+#if defined(SO_BUSY_POLL)
+    {
+        int value = (int)usec;
+
+        return setsockopt(socket, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) == -1 ? -1 : 0;
+    }
+#else
+    SN_UNUSED(usec);
+
+    return -1;
+#endif
+}
+
+int sn_io_sock_set_rcvbuf(sn_io_sock_t socket, size_t bytes) {
+    int value = (int)SN_MIN(bytes, (size_t)0x7fffffff);
+
+    assert(socket != SN_IO_SOCK_INVALID);
+
+    return setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value)) == -1 ? -1 : 0;
+}
+
+int sn_io_sock_set_rx_info(sn_io_sock_t socket, int enable) {
+    assert(socket != SN_IO_SOCK_INVALID);
+
+#if defined(SO_TIMESTAMPNS)
+    {
+        int value = enable ? 1 : 0;
+
+        if(setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPNS, &value, sizeof(value)) == -1)
+            return -1;
+
+        /* Not every family counts drops(unix sockets block the sender instead) */
+
+#if defined(SO_RXQ_OVFL)
+        setsockopt(socket, SOL_SOCKET, SO_RXQ_OVFL, &value, sizeof(value));
+#endif
+
+        return 0;
+    }
+#else
+    SN_UNUSED(enable);
+
+    return -1;
+#endif
+}
+
 int sn_io_sock_get_name(sn_io_sock_t socket, sn_io_naddr_t* out_name) {
     socklen_t addrlen;
 
@@ -54,6 +135,55 @@ ssize_t sn_io_sock_send(sn_io_sock_t socket, const void* buf, size_t len, const
     return sendto(socket, buf, len, 0, dst, sizeof(*dst));
 }
 
+ssize_t sn_io_sock_send_many(sn_io_sock_t socket, const void* const bufs[], const size_t lens[], const sn_io_naddr_t* const dsts[], size_t count) {
+    size_t sent = 0;
+
+    assert(socket != SN_IO_SOCK_INVALID);
+    assert(bufs != NULL || count == 0);
+    assert(lens != NULL || count == 0);
+    assert(dsts != NULL || count == 0);
+
+#if defined(__linux__)
+    while(sent < count) {
+        struct mmsghdr msgs[SN_IO_SOCK_BATCH_LEN];
+        struct iovec iovs[SN_IO_SOCK_BATCH_LEN];
+        unsigned int batch_len = (unsigned int)SN_MIN(count - sent, SN_IO_SOCK_BATCH_LEN);
+        unsigned int i;
+        int ret;
+
+        memset(msgs, 0, batch_len*sizeof(struct mmsghdr));
+
+        for(i = 0; i < batch_len; ++i) {
+            iovs[i].iov_base = (void*)bufs[sent + i];
+            iovs[i].iov_len = lens[sent + i];
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = (void*)dsts[sent + i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(*dsts[sent + i]);
+        }
+
+        do {
+            ret = sendmmsg(socket, msgs, batch_len, 0);
+        } while(ret == -1 && errno == EINTR);
+
+        if(ret <= 0)
+            return sent ? (ssize_t)sent : -1;
+
+        sent += (size_t)ret;
+
+        if((unsigned int)ret < batch_len)
+            break;
+    }
+#else
+    for(; sent < count; ++sent) {
+        if(sn_io_sock_send(socket, bufs[sent], lens[sent], dsts[sent]) < (ssize_t)lens[sent])
+            return sent ? (ssize_t)sent : -1;
+    }
+#endif
+
+    return (ssize_t)sent;
+}
+
 ssize_t sn_io_sock_recv(sn_io_sock_t socket, void* buf, size_t len, sn_io_naddr_t* src) {
     socklen_t addrlen;
 
@@ -65,6 +195,106 @@ ssize_t sn_io_sock_recv(sn_io_sock_t socket, void* buf, size_t len, sn_io_naddr_
     return recvfrom(socket, buf, len, 0, src, &addrlen);
 }
 
+ssize_t sn_io_sock_recv_info(sn_io_sock_t socket, void* buf, size_t len, sn_io_naddr_t* src, sn_io_sock_rx_info_t* out_info) {
+    struct msghdr msg;
+    struct iovec iov;
+    sock_rx_ctrl_t ctrl;
+    ssize_t ret;
+
+    assert(socket != SN_IO_SOCK_INVALID);
+    assert(buf != NULL || len == 0);
+    assert(out_info != NULL);
+
+    memset(&msg, 0, sizeof(msg));
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_name = src;
+    msg.msg_namelen = src != NULL ? sizeof(*src) : 0;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    ret = recvmsg(socket, &msg, 0);
+
+    if(ret >= 0)
+        sock_parse_rx_info(&msg, out_info);
+
+    return ret;
+}
+
+ssize_t sn_io_sock_recv_many(sn_io_sock_t socket, void* const bufs[], size_t cap, size_t lens[], sn_io_naddr_t srcs[], sn_io_sock_rx_info_t infos[], size_t count) {
+    size_t received = 0;
+
+    assert(socket != SN_IO_SOCK_INVALID);
+    assert(bufs != NULL || count == 0);
+    assert(lens != NULL || count == 0);
+
+#if defined(__linux__)
+    while(received < count) {
+        struct mmsghdr msgs[SN_IO_SOCK_BATCH_LEN];
+        struct iovec iovs[SN_IO_SOCK_BATCH_LEN];
+        sock_rx_ctrl_t ctrls[SN_IO_SOCK_BATCH_LEN];
+        unsigned int batch_len = (unsigned int)SN_MIN(count - received, SN_IO_SOCK_BATCH_LEN);
+        unsigned int i;
+        int ret;
+
+        memset(msgs, 0, batch_len*sizeof(struct mmsghdr));
+
+        for(i = 0; i < batch_len; ++i) {
+            iovs[i].iov_base = bufs[received + i];
+            iovs[i].iov_len = cap;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+
+            if(srcs != NULL) {
+                msgs[i].msg_hdr.msg_name = &srcs[received + i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(srcs[received + i]);
+            }
+
+            if(infos != NULL) {
+                msgs[i].msg_hdr.msg_control = ctrls[i].buf;
+                msgs[i].msg_hdr.msg_controllen = sizeof(ctrls[i].buf);
+            }
+        }
+
+        do {
+            ret = recvmmsg(socket, msgs, batch_len, MSG_DONTWAIT, NULL);
+        } while(ret == -1 && errno == EINTR);
+
+        if(ret <= 0)
+            return received ? (ssize_t)received : -1;
+
+        for(i = 0; i < (unsigned int)ret; ++i) {
+            lens[received + i] = msgs[i].msg_len;
+
+            if(infos != NULL)
+                sock_parse_rx_info(&msgs[i].msg_hdr, &infos[received + i]);
+        }
+
+        received += (size_t)ret;
+
+        if((unsigned int)ret < batch_len)
+            break;
+    }
+#else
+    for(; received < count; ++received) {
+        sn_io_naddr_t* src = srcs != NULL ? &srcs[received] : NULL;
+        ssize_t ret = infos != NULL ?
+            sn_io_sock_recv_info(socket, bufs[received], cap, src, &infos[received]) :
+            sn_io_sock_recv(socket, bufs[received], cap, src);
+
+        if(ret < 0)
+            return received ? (ssize_t)received : -1;
+
+        lens[received] = (size_t)ret;
+    }
+#endif
+
+    return (ssize_t)received;
+}
+
 ssize_t sn_io_sock_peek(sn_io_sock_t socket, void* buf, size_t len, sn_io_naddr_t* src) {
     socklen_t addrlen;
 
@@ -75,3 +305,39 @@ ssize_t sn_io_sock_peek(sn_io_sock_t socket, void* buf, size_t len, sn_io_naddr_
 
     return recvfrom(socket, buf, len, MSG_PEEK, src, &addrlen);
 }
+
+/*Private functions*/
+
+void sock_parse_rx_info(struct msghdr* msg, sn_io_sock_rx_info_t* out_info) {
+    struct cmsghdr* cmsg;
+
+    assert(msg != NULL);
+    assert(out_info != NULL);
+
+    out_info->stamp_ns = 0;
+    out_info->drops = 0;
+    out_info->drops_reported = 0;
+
+    if(msg->msg_control == NULL)
+        return;
+
+    for(cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if(cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+
+#if defined(SCM_TIMESTAMPNS)
+        if(cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            out_info->stamp_ns = (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+        }
+#endif
+#if defined(SO_RXQ_OVFL)
+        if(cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(&out_info->drops, CMSG_DATA(cmsg), sizeof(out_info->drops));
+            out_info->drops_reported = 1;
+        }
+#endif
+    }
+}
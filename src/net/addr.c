@@ -102,6 +102,17 @@ void sn_net_addr_dist(const sn_net_addr_t* a, const sn_net_addr_t* b, sn_net_add
     sn_net_addr_init(dist, sub);
 }
 
+void sn_net_addr_xor(const sn_net_addr_t* a, const sn_net_addr_t* b, sn_net_addr_t* dist) {
+    int i;
+
+    assert(a != 0);
+    assert(b != 0);
+    assert(dist != 0);
+
+    for(i = 0; i < SN_NET_ADDR_LEN; ++i)
+        dist->key[i] = a->key[i] ^ b->key[i];
+}
+
 void sn_net_addr_index(const sn_net_addr_t* self, const sn_net_addr_t* addr, unsigned int* level, unsigned char* column) {
     unsigned int l = 0;
     unsigned int i;
@@ -0,0 +1,194 @@
+#include "net/detector.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+/* 1/ln(10), phi for exponential intervals is t/(mean*ln(10)) */
+
+#define DETECTOR_LOG10_E 0.4342944819032518
+
+int detector_key(const sn_io_naddr_t* net_addr, sn_io_naddr_ser_t* key);
+int detector_watch(sn_net_detector_t* d, const sn_net_entry_t* e, uint64_t now);
+double detector_phi(const sn_net_detector_peer_t* peer, uint64_t now);
+
+int sn_net_detector_init(sn_net_detector_t* d) {
+    assert(d != NULL);
+
+    d->router_version = 0;
+    d->gen = 0;
+
+    return sn_data_hmap_init(&d->peers, sizeof(sn_io_naddr_ser_t), sizeof(sn_net_detector_peer_t));
+}
+
+void sn_net_detector_destroy(sn_net_detector_t* d) {
+    assert(d != NULL);
+
+    sn_data_hmap_destroy(&d->peers);
+}
+
+void sn_net_detector_heard(sn_net_detector_t* d, const sn_io_naddr_t* net_addr, uint64_t now) {
+    sn_io_naddr_ser_t key;
+    sn_net_detector_peer_t peer;
+
+    assert(d != NULL);
+    assert(net_addr != NULL);
+
+    if(detector_key(net_addr, &key) != 0 || sn_data_hmap_get(&d->peers, &key, &peer) != 0)
+        return;
+
+    if(now > peer.last) {
+        peer.mean += ((double)(now - peer.last) - peer.mean)/8;
+
+        if(peer.mean < SN_NET_DETECTOR_MIN_MEAN)
+            peer.mean = SN_NET_DETECTOR_MIN_MEAN;
+
+        peer.last = now;
+    }
+
+    peer.probes = 0;
+
+    sn_data_hmap_put(&d->peers, &key, &peer);
+}
+
+int sn_net_detector_sync(sn_net_detector_t* d, const sn_net_router_t* snr, uint64_t now) {
+    sn_data_vec_t gone;
+    sn_io_naddr_ser_t key;
+    sn_net_detector_peer_t peer;
+    unsigned int l, c;
+    size_t iter = 0;
+    int p, ret = 0;
+
+    assert(d != NULL);
+    assert(snr != NULL);
+
+    if(d->router_version == sn_net_router_version(snr))
+        return 0;
+
+    ++d->gen;
+
+    for(l = 0; l < SN_NET_ROUTER_LEVELS; ++l)
+        for(c = 0; c < SN_NET_ROUTER_COLUMNS; ++c)
+            if(detector_watch(d, sn_net_router_table_get(snr, l, c), now) != 0)
+                ret = -1;
+
+    for(p = -SN_NET_ROUTER_LEAFSET_SIZE; p <= SN_NET_ROUTER_LEAFSET_SIZE; ++p)
+        if(p != 0 && detector_watch(d, sn_net_router_leafset_get(snr, p), now) != 0)
+            ret = -1;
+
+    /* Neighbors no longer on the router */
+
+    if(sn_data_vec_init(&gone, sizeof(sn_io_naddr_ser_t)) != 0)
+        return -1;
+
+    while(sn_data_hmap_next(&d->peers, &iter, &key, &peer) == 0)
+        if(peer.gen != d->gen && sn_data_vec_push(&gone, &key) != 0)
+            ret = -1;
+
+    for(iter = 0; sn_data_vec_at(&gone, iter, &key) == 0; ++iter)
+        sn_data_hmap_remove(&d->peers, &key, NULL);
+
+    sn_data_vec_destroy(&gone);
+
+    if(ret == 0)
+        d->router_version = sn_net_router_version(snr);
+
+    return ret;
+}
+
+double sn_net_detector_phi(const sn_net_detector_t* d, const sn_io_naddr_t* net_addr, uint64_t now) {
+    sn_io_naddr_ser_t key;
+    sn_net_detector_peer_t peer;
+
+    assert(d != NULL);
+    assert(net_addr != NULL);
+
+    if(detector_key(net_addr, &key) != 0 || sn_data_hmap_get(&d->peers, &key, &peer) != 0)
+        return -1;
+
+    return detector_phi(&peer, now);
+}
+
+int sn_net_detector_check(sn_net_detector_t* d, uint64_t now, sn_data_vec_t* probes, sn_data_vec_t* dead) {
+    sn_data_vec_t gone;
+    sn_io_naddr_ser_t key;
+    sn_net_detector_peer_t peer;
+    size_t iter = 0;
+    int ret = 0;
+
+    assert(d != NULL);
+    assert(probes != NULL);
+    assert(dead != NULL);
+
+    if(sn_data_vec_init(&gone, sizeof(sn_io_naddr_ser_t)) != 0)
+        return -1;
+
+    while(sn_data_hmap_next(&d->peers, &iter, &key, &peer) == 0) {
+        double phi = detector_phi(&peer, now);
+
+        if(phi < SN_NET_DETECTOR_PHI_PROBE)
+            continue;
+
+        if(phi >= SN_NET_DETECTOR_PHI_DEAD && peer.probes >= SN_NET_DETECTOR_PROBES) {
+            if(sn_data_vec_push(dead, &peer.entry) != 0 || sn_data_vec_push(&gone, &key) != 0)
+                ret = -1;
+
+            continue;
+        }
+
+        if(now - peer.probed < SN_NET_DETECTOR_PROBE_INTERVAL)
+            continue;
+
+        if(sn_data_vec_push(probes, &peer.entry) != 0) {
+            ret = -1;
+            continue;
+        }
+
+        /* Updating a present key does not move the slots iter walks */
+
+        peer.probed = now;
+        ++peer.probes;
+        sn_data_hmap_put(&d->peers, &key, &peer);
+    }
+
+    for(iter = 0; sn_data_vec_at(&gone, iter, &key) == 0; ++iter)
+        sn_data_hmap_remove(&d->peers, &key, NULL);
+
+    sn_data_vec_destroy(&gone);
+
+    return ret;
+}
+
+/*Private functions*/
+
+int detector_key(const sn_io_naddr_t* net_addr, sn_io_naddr_ser_t* key) {
+    /* The serialization is zero padded, unlike sn_io_naddr_t */
+
+    return sn_io_naddr_ser(net_addr, key);
+}
+
+int detector_watch(sn_net_detector_t* d, const sn_net_entry_t* e, uint64_t now) {
+    sn_io_naddr_ser_t key;
+    sn_net_detector_peer_t peer;
+
+    if(e == NULL || !e->is_set || detector_key(&e->net_addr, &key) != 0)
+        return 0;
+
+    if(sn_data_hmap_get(&d->peers, &key, &peer) != 0) {
+        memset(&peer, 0, sizeof(peer));
+        peer.last = now;
+        peer.mean = SN_NET_DETECTOR_INITIAL_MEAN;
+    }
+
+    peer.entry = *e;
+    peer.gen = d->gen;
+
+    return sn_data_hmap_put(&d->peers, &key, &peer);
+}
+
+double detector_phi(const sn_net_detector_peer_t* peer, uint64_t now) {
+    if(now <= peer->last)
+        return 0;
+
+    return DETECTOR_LOG10_E*(double)(now - peer->last)/peer->mean;
+}
@@ -0,0 +1,133 @@
+#include "net/geometry.h"
+
+#include "net/kbucket.h"
+#include "net/members.h"
+#include "net/router.h"
+
+#include <stddef.h>
+
+void pastry_init(void* state, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr);
+void pastry_destroy(void* state);
+void pastry_add(void* state, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr);
+void pastry_remove(void* state, const sn_net_addr_t* addr);
+void pastry_nexthop(const void* state, const sn_net_addr_t* dst, sn_net_entry_t* nexthop);
+void pastry_nexthop_alt(const void* state, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop);
+void kademlia_init(void* state, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr);
+void kademlia_destroy(void* state);
+void kademlia_add(void* state, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr);
+void kademlia_remove(void* state, const sn_net_addr_t* addr);
+void kademlia_nexthop(const void* state, const sn_net_addr_t* dst, sn_net_entry_t* nexthop);
+void kademlia_nexthop_alt(const void* state, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop);
+void onehop_init(void* state, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr);
+void onehop_destroy(void* state);
+void onehop_add(void* state, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr);
+void onehop_remove(void* state, const sn_net_addr_t* addr);
+void onehop_nexthop(const void* state, const sn_net_addr_t* dst, sn_net_entry_t* nexthop);
+void onehop_nexthop_alt(const void* state, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop);
+
+const sn_net_geometry_t sn_net_geometry_pastry = {
+    "pastry",
+    sizeof(sn_net_router_t),
+    pastry_init,
+    pastry_destroy,
+    pastry_add,
+    pastry_remove,
+    pastry_nexthop,
+    pastry_nexthop_alt
+};
+
+const sn_net_geometry_t sn_net_geometry_kademlia = {
+    "kademlia",
+    sizeof(sn_net_kbucket_t),
+    kademlia_init,
+    kademlia_destroy,
+    kademlia_add,
+    kademlia_remove,
+    kademlia_nexthop,
+    kademlia_nexthop_alt
+};
+
+const sn_net_geometry_t sn_net_geometry_onehop = {
+    "onehop",
+    sizeof(sn_net_members_t),
+    onehop_init,
+    onehop_destroy,
+    onehop_add,
+    onehop_remove,
+    onehop_nexthop,
+    onehop_nexthop_alt
+};
+
+/* Private functions */
+
+void pastry_init(void* state, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr) {
+    sn_net_router_init((sn_net_router_t*)state, self_addr, self_net_addr);
+}
+
+void pastry_destroy(void* state) {
+    sn_net_router_destroy((sn_net_router_t*)state);
+}
+
+void pastry_add(void* state, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr) {
+    sn_net_router_add((sn_net_router_t*)state, addr, net_addr);
+}
+
+void pastry_remove(void* state, const sn_net_addr_t* addr) {
+    sn_net_router_remove((sn_net_router_t*)state, addr);
+}
+
+void pastry_nexthop(const void* state, const sn_net_addr_t* dst, sn_net_entry_t* nexthop) {
+    sn_net_router_nexthop((const sn_net_router_t*)state, dst, nexthop);
+}
+
+void pastry_nexthop_alt(const void* state, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop) {
+    sn_net_router_nexthop_alt((const sn_net_router_t*)state, dst, exclude, nexthop);
+}
+
+void kademlia_init(void* state, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr) {
+    sn_net_kbucket_init((sn_net_kbucket_t*)state, self_addr, self_net_addr);
+}
+
+void kademlia_destroy(void* state) {
+    sn_net_kbucket_destroy((sn_net_kbucket_t*)state);
+}
+
+void kademlia_add(void* state, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr) {
+    sn_net_kbucket_add((sn_net_kbucket_t*)state, addr, net_addr);
+}
+
+void kademlia_remove(void* state, const sn_net_addr_t* addr) {
+    sn_net_kbucket_remove((sn_net_kbucket_t*)state, addr);
+}
+
+void kademlia_nexthop(const void* state, const sn_net_addr_t* dst, sn_net_entry_t* nexthop) {
+    sn_net_kbucket_nexthop((const sn_net_kbucket_t*)state, dst, nexthop);
+}
+
+void kademlia_nexthop_alt(const void* state, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop) {
+    sn_net_kbucket_nexthop_alt((const sn_net_kbucket_t*)state, dst, exclude, nexthop);
+}
+
+void onehop_init(void* state, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr) {
+    sn_net_members_init((sn_net_members_t*)state, self_addr, self_net_addr);
+}
+
+void onehop_destroy(void* state) {
+    sn_net_members_destroy((sn_net_members_t*)state);
+}
+
+void onehop_add(void* state, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr) {
+    sn_net_members_add((sn_net_members_t*)state, addr, net_addr);
+}
+
+void onehop_remove(void* state, const sn_net_addr_t* addr) {
+    sn_net_members_remove((sn_net_members_t*)state, addr);
+}
+
+void onehop_nexthop(const void* state, const sn_net_addr_t* dst, sn_net_entry_t* nexthop) {
+    sn_net_members_nexthop((const sn_net_members_t*)state, dst, nexthop);
+}
+
+void onehop_nexthop_alt(const void* state, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop) {
+    sn_net_members_nexthop_alt((const sn_net_members_t*)state, dst, exclude, nexthop);
+}
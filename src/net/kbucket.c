@@ -0,0 +1,193 @@
+#include "net/kbucket.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+unsigned int bucket_index(const sn_net_addr_t* self, const sn_net_addr_t* addr);
+int bucket_find(const sn_net_kbucket_t* snk, unsigned int b, const sn_net_addr_t* addr);
+void closest_consider(const sn_net_entry_t* e, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_addr_t* min_dist, sn_net_entry_t* nexthop);
+void closest_search(const sn_net_kbucket_t* snk, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop);
+
+void sn_net_kbucket_init(sn_net_kbucket_t* snk, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr) {
+    assert(snk != NULL);
+    assert(self_addr != NULL);
+
+    memset(snk, 0, sizeof(sn_net_kbucket_t));
+    snk->self.is_set = 1;
+    snk->self.addr = *self_addr;
+
+    if(self_net_addr != NULL)
+        snk->self.net_addr = *self_net_addr;
+}
+
+void sn_net_kbucket_destroy(sn_net_kbucket_t* snk) {
+    unsigned int b;
+
+    assert(snk != NULL);
+
+    for(b = 0; b < SN_NET_KBUCKET_COUNT; ++b) {
+        free(snk->buckets[b]);
+        snk->buckets[b] = NULL;
+        snk->lens[b] = 0;
+    }
+
+    snk->size = 0;
+}
+
+void sn_net_kbucket_add(sn_net_kbucket_t* snk, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr) {
+    sn_net_entry_t e;
+    unsigned int b;
+    int i;
+
+    assert(snk != NULL);
+    assert(addr != NULL);
+
+    if(sn_net_addr_cmp(addr, &snk->self.addr) == 0)
+        return;
+
+    e.is_set = 1;
+    e.addr = *addr;
+
+    if(net_addr != NULL)
+        e.net_addr = *net_addr;
+    else
+        memset(&e.net_addr, 0, sizeof(sn_io_naddr_t));
+
+    b = bucket_index(&snk->self.addr, addr);
+
+    /* Buckets far from us are the only ones most nodes fill, the rest are allocated on first use */
+
+    if(snk->buckets[b] == NULL && (snk->buckets[b] = (sn_net_entry_t*)malloc(SN_NET_KBUCKET_K*sizeof(sn_net_entry_t))) == NULL)
+        return;
+
+    if((i = bucket_find(snk, b, addr)) >= 0) {
+        memmove(&snk->buckets[b][i], &snk->buckets[b][i + 1], (snk->lens[b] - i - 1)*sizeof(sn_net_entry_t));
+        snk->buckets[b][snk->lens[b] - 1] = e;
+        return;
+    }
+
+    if(snk->lens[b] == SN_NET_KBUCKET_K)
+        return;
+
+    snk->buckets[b][snk->lens[b]++] = e;
+    ++snk->size;
+}
+
+void sn_net_kbucket_remove(sn_net_kbucket_t* snk, const sn_net_addr_t* addr) {
+    unsigned int b;
+    int i;
+
+    assert(snk != NULL);
+    assert(addr != NULL);
+
+    if(sn_net_addr_cmp(addr, &snk->self.addr) == 0)
+        return;
+
+    b = bucket_index(&snk->self.addr, addr);
+
+    if((i = bucket_find(snk, b, addr)) < 0)
+        return;
+
+    memmove(&snk->buckets[b][i], &snk->buckets[b][i + 1], (snk->lens[b] - i - 1)*sizeof(sn_net_entry_t));
+    --snk->lens[b];
+    --snk->size;
+}
+
+void sn_net_kbucket_nexthop(const sn_net_kbucket_t* snk, const sn_net_addr_t* dst, sn_net_entry_t* nexthop) {
+    assert(snk != NULL);
+    assert(dst != NULL);
+    assert(nexthop != NULL);
+
+    closest_search(snk, dst, NULL, nexthop);
+}
+
+void sn_net_kbucket_nexthop_alt(const sn_net_kbucket_t* snk, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop) {
+    assert(snk != NULL);
+    assert(dst != NULL);
+    assert(exclude != NULL);
+    assert(nexthop != NULL);
+
+    closest_search(snk, dst, exclude, nexthop);
+}
+
+size_t sn_net_kbucket_size(const sn_net_kbucket_t* snk) {
+    assert(snk != NULL);
+
+    return snk->size;
+}
+
+/* Private functions */
+
+unsigned int bucket_index(const sn_net_addr_t* self, const sn_net_addr_t* addr) {
+    unsigned int i, bits = 0;
+    unsigned char diff = 0;
+
+    for(i = 0; i < SN_NET_ADDR_LEN && (diff = self->key[i] ^ addr->key[i]) == 0; ++i)
+        bits += 8;
+
+    if(i == SN_NET_ADDR_LEN)
+        return SN_NET_KBUCKET_COUNT - 1;
+
+    while(!(diff & 0x80)) {
+        diff <<= 1;
+        ++bits;
+    }
+
+    return bits;
+}
+
+int bucket_find(const sn_net_kbucket_t* snk, unsigned int b, const sn_net_addr_t* addr) {
+    int i;
+
+    for(i = 0; i < snk->lens[b]; ++i) {
+        if(sn_net_addr_cmp(&snk->buckets[b][i].addr, addr) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+void closest_consider(const sn_net_entry_t* e, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_addr_t* min_dist, sn_net_entry_t* nexthop) {
+    sn_net_addr_t dist;
+
+    if(exclude != NULL && sn_net_addr_cmp(&e->addr, exclude) == 0)
+        return;
+
+    sn_net_addr_xor(&e->addr, dst, &dist);
+
+    if(sn_net_addr_cmp(&dist, min_dist) < 0) {
+        *min_dist = dist;
+        *nexthop = *e;
+    }
+}
+
+void closest_search(const sn_net_kbucket_t* snk, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop) {
+    sn_net_addr_t min_dist;
+    unsigned int b, first;
+    int i;
+
+    *nexthop = snk->self;
+    nexthop->is_set = 0;
+
+    if(sn_net_addr_cmp(dst, &snk->self.addr) == 0)
+        return;
+
+    sn_net_addr_xor(&snk->self.addr, dst, &min_dist);
+
+    /*
+    Contacts on buckets before first differ from dst on a bit we share with it, so they are further than us.
+    The ones on first share one more bit with dst than us, and beat anything on the later buckets.
+    */
+
+    first = bucket_index(&snk->self.addr, dst);
+
+    for(b = first; b < SN_NET_KBUCKET_COUNT; ++b) {
+        for(i = 0; i < snk->lens[b]; ++i)
+            closest_consider(&snk->buckets[b][i], dst, exclude, &min_dist, nexthop);
+
+        if(b == first && nexthop->is_set)
+            return;
+    }
+}
@@ -0,0 +1,230 @@
+#include "net/members.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint64_t members_prefix(const sn_net_addr_t* addr);
+const sn_net_entry_t* members_ring(const sn_net_members_t* snm, size_t idx, long offset);
+
+void sn_net_members_init(sn_net_members_t* snm, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr) {
+    assert(snm != NULL);
+    assert(self_addr != NULL);
+
+    memset(snm, 0, sizeof(sn_net_members_t));
+    snm->self.is_set = 1;
+    snm->self.addr = *self_addr;
+
+    if(self_net_addr != NULL)
+        snm->self.net_addr = *self_net_addr;
+}
+
+void sn_net_members_destroy(sn_net_members_t* snm) {
+    assert(snm != NULL);
+
+    free(snm->prefixes);
+    free(snm->entries);
+    snm->prefixes = NULL;
+    snm->entries = NULL;
+    snm->len = snm->cap = 0;
+}
+
+int sn_net_members_add(sn_net_members_t* snm, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr) {
+    sn_net_entry_t* e;
+    size_t idx;
+
+    assert(snm != NULL);
+    assert(addr != NULL);
+
+    if(sn_net_addr_cmp(addr, &snm->self.addr) == 0)
+        return 0;
+
+    if(sn_net_members_find(snm, addr, &idx) == 0) {
+        if(net_addr != NULL)
+            snm->entries[idx].net_addr = *net_addr;
+
+        return 0;
+    }
+
+    if(snm->len == snm->cap) {
+        size_t cap = snm->cap ? snm->cap*2 : 64;
+        uint64_t* prefixes = (uint64_t*)realloc(snm->prefixes, cap*sizeof(uint64_t));
+        sn_net_entry_t* entries;
+
+        if(prefixes == NULL)
+            return -1;
+
+        snm->prefixes = prefixes;
+
+        if((entries = (sn_net_entry_t*)realloc(snm->entries, cap*sizeof(sn_net_entry_t))) == NULL)
+            return -1;
+
+        snm->entries = entries;
+        snm->cap = cap;
+    }
+
+    /* Stable clusters change rarely, an insertion moves the tail of both arrays */
+
+    memmove(&snm->prefixes[idx + 1], &snm->prefixes[idx], (snm->len - idx)*sizeof(uint64_t));
+    memmove(&snm->entries[idx + 1], &snm->entries[idx], (snm->len - idx)*sizeof(sn_net_entry_t));
+    ++snm->len;
+
+    snm->prefixes[idx] = members_prefix(addr);
+    e = &snm->entries[idx];
+    e->is_set = 1;
+    e->addr = *addr;
+
+    if(net_addr != NULL)
+        e->net_addr = *net_addr;
+    else
+        memset(&e->net_addr, 0, sizeof(sn_io_naddr_t));
+
+    return 1;
+}
+
+int sn_net_members_remove(sn_net_members_t* snm, const sn_net_addr_t* addr) {
+    size_t idx;
+
+    assert(snm != NULL);
+    assert(addr != NULL);
+
+    if(sn_net_members_find(snm, addr, &idx) != 0)
+        return -1;
+
+    --snm->len;
+    memmove(&snm->prefixes[idx], &snm->prefixes[idx + 1], (snm->len - idx)*sizeof(uint64_t));
+    memmove(&snm->entries[idx], &snm->entries[idx + 1], (snm->len - idx)*sizeof(sn_net_entry_t));
+
+    return 0;
+}
+
+int sn_net_members_find(const sn_net_members_t* snm, const sn_net_addr_t* addr, size_t* out_idx) {
+    uint64_t prefix;
+    size_t lo = 0, hi, mid;
+
+    assert(snm != NULL);
+    assert(addr != NULL);
+
+    prefix = members_prefix(addr);
+    hi = snm->len;
+
+    /* Lower bound on the dense prefix array, whole keys only break prefix ties */
+
+    while(lo < hi) {
+        mid = lo + (hi - lo)/2;
+
+        if(snm->prefixes[mid] < prefix || (snm->prefixes[mid] == prefix && sn_net_addr_cmp(&snm->entries[mid].addr, addr) < 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if(out_idx != NULL)
+        *out_idx = lo;
+
+    return lo < snm->len && sn_net_addr_cmp(&snm->entries[lo].addr, addr) == 0 ? 0 : -1;
+}
+
+const sn_net_entry_t* sn_net_members_at(const sn_net_members_t* snm, size_t idx) {
+    assert(snm != NULL);
+
+    return idx < snm->len ? &snm->entries[idx] : NULL;
+}
+
+size_t sn_net_members_size(const sn_net_members_t* snm) {
+    assert(snm != NULL);
+
+    return snm->len;
+}
+
+void sn_net_members_nexthop(const sn_net_members_t* snm, const sn_net_addr_t* dst, sn_net_entry_t* nexthop) {
+    sn_net_entry_t candidates[3];
+    size_t idx;
+
+    assert(snm != NULL);
+    assert(dst != NULL);
+    assert(nexthop != NULL);
+
+    candidates[0] = snm->self;
+
+    if(snm->len == 0) {
+        *nexthop = snm->self;
+        nexthop->is_set = 0;
+        return;
+    }
+
+    /* The owner is a neighbor of dst on the ring */
+
+    sn_net_members_find(snm, dst, &idx);
+
+    candidates[1] = *members_ring(snm, idx, -1);
+    candidates[2] = *members_ring(snm, idx, 0);
+
+    sn_net_entry_closest(dst, candidates, 3, NULL, 0, nexthop);
+
+    if(sn_net_entry_cmp(nexthop, &snm->self) == 0)
+        nexthop->is_set = 0;
+}
+
+void sn_net_members_nexthop_alt(const sn_net_members_t* snm, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop) {
+    sn_net_entry_t candidates[4];
+    sn_net_addr_t self_dist, dist;
+    size_t idx, len = 0;
+    long offset;
+
+    assert(snm != NULL);
+    assert(dst != NULL);
+    assert(exclude != NULL);
+    assert(nexthop != NULL);
+
+    nexthop->is_set = 0;
+
+    if(snm->len == 0)
+        return;
+
+    /* Two members on each side of dst, one of them may be excluded */
+
+    sn_net_members_find(snm, dst, &idx);
+
+    for(offset = -2; offset <= 1; ++offset) {
+        const sn_net_entry_t* e = members_ring(snm, idx, offset);
+
+        if(sn_net_addr_cmp(&e->addr, exclude) != 0)
+            candidates[len++] = *e;
+    }
+
+    if(len == 0)
+        return;
+
+    sn_net_entry_closest(dst, candidates, len, NULL, 0, nexthop);
+    sn_net_addr_dist(&snm->self.addr, dst, &self_dist);
+    sn_net_addr_dist(&nexthop->addr, dst, &dist);
+
+    if(sn_net_addr_cmp(&dist, &self_dist) >= 0)
+        nexthop->is_set = 0;
+}
+
+size_t sn_net_members_memory(const sn_net_members_t* snm) {
+    assert(snm != NULL);
+
+    return snm->cap*(sizeof(uint64_t) + sizeof(sn_net_entry_t));
+}
+
+/* Private functions */
+
+uint64_t members_prefix(const sn_net_addr_t* addr) {
+    uint64_t prefix = 0;
+    int i;
+
+    for(i = 0; i < 8; ++i)
+        prefix = (prefix << 8) | addr->key[i];
+
+    return prefix;
+}
+
+const sn_net_entry_t* members_ring(const sn_net_members_t* snm, size_t idx, long offset) {
+    long len = (long)snm->len;
+
+    return &snm->entries[(((long)idx + offset)%len + len)%len];
+}
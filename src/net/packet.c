@@ -9,6 +9,12 @@
 #include <string.h>
 
 sn_net_packet_t* sn_net_packet_recv(sn_io_sock_t socket, sn_io_naddr_t* src_addr) {
+    sn_io_sock_rx_info_t info;
+
+    return sn_net_packet_recv_info(socket, src_addr, &info);
+}
+
+sn_net_packet_t* sn_net_packet_recv_info(sn_io_sock_t socket, sn_io_naddr_t* src_addr, sn_io_sock_rx_info_t* out_info) {
     sn_net_packet_t* packet;
     int recv_count;
     size_t packet_size;
@@ -40,7 +46,7 @@ sn_net_packet_t* sn_net_packet_recv(sn_io_sock_t socket, sn_io_naddr_t* src_addr
         return NULL;
     }
 
-    recv_count = sn_io_sock_recv(socket, &packet->header, packet_size, NULL);
+    recv_count = sn_io_sock_recv_info(socket, &packet->header, packet_size, NULL, out_info);
 
     if(recv_count < (ssize_t)sizeof(sn_wire_net_header_t) + (ssize_t)payload_len) {
         if(recv_count < 0) {
@@ -56,6 +62,50 @@ sn_net_packet_t* sn_net_packet_recv(sn_io_sock_t socket, sn_io_naddr_t* src_addr
     return packet;
 }
 
+int sn_net_packet_recv_many(sn_io_sock_t socket, sn_net_packet_t* packets[], sn_io_naddr_t src_addrs[], sn_io_sock_rx_info_t infos[], size_t count) {
+    size_t lens[SN_IO_SOCK_BATCH_LEN];
+    ssize_t received;
+    size_t i, valid = 0;
+
+    assert(socket != SN_IO_SOCK_INVALID);
+    assert(packets != NULL || count == 0);
+
+    count = SN_MIN(count, SN_IO_SOCK_BATCH_LEN);
+
+    /* One byte less so the trailing zero always fits */
+
+    received = sn_io_sock_recv_many(socket, (void* const*)packets, SN_NET_PACKET_BUF_LEN - 1, lens, src_addrs, infos, count);
+
+    if(received <= 0)
+        return (int)received;
+
+    for(i = 0; i < (size_t)received; ++i) {
+        sn_net_packet_t* packet = packets[i];
+
+        if(lens[i] < sizeof(sn_wire_net_header_t) ||
+                packet->header.len > SN_NET_PACKET_MAX_LEN ||
+                lens[i] < sizeof(sn_wire_net_header_t) + (size_t)packet->header.len)
+            continue;
+
+        packet->payload[packet->header.len] = '\0';
+
+        /* Compaction swaps buffers so every one stays owned by the caller */
+
+        packets[i] = packets[valid];
+        packets[valid] = packet;
+
+        if(src_addrs != NULL)
+            src_addrs[valid] = src_addrs[i];
+
+        if(infos != NULL)
+            infos[valid] = infos[i];
+
+        ++valid;
+    }
+
+    return (int)valid;
+}
+
 sn_net_packet_t* sn_net_packet_pack(const sn_net_addr_t* dst, const sn_net_addr_t* src, uint8_t type, size_t len, const char* payload) {
     sn_net_packet_t* packet;
 
@@ -123,6 +173,39 @@ int sn_net_packet_send(const sn_net_packet_t* packet, sn_io_sock_t socket, const
     return 0;
 }
 
+int sn_net_packet_send_many(const sn_net_packet_t* const packets[], sn_io_sock_t socket, const sn_io_naddr_t* const dst_addrs[], size_t count) {
+    const void* bufs[SN_IO_SOCK_BATCH_LEN];
+    size_t lens[SN_IO_SOCK_BATCH_LEN];
+    size_t sent = 0;
+
+    assert(packets != NULL || count == 0);
+    assert(socket != SN_IO_SOCK_INVALID);
+    assert(dst_addrs != NULL || count == 0);
+
+    while(sent < count) {
+        size_t batch_len = SN_MIN(count - sent, SN_IO_SOCK_BATCH_LEN);
+        ssize_t batch_sent;
+        size_t i;
+
+        for(i = 0; i < batch_len; ++i) {
+            bufs[i] = packets[sent + i];
+            lens[i] = sizeof(sn_wire_net_header_t) + (size_t)packets[sent + i]->header.len;
+        }
+
+        batch_sent = sn_io_sock_send_many(socket, bufs, lens, &dst_addrs[sent], batch_len);
+
+        if(batch_sent <= 0)
+            return sent ? (int)sent : -1;
+
+        sent += (size_t)batch_sent;
+
+        if((size_t)batch_sent < batch_len)
+            break;
+    }
+
+    return (int)sent;
+}
+
 void sn_net_packet_get_dst(const sn_net_packet_t* packet, sn_net_addr_t* out_dst) {
     assert(packet != NULL);
     assert(out_dst != NULL);
@@ -10,16 +10,29 @@
 void sn_net_router_set(sn_net_router_t* snr, const sn_net_entry_t* sne);
 void leafset_add(sn_net_router_t* snr, const sn_net_entry_t* sne);
 void leafset_remove(sn_net_router_t* snr, const sn_net_entry_t* sne);
-void leafset_insert(sn_net_entry_t* leafset, const sn_net_entry_t* sne, int right);
-void leafset_extract(sn_net_entry_t* leafset, const sn_net_entry_t* sne, int right);
+int leafset_insert(sn_net_entry_t* leafset, const sn_net_entry_t* sne, int right);
+int leafset_extract(sn_net_entry_t* leafset, const sn_net_entry_t* sne, int right);
 void leafset_sort(sn_net_entry_t* leafset, int right);
 int leafset_is_on_range(const sn_net_router_t* snr, const sn_net_addr_t* addr);
+void split_bounds(const sn_net_addr_t* self, unsigned int level, unsigned int column, sn_net_addr_t* min, sn_net_addr_t* max);
+void alt_consider(const sn_net_entry_t* e, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_addr_t* min_dist, sn_net_entry_t* nexthop);
+void query_table_row(const sn_net_router_t* snr, uint16_t l, sn_net_router_query_ser_t* query);
+void query_leafset_range(const sn_net_router_t* snr, int32_t p_min, int32_t p_max, sn_net_router_query_ser_t* query);
+const sn_net_entry_t* cursor_get(const sn_net_router_t* snr, const sn_net_router_cursor_t* cur, int32_t* out_a, int32_t* out_b);
+void cursor_fill(const sn_net_router_t* snr, sn_net_router_cursor_t* cur, sn_net_router_query_ser_t* query, size_t max_entries);
+sn_net_router_cache_t* cache_slot(sn_net_router_cache_t** cache, size_t max_entries);
+const sn_net_entry_t* delta_get(const sn_net_router_t* snr, const sn_net_router_delta_cursor_t* cur, uint8_t* out_flags, int32_t* out_a, int32_t* out_b);
+size_t delta_encode(const sn_net_router_t* snr, const sn_net_entry_t* e, uint8_t flags, int32_t a, int32_t b, unsigned char* out);
+int entry_same(const sn_net_entry_t* a, const sn_net_entry_t* b);
+void row_changed(sn_net_router_t* snr, unsigned int level, unsigned int column);
+void leafset_changed(sn_net_router_t* snr);
 
 void sn_net_router_init(sn_net_router_t* snr, const sn_net_addr_t* self_addr, const sn_io_naddr_t* self_net_addr) {
     assert(snr != NULL);
     assert(self_addr != NULL);
 
     memset(snr, 0, sizeof(sn_net_router_t));
+    snr->version = 1;
     snr->self.is_set = 1;
     snr->self.addr = *self_addr;
 
@@ -27,6 +40,22 @@ void sn_net_router_init(sn_net_router_t* snr, const sn_net_addr_t* self_addr, co
         snr->self.net_addr = *self_net_addr;
 }
 
+void sn_net_router_destroy(sn_net_router_t* snr) {
+    unsigned int i;
+
+    assert(snr != NULL);
+
+    for(i = 0; i < SN_NET_ROUTER_LEVELS; ++i) {
+        free(snr->row_cache[i]);
+        snr->row_cache[i] = NULL;
+    }
+
+    for(i = 0; i < 2; ++i) {
+        free(snr->leafset_cache[i]);
+        snr->leafset_cache[i] = NULL;
+    }
+}
+
 void sn_net_router_add(sn_net_router_t* snr, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr) {
     sn_net_entry_t e;
 
@@ -46,6 +75,9 @@ void sn_net_router_add(sn_net_router_t* snr, const sn_net_addr_t* addr, const sn
 }
 
 void sn_net_router_remove(sn_net_router_t* snr, const sn_net_addr_t* addr) {
+    const sn_net_entry_t* slot;
+    unsigned int level;
+    unsigned char column;
     sn_net_entry_t e;
 
     assert(addr != NULL);
@@ -53,7 +85,16 @@ void sn_net_router_remove(sn_net_router_t* snr, const sn_net_addr_t* addr) {
     e.is_set = 0;
     e.addr = *addr;
 
-    sn_net_router_set(snr, &e);
+    /* Another node may hold its table slot, and stays there */
+
+    sn_net_addr_index(&snr->self.addr, addr, &level, &column);
+
+    if(level < SN_NET_ROUTER_LEVELS && column < SN_NET_ROUTER_COLUMNS) {
+        slot = &snr->table[level][column];
+
+        if(slot->is_set && sn_net_addr_cmp(&slot->addr, addr) == 0)
+            sn_net_router_set(snr, &e);
+    }
 
     leafset_remove(snr, &e);
 }
@@ -115,6 +156,71 @@ void sn_net_router_nexthop(const sn_net_router_t* snr, const sn_net_addr_t* dst,
     }
 }
 
+void sn_net_router_nexthop_alt(const sn_net_router_t* snr, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_entry_t* nexthop) {
+    sn_net_addr_t min_dist;
+    unsigned int level, l, c;
+    int i;
+
+    assert(snr != NULL);
+    assert(dst != NULL);
+    assert(exclude != NULL);
+    assert(nexthop != NULL);
+
+    nexthop->is_set = 0;
+
+    /* Anything making progress, the rows above level share less with dst than us */
+
+    sn_net_addr_dist(&snr->self.addr, dst, &min_dist);
+    sn_net_addr_index(&snr->self.addr, dst, &level, 0);
+
+    for(i = 0; i < SN_NET_ROUTER_LEAFSET_SIZE; ++i) {
+        alt_consider(&snr->left_leafset[i], dst, exclude, &min_dist, nexthop);
+        alt_consider(&snr->right_leafset[i], dst, exclude, &min_dist, nexthop);
+    }
+
+    for(l = level; l < SN_NET_ROUTER_LEVELS; ++l)
+        for(c = 0; c < SN_NET_ROUTER_COLUMNS; ++c)
+            alt_consider(&snr->table[l][c], dst, exclude, &min_dist, nexthop);
+}
+
+size_t sn_net_router_split(const sn_net_router_t* snr, unsigned int level, const sn_net_addr_t* lo, const sn_net_addr_t* hi, sn_net_entry_t out_entries[], uint8_t out_levels[], size_t max) {
+    unsigned char hex[SN_NET_ADDR_HEX_LEN];
+    sn_net_addr_t min, max_addr;
+    unsigned int l, c;
+    size_t n = 0;
+
+    assert(snr != NULL);
+    assert(lo != NULL);
+    assert(hi != NULL);
+    assert(out_entries != NULL || max == 0);
+    assert(out_levels != NULL || max == 0);
+
+    sn_net_addr_get_hex(&snr->self.addr, hex);
+
+    for(l = level; l < SN_NET_ROUTER_LEVELS; ++l) {
+        for(c = 0; c < SN_NET_ROUTER_COLUMNS; ++c) {
+            if(c == hex[l] || !snr->table[l][c].is_set)
+                continue;
+
+            /* Subtrees out of the range are left alone */
+
+            split_bounds(&snr->self.addr, l, c, &min, &max_addr);
+
+            if(sn_net_addr_cmp(&min, hi) > 0 || sn_net_addr_cmp(&max_addr, lo) < 0)
+                continue;
+
+            if(n == max)
+                return n;
+
+            out_entries[n] = snr->table[l][c];
+            out_levels[n] = (uint8_t)(l + 1);
+            ++n;
+        }
+    }
+
+    return n;
+}
+
 int sn_net_router_to_str(const sn_net_router_t* snr, char* out_str, size_t out_str_len) {
     size_t used_len = 0;
 
@@ -235,7 +341,11 @@ void sn_net_router_table_set(sn_net_router_t* snr, unsigned int level, unsigned
     assert(column < SN_NET_ROUTER_COLUMNS);
     assert(e != NULL);
 
+    if(entry_same(&snr->table[level][column], e))
+        return;
+
     snr->table[level][column] = *e;
+    row_changed(snr, level, column);
 }
 
 void sn_net_router_leafset_set(sn_net_router_t* snr, int position, const sn_net_entry_t* e) {
@@ -244,6 +354,9 @@ void sn_net_router_leafset_set(sn_net_router_t* snr, int position, const sn_net_
     assert(-SN_NET_ROUTER_LEAFSET_SIZE <= position);
     assert(e != NULL);
 
+    if(entry_same(sn_net_router_leafset_get(snr, position), e))
+        return;
+
     if(position > 0) {
         snr->right_leafset[position - 1] = *e;
     } else if(position < 0) {
@@ -251,6 +364,8 @@ void sn_net_router_leafset_set(sn_net_router_t* snr, int position, const sn_net_
     } else {
         snr->self = *e;
     }
+
+    leafset_changed(snr);
 }
 
 size_t sn_net_router_query_table(const sn_net_router_t* snr, uint16_t l_min, uint16_t l_max, sn_net_router_query_ser_t** out_query) {
@@ -266,7 +381,7 @@ size_t sn_net_router_query_table(const sn_net_router_t* snr, uint16_t l_min, uin
        l_max < l_min)
        return 0;
 
-    max_size = (l_max - l_min)*SN_NET_ROUTER_COLUMNS + 1;
+    max_size = (l_max - l_min + 1)*SN_NET_ROUTER_COLUMNS;
 
     ret = (sn_net_router_query_ser_t*)malloc(sizeof(sn_net_router_query_ser_t) + max_size*sizeof(sn_net_router_entry_ser_t));
 
@@ -276,22 +391,7 @@ size_t sn_net_router_query_table(const sn_net_router_t* snr, uint16_t l_min, uin
     ret->entries_len = 0;
 
     for(uint16_t l = l_min; l <= l_max; ++l)
-        for(uint16_t c = 0; c < SN_NET_ROUTER_COLUMNS; ++c) {
-            const sn_net_entry_t* e = sn_net_router_table_get(snr, l, c);
-
-            if(e && e->is_set) {
-                sn_net_router_entry_ser_t* e_ser = &ret->entries[ret->entries_len];
-
-                if(sn_net_entry_ser(e, &e_ser->entry) == 0) {
-                    e_ser->is_table = 1;
-                    e_ser->level = l;
-                    e_ser->column = c;
-
-                    ++ret->entries_len;
-                }
-            }
-        }
-
+        query_table_row(snr, l, ret);
 
     final_size = sizeof(sn_net_router_query_ser_t) + (ret->entries_len)*sizeof(sn_net_router_entry_ser_t);
     *out_query = (sn_net_router_query_ser_t*)realloc(ret, final_size);
@@ -326,20 +426,7 @@ size_t sn_net_router_query_leafset(const sn_net_router_t* snr, int32_t p_min, in
 
     ret->entries_len = 0;
 
-    for(int32_t p = p_min; p <= p_max; ++p) {
-        const sn_net_entry_t* e = sn_net_router_leafset_get(snr, p);
-
-        if(e && e->is_set) {
-            sn_net_router_entry_ser_t* e_ser = &ret->entries[ret->entries_len];
-
-            if(sn_net_entry_ser(e, &e_ser->entry) == 0) {
-                e_ser->is_table = 0;
-                e_ser->position = p;
-
-                ++ret->entries_len;
-            }
-        }
-    }
+    query_leafset_range(snr, p_min, p_max, ret);
 
     final_size = sizeof(sn_net_router_query_ser_t) + (ret->entries_len)*sizeof(sn_net_router_entry_ser_t);
     *out_query = (sn_net_router_query_ser_t*)realloc(ret, final_size);
@@ -352,6 +439,258 @@ size_t sn_net_router_query_leafset(const sn_net_router_t* snr, int32_t p_min, in
     return final_size;
 }
 
+int sn_net_router_cursor_table(sn_net_router_cursor_t* cur, uint16_t l_min, uint16_t l_max) {
+    assert(cur != NULL);
+
+    if(l_min >= SN_NET_ROUTER_LEVELS ||
+       l_max >= SN_NET_ROUTER_LEVELS ||
+       l_max < l_min)
+       return -1;
+
+    cur->is_table = 1;
+    cur->first = l_min;
+    cur->last = l_max;
+    cur->next = 0;
+
+    return 0;
+}
+
+int sn_net_router_cursor_leafset(sn_net_router_cursor_t* cur, int32_t p_min, int32_t p_max) {
+    assert(cur != NULL);
+
+    if(p_min < -SN_NET_ROUTER_LEAFSET_SIZE ||
+       p_max > SN_NET_ROUTER_LEAFSET_SIZE ||
+       p_max < p_min)
+       return -1;
+
+    cur->is_table = 0;
+    cur->first = p_min;
+    cur->last = p_max;
+    cur->next = 0;
+
+    return 0;
+}
+
+size_t sn_net_router_query_next(const sn_net_router_t* snr, sn_net_router_cursor_t* cur, void* buf, size_t cap) {
+    sn_net_router_query_ser_t* query = (sn_net_router_query_ser_t*)buf;
+    int32_t a, b;
+
+    assert(snr != NULL);
+    assert(cur != NULL);
+    assert(buf != NULL);
+
+    if(cap < sizeof(sn_net_router_query_ser_t) + sizeof(sn_net_router_entry_ser_t))
+        return 0;
+
+    query->entries_len = 0;
+
+    cursor_fill(snr, cur, query, (cap - sizeof(sn_net_router_query_ser_t))/sizeof(sn_net_router_entry_ser_t));
+
+    /* Skips empty slots, so a full buffer at the end of the query is reported as done */
+
+    while(!sn_net_router_cursor_done(cur)) {
+        const sn_net_entry_t* e = cursor_get(snr, cur, &a, &b);
+
+        if(e && e->is_set)
+            break;
+
+        ++cur->next;
+    }
+
+    return sizeof(sn_net_router_query_ser_t) + query->entries_len*sizeof(sn_net_router_entry_ser_t);
+}
+
+int sn_net_router_cursor_done(const sn_net_router_cursor_t* cur) {
+    assert(cur != NULL);
+
+    if(cur->is_table)
+        return cur->next >= (uint32_t)(cur->last - cur->first + 1)*SN_NET_ROUTER_COLUMNS;
+
+    return cur->next >= (uint32_t)(cur->last - cur->first + 1);
+}
+
+void sn_net_router_cursor_delta(const sn_net_router_t* snr, sn_net_router_delta_cursor_t* cur, uint32_t since) {
+    assert(snr != NULL);
+    assert(cur != NULL);
+
+    cur->since = since;
+    cur->version = snr->version;
+    cur->next = 0;
+}
+
+size_t sn_net_router_delta_next(const sn_net_router_t* snr, sn_net_router_delta_cursor_t* cur, void* buf, size_t cap) {
+    sn_net_router_delta_ser_t* delta = (sn_net_router_delta_ser_t*)buf;
+    size_t len = sizeof(sn_net_router_delta_ser_t);
+    uint8_t flags;
+    int32_t a, b;
+
+    assert(snr != NULL);
+    assert(cur != NULL);
+    assert(buf != NULL);
+
+    if(cap < sizeof(sn_net_router_delta_ser_t) + SN_NET_ROUTER_DELTA_RECORD_MAX)
+        return 0;
+
+    delta->version = cur->version;
+    delta->since = cur->since;
+    delta->records_len = 0;
+
+    for(; !sn_net_router_delta_done(cur); ++cur->next) {
+        const sn_net_entry_t* e = delta_get(snr, cur, &flags, &a, &b);
+        size_t rec;
+
+        if(e == NULL)
+            continue;
+
+        if(len + SN_NET_ROUTER_DELTA_RECORD_MAX > cap)
+            break;
+
+        if((rec = delta_encode(snr, e, flags, a, b, (unsigned char*)buf + len)) != 0) {
+            len += rec;
+            ++delta->records_len;
+        }
+    }
+
+    /* Skips unchanged slots, so a full buffer at the end of the delta is reported as done */
+
+    while(!sn_net_router_delta_done(cur) && delta_get(snr, cur, &flags, &a, &b) == NULL)
+        ++cur->next;
+
+    return len;
+}
+
+int sn_net_router_delta_done(const sn_net_router_delta_cursor_t* cur) {
+    assert(cur != NULL);
+
+    return cur->next >= SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS + 2*SN_NET_ROUTER_LEAFSET_SIZE;
+}
+
+int sn_net_router_delta_apply(sn_net_router_t* snr, const sn_net_addr_t* from, const void* buf, size_t len, uint32_t* out_version) {
+    const sn_net_router_delta_ser_t* delta = (const sn_net_router_delta_ser_t*)buf;
+    const unsigned char* rec;
+    const unsigned char* end = (const unsigned char*)buf + len;
+    const sn_net_entry_t* slot;
+    sn_net_entry_t e;
+    unsigned int level;
+    unsigned char column;
+    uint32_t i;
+
+    assert(snr != NULL);
+    assert(from != NULL);
+    assert(buf != NULL);
+
+    if(len < sizeof(sn_net_router_delta_ser_t))
+        return -1;
+
+    rec = delta->records;
+
+    for(i = 0; i < delta->records_len; ++i) {
+        sn_net_addr_t addr;
+        sn_io_naddr_t net_addr;
+        size_t shared;
+
+        if(end - rec < 4 || (shared = rec[3]) > SN_NET_ADDR_LEN || (size_t)(end - rec) < 4 + SN_NET_ADDR_LEN - shared)
+            return -1;
+
+        /* Keys are relative to the sender address */
+
+        memcpy(addr.key, from->key, shared);
+        memcpy(addr.key + shared, rec + 4, SN_NET_ADDR_LEN - shared);
+
+        if(rec[0] & SN_NET_ROUTER_DELTA_REMOVED) {
+            rec += 4 + SN_NET_ADDR_LEN - shared;
+
+            /* Only drops the entry if it is the one we have on its slot */
+
+            if(sn_net_addr_cmp(&addr, &snr->self.addr) != 0)
+                sn_net_router_remove(snr, &addr);
+
+            continue;
+        }
+
+        if((size_t)(end - rec) < 4 + SN_NET_ADDR_LEN - shared + sizeof(sn_io_naddr_ser_t) ||
+                sn_io_naddr_deser(&net_addr, (const sn_io_naddr_ser_t*)(rec + 4 + SN_NET_ADDR_LEN - shared)) != 0)
+            return -1;
+
+        rec += 4 + SN_NET_ADDR_LEN - shared + sizeof(sn_io_naddr_ser_t);
+
+        if(sn_net_addr_cmp(&addr, &snr->self.addr) == 0)
+            continue;
+
+        e.is_set = 1;
+        e.addr = addr;
+        e.net_addr = net_addr;
+
+        /* Slots keep the live entry they hold, or two routers would swap theirs back and forth */
+
+        sn_net_addr_index(&snr->self.addr, &addr, &level, &column);
+        slot = &snr->table[level][column];
+
+        if(!slot->is_set || sn_net_addr_cmp(&slot->addr, &addr) == 0)
+            sn_net_router_set(snr, &e);
+
+        leafset_add(snr, &e);
+    }
+
+    if(out_version != NULL)
+        *out_version = delta->version;
+
+    return 0;
+}
+
+const sn_net_router_query_ser_t* sn_net_router_cached_row(sn_net_router_t* snr, uint16_t level, size_t* out_len) {
+    sn_net_router_cache_t* c;
+
+    assert(snr != NULL);
+    assert(out_len != NULL);
+
+    if(level >= SN_NET_ROUTER_LEVELS || (c = cache_slot(&snr->row_cache[level], SN_NET_ROUTER_COLUMNS)) == NULL)
+        return NULL;
+
+    if(!c->built || c->version != snr->row_versions[level]) {
+        c->query->entries_len = 0;
+        query_table_row(snr, level, c->query);
+        c->version = snr->row_versions[level];
+        c->built = 1;
+    }
+
+    *out_len = sizeof(sn_net_router_query_ser_t) + c->query->entries_len*sizeof(sn_net_router_entry_ser_t);
+
+    return c->query;
+}
+
+const sn_net_router_query_ser_t* sn_net_router_cached_leafset(sn_net_router_t* snr, int right, size_t* out_len) {
+    sn_net_router_cache_t* c;
+
+    assert(snr != NULL);
+    assert(out_len != NULL);
+
+    if((c = cache_slot(&snr->leafset_cache[right ? 1 : 0], SN_NET_ROUTER_LEAFSET_SIZE + 1)) == NULL)
+        return NULL;
+
+    if(!c->built || c->version != snr->leafset_version) {
+        c->query->entries_len = 0;
+
+        if(right)
+            query_leafset_range(snr, 0, SN_NET_ROUTER_LEAFSET_SIZE, c->query);
+        else
+            query_leafset_range(snr, -SN_NET_ROUTER_LEAFSET_SIZE, -1, c->query);
+
+        c->version = snr->leafset_version;
+        c->built = 1;
+    }
+
+    *out_len = sizeof(sn_net_router_query_ser_t) + c->query->entries_len*sizeof(sn_net_router_entry_ser_t);
+
+    return c->query;
+}
+
+uint32_t sn_net_router_version(const sn_net_router_t* snr) {
+    assert(snr != NULL);
+
+    return snr->version;
+}
+
 /* Private functions */
 
 int leafset_is_on_range(const sn_net_router_t* snr, const sn_net_addr_t* addr) {
@@ -367,18 +706,32 @@ int leafset_is_on_range(const sn_net_router_t* snr, const sn_net_addr_t* addr) {
     right_count = sn_net_entry_array_len(snr->right_leafset, SN_NET_ROUTER_LEAFSET_SIZE);
 
     if(left_count)
-        left_bound = &snr->left_leafset[left_count].addr;
+        left_bound = &snr->left_leafset[left_count - 1].addr;
     else
         left_bound = &snr->self.addr;
 
     if(right_count)
-        right_bound = &snr->right_leafset[right_count].addr;
+        right_bound = &snr->right_leafset[right_count - 1].addr;
     else
         right_bound = &snr->self.addr;
 
     return sn_net_addr_cmp(left_bound, addr) <= 0 && sn_net_addr_cmp(addr, right_bound) <= 0;
 }
 
+void alt_consider(const sn_net_entry_t* e, const sn_net_addr_t* dst, const sn_net_addr_t* exclude, sn_net_addr_t* min_dist, sn_net_entry_t* nexthop) {
+    sn_net_addr_t dist;
+
+    if(!e->is_set || sn_net_addr_cmp(&e->addr, exclude) == 0)
+        return;
+
+    sn_net_addr_dist(&e->addr, dst, &dist);
+
+    if(sn_net_addr_cmp(&dist, min_dist) < 0) {
+        *min_dist = dist;
+        *nexthop = *e;
+    }
+}
+
 void sn_net_router_set(sn_net_router_t* snr, const sn_net_entry_t* sne) {
     unsigned int level;
     unsigned char column;
@@ -396,52 +749,83 @@ void sn_net_router_set(sn_net_router_t* snr, const sn_net_entry_t* sne) {
 
     assert(sn_net_addr_cmp(&snr->self.addr, &insert->addr) != 0); //Should be impossible
 
+    /* Unchanged entries keep their stamps, deltas only carry real changes */
+
+    if(entry_same(insert, sne))
+        return;
+
     *insert = *sne;
+    row_changed(snr, level, column);
 }
 
 void leafset_add(sn_net_router_t* snr, const sn_net_entry_t* sne) {
+    int changed;
+
     assert(snr != NULL);
     assert(sne != NULL);
 
     if(sn_net_entry_cmp(sne, &snr->self) < 0) {
-        leafset_insert(snr->left_leafset, sne, 0);
+        changed = leafset_insert(snr->left_leafset, sne, 0);
     } else {
-        leafset_insert(snr->right_leafset, sne, 1);
+        changed = leafset_insert(snr->right_leafset, sne, 1);
     }
+
+    if(changed)
+        leafset_changed(snr);
 }
 
 void leafset_remove(sn_net_router_t* snr, const sn_net_entry_t* sne) {
+    int changed;
+
     assert(snr != NULL);
     assert(sne != NULL);
 
     if(sn_net_entry_cmp(sne, &snr->self) < 0) {
-        leafset_extract(snr->left_leafset, sne, 0);
+        changed = leafset_extract(snr->left_leafset, sne, 0);
     } else {
-        leafset_extract(snr->right_leafset, sne, 1);
+        changed = leafset_extract(snr->right_leafset, sne, 1);
     }
+
+    if(changed)
+        leafset_changed(snr);
 }
 
-void leafset_insert(sn_net_entry_t* leafset, const sn_net_entry_t* sne, int right) {
+int leafset_insert(sn_net_entry_t* leafset, const sn_net_entry_t* sne, int right) {
     size_t ls;
+    unsigned int i;
 
     assert(leafset != NULL);
     assert(sne != NULL);
 
     ls = sn_net_entry_array_len(leafset, SN_NET_ROUTER_LEAFSET_SIZE);
 
+    /* Already there, only the network address may change */
+
+    for(i = 0; i < ls; ++i) {
+        if(sn_net_entry_cmp(sne, &leafset[i]) == 0) {
+            if(entry_same(sne, &leafset[i]))
+                return 0;
+
+            leafset[i] = *sne;
+            return 1;
+        }
+    }
+
     if(ls < SN_NET_ROUTER_LEAFSET_SIZE) {
         leafset[ls] = *sne;
     } else {
         if((sn_net_addr_cmp(&sne->addr, &leafset[SN_NET_ROUTER_LEAFSET_SIZE-1].addr) < 0) ^ right)
-            return;
+            return 0;
 
         leafset[SN_NET_ROUTER_LEAFSET_SIZE-1] = *sne;
     }
 
     leafset_sort(leafset, right);
+
+    return 1;
 }
 
-void leafset_extract(sn_net_entry_t* leafset, const sn_net_entry_t* sne, int right) {
+int leafset_extract(sn_net_entry_t* leafset, const sn_net_entry_t* sne, int right) {
     size_t ls;
     unsigned int i;
 
@@ -457,9 +841,11 @@ void leafset_extract(sn_net_entry_t* leafset, const sn_net_entry_t* sne, int rig
 
             leafset_sort(leafset, right);
 
-            return;
+            return 1;
         }
     }
+
+    return 0;
 }
 
 void leafset_sort(sn_net_entry_t* leafset, int right) {
@@ -468,3 +854,171 @@ void leafset_sort(sn_net_entry_t* leafset, int right) {
     qsort(leafset, sn_net_entry_array_len(leafset, SN_NET_ROUTER_LEAFSET_SIZE), sizeof(sn_net_entry_t),
         (cmp_t)(right ? sn_net_entry_cmp : sn_net_entry_cmp_neg));
 }
+
+void query_table_row(const sn_net_router_t* snr, uint16_t l, sn_net_router_query_ser_t* query) {
+    sn_net_router_cursor_t cur;
+
+    sn_net_router_cursor_table(&cur, l, l);
+    cursor_fill(snr, &cur, query, SN_NET_ROUTER_COLUMNS);
+}
+
+void query_leafset_range(const sn_net_router_t* snr, int32_t p_min, int32_t p_max, sn_net_router_query_ser_t* query) {
+    sn_net_router_cursor_t cur;
+
+    sn_net_router_cursor_leafset(&cur, p_min, p_max);
+    cursor_fill(snr, &cur, query, (size_t)(p_max - p_min + 1));
+}
+
+const sn_net_entry_t* cursor_get(const sn_net_router_t* snr, const sn_net_router_cursor_t* cur, int32_t* out_a, int32_t* out_b) {
+    if(cur->is_table) {
+        *out_a = cur->first + (int32_t)(cur->next/SN_NET_ROUTER_COLUMNS);
+        *out_b = (int32_t)(cur->next%SN_NET_ROUTER_COLUMNS);
+
+        return sn_net_router_table_get(snr, (unsigned int)*out_a, (unsigned int)*out_b);
+    }
+
+    *out_a = cur->first + (int32_t)cur->next;
+    *out_b = 0;
+
+    return sn_net_router_leafset_get(snr, *out_a);
+}
+
+void cursor_fill(const sn_net_router_t* snr, sn_net_router_cursor_t* cur, sn_net_router_query_ser_t* query, size_t max_entries) {
+    size_t added = 0;
+    int32_t a, b;
+
+    /* max_entries counts the entries added now, query may already hold some */
+
+    for(; added < max_entries && !sn_net_router_cursor_done(cur); ++cur->next) {
+        const sn_net_entry_t* e = cursor_get(snr, cur, &a, &b);
+
+        if(e && e->is_set) {
+            sn_net_router_entry_ser_t* e_ser = &query->entries[query->entries_len];
+
+            if(sn_net_entry_ser(e, &e_ser->entry) == 0) {
+                e_ser->is_table = (uint8_t)cur->is_table;
+
+                if(cur->is_table) {
+                    e_ser->level = (uint16_t)a;
+                    e_ser->column = (uint16_t)b;
+                } else {
+                    e_ser->position = a;
+                }
+
+                ++query->entries_len;
+                ++added;
+            }
+        }
+    }
+}
+
+sn_net_router_cache_t* cache_slot(sn_net_router_cache_t** cache, size_t max_entries) {
+    if(*cache != NULL)
+        return *cache;
+
+    /* Allocated on first use, most rows of most routers are never asked for */
+
+    *cache = (sn_net_router_cache_t*)malloc(sizeof(sn_net_router_cache_t) + sizeof(sn_net_router_query_ser_t) + max_entries*sizeof(sn_net_router_entry_ser_t));
+
+    if(*cache == NULL)
+        return NULL;
+
+    (*cache)->query = (sn_net_router_query_ser_t*)(*cache + 1);
+    (*cache)->built = 0;
+
+    return *cache;
+}
+
+int entry_same(const sn_net_entry_t* a, const sn_net_entry_t* b) {
+    /* Empty slots are all the same, whatever address they last held */
+
+    if(!a->is_set || !b->is_set)
+        return a->is_set == b->is_set;
+
+    return sn_net_addr_cmp(&a->addr, &b->addr) == 0 && sn_io_naddr_cmp(&a->net_addr, &b->net_addr) == 0;
+}
+
+void row_changed(sn_net_router_t* snr, unsigned int level, unsigned int column) {
+    ++snr->row_versions[level];
+    snr->table_stamps[level][column] = ++snr->version;
+}
+
+void leafset_changed(sn_net_router_t* snr) {
+    ++snr->leafset_version;
+    snr->leafset_stamp = ++snr->version;
+}
+
+const sn_net_entry_t* delta_get(const sn_net_router_t* snr, const sn_net_router_delta_cursor_t* cur, uint8_t* out_flags, int32_t* out_a, int32_t* out_b) {
+    const sn_net_entry_t* e;
+
+    if(cur->next < SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS) {
+        *out_a = (int32_t)(cur->next/SN_NET_ROUTER_COLUMNS);
+        *out_b = (int32_t)(cur->next%SN_NET_ROUTER_COLUMNS);
+
+        if(snr->table_stamps[*out_a][*out_b] <= cur->since)
+            return NULL;
+
+        /* Removed entries keep their address, so they are sent too */
+
+        e = &snr->table[*out_a][*out_b];
+        *out_flags = SN_NET_ROUTER_DELTA_TABLE | (e->is_set ? 0 : SN_NET_ROUTER_DELTA_REMOVED);
+
+        return e;
+    }
+
+    /* Leafset positions move on every insertion, a changed leafset is sent whole(but ourselves) */
+
+    if(snr->leafset_stamp <= cur->since)
+        return NULL;
+
+    *out_a = (int32_t)(cur->next - SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS);
+    *out_a = *out_a < SN_NET_ROUTER_LEAFSET_SIZE ? -*out_a - 1 : *out_a - SN_NET_ROUTER_LEAFSET_SIZE + 1;
+    *out_b = 0;
+    *out_flags = 0;
+
+    e = sn_net_router_leafset_get(snr, *out_a);
+
+    return e && e->is_set ? e : NULL;
+}
+
+size_t delta_encode(const sn_net_router_t* snr, const sn_net_entry_t* e, uint8_t flags, int32_t a, int32_t b, unsigned char* out) {
+    size_t shared = 0;
+
+    /* Table entries share at least level nibbles with us, and leafset entries are close to us */
+
+    while(shared < SN_NET_ADDR_LEN && e->addr.key[shared] == snr->self.addr.key[shared])
+        ++shared;
+
+    out[0] = flags;
+    out[1] = (uint8_t)(int8_t)a;
+    out[2] = (uint8_t)b;
+    out[3] = (uint8_t)shared;
+    memcpy(out + 4, e->addr.key + shared, SN_NET_ADDR_LEN - shared);
+
+    if(flags & SN_NET_ROUTER_DELTA_REMOVED)
+        return 4 + SN_NET_ADDR_LEN - shared;
+
+    if(sn_io_naddr_ser(&e->net_addr, (sn_io_naddr_ser_t*)(out + 4 + SN_NET_ADDR_LEN - shared)) != 0)
+        return 0;
+
+    return 4 + SN_NET_ADDR_LEN - shared + sizeof(sn_io_naddr_ser_t);
+}
+
+void split_bounds(const sn_net_addr_t* self, unsigned int level, unsigned int column, sn_net_addr_t* min, sn_net_addr_t* max) {
+    unsigned int i = level/2;
+
+    /* Our first level digits, column, then all zeros or all ones */
+
+    *min = *self;
+
+    if(level%2)
+        min->key[i] = (unsigned char)((min->key[i] & 0xf0) | column);
+    else
+        min->key[i] = (unsigned char)(column << 4);
+
+    memset(min->key + i + 1, 0, SN_NET_ADDR_LEN - i - 1);
+
+    *max = *min;
+    max->key[i] |= (unsigned char)(level%2 ? 0x00 : 0x0f);
+    memset(max->key + i + 1, 0xff, SN_NET_ADDR_LEN - i - 1);
+}
@@ -0,0 +1,247 @@
+#include "net/signer.h"
+
+#include "common.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+typedef struct {
+    pthread_mutex_t mut;
+    pthread_cond_t cond;
+    size_t remaining;
+} sn_net_signer_latch_t;
+
+struct sn_net_signer_job_t_ {
+    sn_net_signer_job_t* next; /**< Next job on the queue */
+    sn_net_packet_t** packets; /**< Packets to sign */
+    size_t count; /**< Number of packets */
+    sn_net_packet_t* single; /**< Storage for single packet jobs */
+    sn_util_closure_t done; /**< Completion closure */
+    int has_done; /**< Is done set? */
+    sn_net_signer_latch_t* latch; /**< Batch latch, NULL for single jobs */
+};
+
+void* signer_worker(void* arg);
+void signer_enqueue(sn_net_signer_t* signer, sn_net_signer_job_t* job);
+void signer_run(sn_net_signer_t* signer, sn_net_signer_job_t* job);
+
+int sn_net_signer_init(sn_net_signer_t* signer, const sn_crypto_sign_key_t* key, unsigned int workers) {
+    unsigned int i;
+
+    assert(signer != NULL);
+    assert(key != NULL);
+
+    if(workers == 0 || workers > SN_NET_SIGNER_MAX_WORKERS)
+        return -1;
+
+    signer->key = *key;
+    signer->head = signer->tail = NULL;
+    signer->stopping = 0;
+    signer->workers_len = 0;
+
+    if(pthread_mutex_init(&signer->mut, NULL) != 0)
+        return -1;
+
+    if(pthread_cond_init(&signer->cond, NULL) != 0) {
+        pthread_mutex_destroy(&signer->mut);
+        return -1;
+    }
+
+    for(i = 0; i < workers; ++i) {
+        if(pthread_create(&signer->workers[i], NULL, signer_worker, signer) != 0) {
+            sn_net_signer_destroy(signer);
+            return -1;
+        }
+
+        ++signer->workers_len;
+    }
+
+    return 0;
+}
+
+void sn_net_signer_destroy(sn_net_signer_t* signer) {
+    unsigned int i;
+
+    assert(signer != NULL);
+
+    pthread_mutex_lock(&signer->mut);
+    signer->stopping = 1;
+    pthread_cond_broadcast(&signer->cond);
+    pthread_mutex_unlock(&signer->mut);
+
+    for(i = 0; i < signer->workers_len; ++i)
+        pthread_join(signer->workers[i], NULL);
+
+    signer->workers_len = 0;
+
+    pthread_cond_destroy(&signer->cond);
+    pthread_mutex_destroy(&signer->mut);
+}
+
+int sn_net_signer_submit(sn_net_signer_t* signer, sn_net_packet_t* packet, const sn_util_closure_t* done) {
+    sn_net_signer_job_t* job;
+
+    assert(signer != NULL);
+    assert(packet != NULL);
+
+    job = (sn_net_signer_job_t*)malloc(sizeof(sn_net_signer_job_t));
+
+    if(job == NULL)
+        return -1;
+
+    job->single = packet;
+    job->packets = &job->single;
+    job->count = 1;
+    job->latch = NULL;
+    job->has_done = done != NULL;
+
+    if(done != NULL)
+        job->done = *done;
+
+    signer_enqueue(signer, job);
+
+    return 0;
+}
+
+int sn_net_signer_sign_many(sn_net_signer_t* signer, sn_net_packet_t* packets[], size_t count) {
+    sn_net_signer_latch_t latch;
+    sn_net_signer_job_t* jobs;
+    size_t chunks;
+    size_t chunk_len;
+    size_t i;
+
+    assert(signer != NULL);
+    assert(packets != NULL || count == 0);
+
+    if(count == 0)
+        return 0;
+
+    chunks = SN_MIN((size_t)signer->workers_len + 1, count);
+    chunk_len = (count + chunks - 1)/chunks;
+    chunks = (count + chunk_len - 1)/chunk_len;
+
+    jobs = (sn_net_signer_job_t*)malloc(chunks*sizeof(sn_net_signer_job_t));
+
+    if(jobs == NULL)
+        return -1;
+
+    if(pthread_mutex_init(&latch.mut, NULL) != 0) {
+        free(jobs);
+        return -1;
+    }
+
+    if(pthread_cond_init(&latch.cond, NULL) != 0) {
+        pthread_mutex_destroy(&latch.mut);
+        free(jobs);
+        return -1;
+    }
+
+    latch.remaining = chunks - 1;
+
+    for(i = 0; i < chunks; ++i) {
+        jobs[i].packets = &packets[i*chunk_len];
+        jobs[i].count = SN_MIN(chunk_len, count - i*chunk_len);
+        jobs[i].has_done = 0;
+        jobs[i].latch = &latch;
+    }
+
+    /* The last chunk is signed by the calling thread */
+
+    for(i = 0; i + 1 < chunks; ++i)
+        signer_enqueue(signer, &jobs[i]);
+
+    for(i = 0; i < jobs[chunks - 1].count; ++i)
+        sn_net_packet_sign(jobs[chunks - 1].packets[i], &signer->key);
+
+    pthread_mutex_lock(&latch.mut);
+    while(latch.remaining > 0)
+        pthread_cond_wait(&latch.cond, &latch.mut);
+    pthread_mutex_unlock(&latch.mut);
+
+    pthread_cond_destroy(&latch.cond);
+    pthread_mutex_destroy(&latch.mut);
+    free(jobs);
+
+    return 0;
+}
+
+/*Private functions*/
+
+void signer_enqueue(sn_net_signer_t* signer, sn_net_signer_job_t* job) {
+    assert(signer != NULL);
+    assert(job != NULL);
+
+    job->next = NULL;
+
+    pthread_mutex_lock(&signer->mut);
+
+    if(signer->tail)
+        signer->tail->next = job;
+    else
+        signer->head = job;
+
+    signer->tail = job;
+
+    pthread_cond_signal(&signer->cond);
+    pthread_mutex_unlock(&signer->mut);
+}
+
+void signer_run(sn_net_signer_t* signer, sn_net_signer_job_t* job) {
+    size_t i;
+
+    assert(signer != NULL);
+    assert(job != NULL);
+
+    for(i = 0; i < job->count; ++i)
+        sn_net_packet_sign(job->packets[i], &signer->key);
+
+    if(job->latch) {
+        sn_net_signer_latch_t* latch = job->latch;
+
+        pthread_mutex_lock(&latch->mut);
+        if(--latch->remaining == 0)
+            pthread_cond_signal(&latch->cond);
+        pthread_mutex_unlock(&latch->mut);
+        return;
+    }
+
+    if(job->has_done) {
+        void* argv[] = { job->single };
+
+        sn_util_closure_call(&job->done, 1, argv);
+    }
+
+    free(job);
+}
+
+void* signer_worker(void* arg) {
+    sn_net_signer_t* signer = (sn_net_signer_t*)arg;
+    sn_net_signer_job_t* job;
+
+    assert(signer != NULL);
+
+    do {
+        pthread_mutex_lock(&signer->mut);
+
+        while(signer->head == NULL && !signer->stopping)
+            pthread_cond_wait(&signer->cond, &signer->mut);
+
+        job = signer->head;
+
+        if(job != NULL) {
+            signer->head = job->next;
+
+            if(signer->head == NULL)
+                signer->tail = NULL;
+        }
+
+        pthread_mutex_unlock(&signer->mut);
+
+        if(job != NULL)
+            signer_run(signer, job);
+    } while(job != NULL);
+
+    return signer;
+}
@@ -2,7 +2,10 @@
 
 #include <assert.h>
 #include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -20,18 +23,303 @@
 #include "callbacks.h"
 #include "net/addr.h"
 #include "common.h"
+#include "net/members.h"
 #include "net/packet.h"
 #include "handler.h"
+#include "util/time.h"
+#include "wire.h"
 
 typedef struct {
     uint32_t reply_id;
     sn_util_closure_t closure;
     int once;
+    uint64_t deadline;
 } sn_reply_sub_t;
 
+typedef struct {
+    sn_node_t* sns;
+    sn_util_closure_t done;
+    int has_done;
+} sn_send_async_t;
+
+typedef struct {
+    sn_net_addr_t target;
+    sn_net_packet_t* packet;
+} sn_mux_local_t;
+
+typedef struct {
+    sn_node_t* sns;
+    uint32_t reply_id;
+    pthread_mutex_t mut;
+    pthread_cond_t cond;
+    int status; /* 0 while joining, 1 if joined, -1 if timed out */
+    int hops; /* Route length, -1 until the closest node replies */
+    uint8_t expected[SN_NET_PACKET_DEFAULT_TTL]; /* Replies sent by each hop, 0 if none arrived */
+    uint8_t received[SN_NET_PACKET_DEFAULT_TTL]; /* Replies received from each hop */
+} sn_join_t;
+
+typedef struct {
+    sn_net_addr_t dead; /* Entry found dead, not taken back from the answers */
+    uint64_t last; /* Last round of questions */
+    uint32_t attempts; /* Rounds asked */
+} sn_repair_t;
+
+typedef struct {
+    sn_net_addr_t addr; /* Candidate seen sending to us */
+    sn_io_naddr_t net_addr; /* Where its packet came from */
+    unsigned char cnt[SN_WIRE_PING_MSG_CONTENT]; /* Verification ping content */
+    uint64_t sent; /* When the ping was sent */
+} sn_learn_t;
+
+typedef struct {
+    sn_io_naddr_t net_addr; /* Where the destination is reached straight */
+    uint64_t expires; /* Usable until then, pushed back by packets coming straight from it */
+    uint64_t offered; /* When we last offered it our own netaddress */
+    uint8_t hops; /* Overlay hops a shortcut saves plus one, 0 if unknown */
+    uint8_t usable; /* Is net_addr known? */
+} sn_shortcut_t;
+
+typedef struct {
+    sn_net_packet_t* packet; /* Second copy, NULL once sent(or not needed) */
+    sn_net_addr_t primary; /* Nexthop of the first copy */
+    uint64_t sent_ns; /* When the first copy was sent */
+    uint64_t deadline; /* When the second copy is due */
+    uint32_t reply_id; /* Reply settling it, 0 if none */
+} sn_hedge_t;
+
+enum { LOOKUP_NEW, LOOKUP_ASKED, LOOKUP_ANSWERED, LOOKUP_FAILED };
+
+typedef struct {
+    sn_net_entry_t entry; /* Contact */
+    sn_net_addr_t dist; /* Its distance to the target */
+    uint64_t asked; /* When it was queried */
+    int state; /* LOOKUP_* */
+} sn_lookup_contact_t;
+
+typedef struct {
+    sn_node_t* sns; /* Owner node */
+    sn_net_addr_t target; /* Looked up address */
+    sn_util_closure_t done; /* Called with the owner entry(NULL if not found) and the number of queries */
+    sn_lookup_contact_t contacts[SN_NODE_LOOKUP_SHORTLIST]; /* Closest contacts known, by distance */
+    size_t contacts_len; /* Number of contacts */
+    unsigned int alpha; /* Queries in flight at most */
+    unsigned int in_flight; /* Queries neither answered nor timed out */
+    unsigned int listeners; /* Reply listeners not called yet, the lookup outlives them */
+    sn_data_vec_t rpcs; /* Queries(sn_lookup_rpc_t*) curried into the listeners, freed with the lookup */
+    unsigned int queries; /* Queries sent */
+    uint64_t deadline; /* Failure time */
+    int finished; /* Has done been called? */
+} sn_lookup_t;
+
+typedef struct {
+    sn_lookup_t* lookup; /* Lookup asking */
+    sn_net_entry_t entry; /* Contact asked */
+    uint32_t reply_id; /* Reply ID of its listener */
+    int waiting; /* Is its listener still registered? */
+} sn_lookup_rpc_t;
+
+typedef struct {
+    sn_net_entry_t entry; /* Member, is_set = 0 if it left */
+    uint32_t incarnation; /* Member incarnation the change is about */
+    unsigned int sends_left; /* Maintenance periods it is still pushed for */
+    uint64_t started; /* When it was first pushed(ms) */
+} sn_rumor_t;
+
+typedef struct {
+    sn_net_entry_t entry; /* Child node */
+    uint64_t expires; /* When it is dropped unless it subscribes again */
+} sn_topic_child_t;
+
+typedef struct {
+    sn_net_addr_t topic; /* Topic address, owned by the tree root */
+    sn_net_entry_t parent; /* Node our subscription went to, unset if we are the root */
+    sn_data_vec_t children; /* Children(sn_topic_child_t) the publications are sent to */
+    sn_util_closure_t on_publish; /* Local subscription closure */
+    int subscribed; /* Is there a local subscription? */
+    uint64_t refresh; /* When the subscription to the parent is renewed */
+} sn_topic_t;
+
+typedef struct {
+    uint32_t incarnation; /* Highest member incarnation heard of */
+    int alive; /* Is it a member at that incarnation? */
+    uint64_t since; /* When it was last changed, dead ones are forgotten after a while */
+} sn_heard_t;
+
+typedef struct {
+    uint32_t id; /* Query ID our children answer to */
+    sn_net_entry_t parent; /* Node that asked us, unset at the origin */
+    uint32_t parent_id; /* Query ID of the parent */
+    uint8_t metric; /* Aggregated value */
+    sn_net_addr_t* asked; /* Children yet to answer, one result taken from each */
+    size_t pending; /* How many of them */
+    uint64_t deadline; /* When the result is sent without them */
+    sn_wire_aggregate_result_t result; /* Our value merged with the subtree results so far */
+    sn_util_closure_t done; /* Origin closure */
+} sn_aggregate_t;
+
+SN_ASSERT_COMPILE(SN_NODE_AGGREGATE_BUCKETS == SN_WIRE_AGGREGATE_BUCKETS);
+
+typedef struct {
+    uint8_t op; /* PUT or GET */
+    sn_net_addr_t key; /* Key asked for */
+    sn_util_closure_t done; /* Caller closure */
+} sn_store_req_t;
+
+typedef struct {
+    sn_net_addr_t key; /* Object key */
+    uint32_t index; /* Fragment index */
+    uint32_t part; /* Fragment part */
+} sn_fragment_key_t;
+
+typedef struct {
+    sn_net_packet_t* packet; /* Signed packet */
+    int direct; /* Straight to net_addr, routed otherwise */
+    sn_io_naddr_t net_addr; /* Holder address */
+} sn_object_out_t;
+
+typedef struct {
+    uint64_t version; /* Object version */
+    uint32_t len; /* Object length */
+    unsigned int index; /* Fragment index */
+    uint32_t parts; /* Parts got, a bit each */
+    unsigned char* bytes; /* Fragment */
+} sn_object_piece_t;
+
+typedef struct {
+    sn_node_t* sns; /* Node state */
+    uint8_t op; /* STORE or FETCH */
+    uint32_t reply_id; /* Listener of the answers */
+    uint64_t version; /* Version being stored */
+    uint32_t stored; /* Fragments stored whole, a bit each */
+    size_t answers; /* MISSING answers, one ends each holder */
+    size_t pieces; /* Fragments got */
+    sn_object_piece_t piece[SN_NODE_OBJECT_DATA + SN_NODE_OBJECT_PARITY]; /* Fragments got */
+    sn_util_closure_t done; /* Caller closure */
+} sn_object_req_t;
+
+SN_ASSERT_COMPILE(SN_NODE_OBJECT_PART_MAX + SN_WIRE_OBJECT_MSG_SIZE <= SN_NET_PACKET_MAX_LEN);
+SN_ASSERT_COMPILE(SN_NODE_OBJECT_PARTS <= 32);
+SN_ASSERT_COMPILE(SN_NODE_OBJECT_DATA <= SN_DATA_ERASURE_MAX_DATA && SN_NODE_OBJECT_PARITY <= SN_DATA_ERASURE_MAX_PARITY);
+
+int node_init(sn_node_t* sns, sn_io_runtime_t* rt, sn_node_mux_t* mux, const sn_crypto_sign_key_t* sk, const sn_crypto_sign_pubkey_t* pk, const sn_io_sock_t socket, int check_sign);
+int node_receive(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr);
+int node_recv_batch(sn_node_t* sns);
+void node_rx_telemetry(sn_node_t* sns, const sn_io_sock_rx_info_t* info, uint64_t now_real);
+void node_noop(int argc, void* argv[]);
+int node_local_target(sn_node_t* sns, const sn_net_addr_t* dst, const sn_net_entry_t* nexthop, sn_net_addr_t* out_target);
+int node_send_nexthop(sn_node_t* sns, const sn_net_packet_t* packet, const sn_net_addr_t* dst, const sn_net_entry_t* nexthop);
+sn_net_packet_t* node_pack(sn_node_t* sns, const sn_net_addr_t* dst, uint8_t type, size_t len, const char* payload);
+void on_mux_ready(int argc, void* argv[]);
+void on_mux_local(int argc, void* argv[]);
+int mux_register(sn_node_mux_t* mux, sn_node_t* sns);
+void mux_unregister(sn_node_mux_t* mux, sn_node_t* sns);
+unsigned int mux_enter(sn_node_mux_t* mux);
+void mux_leave(sn_node_mux_t* mux, unsigned int epoch);
+sn_node_t* mux_lookup(sn_node_mux_t* mux, const sn_net_addr_t* addr, int or_primary);
+int mux_post_local(sn_node_mux_t* mux, const sn_net_addr_t* target, const sn_net_packet_t* packet);
 int deliver(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr);
 int forward(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr);
+int forward_route(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop);
+void forward_log(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, const sn_net_entry_t* nexthop);
+int forward_many(sn_node_t* sns, sn_net_packet_t* packets[], size_t count);
 void* background(void* arg);
+void on_socket_ready(int argc, void* argv[]);
+void on_maintenance(int argc, void* argv[]);
+void maintenance(sn_node_t* sns);
+void reply_sweep(sn_node_t* sns, uint64_t now);
+void reply_expire(sn_reply_sub_t* sub);
+void reply_arm(sn_node_t* sns, uint64_t next, uint64_t now);
+void on_reply_timer(int argc, void* argv[]);
+void detect_failures(sn_node_t* sns, uint64_t now);
+void remove_net_addr(sn_node_t* sns, const sn_io_naddr_t* net_addr, uint64_t now);
+int repair_start(sn_node_t* sns, unsigned int level, unsigned int column, const sn_net_addr_t* dead, uint64_t now);
+void repair_round(sn_node_t* sns, uint16_t slot, sn_repair_t* repair, uint64_t now);
+void repair_tick(sn_node_t* sns, uint64_t now);
+void on_repair_reply(int argc, void* argv[]);
+void learn_observe(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, uint8_t ttl);
+void learn_tick(sn_node_t* sns, uint64_t now);
+void on_learn_reply(int argc, void* argv[]);
+int shortcut_nexthop(sn_node_t* sns, const sn_net_addr_t* dst, sn_net_entry_t* nexthop);
+void shortcut_drop(sn_node_t* sns, const sn_net_addr_t* dst);
+void shortcut_heard(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, uint64_t now);
+void shortcut_offer(sn_node_t* sns, const sn_net_packet_t* packet);
+void shortcut_sweep(sn_node_t* sns, uint64_t now);
+void on_hedge_timer(int argc, void* argv[]);
+void hedge_arm(sn_node_t* sns, uint64_t now);
+void hedge_settle(sn_node_t* sns, uint32_t reply_id);
+void hedge_sweep(sn_node_t* sns, uint64_t now);
+void route_remove(sn_node_t* sns, const sn_net_addr_t* addr);
+int gossip_learn(sn_node_t* sns, const sn_net_addr_t* addr, uint32_t incarnation, int alive);
+int gossip_admit(sn_node_t* sns, const sn_net_addr_t* addr, uint32_t* out_incarnation);
+void gossip_rumor(sn_node_t* sns, const sn_net_entry_t* e, uint32_t incarnation);
+void gossip_tick(sn_node_t* sns, uint64_t now);
+sn_topic_t* topic_find(sn_node_t* sns, const sn_net_addr_t* topic);
+sn_topic_t* topic_add(sn_node_t* sns, const sn_net_addr_t* topic, uint64_t now);
+void topic_join(sn_node_t* sns, sn_topic_t* t, uint64_t now);
+void topic_send(sn_node_t* sns, const sn_topic_t* t, uint8_t flags);
+void topic_drop(sn_node_t* sns, sn_topic_t* t);
+void topic_tick(sn_node_t* sns, uint64_t now);
+int topic_spread(sn_node_t* sns, const sn_net_packet_t* packet, const sn_net_addr_t* from);
+int broadcast_split(sn_node_t* sns, const sn_wire_broadcast_header_t* header, size_t len, const char* msg);
+int aggregate_start(sn_node_t* sns, sn_aggregate_t* a, unsigned int level, uint64_t budget);
+void aggregate_finish(sn_node_t* sns, sn_aggregate_t* a);
+void aggregate_record(sn_wire_aggregate_result_t* result, uint64_t value);
+void aggregate_merge(sn_wire_aggregate_result_t* result, const sn_wire_aggregate_result_t* other);
+uint64_t aggregate_value(sn_node_t* sns, uint8_t metric);
+void on_aggregate_timer(int argc, void* argv[]);
+int store_request(sn_node_t* sns, uint8_t op, const sn_net_addr_t* key, size_t len, const char* value, uint64_t timeout_ms, const sn_util_closure_t* done);
+int store_answer(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* rem_addr, uint8_t op, uint32_t reply_to, const sn_net_addr_t* key, uint64_t version, size_t len, const char* value);
+void store_replicate(sn_node_t* sns, const sn_net_addr_t* key, const sn_data_store_item_t* item);
+int store_replicates(sn_node_t* sns, const sn_net_addr_t* key);
+int store_neighbor(sn_node_t* sns, const sn_net_addr_t* addr);
+uint64_t cache_get_id(const sn_net_addr_t* src, const sn_net_addr_t* key, uint32_t reply_to);
+void on_store_reply(int argc, void* argv[]);
+int store_keep(sn_node_t* sns, const sn_net_addr_t* key, const char* value, size_t len, uint64_t version);
+int store_order(uint64_t version, const unsigned char* digest, uint64_t other_version, const unsigned char* other_digest);
+int sync_start(sn_node_t* sns);
+void sync_tick(sn_node_t* sns, uint64_t now);
+int sync_send(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* net_addr, uint8_t op, const sn_net_addr_t* lo, const sn_net_addr_t* hi, const void* entries, size_t entry_size, size_t count);
+int sync_digests(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, const sn_net_addr_t* lo, const sn_net_addr_t* hi, const sn_wire_sync_digest_t* digests, size_t count);
+void sync_digest(sn_node_t* sns, unsigned int level, uint32_t index, const sn_net_addr_t* lo, const sn_net_addr_t* hi, unsigned char* out);
+int sync_list(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, const sn_net_addr_t* lo, const sn_net_addr_t* hi, sn_data_vec_t* leaves);
+int sync_items(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, const sn_net_addr_t* lo, const sn_net_addr_t* hi, const sn_wire_sync_item_t* items, size_t count);
+int sync_want(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, const sn_net_addr_ser_t* keys, size_t count);
+int sync_span(unsigned int level, uint32_t index, const sn_net_addr_t* lo, const sn_net_addr_t* hi, sn_net_addr_t* out_lo, sn_net_addr_t* out_hi);
+int sync_inside(unsigned int level, uint32_t index, const sn_net_addr_t* lo, const sn_net_addr_t* hi);
+void sync_midpoint(const sn_net_addr_t* a, const sn_net_addr_t* b, sn_net_addr_t* out);
+void sync_successor(const sn_net_addr_t* addr, sn_net_addr_t* out);
+int sync_item_cmp(const void* a, const void* b);
+int sync_leaf_cmp(const void* a, const void* b);
+int object_request(sn_node_t* sns, sn_object_req_t* req, const sn_net_addr_t* key, const char* msgs, size_t count, size_t msg_len, uint64_t timeout_ms);
+int object_send(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* net_addr, const sn_wire_object_msg_t* header, uint8_t op, unsigned int index, size_t len, const char* fragment);
+int object_queue(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* net_addr, size_t len, const char* payload);
+void on_object_timer(int argc, void* argv[]);
+int object_position(unsigned int index);
+const sn_net_entry_t* object_place(sn_node_t* sns, const sn_net_addr_t* key, unsigned int index);
+size_t object_parts(const sn_wire_object_msg_t* msg);
+size_t object_part_len(const sn_wire_object_msg_t* msg);
+int object_keep(sn_node_t* sns, const sn_wire_object_msg_t* msg, size_t len);
+int object_whole(sn_node_t* sns, const sn_wire_object_msg_t* msg);
+void object_tick(sn_node_t* sns);
+int object_gather(sn_node_t* sns, const sn_wire_object_msg_t* msg);
+int object_lookup(sn_node_t* sns, const sn_wire_object_msg_t* msg);
+int object_piece(sn_object_req_t* req, const sn_wire_object_msg_t* msg, size_t len);
+int object_piece_whole(const sn_object_piece_t* p);
+size_t object_count(const sn_object_req_t* req, uint64_t version);
+void object_decode(sn_object_req_t* req, uint64_t version);
+void object_finish(sn_object_req_t* req, const char* value, unsigned long long len, const uint64_t* version);
+void on_object_reply(int argc, void* argv[]);
+void lookup_add(sn_lookup_t* lookup, const sn_net_entry_t* e);
+sn_lookup_contact_t* lookup_find(sn_lookup_t* lookup, const sn_net_addr_t* addr);
+void lookup_step(sn_lookup_t* lookup, uint64_t now);
+void lookup_finish(sn_lookup_t* lookup, const sn_net_entry_t* owner);
+void lookup_free(sn_lookup_t* lookup);
+void on_lookup_reply(int argc, void* argv[]);
+void on_lookup_timer(int argc, void* argv[]);
+void send_async_signed(int argc, void* argv[]);
+void on_join_reply(int argc, void* argv[]);
+void join_finish(sn_join_t* join, int status);
+void join_announce(sn_node_t* sns);
 
 int upcall_wrapper(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr);
 
@@ -39,68 +327,108 @@ void call_log_cb(sn_node_t* sns, char* packet);
 void call_forward_cb(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop);
 void call_deliver_cb(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr);
 
-int sn_node_register_reply(sn_node_t* sns, uint32_t reply_id, const sn_util_closure_t* closure, int once);
-int sn_node_call_reply(sn_node_t* sns, uint32_t reply_id, const char* reply_cnt, unsigned long long reply_cnt_len);
-
 int sn_node_at_socket(sn_node_t* sns, const sn_crypto_sign_key_t* sk, const sn_crypto_sign_pubkey_t* pk, const sn_io_sock_t socket, int check_sign) {
-    sn_io_naddr_t self_net;
+    return node_init(sns, NULL, NULL, sk, pk, socket, check_sign);
+}
 
-    assert(sns != NULL);
-    assert(sk != NULL || pk != NULL);
+int sn_node_at_runtime(sn_node_t* sns, sn_io_runtime_t* rt, const sn_crypto_sign_key_t* sk, const sn_crypto_sign_pubkey_t* pk, const sn_io_sock_t socket, int check_sign) {
+    assert(rt != NULL);
+
+    return node_init(sns, rt, NULL, sk, pk, socket, check_sign);
+}
+
+int sn_node_mux_init(sn_node_mux_t* mux, sn_io_runtime_t* rt, const sn_io_sock_t socket) {
+    sn_util_closure_t closure;
+    size_t i;
+
+    assert(mux != NULL);
+    assert(rt != NULL);
     assert(socket != SN_IO_SOCK_INVALID);
 
-    /* Copying */
+    mux->socket = socket;
+    mux->runtime = rt;
+    mux->primary = NULL;
+    mux->local_posted = 0;
+    mux->busy[0] = mux->busy[1] = 0;
+    mux->epoch = 0;
 
-    sns->check_sign = check_sign;
+    memset(mux->bufs, 0, sizeof(mux->bufs));
 
-    if(sk != NULL) {
-        sns->sign = 1;
-        sns->sk = *sk;
-    } else {
-        sns->sign = 0;
-    }
+    for(i = 0; i < SN_IO_SOCK_BATCH_LEN; ++i)
+        if((mux->bufs[i] = (sn_net_packet_t*)malloc(SN_NET_PACKET_BUF_LEN)) == NULL)
+            goto error_bufs;
 
-    if(pk != NULL)
-        sns->self = *((sn_net_addr_t*)pk);
-    else if(sk != NULL)
-        sn_crypto_sign_pk_from_sk(sk, (sn_crypto_sign_pubkey_t*)&sns->self);
-    else
-        return -1;
+    if(sn_io_sock_get_name(socket, &mux->self_net) != 0 || sn_io_sock_set_nonblocking(socket, 1) != 0)
+        goto error_bufs;
 
-    sns->socket = socket;
+    if(sn_data_hmap_init(&mux->identities, sizeof(sn_net_addr_t), sizeof(sn_node_t*)) != 0)
+        goto error_bufs;
 
-    /* Callback registering */
+    if(sn_data_vec_init(&mux->local, sizeof(sn_mux_local_t)) != 0)
+        goto error_identities;
 
-    sn_node_set_upcall(sns, NULL);
+    pthread_mutex_init(&mux->ident_mut, NULL);
+    pthread_mutex_init(&mux->local_mut, NULL);
+    pthread_cond_init(&mux->idle_cond, NULL);
 
-    void* log_argv[] = { "sndnet" };
-    sn_util_closure_init_curried(&sns->default_log_closure, sn_named_log_callback, 1, log_argv);
-    sn_node_set_log_callback(sns, NULL);
+    sn_util_closure_init_curried_once(&closure, on_mux_ready, mux);
 
-    /* Initializing */
+    if(sn_io_runtime_attach(rt, &mux->sock_src, socket, &closure) != 0)
+        goto error_locks;
 
-    if(sn_io_sock_get_name(socket, &self_net) != 0)
-        return -1;
+    return 0;
 
-    sn_net_router_init(&sns->router, &sns->self, &self_net);
+error_locks:
+    pthread_cond_destroy(&mux->idle_cond);
+    pthread_mutex_destroy(&mux->local_mut);
+    pthread_mutex_destroy(&mux->ident_mut);
+    sn_data_vec_destroy(&mux->local);
+error_identities:
+    sn_data_hmap_destroy(&mux->identities);
+error_bufs:
+    for(i = 0; i < SN_IO_SOCK_BATCH_LEN; ++i)
+        free(mux->bufs[i]);
+    return -1;
+}
 
-    /*Reply vector*/
+void sn_node_mux_destroy(sn_node_mux_t* mux) {
+    sn_mux_local_t local;
+    size_t i;
 
-    if(sn_data_vec_init(&sns->reply_vec, sizeof(sn_reply_sub_t)) != 0)
-        return -1;
+    assert(mux != NULL);
+    assert(sn_data_hmap_size(&mux->identities) == 0);
 
-    pthread_mutex_init(&sns->reply_mut, NULL);
+    sn_io_runtime_detach(mux->runtime, &mux->sock_src);
 
-    /* Background thread initialization */
+    /* A drain may still be running */
 
-    if(pthread_create(&(sns->bg_thrd), 0, background, sns)) {
-        sn_node_log(sns, "Error while starting thread");
-        pthread_mutex_destroy(&sns->reply_mut);
-        sn_data_vec_destroy(&sns->reply_vec);
-        return -1;
+    pthread_mutex_lock(&mux->local_mut);
+    while(mux->local_posted) {
+        pthread_mutex_unlock(&mux->local_mut);
+        sched_yield();
+        pthread_mutex_lock(&mux->local_mut);
     }
+    pthread_mutex_unlock(&mux->local_mut);
 
-    return 0;
+    for(i = 0; sn_data_vec_at(&mux->local, i, &local) == 0; ++i)
+        free(local.packet);
+
+    pthread_cond_destroy(&mux->idle_cond);
+    pthread_mutex_destroy(&mux->local_mut);
+    pthread_mutex_destroy(&mux->ident_mut);
+    sn_data_vec_destroy(&mux->local);
+    sn_data_hmap_destroy(&mux->identities);
+
+    for(i = 0; i < SN_IO_SOCK_BATCH_LEN; ++i)
+        free(mux->bufs[i]);
+
+    sn_io_sock_close(mux->socket);
+}
+
+int sn_node_at_mux(sn_node_t* sns, sn_node_mux_t* mux, const sn_crypto_sign_key_t* sk, const sn_crypto_sign_pubkey_t* pk, int check_sign) {
+    assert(mux != NULL);
+
+    return node_init(sns, mux->runtime, mux, sk, pk, mux->socket, check_sign);
 }
 
 int sn_node_at_port(sn_node_t* sns, const sn_crypto_sign_key_t* sk, const sn_crypto_sign_pubkey_t* pk, uint16_t port, int check_sign) {
@@ -130,17 +458,142 @@ error:
 void sn_node_destroy(sn_node_t* sns) {
     assert(sns != NULL);
 
-    /* Thread closing */
+    /* Signer closing, pending sends still use the socket */
+
+    sn_node_set_signers(sns, 0);
+
+    /* Loop closing */
+
+    if(sns->mux != NULL) {
+        mux_unregister(sns->mux, sns);
+        sn_io_reactor_timer_stop(sns->loop, &sns->maint_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->hedge_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->lookup_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->aggregate_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->object_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->reply_timer);
+    } else if(sns->runtime != NULL) {
+        sn_io_reactor_timer_stop(sns->loop, &sns->maint_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->hedge_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->lookup_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->aggregate_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->object_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->reply_timer);
+        sn_io_runtime_detach(sns->runtime, &sns->sock_src);
+    } else {
+        sn_io_reactor_stop(&sns->reactor);
+        pthread_join(sns->bg_thrd, 0);
+
+        sn_io_reactor_timer_stop(&sns->reactor, &sns->maint_timer);
+        sn_io_reactor_timer_stop(&sns->reactor, &sns->hedge_timer);
+        sn_io_reactor_timer_stop(&sns->reactor, &sns->lookup_timer);
+        sn_io_reactor_timer_stop(&sns->reactor, &sns->aggregate_timer);
+        sn_io_reactor_timer_stop(&sns->reactor, &sns->object_timer);
+        sn_io_reactor_timer_stop(&sns->reactor, &sns->reply_timer);
+        sn_io_reactor_remove(&sns->reactor, &sns->sock_src);
+        sn_io_reactor_destroy(&sns->reactor);
+    }
+
+    if(sns->recv_bufs != NULL) {
+        size_t i;
 
-    pthread_cancel(sns->bg_thrd);
-    pthread_join(sns->bg_thrd, 0);
+        for(i = 0; i < SN_IO_SOCK_BATCH_LEN; ++i)
+            free(sns->recv_bufs[i]);
 
+        free(sns->recv_bufs);
+    }
+
+    pthread_mutex_destroy(&sns->task_mut);
     pthread_mutex_destroy(&sns->reply_mut);
     sn_data_vec_destroy(&sns->reply_vec);
+    sn_net_router_destroy(&sns->router);
+
+    if(sns->geometry_state != &sns->router) {
+        sns->geometry->destroy(sns->geometry_state);
+        free(sns->geometry_state);
+    }
+
+    sn_net_detector_destroy(&sns->detector);
+    sn_data_hmap_destroy(&sns->repairs);
+    sn_data_hmap_destroy(&sns->learning);
+    pthread_mutex_destroy(&sns->shortcut_mut);
+    sn_data_hmap_destroy(&sns->shortcuts);
+
+    {
+        sn_hedge_t hedge;
+        size_t iter = 0;
+
+        while(sn_data_hmap_next(&sns->hedges, &iter, NULL, &hedge) == 0)
+            free(hedge.packet);
+    }
+
+    pthread_mutex_destroy(&sns->hedge_mut);
+    sn_data_hmap_destroy(&sns->hedges);
+    pthread_mutex_destroy(&sns->gossip_mut);
+    sn_data_hmap_destroy(&sns->rumors);
+    sn_data_hmap_destroy(&sns->heard);
+
+    /* Topic trees are left without telling the parents, their children time out */
+
+    {
+        sn_topic_t* t;
+        size_t iter = 0;
+
+        while(sn_data_hmap_next(&sns->topics, &iter, NULL, &t) == 0) {
+            sn_data_vec_destroy(&t->children);
+            free(t);
+        }
+
+        sn_data_hmap_destroy(&sns->topics);
+    }
+
+    /* Unfinished lookups are dropped without calling them back */
+
+    {
+        sn_lookup_t* lookup;
+        size_t i;
+
+        for(i = 0; sn_data_vec_at(&sns->lookups, i, &lookup) == 0; ++i)
+            lookup_free(lookup);
+    }
+
+    sn_data_vec_destroy(&sns->lookups);
+
+    /* So are pending aggregations, their parents give up on them */
+
+    {
+        sn_aggregate_t* a;
+        size_t iter = 0;
+
+        while(sn_data_hmap_next(&sns->aggregates, &iter, NULL, &a) == 0) {
+            free(a->asked);
+            free(a);
+        }
 
-    /* Socket closing */
+        sn_data_hmap_destroy(&sns->aggregates);
+    }
+
+    sn_data_store_destroy(&sns->store);
+    sn_data_merkle_destroy(&sns->merkle);
+    sn_data_store_destroy(&sns->fragments);
+    sn_data_cache_destroy(&sns->cache);
+
+    /* Object packets not sent yet are dropped */
+
+    {
+        sn_object_out_t out;
+        size_t i;
+
+        for(i = sns->object_out_next; sn_data_vec_at(&sns->object_out, i, &out) == 0; ++i)
+            free(out.packet);
+
+        sn_data_vec_destroy(&sns->object_out);
+    }
+
+    /* Socket closing, shared sockets are closed by their mux */
 
-    sn_io_sock_close(sns->socket);
+    if(sns->mux == NULL)
+        sn_io_sock_close(sns->socket);
 }
 
 void sn_node_set_upcall(sn_node_t* sns, sn_upcall_t upcall) {
@@ -204,202 +657,5845 @@ int sn_node_send(sn_node_t* sns, const sn_net_addr_t* dst, size_t len, const cha
 
 int sn_node_send_typed(sn_node_t* sns, const sn_net_addr_t* dst, uint8_t type, size_t len, const char* payload) {
     sn_net_packet_t* packet;
+    int ret;
 
     assert(sns != NULL);
     assert(dst != NULL);
     assert(payload != NULL || len == 0);
     assert(type < SN_WIRE_NET_TYPES);
 
-    packet = sn_net_packet_pack(dst, &sns->self, type, len, payload);
-
-    if(!packet)
+    if((packet = node_pack(sns, dst, type, len, payload)) == NULL)
         return -1;
 
-    if(sns->sign)
-        sn_net_packet_sign(packet, &sns->sk);
+    /* Signed on our own, routed with the loop closures held off */
 
-    if(forward(sns, packet, NULL) == -1)
-        return -1;
+    pthread_mutex_lock(&sns->task_mut);
+    ret = forward(sns, packet, NULL);
+    pthread_mutex_unlock(&sns->task_mut);
 
     free(packet);
 
-    return 0;
+    return ret == -1 ? -1 : 0;
 }
 
-int sn_node_join(sn_node_t* sns, const sn_io_naddr_t* gateway) {
+int sn_node_send_typed_locked(sn_node_t* sns, const sn_net_addr_t* dst, uint8_t type, size_t len, const char* payload) {
+    sn_net_packet_t* packet;
+    int ret;
+
     assert(sns != NULL);
-    assert(gateway != NULL);
+    assert(dst != NULL);
+    assert(payload != NULL || len == 0);
+    assert(type < SN_WIRE_NET_TYPES);
 
-    /*
-    Join steps:
-    1. Find m = owner(self)
-    2. Get m leafset
-    3. Fill our leafset
-    4. Inform m leafset of ourselves
-    5. Get traceroute to m
-    6. Construct routing table for m traceroute
-    */
+    if((packet = node_pack(sns, dst, type, len, payload)) == NULL)
+        return -1;
 
-    return 0;
-}
+    ret = forward(sns, packet, NULL);
 
-/*Private functions*/
+    free(packet);
 
-int deliver(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr) {
-    char packet_str[SN_NET_PACKET_PRINTABLE_LEN];
-    char rem_addr_str[SN_IO_NADDR_PRINTABLE_LEN];
-    sn_deliver_handler_t d_fn;
+    return ret == -1 ? -1 : 0;
+}
+
+sn_net_packet_t* node_pack(sn_node_t* sns, const sn_net_addr_t* dst, uint8_t type, size_t len, const char* payload) {
+    sn_net_packet_t* packet;
 
     assert(sns != NULL);
-    assert(packet != NULL);
+    assert(dst != NULL);
 
-    sn_net_packet_header_to_str(packet, packet_str);
+    packet = sn_net_packet_pack(dst, &sns->self, type, len, payload);
 
-    if(rem_addr != NULL)
-        sn_io_naddr_to_str(rem_addr, rem_addr_str);
-    else
-        strncpy(rem_addr_str, "THIS", SN_IO_NADDR_PRINTABLE_LEN);
+    if(packet && sns->sign)
+        sn_net_packet_sign(packet, &sns->sk);
 
-    sn_node_log(sns,
-        "packet deliver\n"
-        "came from %s\n"
-        "%s"
-        "\n%s\n",
-    rem_addr_str, packet_str, packet->payload);
+    return packet;
+}
 
-    //TODO: logic
+int sn_node_send_direct(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* net_addr, uint8_t type, size_t len, const char* payload) {
+    sn_net_packet_t* packet;
+    int ret;
 
-    if(packet->header.type >= SN_WIRE_NET_TYPES)
+    assert(sns != NULL);
+    assert(dst != NULL);
+    assert(net_addr != NULL);
+    assert(payload != NULL || len == 0);
+    assert(type < SN_WIRE_NET_TYPES);
+
+    packet = sn_net_packet_pack(dst, &sns->self, type, len, payload);
+
+    if(!packet)
         return -1;
 
-    d_fn = sn_default_deliver_handlers[packet->header.type];
+    if(sns->sign)
+        sn_net_packet_sign(packet, &sns->sk);
 
-    if(d_fn)
-        return d_fn(sns, packet, rem_addr);
+    ret = sn_net_packet_send(packet, sns->socket, net_addr) == -1 ? -1 : 0;
 
-    return 0;
+    free(packet);
+
+    return ret;
 }
 
-int forward(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr) {
-    char nh_str[SN_NET_ENTRY_PRINTABLE_LEN];
-    char src_str[SN_NET_ADDR_PRINTABLE_LEN];
-    char dst_str[SN_NET_ADDR_PRINTABLE_LEN];
-    char rem_addr_str[SN_IO_NADDR_PRINTABLE_LEN];
-    sn_net_addr_t src;
-    sn_net_addr_t dst;
-    sn_net_entry_t nexthop;
+int sn_node_send_hedged(sn_node_t* sns, const sn_net_addr_t* dst, uint8_t type, size_t len, const char* payload, uint32_t reply_id) {
+    sn_wire_hedged_header_t* header;
+    sn_net_packet_t* packet;
+    sn_net_entry_t primary;
+    sn_hedge_t hedge;
+    uint32_t id;
+    char* buf;
+    int ret;
 
     assert(sns != NULL);
-    assert(packet != NULL);
+    assert(dst != NULL);
+    assert(payload != NULL || len == 0);
+    assert(type < SN_WIRE_NET_TYPES);
 
-    sn_net_packet_get_src(packet, &src);
-    sn_net_addr_to_str(&src, src_str);
-    sn_net_packet_get_dst(packet, &dst);
-    sn_net_addr_to_str(&dst, dst_str);
+    /* Types handled on the way would see the copies twice */
 
-    if(rem_addr != NULL)
-        sn_io_naddr_to_str(rem_addr, rem_addr_str);
-    else
-        strncpy(rem_addr_str, "THIS", SN_IO_NADDR_PRINTABLE_LEN);
+    if(type == SN_WIRE_NET_TYPE_HEDGED || sn_default_forward_handlers[type] != NULL)
+        return -1;
 
-    if(!packet->header.ttl) {
-        sn_node_log(sns,
-        "packet without TTL\n"
-        "came from %s\n"
-        "src: %s\n"
-        "dst: %s\n",
-        rem_addr_str, src_str, dst_str);
+    if((buf = (char*)malloc(sizeof(*header) + len)) == NULL)
         return -1;
-    }
 
-    packet->header.ttl--;
+    header = (sn_wire_hedged_header_t*)buf;
+    memset(header, 0, sizeof(*header));
+    header->type = type;
+    randombytes_buf(header->nonce, sizeof(header->nonce));
 
-    sn_net_router_nexthop(&(sns->router), &dst, &nexthop);
-    sn_net_entry_to_str(&nexthop, nh_str, SN_NET_ADDR_HEX_LEN);
+    if(len)
+        memcpy(buf + sizeof(*header), payload, len);
 
-    if(nexthop.is_set) {
-        sn_forward_handler_t f_fn;
+    packet = sn_net_packet_pack(dst, &sns->self, SN_WIRE_NET_TYPE_HEDGED, sizeof(*header) + len, buf);
+    free(buf);
 
-        if(packet->header.type >= SN_WIRE_NET_TYPES)
-            return -1;
+    if(!packet)
+        return -1;
 
-        f_fn = sn_default_forward_handlers[packet->header.type];
+    if(sns->sign)
+        sn_net_packet_sign(packet, &sns->sk);
 
-        if(f_fn) {
-            if(f_fn(sns, packet, rem_addr, &nexthop) != 0)
-                return -1;
+    /* Delivered here, nothing to hedge. Routed with the loop closures held off, like any send */
 
-            if(!nexthop.is_set)
-                return deliver(sns, packet, rem_addr);
-        }
+    pthread_mutex_lock(&sns->task_mut);
 
-        if(sn_net_packet_send(packet, sns->socket, &nexthop.net_addr) == -1) {
-            sn_node_log(sns, "ERROR sending packet to %s\n", rem_addr_str);
-            return -1;
-        } else {
-            char packet_str[SN_NET_PACKET_PRINTABLE_LEN];
+    sn_node_nexthop(sns, dst, &primary);
 
-            sn_net_packet_header_to_str(packet, packet_str);
-        
-            sn_node_log(sns,
-            "packet forward\n"
-            "came from %s\n"
-            "%s"
-            "Forwarded to %s\n",
-            rem_addr_str, packet_str, nh_str);
+    if(primary.is_set && (hedge.packet = (sn_net_packet_t*)malloc(sizeof(sn_wire_net_header_t) + packet->header.len)) != NULL) {
+        memcpy(hedge.packet, packet, sizeof(sn_wire_net_header_t) + packet->header.len);
+        hedge.primary = primary.addr;
+        hedge.sent_ns = sn_util_time_ns();
+        hedge.reply_id = reply_id;
+
+        pthread_mutex_lock(&sns->hedge_mut);
+
+        id = reply_id ? reply_id : sn_node_new_reply_id(sns);
+        hedge.deadline = hedge.sent_ns/1000000 + sns->hedge_delay;
+
+        if(sn_data_hmap_size(&sns->hedges) >= SN_NODE_HEDGE_MAX_PENDING || sn_data_hmap_get(&sns->hedges, &id, NULL) == 0 ||
+                sn_data_hmap_put(&sns->hedges, &id, &hedge) != 0) {
+            free(hedge.packet);
+            primary.is_set = 0;
+        } else {
+            hedge_arm(sns, hedge.sent_ns/1000000);
         }
 
-        return 0;
+        pthread_mutex_unlock(&sns->hedge_mut);
     } else {
-        return deliver(sns, packet, rem_addr);
+        primary.is_set = 0;
     }
-}
 
-void* background(void* arg) {
-    sn_node_t* sns = (sn_node_t*)arg;
-    sn_io_naddr_t rem_addr;
-    sn_net_packet_t* packet;
+    ret = forward(sns, packet, NULL);
 
-    assert(sns != NULL);
+    pthread_mutex_unlock(&sns->task_mut);
 
-    do {
-        packet = sn_net_packet_recv(sns->socket, &rem_addr);
+    free(packet);
 
-        if(!packet)
+    if(ret == -1 && primary.is_set) {
+        /* The second copy goes right away */
+
+        pthread_mutex_lock(&sns->hedge_mut);
+
+        if(sn_data_hmap_get(&sns->hedges, &id, &hedge) == 0 && hedge.packet != NULL) {
+            hedge.deadline = 0;
+            sn_data_hmap_put(&sns->hedges, &id, &hedge);
+            hedge_arm(sns, sn_util_time_ms());
+            ret = 0;
+        }
+
+        pthread_mutex_unlock(&sns->hedge_mut);
+    }
+
+    return ret == -1 ? -1 : 0;
+}
+
+int sn_node_lookup(sn_node_t* sns, const sn_net_addr_t* target, unsigned int alpha, uint64_t timeout_ms, const sn_util_closure_t* done) {
+    sn_util_closure_t closure;
+    sn_net_entry_t nexthop;
+    sn_lookup_t* lookup;
+    unsigned int queries = 0;
+    int i, ret = 0;
+
+    assert(sns != NULL);
+    assert(target != NULL);
+    assert(done != NULL);
+
+    if(alpha == 0)
+        return -1;
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    sn_node_nexthop(sns, target, &nexthop);
+
+    /* Ours, answered right away(without the lock, it may start another lookup) */
+
+    if(!nexthop.is_set) {
+        pthread_mutex_unlock(&sns->task_mut);
+
+        {
+            sn_util_closure_t copy = *done;
+            void* argv[] = { &sns->router.self, &queries };
+
+            sn_util_closure_call(&copy, 2, argv);
+        }
+
+        return 0;
+    }
+
+    if((lookup = (sn_lookup_t*)malloc(sizeof(sn_lookup_t))) == NULL) {
+        pthread_mutex_unlock(&sns->task_mut);
+        return -1;
+    }
+
+    if(sn_data_vec_init(&lookup->rpcs, sizeof(sn_lookup_rpc_t*)) != 0) {
+        free(lookup);
+        pthread_mutex_unlock(&sns->task_mut);
+        return -1;
+    }
+
+    lookup->sns = sns;
+    lookup->target = *target;
+    lookup->done = *done;
+    lookup->contacts_len = 0;
+    lookup->alpha = alpha;
+    lookup->in_flight = lookup->listeners = lookup->queries = 0;
+    lookup->deadline = sn_util_time_ms() + timeout_ms;
+    lookup->finished = 0;
+
+    /* Seeded like a recursive route would start, plus the leafset */
+
+    lookup_add(lookup, &nexthop);
+
+    for(i = 0; i < SN_NET_ROUTER_LEAFSET_SIZE; ++i) {
+        lookup_add(lookup, &sns->router.left_leafset[i]);
+        lookup_add(lookup, &sns->router.right_leafset[i]);
+    }
+
+    if(sn_data_vec_push(&sns->lookups, &lookup) != 0) {
+        lookup_free(lookup);
+        ret = -1;
+    } else {
+        if(sn_data_vec_size(&sns->lookups) == 1) {
+            sn_util_closure_init_curried_once(&closure, on_lookup_timer, sns);
+            sn_io_reactor_timer_start(sns->loop, &sns->lookup_timer, SN_NODE_LOOKUP_TICK, SN_NODE_LOOKUP_TICK, &closure);
+        }
+
+        lookup_step(lookup, sn_util_time_ms());
+    }
+
+    pthread_mutex_unlock(&sns->task_mut);
+
+    return ret;
+}
+
+int sn_node_set_geometry(sn_node_t* sns, const sn_net_geometry_t* geometry) {
+    const sn_net_entry_t* e;
+    uint32_t incarnation;
+    void* state;
+    unsigned int l, c;
+    int p;
+
+    assert(sns != NULL);
+    assert(geometry != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    if(geometry == &sn_net_geometry_pastry) {
+        state = &sns->router;
+    } else {
+        if((state = malloc(geometry->state_size)) == NULL) {
+            pthread_mutex_unlock(&sns->task_mut);
+            return -1;
+        }
+
+        geometry->init(state, &sns->self, &sns->router.self.net_addr);
+
+        /* Everyone the router knows so far */
+
+        for(l = 0; l < SN_NET_ROUTER_LEVELS; ++l) {
+            for(c = 0; c < SN_NET_ROUTER_COLUMNS; ++c) {
+                if((e = sn_net_router_table_get(&sns->router, l, c))->is_set)
+                    geometry->add(state, &e->addr, &e->net_addr);
+            }
+        }
+
+        for(p = -SN_NET_ROUTER_LEAFSET_SIZE; p <= SN_NET_ROUTER_LEAFSET_SIZE; ++p) {
+            if(p != 0 && (e = sn_net_router_leafset_get(&sns->router, p))->is_set)
+                geometry->add(state, &e->addr, &e->net_addr);
+        }
+    }
+
+    if(sns->geometry_state != &sns->router) {
+        sns->geometry->destroy(sns->geometry_state);
+        free(sns->geometry_state);
+    }
+
+    sns->geometry = geometry;
+    sns->geometry_state = state;
+
+    /* Restarted nodes have a newer incarnation than the one that left */
+
+    if(geometry == &sn_net_geometry_onehop) {
+        pthread_mutex_lock(&sns->gossip_mut);
+        incarnation = sns->incarnation;
+        pthread_mutex_unlock(&sns->gossip_mut);
+
+        gossip_rumor(sns, &sns->router.self, incarnation);
+    }
+
+    pthread_mutex_unlock(&sns->task_mut);
+
+    return 0;
+}
+
+void sn_node_add_route(sn_node_t* sns, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr) {
+    assert(sns != NULL);
+    assert(addr != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+    sn_node_add_route_locked(sns, addr, net_addr);
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+void sn_node_add_route_locked(sn_node_t* sns, const sn_net_addr_t* addr, const sn_io_naddr_t* net_addr) {
+    assert(sns != NULL);
+    assert(addr != NULL);
+
+    /* We are no route to ourselves */
+
+    if(sn_net_addr_cmp(addr, &sns->self) == 0)
+        return;
+
+    sn_net_router_add(&sns->router, addr, net_addr);
+
+    if(sns->geometry == &sn_net_geometry_onehop) {
+        sn_net_members_t* members = (sn_net_members_t*)sns->geometry_state;
+        sn_net_entry_t e;
+        uint32_t incarnation;
+
+        /* New members are gossiped to the rest, unless they are known to have left */
+
+        if(sn_net_members_find(members, addr, NULL) == 0) {
+            sn_net_members_add(members, addr, net_addr);
+        } else if(gossip_admit(sns, addr, &incarnation) && sn_net_members_add(members, addr, net_addr) == 1) {
+            e.is_set = 1;
+            e.addr = *addr;
+            e.net_addr = *net_addr;
+
+            gossip_rumor(sns, &e, incarnation);
+        }
+    } else if(sns->geometry_state != &sns->router) {
+        sns->geometry->add(sns->geometry_state, addr, net_addr);
+    }
+}
+
+void sn_node_nexthop(const sn_node_t* sns, const sn_net_addr_t* dst, sn_net_entry_t* nexthop) {
+    assert(sns != NULL);
+    assert(dst != NULL);
+    assert(nexthop != NULL);
+
+    sns->geometry->nexthop(sns->geometry_state, dst, nexthop);
+}
+
+void sn_node_gossip_heard(sn_node_t* sns, const sn_net_entry_t* e, uint32_t incarnation) {
+    sn_net_members_t* members;
+    int refute = 0;
+
+    assert(sns != NULL);
+    assert(e != NULL);
+
+    if(sns->geometry != &sn_net_geometry_onehop)
+        return;
+
+    /* Someone thinks we left, tell everyone we did not with a newer incarnation */
+
+    if(sn_net_addr_cmp(&e->addr, &sns->self) == 0) {
+        pthread_mutex_lock(&sns->gossip_mut);
+
+        if(!e->is_set && incarnation >= sns->incarnation) {
+            sns->incarnation = incarnation + 1;
+            refute = 1;
+        }
+
+        incarnation = sns->incarnation;
+
+        pthread_mutex_unlock(&sns->gossip_mut);
+
+        if(refute)
+            gossip_rumor(sns, &sns->router.self, incarnation);
+
+        return;
+    }
+
+    if(!gossip_learn(sns, &e->addr, incarnation, e->is_set))
+        return;
+
+    /* News are spread further, by the route changes themselves if any */
+
+    members = (sn_net_members_t*)sns->geometry_state;
+
+    if(e->is_set && sn_net_members_find(members, &e->addr, NULL) != 0)
+        sn_node_add_route_locked(sns, &e->addr, &e->net_addr);
+    else if(!e->is_set && sn_net_members_find(members, &e->addr, NULL) == 0)
+        route_remove(sns, &e->addr);
+    else
+        gossip_rumor(sns, e, incarnation);
+}
+
+void sn_node_topic(const char* name, sn_net_addr_t* topic) {
+    unsigned char key[SN_NET_ADDR_LEN];
+
+    assert(name != NULL);
+    assert(topic != NULL);
+
+    crypto_generichash(key, sizeof(key), (const unsigned char*)name, strlen(name), NULL, 0);
+    sn_net_addr_init(topic, key);
+}
+
+int sn_node_subscribe(sn_node_t* sns, const sn_net_addr_t* topic, const sn_util_closure_t* on_publish) {
+    sn_topic_t* t;
+
+    assert(sns != NULL);
+    assert(topic != NULL);
+    assert(on_publish != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    if((t = topic_find(sns, topic)) == NULL && (t = topic_add(sns, topic, sn_util_time_ms())) == NULL) {
+        pthread_mutex_unlock(&sns->task_mut);
+        return -1;
+    }
+
+    t->on_publish = *on_publish;
+    t->subscribed = 1;
+
+    pthread_mutex_unlock(&sns->task_mut);
+
+    return 0;
+}
+
+int sn_node_unsubscribe(sn_node_t* sns, const sn_net_addr_t* topic) {
+    sn_topic_t* t;
+
+    assert(sns != NULL);
+    assert(topic != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    if((t = topic_find(sns, topic)) == NULL || !t->subscribed) {
+        pthread_mutex_unlock(&sns->task_mut);
+        return -1;
+    }
+
+    t->subscribed = 0;
+
+    if(sn_data_vec_size(&t->children) == 0)
+        topic_drop(sns, t);
+
+    pthread_mutex_unlock(&sns->task_mut);
+
+    return 0;
+}
+
+int sn_node_publish(sn_node_t* sns, const sn_net_addr_t* topic, size_t len, const char* msg) {
+    sn_wire_publish_header_t* header;
+    sn_net_packet_t* packet;
+    int ret;
+
+    assert(sns != NULL);
+    assert(topic != NULL);
+    assert(msg != NULL || len == 0);
+
+    if(len > SN_NET_PACKET_MAX_LEN - sizeof(*header))
+        return -1;
+
+    if((header = (sn_wire_publish_header_t*)malloc(sizeof(*header) + len)) == NULL)
+        return -1;
+
+    memset(header, 0, sizeof(*header));
+    sn_net_addr_ser(&sns->self, &header->publisher);
+    sn_net_addr_ser(topic, &header->topic);
+    memcpy(header + 1, msg, len);
+
+    pthread_mutex_lock(&sns->task_mut);
+    header->seq = sns->publish_seq++;
+    pthread_mutex_unlock(&sns->task_mut);
+
+    /* The publisher signs the topic, sequence number and message once, tree nodes only their copies */
+
+    if(sns->sign)
+        sn_crypto_sign(&sns->sk, (const unsigned char*)&header->topic, sizeof(*header) - offsetof(sn_wire_publish_header_t, topic) + len, &header->sign);
+
+    packet = sn_net_packet_pack(topic, &sns->self, SN_WIRE_NET_TYPE_PUBLISH, sizeof(*header) + len, (const char*)header);
+    free(header);
+
+    if(!packet)
+        return -1;
+
+    if(sns->sign)
+        sn_net_packet_sign(packet, &sns->sk);
+
+    /* Our branches get it from here, with the loop closures held off */
+
+    pthread_mutex_lock(&sns->task_mut);
+    ret = forward(sns, packet, NULL) == -1 ? -1 : 0;
+    pthread_mutex_unlock(&sns->task_mut);
+
+    free(packet);
+
+    return ret;
+}
+
+int sn_node_topic_heard(sn_node_t* sns, const sn_net_addr_t* topic, const sn_net_addr_t* child, const sn_io_naddr_t* net_addr, int leave) {
+    sn_topic_child_t c, known;
+    sn_topic_t* t;
+    uint64_t now;
+    size_t i;
+
+    assert(sns != NULL);
+    assert(topic != NULL);
+    assert(child != NULL);
+    assert(net_addr != NULL);
+
+    now = sn_util_time_ms();
+    t = topic_find(sns, topic);
+
+    if(leave) {
+        if(t == NULL)
+            return 0;
+
+        for(i = 0; sn_data_vec_at(&t->children, i, &c) == 0; ++i) {
+            if(sn_net_addr_cmp(&c.entry.addr, child) == 0) {
+                sn_data_vec_remove_at(&t->children, i, NULL);
+                break;
+            }
+        }
+
+        if(!t->subscribed && sn_data_vec_size(&t->children) == 0)
+            topic_drop(sns, t);
+
+        return 0;
+    }
+
+    if(sn_net_addr_cmp(child, &sns->self) == 0)
+        return -1;
+
+    if(t == NULL && (t = topic_add(sns, topic, now)) == NULL)
+        return -1;
+
+    /* Our parent taking us as its parent, routes disagree and the tree would loop */
+
+    if(t->parent.is_set && sn_net_addr_cmp(&t->parent.addr, child) == 0)
+        return -1;
+
+    c.entry.is_set = 1;
+    c.entry.addr = *child;
+    c.entry.net_addr = *net_addr;
+    c.expires = now + SN_NODE_TOPIC_CHILD_TTL;
+
+    /* Renewals replace the old entry */
+
+    for(i = 0; sn_data_vec_at(&t->children, i, &known) == 0; ++i) {
+        if(sn_net_addr_cmp(&known.entry.addr, child) == 0) {
+            sn_data_vec_remove_at(&t->children, i, NULL);
+            break;
+        }
+    }
+
+    return sn_data_vec_push(&t->children, &c);
+}
+
+int sn_node_topic_forward(sn_node_t* sns, sn_net_packet_t* packet, sn_net_entry_t* nexthop) {
+    const sn_wire_publish_header_t* header = (const sn_wire_publish_header_t*)packet->payload;
+    sn_net_addr_t src, topic;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    if(packet->header.len < sizeof(*header) || sn_net_addr_deser(&topic, &header->topic) != 0)
+        return -1;
+
+    /* DOWN copies are addressed to the topic but sent straight to the child, never routed */
+
+    if(header->flags & SN_WIRE_PUBLISH_DOWN) {
+        nexthop->is_set = 0;
+        return 0;
+    }
+
+    sn_net_packet_get_src(packet, &src);
+
+    if(topic_spread(sns, packet, &src) != 0)
+        return -1;
+
+    /* The next tree node leaves our branch out */
+
+    if(topic_find(sns, &topic) != NULL) {
+        sn_net_addr_ser(&sns->self, &packet->header.src);
+
+        if(sns->sign)
+            sn_net_packet_sign(packet, &sns->sk);
+    }
+
+    return 0;
+}
+
+int sn_node_topic_deliver(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_publish_header_t* header = (const sn_wire_publish_header_t*)packet->payload;
+    sn_net_addr_t src, dst, topic;
+    sn_topic_t* t;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(packet->header.len < sizeof(*header) || sn_net_addr_deser(&topic, &header->topic) != 0)
+        return -1;
+
+    sn_net_packet_get_src(packet, &src);
+    sn_net_packet_get_dst(packet, &dst);
+
+    /* Everything is addressed to the topic, DOWN copies are taken from our parent only and the rest reach us as the root */
+
+    if(sn_net_addr_cmp(&dst, &topic) != 0)
+        return -1;
+
+    if(header->flags & SN_WIRE_PUBLISH_DOWN) {
+        if((t = topic_find(sns, &topic)) == NULL || !t->parent.is_set || sn_net_addr_cmp(&t->parent.addr, &src) != 0 ||
+                rem_addr == NULL || sn_io_naddr_cmp(&t->parent.net_addr, rem_addr) != 0)
+            return -1;
+    }
+
+    return topic_spread(sns, packet, &src) < 0 ? -1 : 0;
+}
+
+void sn_node_set_broadcast_callback(sn_node_t* sns, const sn_util_closure_t* on_broadcast) {
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    if(on_broadcast != NULL)
+        sns->on_broadcast = *on_broadcast;
+    else
+        memset(&sns->on_broadcast, 0, sizeof(sns->on_broadcast));
+
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+int sn_node_broadcast(sn_node_t* sns, size_t len, const char* msg) {
+    unsigned char key[SN_NET_ADDR_LEN];
+    sn_net_addr_t lo, hi;
+
+    memset(key, 0, sizeof(key));
+    sn_net_addr_init(&lo, key);
+    memset(key, 0xff, sizeof(key));
+    sn_net_addr_init(&hi, key);
+
+    return sn_node_multicast_range(sns, &lo, &hi, len, msg);
+}
+
+int sn_node_multicast_range(sn_node_t* sns, const sn_net_addr_t* lo, const sn_net_addr_t* hi, size_t len, const char* msg) {
+    sn_wire_broadcast_header_t* header;
+    unsigned long long msg_len = len;
+    void* argv[3];
+    int ret;
+
+    assert(sns != NULL);
+    assert(lo != NULL);
+    assert(hi != NULL);
+    assert(msg != NULL || len == 0);
+
+    if(sn_net_addr_cmp(lo, hi) > 0 || len > SN_NET_PACKET_MAX_LEN - sizeof(*header))
+        return -1;
+
+    if((header = (sn_wire_broadcast_header_t*)malloc(sizeof(*header) + len)) == NULL)
+        return -1;
+
+    /* The origin signs the range and the message once, relays only sign their copies */
+
+    memset(header, 0, sizeof(*header));
+    sn_net_addr_ser(&sns->self, &header->origin);
+    sn_net_addr_ser(lo, &header->lo);
+    sn_net_addr_ser(hi, &header->hi);
+    memcpy(header + 1, msg, len);
+
+    if(sns->sign)
+        sn_crypto_sign(&sns->sk, (const unsigned char*)&header->lo, sizeof(*header) - offsetof(sn_wire_broadcast_header_t, lo) + len, &header->sign);
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    ret = broadcast_split(sns, header, len, msg);
+
+    if(sn_net_addr_cmp(lo, &sns->self) <= 0 && sn_net_addr_cmp(&sns->self, hi) <= 0 && sns->on_broadcast.body != NULL) {
+        argv[0] = &sns->self;
+        argv[1] = (void*)msg;
+        argv[2] = &msg_len;
+
+        sn_util_closure_call(&sns->on_broadcast, 3, argv);
+    }
+
+    pthread_mutex_unlock(&sns->task_mut);
+
+    free(header);
+
+    return ret;
+}
+
+int sn_node_broadcast_heard(sn_node_t* sns, const sn_net_packet_t* packet) {
+    const sn_wire_broadcast_header_t* header = (const sn_wire_broadcast_header_t*)packet->payload;
+    sn_net_addr_t origin, lo, hi;
+    unsigned long long len;
+    void* argv[3];
+    int ret;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(packet->header.len < sizeof(*header) || header->level > SN_NET_ROUTER_LEVELS)
+        return -1;
+
+    len = packet->header.len - sizeof(*header);
+
+    if(sns->check_sign && sn_crypto_sign_check(&header->sign, (const sn_crypto_sign_pubkey_t*)&header->origin,
+            (const unsigned char*)&header->lo, sizeof(*header) - offsetof(sn_wire_broadcast_header_t, lo) + len) != 0)
+        return -1;
+
+    if(sn_net_addr_deser(&origin, &header->origin) != 0 || sn_net_addr_deser(&lo, &header->lo) != 0 || sn_net_addr_deser(&hi, &header->hi) != 0)
+        return -1;
+
+    ret = broadcast_split(sns, header, (size_t)len, (const char*)(header + 1));
+
+    if(sn_net_addr_cmp(&lo, &sns->self) <= 0 && sn_net_addr_cmp(&sns->self, &hi) <= 0 && sns->on_broadcast.body != NULL) {
+        argv[0] = &origin;
+        argv[1] = (void*)(header + 1);
+        argv[2] = &len;
+
+        sn_util_closure_call(&sns->on_broadcast, 3, argv);
+    }
+
+    return ret;
+}
+
+int sn_node_aggregate(sn_node_t* sns, uint8_t metric, uint64_t timeout_ms, const sn_util_closure_t* done) {
+    sn_aggregate_t* a;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(done != NULL);
+
+    if(metric >= SN_NODE_METRICS || (a = (sn_aggregate_t*)malloc(sizeof(sn_aggregate_t))) == NULL)
+        return -1;
+
+    a->parent.is_set = 0;
+    a->parent_id = 0;
+    a->metric = metric;
+    a->done = *done;
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    if(aggregate_start(sns, a, 0, timeout_ms) != 0)
+        ret = -1;
+
+    pthread_mutex_unlock(&sns->task_mut);
+
+    return ret;
+}
+
+int sn_node_aggregate_heard(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_aggregate_msg_t* msg = (const sn_wire_aggregate_msg_t*)packet->payload;
+    sn_aggregate_t* a;
+    sn_net_addr_t src;
+    size_t i;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(packet->header.len < sizeof(*msg) || rem_addr == NULL)
+        return -1;
+
+    if(msg->flags & SN_WIRE_AGGREGATE_RESULT) {
+        /* Late results, for aggregations already given up on, are dropped */
+
+        if(packet->header.len < sizeof(*msg) + sizeof(sn_wire_aggregate_result_t))
+            return -1;
+
+        if(sn_data_hmap_get(&sns->aggregates, &msg->query_id, &a) != 0)
+            return 0;
+
+        /* One result from each child asked, anyone else or a repeat is ignored */
+
+        sn_net_packet_get_src(packet, &src);
+
+        for(i = 0; i < a->pending && sn_net_addr_cmp(&a->asked[i], &src) != 0; ++i)
+            ;
+
+        if(i == a->pending)
+            return -1;
+
+        a->asked[i] = a->asked[a->pending - 1];
+        aggregate_merge(&a->result, (const sn_wire_aggregate_result_t*)(msg + 1));
+
+        if(--a->pending == 0) {
+            sn_data_hmap_remove(&sns->aggregates, &msg->query_id, NULL);
+            aggregate_finish(sns, a);
+        }
+
+        return 0;
+    }
+
+    if(msg->metric >= SN_NODE_METRICS || msg->level > SN_NET_ROUTER_LEVELS)
+        return -1;
+
+    if((a = (sn_aggregate_t*)malloc(sizeof(sn_aggregate_t))) == NULL)
+        return -1;
+
+    a->parent.is_set = 1;
+    sn_net_packet_get_src(packet, &a->parent.addr);
+    a->parent.net_addr = *rem_addr;
+    a->parent_id = msg->query_id;
+    a->metric = msg->metric;
+
+    return aggregate_start(sns, a, msg->level, msg->budget);
+}
+
+int sn_node_put(sn_node_t* sns, const sn_net_addr_t* key, size_t len, const char* value, uint64_t timeout_ms, const sn_util_closure_t* done) {
+    return store_request(sns, SN_WIRE_STORE_PUT, key, len, value, timeout_ms, done);
+}
+
+int sn_node_get(sn_node_t* sns, const sn_net_addr_t* key, uint64_t timeout_ms, const sn_util_closure_t* done) {
+    return store_request(sns, SN_WIRE_STORE_GET, key, 0, NULL, timeout_ms, done);
+}
+
+int sn_node_store_holds(sn_node_t* sns, const sn_net_addr_t* key) {
+    assert(sns != NULL);
+    assert(key != NULL);
+
+    return store_replicates(sns, key) && sn_data_store_get(&sns->store, key, NULL) == 0;
+}
+
+int sn_node_store_heard(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_store_msg_t* msg = (const sn_wire_store_msg_t*)packet->payload;
+    sn_data_store_item_t item;
+    sn_net_addr_t key, src;
+    uint64_t version;
+    size_t len;
+    int found;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(packet->header.len < sizeof(*msg) || sn_net_addr_deser(&key, &msg->key) != 0)
+        return -1;
+
+    sn_net_packet_get_src(packet, &src);
+    len = packet->header.len - sizeof(*msg);
+    found = sn_data_store_get(&sns->store, &key, &item) == 0;
+
+    switch(msg->op) {
+        case SN_WIRE_STORE_PUT:
+            /*
+            Delivered here, we own the key. Stamped with the wall clock like objects are, so owners
+            taking over a key without its copy still write over the versions its replicas hold
+            */
+
+            version = sn_util_time_real_ns();
+
+            if(found && item.version >= version)
+                version = item.version + 1;
+
+            if(store_keep(sns, &key, (const char*)(msg + 1), len, version) != 0 ||
+                    sn_data_store_get(&sns->store, &key, &item) != 0)
+                return -1;
+
+            ++sns->stats.store_puts;
+            store_replicate(sns, &key, &item);
+
+            return store_answer(sns, &src, rem_addr, SN_WIRE_STORE_ACK, msg->reply_to, &key, version, 0, NULL);
+        case SN_WIRE_STORE_REPLICA:
+            /* Only leafset neighbors replicate here, and only keys we replicate */
+
+            if(!store_replicates(sns, &key) || !store_neighbor(sns, &src))
+                return -1;
+
+            /* Replicas overtaken on the way are dropped */
+
+            if(found) {
+                unsigned char ours[SN_DATA_MERKLE_DIGEST_LEN], theirs[SN_DATA_MERKLE_DIGEST_LEN];
+
+                sn_data_merkle_item(key.key, SN_NET_ADDR_LEN, item.version, item.value, item.len, ours);
+                sn_data_merkle_item(key.key, SN_NET_ADDR_LEN, msg->version, (const char*)(msg + 1), len, theirs);
+
+                if(store_order(item.version, ours, msg->version, theirs) >= 0)
+                    return 0;
+            }
+
+            if(store_keep(sns, &key, (const char*)(msg + 1), len, msg->version) != 0)
+                return -1;
+
+            ++sns->stats.store_replicas;
+
+            return 0;
+        case SN_WIRE_STORE_GET:
+            ++sns->stats.store_gets;
+
+            if(found)
+                return store_answer(sns, &src, rem_addr, SN_WIRE_STORE_VALUE, msg->reply_to, &key, item.version, item.len, item.value);
+
+            return store_answer(sns, &src, rem_addr, SN_WIRE_STORE_MISS, msg->reply_to, &key, 0, 0, NULL);
+        case SN_WIRE_STORE_ACK:
+        case SN_WIRE_STORE_VALUE:
+        case SN_WIRE_STORE_MISS:
+            return sn_node_call_reply(sns, msg->reply_to, (const char*)packet->payload, packet->header.len, &src);
+        default:
+            return -1;
+    }
+}
+
+int sn_node_sync(sn_node_t* sns) {
+    int ret;
+
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+    ret = sync_start(sns);
+    pthread_mutex_unlock(&sns->task_mut);
+
+    return ret;
+}
+
+int sn_node_sync_heard(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_sync_header_t* header = (const sn_wire_sync_header_t*)packet->payload;
+    sn_net_addr_t src, lo, hi;
+    size_t entry_size;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(packet->header.len < sizeof(*header) || rem_addr == NULL)
+        return -1;
+
+    switch(header->op) {
+        case SN_WIRE_SYNC_DIGESTS:
+            entry_size = sizeof(sn_wire_sync_digest_t);
+            break;
+        case SN_WIRE_SYNC_ITEMS:
+            entry_size = sizeof(sn_wire_sync_item_t);
+            break;
+        case SN_WIRE_SYNC_WANT:
+            entry_size = sizeof(sn_net_addr_ser_t);
+            break;
+        default:
+            return -1;
+    }
+
+    if(packet->header.len < sizeof(*header) + header->count*entry_size)
+        return -1;
+
+    if(sn_net_addr_deser(&lo, &header->lo) != 0 || sn_net_addr_deser(&hi, &header->hi) != 0 || sn_net_addr_cmp(&lo, &hi) > 0)
+        return -1;
+
+    sn_net_packet_get_src(packet, &src);
+
+    /* Answers go straight back, the sender is a leafset neighbor */
+
+    switch(header->op) {
+        case SN_WIRE_SYNC_DIGESTS:
+            return sync_digests(sns, &src, rem_addr, &lo, &hi, (const sn_wire_sync_digest_t*)(header + 1), header->count);
+        case SN_WIRE_SYNC_ITEMS:
+            return sync_items(sns, &src, rem_addr, &lo, &hi, (const sn_wire_sync_item_t*)(header + 1), header->count);
+        default:
+            return sync_want(sns, &src, rem_addr, (const sn_net_addr_ser_t*)(header + 1), header->count);
+    }
+}
+
+int sn_node_object_put(sn_node_t* sns, const sn_net_addr_t* key, size_t len, const char* value, uint64_t timeout_ms, const sn_util_closure_t* done) {
+    const unsigned int k = SN_NODE_OBJECT_DATA, n = SN_NODE_OBJECT_DATA + SN_NODE_OBJECT_PARITY;
+    const unsigned char* data[SN_NODE_OBJECT_DATA];
+    unsigned char* parity[SN_NODE_OBJECT_PARITY];
+    sn_wire_object_msg_t* msg;
+    sn_object_req_t* req;
+    size_t frag_len, msg_len, parts, i, p;
+    unsigned char* fragments;
+    char* msgs;
+    int ret;
+
+    assert(sns != NULL);
+    assert(key != NULL);
+    assert(value != NULL || len == 0);
+    assert(done != NULL);
+
+    if(len > SN_NODE_OBJECT_MAX_LEN)
+        return -1;
+
+    frag_len = (len + k - 1)/k;
+    parts = frag_len ? (frag_len + SN_NODE_OBJECT_PART_MAX - 1)/SN_NODE_OBJECT_PART_MAX : 1;
+    msg_len = sizeof(sn_wire_object_msg_t) + SN_NODE_OBJECT_PART_MAX;
+
+    if((req = (sn_object_req_t*)malloc(sizeof(sn_object_req_t))) == NULL)
+        return -1;
+
+    /* The last data fragment zero padded */
+
+    fragments = (unsigned char*)calloc(n, frag_len + 1);
+    msgs = (char*)calloc(n*parts, msg_len);
+
+    if(fragments == NULL || msgs == NULL) {
+        free(fragments);
+        free(msgs);
+        free(req);
+        return -1;
+    }
+
+    memcpy(fragments, value, len);
+
+    for(i = 0; i < k; ++i)
+        data[i] = fragments + i*frag_len;
+
+    for(i = k; i < n; ++i)
+        parity[i - k] = fragments + i*frag_len;
+
+    sn_data_erasure_encode(&sns->code, data, parity, frag_len);
+
+    req->op = SN_WIRE_OBJECT_STORE;
+    req->reply_id = sn_node_new_reply_id(sns);
+    req->version = sn_util_time_real_ns();
+    req->done = *done;
+
+    /* Every part of every fragment in its own message */
+
+    for(i = 0; i < n; ++i) {
+        for(p = 0; p < parts; ++p) {
+            msg = (sn_wire_object_msg_t*)(msgs + (i*parts + p)*msg_len);
+            msg->op = SN_WIRE_OBJECT_STORE;
+            msg->index = (uint8_t)i;
+            msg->data = SN_NODE_OBJECT_DATA;
+            msg->parity = SN_NODE_OBJECT_PARITY;
+            msg->reply_to = req->reply_id;
+            msg->version = req->version;
+            msg->len = (uint32_t)len;
+            msg->part = (uint32_t)p;
+            sn_net_addr_ser(key, &msg->key);
+            sn_net_addr_ser(&sns->self, &msg->origin);
+
+            memcpy(msg + 1, fragments + i*frag_len + p*SN_NODE_OBJECT_PART_MAX, object_part_len(msg));
+        }
+    }
+
+    ret = object_request(sns, req, key, msgs, n*parts, msg_len, timeout_ms);
+
+    free(fragments);
+    free(msgs);
+
+    return ret;
+}
+
+int sn_node_object_get(sn_node_t* sns, const sn_net_addr_t* key, uint64_t timeout_ms, const sn_util_closure_t* done) {
+    sn_wire_object_msg_t msg;
+    sn_object_req_t* req;
+
+    assert(sns != NULL);
+    assert(key != NULL);
+    assert(done != NULL);
+
+    if((req = (sn_object_req_t*)malloc(sizeof(sn_object_req_t))) == NULL)
+        return -1;
+
+    req->op = SN_WIRE_OBJECT_FETCH;
+    req->reply_id = sn_node_new_reply_id(sns);
+    req->version = 0;
+    req->done = *done;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.op = SN_WIRE_OBJECT_FETCH;
+    msg.data = SN_NODE_OBJECT_DATA;
+    msg.parity = SN_NODE_OBJECT_PARITY;
+    msg.reply_to = req->reply_id;
+    sn_net_addr_ser(key, &msg.key);
+    sn_net_addr_ser(&sns->self, &msg.origin);
+
+    return object_request(sns, req, key, (const char*)&msg, 1, sizeof(msg), timeout_ms);
+}
+
+int sn_node_object_heard(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_object_msg_t* msg = (const sn_wire_object_msg_t*)packet->payload;
+    const sn_net_entry_t* holder;
+    sn_net_addr_t origin, key;
+    size_t len;
+    int kept;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    SN_UNUSED(rem_addr);
+
+    if(packet->header.len < sizeof(*msg) || msg->data == 0 || msg->index >= msg->data + msg->parity)
+        return -1;
+
+    len = packet->header.len - sizeof(*msg);
+
+    switch(msg->op) {
+        case SN_WIRE_OBJECT_STORE:
+        case SN_WIRE_OBJECT_PLACE:
+            /* Stores are delivered to the key owner, which places them on their holder or keeps them */
+
+            if(sn_net_addr_deser(&key, &msg->key) != 0)
+                return -1;
+
+            if(msg->op == SN_WIRE_OBJECT_STORE && (holder = object_place(sns, &key, msg->index)) != NULL)
+                return object_send(sns, &holder->addr, &holder->net_addr, msg, SN_WIRE_OBJECT_PLACE, msg->index, len, (const char*)(msg + 1));
+
+            if(msg->len > SN_NODE_OBJECT_MAX_LEN || msg->part >= object_parts(msg) || len != object_part_len(msg) ||
+                    sn_net_addr_deser(&origin, &msg->origin) != 0 || (kept = object_keep(sns, msg, len)) < 0)
+                return -1;
+
+            /* Answered once, when the last part makes the fragment whole. Moved fragments are not */
+
+            if(!kept || !object_whole(sns, msg))
+                return 0;
+
+            ++sns->stats.object_fragments;
+
+            if(msg->reply_to == 0)
+                return 0;
+
+            return object_send(sns, &origin, NULL, msg, SN_WIRE_OBJECT_STORED, msg->index, 0, NULL);
+        case SN_WIRE_OBJECT_FETCH:
+            return object_gather(sns, msg);
+        case SN_WIRE_OBJECT_GATHER:
+            return object_lookup(sns, msg);
+        case SN_WIRE_OBJECT_STORED:
+        case SN_WIRE_OBJECT_FRAGMENT:
+        case SN_WIRE_OBJECT_MISSING:
+            sn_net_packet_get_src(packet, &origin);
+
+            return sn_node_call_reply(sns, msg->reply_to, (const char*)packet->payload, packet->header.len, &origin);
+        default:
+            return -1;
+    }
+}
+
+void sn_node_set_path_cache(sn_node_t* sns, int enable) {
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+    sns->path_cache = enable;
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+int sn_node_cache_heard(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    const sn_wire_store_msg_t* msg = (const sn_wire_store_msg_t*)packet->payload;
+    sn_data_cache_item_t item;
+    sn_net_addr_t key, src, dst;
+    uint64_t now, id;
+    size_t i;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if(!sns->path_cache || packet->header.len < sizeof(*msg) || sn_net_addr_deser(&key, &msg->key) != 0)
+        return 0;
+
+    now = sn_util_time_ms();
+
+    switch(msg->op) {
+        case SN_WIRE_STORE_VALUE:
+            /* Only answers to the gets we forwarded, the latest one replaces our copy */
+
+            sn_net_packet_get_dst(packet, &dst);
+            id = cache_get_id(&dst, &key, msg->reply_to);
+
+            for(i = 0; i < SN_NODE_CACHE_GETS && sns->cache_gets[i] != id; ++i);
+
+            if(i == SN_NODE_CACHE_GETS)
+                return 0;
+
+            sns->cache_gets[i] = 0;
+            sn_data_cache_remove(&sns->cache, &key);
+
+            if(sn_data_cache_put(&sns->cache, &key, (const char*)(msg + 1), packet->header.len - sizeof(*msg), msg->version, now + SN_NODE_CACHE_TTL) == 0)
+                ++sns->stats.cache_fills;
+
+            return 0;
+        case SN_WIRE_STORE_PUT:
+            /* Our copy is about to be replaced */
+
+            sn_data_cache_remove(&sns->cache, &key);
+
+            return 0;
+        case SN_WIRE_STORE_GET:
+            sn_net_packet_get_src(packet, &src);
+
+            /* Its answer is cached on its way back */
+
+            if(sn_data_cache_get(&sns->cache, &key, now, &item) != 0) {
+                sns->cache_gets[sns->cache_gets_next] = cache_get_id(&src, &key, msg->reply_to);
+                sns->cache_gets_next = (sns->cache_gets_next + 1)%SN_NODE_CACHE_GETS;
+
+                return 0;
+            }
+
+            /* Answered like a replica would, the value fills the caches on its way back */
+
+            if(store_answer(sns, &src, rem_addr, SN_WIRE_STORE_VALUE, msg->reply_to, &key, item.version, item.len, item.value) != 0)
+                return -1;
+
+            ++sns->stats.cache_hits;
+
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+uint64_t cache_get_id(const sn_net_addr_t* src, const sn_net_addr_t* key, uint32_t reply_to) {
+    unsigned char raw[2*sizeof(sn_net_addr_t) + sizeof(uint32_t)];
+    uint64_t id;
+
+    memcpy(raw, src, sizeof(*src));
+    memcpy(raw + sizeof(*src), key, sizeof(*key));
+    memcpy(raw + 2*sizeof(*src), &reply_to, sizeof(reply_to));
+
+    id = sn_data_hmap_hash(raw, sizeof(raw));
+
+    /* 0 marks free slots */
+
+    return id + !id;
+}
+
+int sn_node_dedup(sn_node_t* sns, const sn_net_addr_t* src, const unsigned char nonce[8]) {
+    uint64_t key;
+    size_t i;
+
+    assert(sns != NULL);
+    assert(src != NULL);
+    assert(nonce != NULL);
+
+    memcpy(&key, nonce, sizeof(key));
+    key ^= sn_data_hmap_hash(src, sizeof(*src));
+    key += !key;
+
+    for(i = 0; i < SN_NODE_DEDUP_LEN; ++i) {
+        if(sns->dedup[i] == key) {
+            ++sns->stats.duplicates;
+            return 1;
+        }
+    }
+
+    sns->dedup[sns->dedup_next] = key;
+    sns->dedup_next = (sns->dedup_next + 1)%SN_NODE_DEDUP_LEN;
+
+    return 0;
+}
+
+int sn_node_set_signers(sn_node_t* sns, unsigned int workers) {
+    sn_net_signer_t* signer = NULL;
+
+    assert(sns != NULL);
+
+    if(workers > 0) {
+        if(!sns->sign)
+            return -1;
+
+        signer = (sn_net_signer_t*)malloc(sizeof(sn_net_signer_t));
+
+        if(signer == NULL)
+            return -1;
+
+        if(sn_net_signer_init(signer, &sns->sk, workers) != 0) {
+            free(signer);
+            return -1;
+        }
+    }
+
+    if(sns->signer) {
+        sn_net_signer_destroy(sns->signer);
+        free(sns->signer);
+    }
+
+    sns->signer = signer;
+
+    return 0;
+}
+
+int sn_node_send_async(sn_node_t* sns, const sn_net_addr_t* dst, uint8_t type, size_t len, const char* payload, const sn_util_closure_t* done) {
+    sn_net_packet_t* packet;
+    sn_send_async_t* ctx;
+    sn_util_closure_t signed_closure;
+
+    assert(sns != NULL);
+    assert(dst != NULL);
+    assert(payload != NULL || len == 0);
+    assert(type < SN_WIRE_NET_TYPES);
+
+    packet = sn_net_packet_pack(dst, &sns->self, type, len, payload);
+
+    if(!packet)
+        return -1;
+
+    ctx = (sn_send_async_t*)malloc(sizeof(sn_send_async_t));
+
+    if(!ctx) {
+        free(packet);
+        return -1;
+    }
+
+    ctx->sns = sns;
+    ctx->has_done = done != NULL;
+
+    if(done != NULL)
+        ctx->done = *done;
+
+    sn_util_closure_init_curried_once(&signed_closure, send_async_signed, ctx);
+
+    if(sns->signer == NULL) {
+        void* argv[] = { packet };
+
+        if(sns->sign)
+            sn_net_packet_sign(packet, &sns->sk);
+
+        sn_util_closure_call(&signed_closure, 1, argv);
+
+        return 0;
+    }
+
+    if(sn_net_signer_submit(sns->signer, packet, &signed_closure) != 0) {
+        free(ctx);
+        free(packet);
+        return -1;
+    }
+
+    return 0;
+}
+
+int sn_node_send_many(sn_node_t* sns, const sn_node_msg_t msgs[], size_t count) {
+    sn_net_packet_t** packets;
+    size_t i;
+    int ret = -1;
+
+    assert(sns != NULL);
+    assert(msgs != NULL || count == 0);
+
+    if(count == 0)
+        return 0;
+
+    packets = (sn_net_packet_t**)calloc(count, sizeof(sn_net_packet_t*));
+
+    if(!packets)
+        return -1;
+
+    for(i = 0; i < count; ++i) {
+        assert(msgs[i].dst != NULL);
+        assert(msgs[i].payload != NULL || msgs[i].len == 0);
+        assert(msgs[i].type < SN_WIRE_NET_TYPES);
+
+        packets[i] = sn_net_packet_pack(msgs[i].dst, &sns->self, msgs[i].type, msgs[i].len, msgs[i].payload);
+
+        if(!packets[i])
+            goto cleanup;
+    }
+
+    if(sns->signer) {
+        if(sn_net_signer_sign_many(sns->signer, packets, count) != 0)
+            goto cleanup;
+    } else if(sns->sign) {
+        for(i = 0; i < count; ++i)
+            sn_net_packet_sign(packets[i], &sns->sk);
+    }
+
+    pthread_mutex_lock(&sns->task_mut);
+    ret = forward_many(sns, packets, count);
+    pthread_mutex_unlock(&sns->task_mut);
+
+cleanup:
+    for(i = 0; i < count; ++i)
+        free(packets[i]);
+
+    free(packets);
+
+    return ret;
+}
+
+int sn_node_set_busy_poll(sn_node_t* sns, unsigned int idle_us) {
+    sn_util_closure_t wakeup;
+
+    assert(sns != NULL);
+
+    if(sns->runtime != NULL)
+        return -1;
+
+    if(idle_us && sns->recv_bufs == NULL) {
+        sn_net_packet_t** bufs;
+        size_t i;
+
+        if((bufs = (sn_net_packet_t**)calloc(SN_IO_SOCK_BATCH_LEN, sizeof(sn_net_packet_t*))) == NULL)
+            return -1;
+
+        for(i = 0; i < SN_IO_SOCK_BATCH_LEN; ++i) {
+            if((bufs[i] = (sn_net_packet_t*)malloc(SN_NET_PACKET_BUF_LEN)) == NULL) {
+                while(i--)
+                    free(bufs[i]);
+
+                free(bufs);
+                return -1;
+            }
+        }
+
+        /* Published before the flag, the loop only reads them while busy polling */
+
+        sns->recv_bufs = bufs;
+        mint_thread_fence_release();
+    }
+
+    /* Best effort, needs kernel support */
+
+    sn_io_sock_set_busy_poll(sns->socket, idle_us ? SN_NODE_BUSY_POLL_SOCK_US : 0);
+
+    mint_store_32_relaxed(&sns->busy_idle_us, idle_us);
+
+    /* Wakes a blocked loop up so it sees the new mode */
+
+    sn_util_closure_init(&wakeup, node_noop);
+
+    return sn_io_reactor_post(sns->loop, &wakeup);
+}
+
+int sn_node_set_rx_telemetry(sn_node_t* sns, int enable) {
+    assert(sns != NULL);
+
+    return sn_io_sock_set_rx_info(sns->mux != NULL ? sns->mux->socket : sns->socket, enable);
+}
+
+int sn_node_repair(sn_node_t* sns, unsigned int level, unsigned int column, const sn_net_addr_t* dead) {
+    const sn_net_entry_t* e;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(dead != NULL);
+
+    if(level >= SN_NET_ROUTER_LEVELS || column >= SN_NET_ROUTER_COLUMNS)
+        return -1;
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    e = sn_net_router_table_get(&sns->router, level, column);
+
+    /* Another entry(the repaired one) holds the slot already */
+
+    if(!e->is_set || sn_net_addr_cmp(&e->addr, dead) == 0) {
+        if(e->is_set)
+            route_remove(sns, dead);
+
+        ret = repair_start(sns, level, column, dead, sn_util_time_ms());
+    }
+
+    pthread_mutex_unlock(&sns->task_mut);
+
+    return ret;
+}
+
+void sn_node_set_learning(sn_node_t* sns, int enable) {
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+    sns->learn = enable;
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+void sn_node_set_shortcuts(sn_node_t* sns, int enable) {
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->shortcut_mut);
+    sns->shortcut = enable;
+    pthread_mutex_unlock(&sns->shortcut_mut);
+}
+
+int sn_node_add_shortcut(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* net_addr, uint8_t hops) {
+    sn_shortcut_t sc;
+    int ret = -1;
+
+    assert(sns != NULL);
+    assert(dst != NULL);
+    assert(net_addr != NULL);
+
+    pthread_mutex_lock(&sns->shortcut_mut);
+
+    if(sn_data_hmap_get(&sns->shortcuts, dst, &sc) == 0 || sn_data_hmap_size(&sns->shortcuts) < SN_NODE_SHORTCUT_MAX) {
+        if(sn_data_hmap_get(&sns->shortcuts, dst, &sc) != 0)
+            sc.offered = 0;
+
+        sc.net_addr = *net_addr;
+        sc.expires = sn_util_time_ms() + SN_NODE_SHORTCUT_TTL;
+        sc.hops = hops;
+        sc.usable = 1;
+
+        ret = sn_data_hmap_put(&sns->shortcuts, dst, &sc);
+    }
+
+    pthread_mutex_unlock(&sns->shortcut_mut);
+
+    return ret;
+}
+
+void sn_node_set_failure_detection(sn_node_t* sns, int enable) {
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+    sns->detect = enable;
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+void sn_node_get_stats(sn_node_t* sns, sn_node_stats_t* out_stats) {
+    assert(sns != NULL);
+    assert(out_stats != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+    pthread_mutex_lock(&sns->shortcut_mut);
+    pthread_mutex_lock(&sns->hedge_mut);
+    *out_stats = sns->stats;
+    pthread_mutex_unlock(&sns->hedge_mut);
+    pthread_mutex_unlock(&sns->shortcut_mut);
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+void sn_node_reset_stats(sn_node_t* sns) {
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+    pthread_mutex_lock(&sns->shortcut_mut);
+    pthread_mutex_lock(&sns->hedge_mut);
+    memset(&sns->stats, 0, sizeof(sns->stats));
+    sn_util_hist_init(&sns->stats.forward_ns);
+    sn_util_hist_init(&sns->stats.queue_ns);
+    pthread_mutex_unlock(&sns->hedge_mut);
+    pthread_mutex_unlock(&sns->shortcut_mut);
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+int sn_node_post(sn_node_t* sns, const sn_util_closure_t* closure) {
+    assert(sns != NULL);
+    assert(closure != NULL);
+
+    return sn_io_reactor_post(sns->loop, closure);
+}
+
+uint32_t sn_node_new_reply_id(sn_node_t* sns) {
+    uint32_t id;
+
+    assert(sns != NULL);
+
+    /* 0 is never given so it can mean "no reply wanted" */
+
+    do {
+        id = mint_fetch_add_32_relaxed(&sns->reply_seq, 1) + 1;
+    } while(id == 0);
+
+    return id;
+}
+
+int sn_node_register_reply(sn_node_t* sns, uint32_t reply_id, const sn_util_closure_t* closure, int once, uint64_t timeout_ms) {
+    sn_reply_sub_t sub;
+    uint64_t now = sn_util_time_ms();
+    int ret;
+
+    assert(sns != NULL);
+    assert(closure != NULL);
+
+    sub.reply_id = reply_id;
+    sub.closure = *closure;
+    sub.once = once;
+    sub.deadline = timeout_ms ? now + timeout_ms : 0;
+
+    pthread_mutex_lock(&sns->reply_mut);
+
+    ret = sn_data_vec_push(&sns->reply_vec, &sub);
+
+    /* Timed out on time, not on the next maintenance */
+
+    if(ret == 0 && sub.deadline && (sns->reply_next == 0 || sub.deadline < sns->reply_next))
+        reply_arm(sns, sub.deadline, now);
+
+    pthread_mutex_unlock(&sns->reply_mut);
+
+    return ret;
+}
+
+int sn_node_unregister_reply(sn_node_t* sns, uint32_t reply_id) {
+    sn_reply_sub_t sub;
+    size_t i;
+    int ret = -1;
+
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->reply_mut);
+
+    for(i = 0; sn_data_vec_at(&sns->reply_vec, i, &sub) == 0; ++i) {
+        if(sub.reply_id == reply_id) {
+            sn_data_vec_remove_at(&sns->reply_vec, i, NULL);
+            ret = 0;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&sns->reply_mut);
+
+    return ret;
+}
+
+int sn_node_call_reply(sn_node_t* sns, uint32_t reply_id, const char* reply_cnt, unsigned long long reply_cnt_len, const sn_net_addr_t* src) {
+    sn_reply_sub_t sub;
+    size_t i;
+    int found = 0;
+
+    assert(sns != NULL);
+    assert(reply_cnt != NULL || reply_cnt_len == 0);
+
+    hedge_settle(sns, reply_id);
+
+    pthread_mutex_lock(&sns->reply_mut);
+
+    for(i = 0; sn_data_vec_at(&sns->reply_vec, i, &sub) == 0; ++i) {
+        if(sub.reply_id == reply_id) {
+            if(sub.once)
+                sn_data_vec_remove_at(&sns->reply_vec, i, NULL);
+
+            found = 1;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&sns->reply_mut);
+
+    if(!found)
+        return -1;
+
+    {
+        /* Replies without content still get a non-NULL pointer, NULL means timeout */
+        void* argv[] = { (void*)(reply_cnt ? reply_cnt : ""), &reply_cnt_len, (void*)src };
+
+        sn_util_closure_call(&sub.closure, 3, argv);
+    }
+
+    return 0;
+}
+
+int sn_node_join(sn_node_t* sns, const sn_io_naddr_t* gateway) {
+    sn_join_t* join;
+    sn_wire_join_msg_t msg;
+    sn_util_closure_t closure;
+    int status;
+
+    assert(sns != NULL);
+    assert(gateway != NULL);
+
+    /*
+    Join steps:
+    1. Route a join message to our own address through the gateway
+    2. Every node on the route(the traceroute to m = owner(self)) replies with its rows
+    3. m replies with its leafset too
+    4. Fill our table and leafset with the replies, as they come
+    5. Inform every node learned of ourselves
+    */
+
+    if((join = (sn_join_t*)calloc(1, sizeof(sn_join_t))) == NULL)
+        return -1;
+
+    join->sns = sns;
+    join->reply_id = sn_node_new_reply_id(sns);
+    join->hops = -1;
+    pthread_mutex_init(&join->mut, NULL);
+    pthread_cond_init(&join->cond, NULL);
+
+    msg.reply_to = join->reply_id;
+
+    if(sn_io_naddr_ser(&sns->router.self.net_addr, &msg.net_addr) != 0)
+        goto error;
+
+    /* Registered before sending, the replies race the call */
+
+    sn_util_closure_init_curried_once(&closure, on_join_reply, join);
+
+    if(sn_node_register_reply(sns, join->reply_id, &closure, 0, SN_NODE_JOIN_TIMEOUT) != 0)
+        goto error;
+
+    if(sn_node_send_direct(sns, &sns->self, gateway, SN_WIRE_NET_TYPE_JOIN, sizeof(msg), (const char*)&msg) != 0) {
+        /* Unless it already timed out the listener is still there */
+
+        if(sn_node_unregister_reply(sns, join->reply_id) != 0)
+            goto wait;
+
+        goto error;
+    }
+
+wait:
+    pthread_mutex_lock(&join->mut);
+    while(join->status == 0)
+        pthread_cond_wait(&join->cond, &join->mut);
+    status = join->status;
+    pthread_mutex_unlock(&join->mut);
+
+    pthread_cond_destroy(&join->cond);
+    pthread_mutex_destroy(&join->mut);
+    free(join);
+
+    return status == 1 ? 0 : -1;
+
+error:
+    pthread_cond_destroy(&join->cond);
+    pthread_mutex_destroy(&join->mut);
+    free(join);
+    return -1;
+}
+
+/*Private functions*/
+
+int node_init(sn_node_t* sns, sn_io_runtime_t* rt, sn_node_mux_t* mux, const sn_crypto_sign_key_t* sk, const sn_crypto_sign_pubkey_t* pk, const sn_io_sock_t socket, int check_sign) {
+    sn_io_naddr_t self_net;
+    sn_util_closure_t closure;
+
+    assert(sns != NULL);
+    assert(sk != NULL || pk != NULL);
+    assert(socket != SN_IO_SOCK_INVALID);
+
+    /* Copying */
+
+    sns->check_sign = check_sign;
+
+    if(sk != NULL) {
+        sns->sign = 1;
+        sns->sk = *sk;
+    } else {
+        sns->sign = 0;
+    }
+
+    if(pk != NULL)
+        sns->self = *((sn_net_addr_t*)pk);
+    else if(sk != NULL)
+        sn_crypto_sign_pk_from_sk(sk, (sn_crypto_sign_pubkey_t*)&sns->self);
+    else
+        return -1;
+
+    sns->socket = socket;
+    sns->signer = NULL;
+
+    /* Callback registering */
+
+    sn_node_set_upcall(sns, NULL);
+
+    void* log_argv[] = { "sndnet" };
+    sn_util_closure_init_curried(&sns->default_log_closure, sn_named_log_callback, 1, log_argv);
+    sn_node_set_log_callback(sns, NULL);
+
+    /* Initializing */
+
+    if(sn_io_sock_get_name(socket, &self_net) != 0)
+        return -1;
+
+    sn_net_router_init(&sns->router, &sns->self, &self_net);
+    sns->geometry = &sn_net_geometry_pastry;
+    sns->geometry_state = &sns->router;
+
+    /*Reply vector*/
+
+    if(sn_data_vec_init(&sns->reply_vec, sizeof(sn_reply_sub_t)) != 0)
+        return -1;
+
+    pthread_mutex_init(&sns->reply_mut, NULL);
+    mint_store_32_relaxed(&sns->reply_seq, 0);
+    sn_io_reactor_timer_init(&sns->reply_timer);
+    sns->reply_next = 0;
+
+    /* Event loop initialization */
+
+    sns->runtime = rt;
+    sns->loop = rt != NULL ? sn_io_runtime_reactor(rt) : &sns->reactor;
+    sns->mux = mux;
+    sns->recv_bufs = NULL;
+    mint_store_32_relaxed(&sns->busy_idle_us, 0);
+    sns->rx_drops = 0;
+    sns->rx_drops_known = 0;
+    memset(&sns->stats, 0, sizeof(sns->stats));
+    sn_util_hist_init(&sns->stats.forward_ns);
+    sn_util_hist_init(&sns->stats.queue_ns);
+
+    /* Failure detection, on by default */
+
+    sns->detect = 1;
+
+    if(sn_net_detector_init(&sns->detector) != 0)
+        goto error_reply;
+
+    /* Repairs share a listener, the answers tell the slot */
+
+    if(sn_data_hmap_init(&sns->repairs, sizeof(uint16_t), sizeof(sn_repair_t)) != 0)
+        goto error_detector;
+
+    sns->repair_reply_id = sn_node_new_reply_id(sns);
+    sn_util_closure_init_curried_once(&closure, on_repair_reply, sns);
+
+    if(sn_node_register_reply(sns, sns->repair_reply_id, &closure, 0, 0) != 0)
+        goto error_repairs;
+
+    /* Learning as well */
+
+    sns->learn = 0;
+    sns->learn_budget = SN_NODE_LEARN_RATE;
+
+    if(sn_data_hmap_init(&sns->learning, sizeof(uint16_t), sizeof(sn_learn_t)) != 0)
+        goto error_repairs;
+
+    sns->learn_reply_id = sn_node_new_reply_id(sns);
+    sn_util_closure_init_curried_once(&closure, on_learn_reply, sns);
+
+    if(sn_node_register_reply(sns, sns->learn_reply_id, &closure, 0, 0) != 0)
+        goto error_learning;
+
+    /* And shortcuts, looked up by the sending threads too */
+
+    sns->shortcut = 0;
+    sns->shortcut_budget = SN_NODE_SHORTCUT_OFFER_RATE;
+
+    if(sn_data_hmap_init(&sns->shortcuts, sizeof(sn_net_addr_t), sizeof(sn_shortcut_t)) != 0)
+        goto error_learning;
+
+    if(pthread_mutex_init(&sns->shortcut_mut, NULL) != 0)
+        goto error_shortcuts;
+
+    /* Hedges, settled by replies and sent by their own timer */
+
+    sns->hedge_delay = SN_NODE_HEDGE_DEFAULT_DELAY;
+    sn_util_hist_init(&sns->hedge_rtt);
+    memset(sns->dedup, 0, sizeof(sns->dedup));
+    sns->dedup_next = 0;
+
+    if(sn_data_hmap_init(&sns->hedges, sizeof(uint32_t), sizeof(sn_hedge_t)) != 0)
+        goto error_shortcut_mut;
+
+    if(pthread_mutex_init(&sns->hedge_mut, NULL) != 0)
+        goto error_hedges;
+
+    /* Membership gossip, for the one-hop geometry */
+
+    sns->incarnation = (uint32_t)(sn_util_time_real_ns()/1000000000);
+
+    if(sn_data_hmap_init(&sns->rumors, sizeof(sn_net_addr_t), sizeof(sn_rumor_t)) != 0)
+        goto error_hedge_mut;
+
+    if(sn_data_hmap_init(&sns->heard, sizeof(sn_net_addr_t), sizeof(sn_heard_t)) != 0)
+        goto error_rumors;
+
+    if(pthread_mutex_init(&sns->gossip_mut, NULL) != 0)
+        goto error_heard;
+
+    /* Topic trees, renewed by the maintenance */
+
+    if(sn_data_hmap_init(&sns->topics, sizeof(sn_net_addr_t), sizeof(sn_topic_t*)) != 0)
+        goto error_gossip_mut;
+
+    randombytes_buf(&sns->publish_seq, sizeof(sns->publish_seq));
+    memset(&sns->on_broadcast, 0, sizeof(sns->on_broadcast));
+
+    /* Lookups, stepped by replies and their timer */
+
+    if(sn_data_vec_init(&sns->lookups, sizeof(sn_lookup_t*)) != 0)
+        goto error_topics;
+
+    /* Aggregations, finished by results and their timer */
+
+    if(sn_data_hmap_init(&sns->aggregates, sizeof(uint32_t), sizeof(sn_aggregate_t*)) != 0)
+        goto error_lookups;
+
+    /* Stored values and replicas */
+
+    if(sn_data_store_init(&sns->store, sizeof(sn_net_addr_t)) != 0)
+        goto error_aggregates;
+
+    if(sn_data_merkle_init(&sns->merkle) != 0)
+        goto error_store;
+
+    sns->sync_next = sn_util_time_ms() + SN_NODE_SYNC_PERIOD + randombytes_uniform(SN_NODE_SYNC_PERIOD);
+
+    /* Object fragments we hold */
+
+    if(sn_data_store_init(&sns->fragments, sizeof(sn_fragment_key_t)) != 0)
+        goto error_merkle;
+
+    sns->fragments_version = sn_net_router_version(&sns->router);
+    sn_data_erasure_init(&sns->code, SN_NODE_OBJECT_DATA, SN_NODE_OBJECT_PARITY);
+
+    if(sn_data_vec_init(&sns->object_out, sizeof(sn_object_out_t)) != 0)
+        goto error_fragments;
+
+    sns->object_out_next = 0;
+
+    /* Path cache, filled once enabled */
+
+    sns->path_cache = 0;
+    memset(sns->cache_gets, 0, sizeof(sns->cache_gets));
+    sns->cache_gets_next = 0;
+
+    if(sn_data_cache_init(&sns->cache, sizeof(sn_net_addr_t), SN_NODE_CACHE_SLOTS) != 0)
+        goto error_object_out;
+
+    if(pthread_mutex_init(&sns->task_mut, NULL) != 0)
+        goto error_cache;
+
+    if(mux != NULL) {
+        /* The mux reads the socket */
+
+        if(mux_register(mux, sns) != 0)
+            goto error_task;
+    } else {
+        if(sn_io_sock_set_nonblocking(socket, 1) != 0)
+            goto error_task;
+
+        if(rt == NULL && sn_io_reactor_init(&sns->reactor) != 0)
+            goto error_task;
+
+        sn_util_closure_init_curried_once(&closure, on_socket_ready, sns);
+
+        if(rt != NULL ? sn_io_runtime_attach(rt, &sns->sock_src, socket, &closure) != 0
+                      : sn_io_reactor_add(&sns->reactor, &sns->sock_src, socket, &closure) != 0)
+            goto error_reactor;
+    }
+
+    /* Randomized first run so the maintenance of many hosted nodes is spread over the period */
+
+    sn_io_reactor_timer_init(&sns->maint_timer);
+    sn_io_reactor_timer_init(&sns->hedge_timer);
+    sn_io_reactor_timer_init(&sns->lookup_timer);
+    sn_io_reactor_timer_init(&sns->aggregate_timer);
+    sn_io_reactor_timer_init(&sns->object_timer);
+    sn_util_closure_init_curried_once(&closure, on_maintenance, sns);
+
+    if(sn_io_reactor_timer_start(sns->loop, &sns->maint_timer,
+            SN_NODE_MAINTENANCE_PERIOD/2 + randombytes_uniform(SN_NODE_MAINTENANCE_PERIOD),
+            SN_NODE_MAINTENANCE_PERIOD, &closure) != 0)
+        goto error_source;
+
+    if(rt != NULL)
+        return 0;
+
+    /* Background thread initialization */
+
+    if(pthread_create(&(sns->bg_thrd), 0, background, sns)) {
+        sn_node_log(sns, "Error while starting thread");
+        goto error_timer;
+    }
+
+    return 0;
+
+error_timer:
+    sn_io_reactor_timer_stop(sns->loop, &sns->maint_timer);
+error_source:
+    if(mux != NULL)
+        mux_unregister(mux, sns);
+    else if(rt != NULL)
+        sn_io_runtime_detach(rt, &sns->sock_src);
+    else
+        sn_io_reactor_remove(&sns->reactor, &sns->sock_src);
+error_reactor:
+    if(rt == NULL)
+        sn_io_reactor_destroy(&sns->reactor);
+error_task:
+    pthread_mutex_destroy(&sns->task_mut);
+error_cache:
+    sn_data_cache_destroy(&sns->cache);
+error_object_out:
+    sn_data_vec_destroy(&sns->object_out);
+error_fragments:
+    sn_data_store_destroy(&sns->fragments);
+error_merkle:
+    sn_data_merkle_destroy(&sns->merkle);
+error_store:
+    sn_data_store_destroy(&sns->store);
+error_aggregates:
+    sn_data_hmap_destroy(&sns->aggregates);
+error_lookups:
+    sn_data_vec_destroy(&sns->lookups);
+error_topics:
+    sn_data_hmap_destroy(&sns->topics);
+error_gossip_mut:
+    pthread_mutex_destroy(&sns->gossip_mut);
+error_heard:
+    sn_data_hmap_destroy(&sns->heard);
+error_rumors:
+    sn_data_hmap_destroy(&sns->rumors);
+error_hedge_mut:
+    pthread_mutex_destroy(&sns->hedge_mut);
+error_hedges:
+    sn_data_hmap_destroy(&sns->hedges);
+error_shortcut_mut:
+    pthread_mutex_destroy(&sns->shortcut_mut);
+error_shortcuts:
+    sn_data_hmap_destroy(&sns->shortcuts);
+error_learning:
+    sn_data_hmap_destroy(&sns->learning);
+error_repairs:
+    sn_data_hmap_destroy(&sns->repairs);
+error_detector:
+    sn_net_detector_destroy(&sns->detector);
+error_reply:
+    pthread_mutex_destroy(&sns->reply_mut);
+    sn_data_vec_destroy(&sns->reply_vec);
+    return -1;
+}
+
+int deliver(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr) {
+    char packet_str[SN_NET_PACKET_PRINTABLE_LEN];
+    char rem_addr_str[SN_IO_NADDR_PRINTABLE_LEN];
+    sn_deliver_handler_t d_fn;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    sn_net_packet_header_to_str(packet, packet_str);
+
+    if(rem_addr != NULL)
+        sn_io_naddr_to_str(rem_addr, rem_addr_str);
+    else
+        strncpy(rem_addr_str, "THIS", SN_IO_NADDR_PRINTABLE_LEN);
+
+    sn_node_log(sns,
+        "packet deliver\n"
+        "came from %s\n"
+        "%s"
+        "\n%s\n",
+    rem_addr_str, packet_str, packet->payload);
+
+    //TODO: logic
+
+    if(packet->header.type >= SN_WIRE_NET_TYPES)
+        return -1;
+
+    if(rem_addr != NULL && (packet->header.type == SN_WIRE_NET_TYPE_USER || packet->header.type == SN_WIRE_NET_TYPE_REPLY))
+        shortcut_offer(sns, packet);
+
+    d_fn = sn_default_deliver_handlers[packet->header.type];
+
+    if(d_fn)
+        return d_fn(sns, packet, rem_addr);
+
+    return 0;
+}
+
+int forward(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr) {
+    sn_net_addr_t dst;
+    sn_net_entry_t nexthop;
+    int ret;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    if((ret = forward_route(sns, packet, rem_addr, &nexthop)) != 0 || !nexthop.is_set)
+        return ret;
+
+    sn_net_packet_get_dst(packet, &dst);
+
+    if(rem_addr == NULL && (packet->header.type == SN_WIRE_NET_TYPE_USER || packet->header.type == SN_WIRE_NET_TYPE_REPLY)) {
+        /* Our own conversations go straight to known destinations, the overlay if that fails */
+
+        sn_net_entry_t shortcut = nexthop;
+
+        if(shortcut_nexthop(sns, &dst, &shortcut) == 0) {
+            if(sn_net_packet_send(packet, sns->socket, &shortcut.net_addr) != -1)
+                return 0;
+
+            shortcut_drop(sns, &dst);
+        }
+    }
+
+    if(node_send_nexthop(sns, packet, &dst, &nexthop) != 0) {
+        char rem_addr_str[SN_IO_NADDR_PRINTABLE_LEN];
+
+        if(rem_addr != NULL)
+            sn_io_naddr_to_str(rem_addr, rem_addr_str);
+        else
+            strncpy(rem_addr_str, "THIS", SN_IO_NADDR_PRINTABLE_LEN);
+
+        sn_node_log(sns, "ERROR sending packet to %s\n", rem_addr_str);
+        return -1;
+    }
+
+    forward_log(sns, packet, rem_addr, &nexthop);
+
+    return 0;
+}
+
+int forward_route(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr, sn_net_entry_t* nexthop) {
+    char src_str[SN_NET_ADDR_PRINTABLE_LEN];
+    char dst_str[SN_NET_ADDR_PRINTABLE_LEN];
+    char rem_addr_str[SN_IO_NADDR_PRINTABLE_LEN];
+    sn_net_addr_t src;
+    sn_net_addr_t dst;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    nexthop->is_set = 0;
+
+    sn_net_packet_get_src(packet, &src);
+    sn_net_packet_get_dst(packet, &dst);
+
+    if(!packet->header.ttl) {
+        sn_net_addr_to_str(&src, src_str);
+        sn_net_addr_to_str(&dst, dst_str);
+
+        if(rem_addr != NULL)
+            sn_io_naddr_to_str(rem_addr, rem_addr_str);
+        else
+            strncpy(rem_addr_str, "THIS", SN_IO_NADDR_PRINTABLE_LEN);
+
+        sn_node_log(sns,
+        "packet without TTL\n"
+        "came from %s\n"
+        "src: %s\n"
+        "dst: %s\n",
+        rem_addr_str, src_str, dst_str);
+        return -1;
+    }
+
+    if(rem_addr != NULL && packet->header.ttl >= SN_NET_PACKET_DEFAULT_TTL - 1) {
+        /* Straight from its source */
+
+        if(sns->learn)
+            learn_observe(sns, &src, rem_addr, packet->header.ttl);
+
+        if(packet->header.type == SN_WIRE_NET_TYPE_USER || packet->header.type == SN_WIRE_NET_TYPE_REPLY)
+            shortcut_heard(sns, &src, rem_addr, sn_util_time_ms());
+    }
+
+    packet->header.ttl--;
+
+    sn_node_nexthop(sns, &dst, nexthop);
+
+    /* Left set only for packets that still have to be sent to it */
+
+    if(nexthop->is_set) {
+        sn_forward_handler_t f_fn;
+
+        if(packet->header.type >= SN_WIRE_NET_TYPES) {
+            nexthop->is_set = 0;
+            return -1;
+        }
+
+        f_fn = sn_default_forward_handlers[packet->header.type];
+
+        if(f_fn) {
+            int handled;
+
+            /* Packets the handler answered itself go no further */
+
+            if((handled = f_fn(sns, packet, rem_addr, nexthop)) != 0) {
+                nexthop->is_set = 0;
+                return handled > 0 ? 0 : -1;
+            }
+
+            if(!nexthop->is_set)
+                return deliver(sns, packet, rem_addr);
+        }
+
+        return 0;
+    }
+
+    return deliver(sns, packet, rem_addr);
+}
+
+void forward_log(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr, const sn_net_entry_t* nexthop) {
+    char nh_str[SN_NET_ENTRY_PRINTABLE_LEN];
+    char rem_addr_str[SN_IO_NADDR_PRINTABLE_LEN];
+    char packet_str[SN_NET_PACKET_PRINTABLE_LEN];
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    if(rem_addr != NULL)
+        sn_io_naddr_to_str(rem_addr, rem_addr_str);
+    else
+        strncpy(rem_addr_str, "THIS", SN_IO_NADDR_PRINTABLE_LEN);
+
+    sn_net_entry_to_str(nexthop, nh_str, SN_NET_ADDR_HEX_LEN);
+    sn_net_packet_header_to_str(packet, packet_str);
+
+    sn_node_log(sns,
+    "packet forward\n"
+    "came from %s\n"
+    "%s"
+    "Forwarded to %s\n",
+    rem_addr_str, packet_str, nh_str);
+}
+
+int forward_many(sn_node_t* sns, sn_net_packet_t* packets[], size_t count) {
+    const sn_net_packet_t** batch;
+    sn_net_entry_t* batch_hops;
+    const sn_io_naddr_t** batch_dsts;
+    size_t batch_len = 0;
+    size_t i;
+    int sent = 0;
+
+    assert(sns != NULL);
+    assert(packets != NULL);
+
+    batch = (const sn_net_packet_t**)malloc(count*sizeof(sn_net_packet_t*));
+    batch_hops = (sn_net_entry_t*)malloc(count*sizeof(sn_net_entry_t));
+    batch_dsts = (const sn_io_naddr_t**)malloc(count*sizeof(sn_io_naddr_t*));
+
+    if(!batch || !batch_hops || !batch_dsts) {
+        free(batch);
+        free(batch_hops);
+        free(batch_dsts);
+        return -1;
+    }
+
+    /* Routed, handled and delivered like forward does, only the sends to the network are batched */
+
+    for(i = 0; i < count; ++i) {
+        sn_net_packet_t* packet = packets[i];
+        sn_net_entry_t nexthop;
+        sn_net_addr_t dst;
+        int ret;
+
+        if((ret = forward_route(sns, packet, NULL, &nexthop)) != 0 || !nexthop.is_set) {
+            sent += ret == 0;
+            continue;
+        }
+
+        sn_net_packet_get_dst(packet, &dst);
+
+        if(sns->mux != NULL && node_local_target(sns, &dst, &nexthop, NULL) == 0) {
+            if(node_send_nexthop(sns, packet, &dst, &nexthop) == 0) {
+                forward_log(sns, packet, NULL, &nexthop);
+                ++sent;
+            }
+
+            continue;
+        }
+
+        if(packet->header.type == SN_WIRE_NET_TYPE_USER || packet->header.type == SN_WIRE_NET_TYPE_REPLY)
+            shortcut_nexthop(sns, &dst, &nexthop);
+
+        batch[batch_len] = packet;
+        batch_hops[batch_len] = nexthop;
+        batch_dsts[batch_len] = &batch_hops[batch_len].net_addr;
+        ++batch_len;
+    }
+
+    if(batch_len) {
+        int batch_sent = sn_net_packet_send_many(batch, sns->socket, batch_dsts, batch_len);
+
+        for(i = 0; i < (size_t)SN_MAX(batch_sent, 0); ++i)
+            forward_log(sns, batch[i], NULL, &batch_hops[i]);
+
+        if(batch_sent < (int)batch_len)
+            sn_node_log(sns, "ERROR sending batch, %d of %lu packets sent\n", SN_MAX(batch_sent, 0), (unsigned long)batch_len);
+
+        sent += SN_MAX(batch_sent, 0);
+    }
+
+    free(batch);
+    free(batch_hops);
+    free(batch_dsts);
+
+    return sent;
+}
+
+int node_receive(sn_node_t* sns, sn_net_packet_t* packet, sn_io_naddr_t* rem_addr) {
+    uint64_t start;
+    int ret;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    start = sn_util_time_ns();
+    ++sns->stats.received;
+
+    if(sns->check_sign && sn_net_packet_check_sign(packet) != 0) {
+        char rem_addr_str[SN_IO_NADDR_PRINTABLE_LEN];
+        char packet_str[SN_NET_PACKET_PRINTABLE_LEN];
+
+        sn_io_naddr_to_str(rem_addr, rem_addr_str);
+
+        sn_net_packet_header_to_str(packet, packet_str);
+
+        sn_node_log(sns,
+            "Bad signed msg:\n"
+            "sent from %s\n"
+            "%s"
+            "REJECTED\n",
+            rem_addr_str, packet_str);
+
+        ++sns->stats.rejected;
+        return -1;
+    }
+
+    /* Any packet is a heartbeat of the neighbor that sent it */
+
+    if(sns->detect)
+        sn_net_detector_heard(&sns->detector, rem_addr, start/1000000);
+
+    ret = forward(sns, packet, rem_addr);
+
+    sn_util_hist_record(&sns->stats.forward_ns, sn_util_time_ns() - start);
+
+    return ret;
+}
+
+int node_recv_batch(sn_node_t* sns) {
+    sn_io_naddr_t rem_addrs[SN_IO_SOCK_BATCH_LEN];
+    sn_io_sock_rx_info_t infos[SN_IO_SOCK_BATCH_LEN];
+    uint64_t now_real;
+    int i, n;
+
+    assert(sns != NULL);
+    assert(sns->recv_bufs != NULL);
+
+    n = sn_net_packet_recv_many(sns->socket, sns->recv_bufs, rem_addrs, infos, SN_IO_SOCK_BATCH_LEN);
+    now_real = sn_util_time_real_ns();
+
+    for(i = 0; i < n; ++i) {
+        node_rx_telemetry(sns, &infos[i], now_real);
+        node_receive(sns, sns->recv_bufs[i], &rem_addrs[i]);
+    }
+
+    return n;
+}
+
+void node_rx_telemetry(sn_node_t* sns, const sn_io_sock_rx_info_t* info, uint64_t now_real) {
+    uint32_t diff;
+
+    assert(sns != NULL);
+    assert(info != NULL);
+
+    if(info->stamp_ns)
+        sn_util_hist_record(&sns->stats.queue_ns, now_real > info->stamp_ns ? now_real - info->stamp_ns : 0);
+
+    if(!info->drops_reported)
+        return;
+
+    /* The kernel reports a running total per socket, wrapping at 2^32. The first one seen
+       is the baseline, drops from before we looked(or before another identity did) are not ours */
+
+    if(!sns->rx_drops_known) {
+        sns->rx_drops = info->drops;
+        sns->rx_drops_known = 1;
+        return;
+    }
+
+    if((diff = info->drops - sns->rx_drops) != 0 && diff < UINT32_C(0x80000000)) {
+        sns->stats.kernel_drops += diff;
+        sns->rx_drops = info->drops;
+    }
+}
+
+void node_noop(int argc, void* argv[]) {
+    SN_UNUSED(argc);
+    SN_UNUSED(argv);
+}
+
+int node_local_target(sn_node_t* sns, const sn_net_addr_t* dst, const sn_net_entry_t* nexthop, sn_net_addr_t* out_target) {
+    const sn_net_addr_t* target;
+
+    assert(sns != NULL);
+    assert(sns->mux != NULL);
+
+    /* Addressed to another local identity, or routed through one */
+
+    if(mux_lookup(sns->mux, dst, 0) != NULL)
+        target = dst;
+    else if(sn_io_naddr_cmp(&nexthop->net_addr, &sns->mux->self_net) == 0)
+        target = &nexthop->addr;
+    else
+        return -1;
+
+    if(out_target != NULL)
+        *out_target = *target;
+
+    return 0;
+}
+
+int node_send_nexthop(sn_node_t* sns, const sn_net_packet_t* packet, const sn_net_addr_t* dst, const sn_net_entry_t* nexthop) {
+    sn_net_addr_t target;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(nexthop != NULL);
+
+    /* Local identities skip the network */
+
+    if(sns->mux != NULL && node_local_target(sns, dst, nexthop, &target) == 0)
+        return mux_post_local(sns->mux, &target, packet) == 0 ? 0 : -1;
+
+    return sn_net_packet_send(packet, sns->socket, &nexthop->net_addr) == -1 ? -1 : 0;
+}
+
+void on_mux_ready(int argc, void* argv[]) {
+    sn_node_mux_t* mux;
+    sn_io_naddr_t rem_addrs[SN_IO_SOCK_BATCH_LEN];
+    sn_io_sock_rx_info_t infos[SN_IO_SOCK_BATCH_LEN];
+    unsigned int epoch;
+    int i, received = 0;
+
+    assert(argc >= 1);
+
+    mux = (sn_node_mux_t*)argv[0];
+
+    assert(mux != NULL);
+
+    epoch = mux_enter(mux);
+
+    while(received < SN_NODE_RECV_BUDGET) {
+        int n = sn_net_packet_recv_many(mux->socket, mux->bufs, rem_addrs, infos, SN_IO_SOCK_BATCH_LEN);
+        uint64_t now_real = sn_util_time_real_ns();
+
+        if(n < 0)
+            break;
+
+        for(i = 0; i < n; ++i) {
+            sn_net_addr_t dst;
+            sn_node_t* sns;
+
+            sn_net_packet_get_dst(mux->bufs[i], &dst);
+
+            if((sns = mux_lookup(mux, &dst, 1)) == NULL)
+                continue;
+
+            pthread_mutex_lock(&sns->task_mut);
+            node_rx_telemetry(sns, &infos[i], now_real);
+            node_receive(sns, mux->bufs[i], &rem_addrs[i]);
+            pthread_mutex_unlock(&sns->task_mut);
+        }
+
+        received += SN_MAX(n, 1);
+    }
+
+    mux_leave(mux, epoch);
+}
+
+void on_mux_local(int argc, void* argv[]) {
+    sn_node_mux_t* mux;
+    sn_data_vec_t batch;
+    sn_mux_local_t local;
+    unsigned int epoch;
+    size_t i;
+
+    assert(argc >= 1);
+
+    mux = (sn_node_mux_t*)argv[0];
+
+    assert(mux != NULL);
+
+    epoch = mux_enter(mux);
+    pthread_mutex_lock(&mux->local_mut);
+
+    /* Packets posted while draining are drained too */
+
+    while(sn_data_vec_size(&mux->local) != 0) {
+        batch = mux->local;
+
+        if(sn_data_vec_init(&mux->local, sizeof(sn_mux_local_t)) != 0) {
+            mux->local = batch;
+            break;
+        }
+
+        pthread_mutex_unlock(&mux->local_mut);
+
+        for(i = 0; sn_data_vec_at(&batch, i, &local) == 0; ++i) {
+            sn_node_t* sns;
+
+            if((sns = mux_lookup(mux, &local.target, 0)) != NULL) {
+                pthread_mutex_lock(&sns->task_mut);
+                forward(sns, local.packet, &mux->self_net);
+                pthread_mutex_unlock(&sns->task_mut);
+            }
+
+            free(local.packet);
+        }
+
+        sn_data_vec_destroy(&batch);
+
+        pthread_mutex_lock(&mux->local_mut);
+    }
+
+    mux->local_posted = 0;
+
+    pthread_mutex_unlock(&mux->local_mut);
+    mux_leave(mux, epoch);
+}
+
+int mux_register(sn_node_mux_t* mux, sn_node_t* sns) {
+    int ret = -1;
+
+    pthread_mutex_lock(&mux->ident_mut);
+
+    if(sn_data_hmap_get(&mux->identities, &sns->self, NULL) != 0 &&
+            sn_data_hmap_put(&mux->identities, &sns->self, &sns) == 0) {
+        if(mux->primary == NULL)
+            mux->primary = sns;
+
+        ret = 0;
+    }
+
+    pthread_mutex_unlock(&mux->ident_mut);
+
+    return ret;
+}
+
+void mux_unregister(sn_node_mux_t* mux, sn_node_t* sns) {
+    size_t iter = 0;
+    unsigned int old;
+
+    pthread_mutex_lock(&mux->ident_mut);
+
+    sn_data_hmap_remove(&mux->identities, &sns->self, NULL);
+
+    if(mux->primary == sns) {
+        mux->primary = NULL;
+        sn_data_hmap_next(&mux->identities, &iter, NULL, &mux->primary);
+    }
+
+    /*
+    Closures started from now on cannot find the identity. Waits for the ones
+    already processing packets, it may be one of their targets.
+    */
+
+    old = mux->epoch;
+    mux->epoch ^= 1;
+
+    while(mux->busy[old])
+        pthread_cond_wait(&mux->idle_cond, &mux->ident_mut);
+
+    pthread_mutex_unlock(&mux->ident_mut);
+}
+
+unsigned int mux_enter(sn_node_mux_t* mux) {
+    unsigned int epoch;
+
+    pthread_mutex_lock(&mux->ident_mut);
+    epoch = mux->epoch;
+    ++mux->busy[epoch];
+    pthread_mutex_unlock(&mux->ident_mut);
+
+    return epoch;
+}
+
+void mux_leave(sn_node_mux_t* mux, unsigned int epoch) {
+    pthread_mutex_lock(&mux->ident_mut);
+
+    if(--mux->busy[epoch] == 0)
+        pthread_cond_broadcast(&mux->idle_cond);
+
+    pthread_mutex_unlock(&mux->ident_mut);
+}
+
+sn_node_t* mux_lookup(sn_node_mux_t* mux, const sn_net_addr_t* addr, int or_primary) {
+    sn_node_t* sns = NULL;
+
+    pthread_mutex_lock(&mux->ident_mut);
+
+    if(sn_data_hmap_get(&mux->identities, addr, &sns) != 0 && or_primary)
+        sns = mux->primary;
+
+    pthread_mutex_unlock(&mux->ident_mut);
+
+    return sns;
+}
+
+int mux_post_local(sn_node_mux_t* mux, const sn_net_addr_t* target, const sn_net_packet_t* packet) {
+    size_t packet_size = sizeof(sn_net_packet_t) + (size_t)packet->header.len + 1;
+    sn_mux_local_t local;
+    int ret = 0;
+
+    local.target = *target;
+    local.packet = (sn_net_packet_t*)malloc(packet_size);
+
+    if(local.packet == NULL)
+        return -1;
+
+    memcpy(local.packet, packet, packet_size);
+
+    pthread_mutex_lock(&mux->local_mut);
+
+    if(sn_data_vec_push(&mux->local, &local) != 0) {
+        free(local.packet);
+        ret = -1;
+    } else if(!mux->local_posted) {
+        sn_util_closure_t closure;
+
+        sn_util_closure_init_curried_once(&closure, on_mux_local, mux);
+
+        if(sn_io_reactor_post(sn_io_runtime_reactor(mux->runtime), &closure) == 0)
+            mux->local_posted = 1;
+    }
+
+    pthread_mutex_unlock(&mux->local_mut);
+
+    return ret;
+}
+
+void* background(void* arg) {
+    sn_node_t* sns = (sn_node_t*)arg;
+    uint64_t last_traffic = 0;
+    int error = 0;
+
+    assert(sns != NULL);
+
+    while(!sn_io_reactor_stopping(&sns->reactor)) {
+        uint32_t idle_us = mint_load_32_relaxed(&sns->busy_idle_us);
+        int received;
+
+        if(!idle_us) {
+            if(sn_io_reactor_run_once(&sns->reactor, -1) == -1) {
+                error = 1;
+                break;
+            }
+
+            continue;
+        }
+
+        /* Busy polling, the socket is read directly and the loop only runs what is ready */
+
+        mint_thread_fence_acquire();
+
+        pthread_mutex_lock(&sns->task_mut);
+        received = node_recv_batch(sns);
+        pthread_mutex_unlock(&sns->task_mut);
+
+        if(received > 0 || last_traffic == 0) {
+            last_traffic = sn_util_time_ns();
+            continue;
+        }
+
+        if(sn_io_reactor_run_once(&sns->reactor, 0) == -1) {
+            error = 1;
+            break;
+        }
+
+        /* Idle for too long, blocks until the next event */
+
+        if(sn_util_time_ns() - last_traffic > (uint64_t)idle_us*1000) {
+            if(sn_io_reactor_run_once(&sns->reactor, -1) == -1) {
+                error = 1;
+                break;
+            }
+
+            last_traffic = sn_util_time_ns();
+        }
+    }
+
+    if(error)
+        sn_node_log(sns, "ERROR running the event loop\n");
+
+    /* Runs the posts queued before stopping(or the plain loop after an error) */
+
+    sn_io_reactor_run(&sns->reactor);
+
+    return sns;
+}
+
+void on_socket_ready(int argc, void* argv[]) {
+    sn_node_t* sns;
+    sn_io_naddr_t rem_addr;
+    sn_io_sock_rx_info_t info;
+    sn_net_packet_t* packet;
+    int i;
+
+    assert(argc >= 1);
+
+    sns = (sn_node_t*)argv[0];
+
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    if(mint_load_32_relaxed(&sns->busy_idle_us)) {
+        mint_thread_fence_acquire();
+
+        for(i = 0; i < SN_NODE_RECV_BUDGET && node_recv_batch(sns) >= 0; i += SN_IO_SOCK_BATCH_LEN);
+
+        pthread_mutex_unlock(&sns->task_mut);
+        return;
+    }
+
+    for(i = 0; i < SN_NODE_RECV_BUDGET; ++i) {
+        errno = 0;
+        packet = sn_net_packet_recv_info(sns->socket, &rem_addr, &info);
+
+        if(!packet) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            continue;
+        }
+
+        node_rx_telemetry(sns, &info, sn_util_time_real_ns());
+        node_receive(sns, packet, &rem_addr);
+
+        free(packet);
+    }
+
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+void on_maintenance(int argc, void* argv[]) {
+    sn_node_t* sns;
+
+    assert(argc >= 1);
+    assert(argv[0] != NULL);
+
+    sns = (sn_node_t*)argv[0];
+
+    pthread_mutex_lock(&sns->task_mut);
+    maintenance(sns);
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+void maintenance(sn_node_t* sns) {
+    uint64_t now;
+
+    assert(sns != NULL);
+
+    now = sn_util_time_ms();
+
+    reply_sweep(sns, now);
+
+    if(sns->detect)
+        detect_failures(sns, now);
+
+    repair_tick(sns, now);
+    learn_tick(sns, now);
+    shortcut_sweep(sns, now);
+    hedge_sweep(sns, now);
+    gossip_tick(sns, now);
+    topic_tick(sns, now);
+    sync_tick(sns, now);
+    object_tick(sns);
+}
+
+void detect_failures(sn_node_t* sns, uint64_t now) {
+    sn_data_vec_t probes, dead;
+    sn_wire_ping_msg_t ping;
+    sn_net_entry_t e;
+    size_t i;
+
+    assert(sns != NULL);
+
+    if(sn_net_detector_sync(&sns->detector, &sns->router, now) != 0)
+        return;
+
+    if(sn_data_vec_init(&probes, sizeof(sn_net_entry_t)) != 0)
+        return;
+
+    if(sn_data_vec_init(&dead, sizeof(sn_net_entry_t)) != 0) {
+        sn_data_vec_destroy(&probes);
+        return;
+    }
+
+    sn_net_detector_check(&sns->detector, now, &probes, &dead);
+
+    /*
+    Probes are sent straight to the quiet neighbors, which answer straight back. The answer is a
+    heartbeat like any other packet, reply ID 0 is never given to a listener.
+    */
+
+    memset(&ping, 0, sizeof(ping));
+
+    for(i = 0; sn_data_vec_at(&probes, i, &e) == 0; ++i) {
+        sn_node_send_direct(sns, &e.addr, &e.net_addr, SN_WIRE_NET_TYPE_PING, sizeof(ping), (const char*)&ping);
+        ++sns->stats.probes;
+    }
+
+    for(i = 0; sn_data_vec_at(&dead, i, &e) == 0; ++i) {
+        char e_str[SN_NET_ENTRY_PRINTABLE_LEN];
+
+        sn_net_entry_to_str(&e, e_str, 8);
+        sn_node_log(sns, "Neighbor %s is not answering, removed\n", e_str);
+
+        remove_net_addr(sns, &e.net_addr, now);
+        ++sns->stats.failures;
+    }
+
+    sn_data_vec_destroy(&probes);
+    sn_data_vec_destroy(&dead);
+}
+
+void remove_net_addr(sn_node_t* sns, const sn_io_naddr_t* net_addr, uint64_t now) {
+    const sn_net_entry_t* e;
+    sn_net_addr_t addr;
+    unsigned int l, c;
+    int p;
+
+    /* Every identity at the network address(nodes sharing a mux) */
+
+    for(l = 0; l < SN_NET_ROUTER_LEVELS; ++l) {
+        for(c = 0; c < SN_NET_ROUTER_COLUMNS; ++c) {
+            e = sn_net_router_table_get(&sns->router, l, c);
+
+            if(e->is_set && sn_io_naddr_cmp(&e->net_addr, net_addr) == 0) {
+                addr = e->addr;
+                route_remove(sns, &addr);
+                repair_start(sns, l, c, &addr, now);
+            }
+        }
+    }
+
+    for(p = -SN_NET_ROUTER_LEAFSET_SIZE; p <= SN_NET_ROUTER_LEAFSET_SIZE; ++p) {
+        e = sn_net_router_leafset_get(&sns->router, p);
+
+        /* Removals shift the leafset, the position is checked again */
+
+        while(p != 0 && e != NULL && e->is_set && sn_io_naddr_cmp(&e->net_addr, net_addr) == 0) {
+            addr = e->addr;
+            route_remove(sns, &addr);
+            e = sn_net_router_leafset_get(&sns->router, p);
+        }
+    }
+}
+
+void route_remove(sn_node_t* sns, const sn_net_addr_t* addr) {
+    sn_net_router_remove(&sns->router, addr);
+
+    if(sns->geometry == &sn_net_geometry_onehop) {
+        sn_net_members_t* members = (sn_net_members_t*)sns->geometry_state;
+        sn_heard_t heard;
+        sn_net_entry_t e;
+        size_t idx;
+
+        /* Members leaving are gossiped too, at the incarnation they were heard of */
+
+        if(sn_net_members_find(members, addr, &idx) == 0) {
+            e = *sn_net_members_at(members, idx);
+            e.is_set = 0;
+
+            pthread_mutex_lock(&sns->gossip_mut);
+
+            if(sn_data_hmap_get(&sns->heard, addr, &heard) != 0)
+                heard.incarnation = 0;
+
+            heard.alive = 0;
+            heard.since = sn_util_time_ms();
+            sn_data_hmap_put(&sns->heard, addr, &heard);
+
+            pthread_mutex_unlock(&sns->gossip_mut);
+
+            sn_net_members_remove(members, addr);
+            gossip_rumor(sns, &e, heard.incarnation);
+        }
+    } else if(sns->geometry_state != &sns->router) {
+        sns->geometry->remove(sns->geometry_state, addr);
+    }
+}
+
+int gossip_learn(sn_node_t* sns, const sn_net_addr_t* addr, uint32_t incarnation, int alive) {
+    sn_heard_t heard;
+    int news;
+
+    assert(sns != NULL);
+    assert(addr != NULL);
+
+    /* Newer incarnations win, and leaving wins over joining within one */
+
+    pthread_mutex_lock(&sns->gossip_mut);
+
+    news = sn_data_hmap_get(&sns->heard, addr, &heard) != 0 || incarnation > heard.incarnation ||
+        (incarnation == heard.incarnation && heard.alive && !alive);
+
+    if(news) {
+        heard.incarnation = incarnation;
+        heard.alive = alive;
+        heard.since = sn_util_time_ms();
+
+        if(sn_data_hmap_put(&sns->heard, addr, &heard) != 0)
+            news = 0;
+    }
+
+    pthread_mutex_unlock(&sns->gossip_mut);
+
+    return news;
+}
+
+int gossip_admit(sn_node_t* sns, const sn_net_addr_t* addr, uint32_t* out_incarnation) {
+    sn_heard_t heard;
+    int admit = 1;
+
+    assert(sns != NULL);
+    assert(addr != NULL);
+    assert(out_incarnation != NULL);
+
+    pthread_mutex_lock(&sns->gossip_mut);
+
+    if(sn_data_hmap_get(&sns->heard, addr, &heard) != 0) {
+        heard.incarnation = 0;
+        heard.alive = 1;
+        heard.since = sn_util_time_ms();
+
+        admit = sn_data_hmap_put(&sns->heard, addr, &heard) == 0;
+    } else {
+        admit = heard.alive;
+    }
+
+    *out_incarnation = heard.incarnation;
+
+    pthread_mutex_unlock(&sns->gossip_mut);
+
+    return admit;
+}
+
+void gossip_rumor(sn_node_t* sns, const sn_net_entry_t* e, uint32_t incarnation) {
+    size_t n = sn_net_members_size((const sn_net_members_t*)sns->geometry_state) + 1;
+    sn_rumor_t rumor, other, victim;
+    sn_net_addr_t addr, victim_addr;
+    size_t iter = 0;
+
+    assert(sns != NULL);
+    assert(e != NULL);
+
+    /* Pushed for about log2(members) periods, enough to reach everyone with high probability */
+
+    rumor.entry = *e;
+    rumor.incarnation = incarnation;
+    rumor.sends_left = 0;
+    rumor.started = sn_util_time_ms();
+
+    while(n) {
+        rumor.sends_left += SN_NODE_GOSSIP_REPEAT;
+        n >>= 1;
+    }
+
+    pthread_mutex_lock(&sns->gossip_mut);
+
+    /* Full, the change most spread already(the oldest on ties) makes room */
+
+    if(sn_data_hmap_size(&sns->rumors) >= SN_NODE_GOSSIP_MAX_RUMORS && sn_data_hmap_get(&sns->rumors, &e->addr, NULL) != 0) {
+        victim.sends_left = UINT_MAX;
+
+        while(sn_data_hmap_next(&sns->rumors, &iter, &addr, &other) == 0) {
+            if(other.sends_left < victim.sends_left || (other.sends_left == victim.sends_left && other.started < victim.started)) {
+                victim = other;
+                victim_addr = addr;
+            }
+        }
+
+        if(victim.sends_left != UINT_MAX)
+            sn_data_hmap_remove(&sns->rumors, &victim_addr, NULL);
+    }
+
+    sn_data_hmap_put(&sns->rumors, &e->addr, &rumor);
+
+    pthread_mutex_unlock(&sns->gossip_mut);
+}
+
+void gossip_tick(sn_node_t* sns, uint64_t now) {
+    sn_net_members_t* members;
+    sn_wire_members_header_t* header;
+    sn_wire_members_record_t* records;
+    unsigned char buf[SN_NET_PACKET_MAX_LEN];
+    const size_t max = (sizeof(buf) - sizeof(*header))/sizeof(*records);
+    sn_data_vec_t spent;
+    sn_net_addr_t addr;
+    sn_rumor_t rumor;
+    sn_heard_t heard;
+    size_t iter = 0, len = 0, spent_rumors, n, i;
+
+    assert(sns != NULL);
+
+    if(sns->geometry != &sn_net_geometry_onehop || sn_data_vec_init(&spent, sizeof(sn_net_addr_t)) != 0)
+        return;
+
+    members = (sn_net_members_t*)sns->geometry_state;
+    n = sn_net_members_size(members);
+
+    header = (sn_wire_members_header_t*)buf;
+    records = (sn_wire_members_record_t*)(header + 1);
+
+    pthread_mutex_lock(&sns->gossip_mut);
+
+    /* As many changes as fit, the others wait for the next periods */
+
+    while(n && len < max && sn_data_hmap_next(&sns->rumors, &iter, &addr, &rumor) == 0) {
+        if(sn_net_entry_ser(&rumor.entry, &records[len].entry) != 0)
+            continue;
+
+        records[len++].incarnation = rumor.incarnation;
+
+        if(--rumor.sends_left == 0)
+            sn_data_vec_push(&spent, &addr);
+        else
+            sn_data_hmap_put(&sns->rumors, &addr, &rumor);
+    }
+
+    spent_rumors = sn_data_vec_size(&spent);
+
+    /* And the members gone long enough to have been forgotten by everyone */
+
+    iter = 0;
+
+    while(sn_data_hmap_next(&sns->heard, &iter, &addr, &heard) == 0) {
+        if(!heard.alive && heard.since + SN_NODE_GOSSIP_FORGET_AFTER <= now)
+            sn_data_vec_push(&spent, &addr);
+    }
+
+    for(i = 0; sn_data_vec_at(&spent, i, &addr) == 0; ++i)
+        sn_data_hmap_remove(i < spent_rumors ? &sns->rumors : &sns->heard, &addr, NULL);
+
+    pthread_mutex_unlock(&sns->gossip_mut);
+
+    sn_data_vec_destroy(&spent);
+
+    if(len == 0)
+        return;
+
+    header->records_len = (uint16_t)len;
+    memset(header->reserved, 0, sizeof(header->reserved));
+
+    /* Pushed to random members */
+
+    for(i = 0; i < SN_MIN(n, (size_t)SN_NODE_GOSSIP_FANOUT); ++i) {
+        const sn_net_entry_t* e = sn_net_members_at(members, randombytes_uniform((uint32_t)n));
+
+        sn_node_send_direct(sns, &e->addr, &e->net_addr, SN_WIRE_NET_TYPE_MEMBERS,
+            sizeof(*header) + len*sizeof(*records), (const char*)buf);
+    }
+}
+
+sn_topic_t* topic_find(sn_node_t* sns, const sn_net_addr_t* topic) {
+    sn_topic_t* t;
+
+    return sn_data_hmap_get(&sns->topics, topic, &t) == 0 ? t : NULL;
+}
+
+sn_topic_t* topic_add(sn_node_t* sns, const sn_net_addr_t* topic, uint64_t now) {
+    sn_topic_t* t;
+
+    assert(sns != NULL);
+    assert(topic != NULL);
+
+    if((t = (sn_topic_t*)malloc(sizeof(sn_topic_t))) == NULL)
+        return NULL;
+
+    t->topic = *topic;
+    t->parent.is_set = 0;
+    t->subscribed = 0;
+
+    if(sn_data_vec_init(&t->children, sizeof(sn_topic_child_t)) != 0) {
+        free(t);
+        return NULL;
+    }
+
+    if(sn_data_hmap_put(&sns->topics, topic, &t) != 0) {
+        sn_data_vec_destroy(&t->children);
+        free(t);
+        return NULL;
+    }
+
+    topic_join(sns, t, now);
+
+    return t;
+}
+
+void topic_join(sn_node_t* sns, sn_topic_t* t, uint64_t now) {
+    sn_net_entry_t nexthop;
+
+    assert(sns != NULL);
+    assert(t != NULL);
+
+    /* A new nexthop towards the root takes over as parent */
+
+    sn_node_nexthop(sns, &t->topic, &nexthop);
+
+    if(t->parent.is_set && (!nexthop.is_set || sn_net_addr_cmp(&nexthop.addr, &t->parent.addr) != 0))
+        topic_send(sns, t, SN_WIRE_SUBSCRIBE_LEAVE);
+
+    t->parent = nexthop;
+    t->refresh = now + SN_NODE_TOPIC_REFRESH;
+
+    if(t->parent.is_set)
+        topic_send(sns, t, 0);
+}
+
+void topic_send(sn_node_t* sns, const sn_topic_t* t, uint8_t flags) {
+    sn_wire_subscribe_msg_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.flags = flags;
+
+    sn_node_send_direct(sns, &t->topic, &t->parent.net_addr, SN_WIRE_NET_TYPE_SUBSCRIBE, sizeof(msg), (const char*)&msg);
+}
+
+void topic_drop(sn_node_t* sns, sn_topic_t* t) {
+    assert(sns != NULL);
+    assert(t != NULL);
+
+    sn_data_hmap_remove(&sns->topics, &t->topic, NULL);
+
+    if(t->parent.is_set)
+        topic_send(sns, t, SN_WIRE_SUBSCRIBE_LEAVE);
+
+    sn_data_vec_destroy(&t->children);
+    free(t);
+}
+
+void topic_tick(sn_node_t* sns, uint64_t now) {
+    sn_data_vec_t idle;
+    sn_topic_child_t c;
+    sn_topic_t* t;
+    size_t iter = 0, i;
+
+    assert(sns != NULL);
+
+    if(sn_data_hmap_size(&sns->topics) == 0 || sn_data_vec_init(&idle, sizeof(sn_topic_t*)) != 0)
+        return;
+
+    while(sn_data_hmap_next(&sns->topics, &iter, NULL, &t) == 0) {
+        /* Children that stopped renewing, then our own renewal */
+
+        for(i = 0; sn_data_vec_at(&t->children, i, &c) == 0;) {
+            if(c.expires <= now)
+                sn_data_vec_remove_at(&t->children, i, NULL);
+            else
+                ++i;
+        }
+
+        if(!t->subscribed && sn_data_vec_size(&t->children) == 0)
+            sn_data_vec_push(&idle, &t);
+        else if(t->refresh <= now)
+            topic_join(sns, t, now);
+    }
+
+    for(i = 0; sn_data_vec_at(&idle, i, &t) == 0; ++i)
+        topic_drop(sns, t);
+
+    sn_data_vec_destroy(&idle);
+}
+
+int topic_spread(sn_node_t* sns, const sn_net_packet_t* packet, const sn_net_addr_t* from) {
+    const sn_wire_publish_header_t* header = (const sn_wire_publish_header_t*)packet->payload;
+    sn_wire_publish_header_t* payload = NULL;
+    sn_net_packet_t* copy = NULL;
+    const sn_net_packet_t** copies = NULL;
+    const sn_io_naddr_t** dsts = NULL;
+    sn_net_entry_t* children = NULL;
+    unsigned char nonce[8];
+    unsigned long long len;
+    sn_net_addr_t publisher, topic;
+    sn_topic_child_t c;
+    sn_topic_t* t;
+    size_t i, n = 0, k;
+    int sent;
+
+    len = packet->header.len - sizeof(*header);
+
+    if(sns->check_sign && sn_crypto_sign_check(&header->sign, (const sn_crypto_sign_pubkey_t*)&header->publisher,
+            (const unsigned char*)&header->topic, sizeof(*header) - offsetof(sn_wire_publish_header_t, topic) + len) != 0)
+        return -1;
+
+    if(sn_net_addr_deser(&publisher, &header->publisher) != 0 || sn_net_addr_deser(&topic, &header->topic) != 0)
+        return -1;
+
+    /* Once per publication, loops end here */
+
+    memset(nonce, 0, sizeof(nonce));
+    memcpy(nonce, &header->seq, sizeof(header->seq));
+
+    if(sn_node_dedup(sns, &publisher, nonce))
+        return 1;
+
+    if((t = topic_find(sns, &topic)) == NULL)
+        return 0;
+
+    /* The same copy to every child but the one it came from, addressed to the topic and signed once by us */
+
+    if((k = sn_data_vec_size(&t->children)) > 0) {
+        copies = (const sn_net_packet_t**)malloc(k*sizeof(sn_net_packet_t*));
+        dsts = (const sn_io_naddr_t**)malloc(k*sizeof(sn_io_naddr_t*));
+        children = (sn_net_entry_t*)malloc(k*sizeof(sn_net_entry_t));
+        payload = (sn_wire_publish_header_t*)malloc(packet->header.len);
+    }
+
+    if(copies != NULL && dsts != NULL && children != NULL && payload != NULL) {
+        memcpy(payload, header, packet->header.len);
+        payload->flags |= SN_WIRE_PUBLISH_DOWN;
+
+        if((copy = sn_net_packet_pack(&topic, &sns->self, SN_WIRE_NET_TYPE_PUBLISH, packet->header.len, (const char*)payload)) != NULL) {
+            if(sns->sign)
+                sn_net_packet_sign(copy, &sns->sk);
+
+            for(i = 0; sn_data_vec_at(&t->children, i, &c) == 0; ++i) {
+                if(sn_net_addr_cmp(&c.entry.addr, from) == 0)
+                    continue;
+
+                children[n] = c.entry;
+                copies[n] = copy;
+                dsts[n] = &children[n].net_addr;
+                ++n;
+            }
+
+            sent = sn_net_packet_send_many(copies, sns->socket, dsts, n);
+            sns->stats.tree_copies += (uint64_t)SN_MAX(sent, 0);
+        }
+    }
+
+    if(t->subscribed) {
+        void* argv[3];
+
+        argv[0] = &topic;
+        argv[1] = (void*)(header + 1);
+        argv[2] = &len;
+
+        sn_util_closure_call(&t->on_publish, 3, argv);
+    }
+
+    /* Children missing their copy are dropped once they stop renewing */
+
+    free(copy);
+    free(copies);
+    free(dsts);
+    free(children);
+    free(payload);
+
+    return 0;
+}
+
+int broadcast_split(sn_node_t* sns, const sn_wire_broadcast_header_t* header, size_t len, const char* msg) {
+    const size_t max = SN_NET_ROUTER_LEVELS*(SN_NET_ROUTER_COLUMNS - 1);
+    sn_net_packet_t* level_packets[SN_NET_ROUTER_LEVELS + 1];
+    const sn_net_packet_t** packets = NULL;
+    const sn_io_naddr_t** dsts = NULL;
+    sn_wire_broadcast_header_t* payload = NULL;
+    sn_net_addr_t origin, lo, hi;
+    sn_net_entry_t* entries;
+    uint8_t* levels;
+    size_t n = 0, i;
+    int sent = -1;
+
+    assert(sns != NULL);
+    assert(header != NULL);
+    assert(msg != NULL || len == 0);
+
+    sn_net_addr_deser(&origin, &header->origin);
+    sn_net_addr_deser(&lo, &header->lo);
+    sn_net_addr_deser(&hi, &header->hi);
+
+    memset(level_packets, 0, sizeof(level_packets));
+    entries = (sn_net_entry_t*)malloc(max*sizeof(sn_net_entry_t));
+    levels = (uint8_t*)malloc(max);
+
+    if(entries == NULL || levels == NULL)
+        goto end;
+
+    if((n = sn_net_router_split(&sns->router, header->level, &lo, &hi, entries, levels, max)) == 0) {
+        sent = 0;
+        goto end;
+    }
+
+    packets = (const sn_net_packet_t**)malloc(n*sizeof(sn_net_packet_t*));
+    dsts = (const sn_io_naddr_t**)malloc(n*sizeof(sn_io_naddr_t*));
+    payload = (sn_wire_broadcast_header_t*)malloc(sizeof(*payload) + len);
+
+    if(packets == NULL || dsts == NULL || payload == NULL)
+        goto end;
+
+    *payload = *header;
+    memcpy(payload + 1, msg, len);
+
+    /* Copies split from the same level are the same packet, signed once */
+
+    for(i = 0; i < n; ++i) {
+        if(level_packets[levels[i]] == NULL) {
+            payload->level = levels[i];
+
+            if((level_packets[levels[i]] = sn_net_packet_pack(&origin, &sns->self, SN_WIRE_NET_TYPE_BROADCAST, sizeof(*payload) + len, (const char*)payload)) == NULL)
+                goto end;
+
+            if(sns->sign)
+                sn_net_packet_sign(level_packets[levels[i]], &sns->sk);
+        }
+
+        packets[i] = level_packets[levels[i]];
+        dsts[i] = &entries[i].net_addr;
+    }
+
+    sent = sn_net_packet_send_many(packets, sns->socket, dsts, n);
+    sns->stats.broadcast_copies += (uint64_t)SN_MAX(sent, 0);
+
+end:
+    for(i = 0; i <= SN_NET_ROUTER_LEVELS; ++i)
+        free(level_packets[i]);
+
+    free(entries);
+    free(levels);
+    free(packets);
+    free(dsts);
+    free(payload);
+
+    return sent < 0 || (size_t)sent < n ? -1 : 0;
+}
+
+int aggregate_start(sn_node_t* sns, sn_aggregate_t* a, unsigned int level, uint64_t budget) {
+    const size_t max = SN_NET_ROUTER_LEVELS*(SN_NET_ROUTER_COLUMNS - 1);
+    sn_net_packet_t* level_packets[SN_NET_ROUTER_LEVELS + 1];
+    const sn_net_packet_t** packets = NULL;
+    const sn_io_naddr_t** dsts = NULL;
+    unsigned char key[SN_NET_ADDR_LEN];
+    sn_wire_aggregate_msg_t msg;
+    sn_net_entry_t* entries = NULL;
+    sn_net_addr_t lo, hi;
+    sn_util_closure_t closure;
+    uint8_t* levels = NULL;
+    size_t n = 0, i, sent = 0;
+
+    assert(sns != NULL);
+    assert(a != NULL);
+
+    a->id = sn_node_new_reply_id(sns);
+    a->deadline = sn_util_time_ms() + budget;
+    a->asked = NULL;
+    a->pending = 0;
+
+    memset(&a->result, 0, sizeof(a->result));
+    a->result.min = UINT64_MAX;
+    aggregate_record(&a->result, aggregate_value(sns, a->metric));
+
+    /* Children get what is left once we kept the time to answer, none if that is nothing */
+
+    memset(level_packets, 0, sizeof(level_packets));
+
+    if(budget > SN_NODE_AGGREGATE_HOP_MARGIN) {
+        memset(key, 0, sizeof(key));
+        sn_net_addr_init(&lo, key);
+        memset(key, 0xff, sizeof(key));
+        sn_net_addr_init(&hi, key);
+
+        entries = (sn_net_entry_t*)malloc(max*sizeof(sn_net_entry_t));
+        levels = (uint8_t*)malloc(max);
+
+        if(entries != NULL && levels != NULL)
+            n = sn_net_router_split(&sns->router, level, &lo, &hi, entries, levels, max);
+    }
+
+    if(n > 0) {
+        packets = (const sn_net_packet_t**)malloc(n*sizeof(sn_net_packet_t*));
+        dsts = (const sn_io_naddr_t**)malloc(n*sizeof(sn_io_naddr_t*));
+        a->asked = (sn_net_addr_t*)malloc(n*sizeof(sn_net_addr_t));
+    }
+
+    if(packets != NULL && dsts != NULL && a->asked != NULL) {
+        memset(&msg, 0, sizeof(msg));
+        msg.metric = a->metric;
+        msg.query_id = a->id;
+        msg.budget = (uint32_t)SN_MIN(budget - SN_NODE_AGGREGATE_HOP_MARGIN, UINT32_MAX);
+
+        for(i = 0; i < n; ++i) {
+            if(level_packets[levels[i]] == NULL) {
+                msg.level = levels[i];
+
+                if((level_packets[levels[i]] = sn_net_packet_pack(&sns->self, &sns->self, SN_WIRE_NET_TYPE_AGGREGATE, sizeof(msg), (const char*)&msg)) == NULL)
+                    break;
+
+                if(sns->sign)
+                    sn_net_packet_sign(level_packets[levels[i]], &sns->sk);
+            }
+
+            packets[i] = level_packets[levels[i]];
+            dsts[i] = &entries[i].net_addr;
+        }
+
+        /* Only children that got the query are waited for, the rest are skipped */
+
+        for(n = i, i = 0; i < n;) {
+            int ret = sn_net_packet_send_many(packets + i, sns->socket, dsts + i, n - i);
+
+            for(; ret > 0; --ret, ++i)
+                a->asked[sent++] = entries[i].addr;
+
+            if(i < n)
+                ++i;
+        }
+    }
+
+    for(i = 0; i <= SN_NET_ROUTER_LEVELS; ++i)
+        free(level_packets[i]);
+
+    free(entries);
+    free(levels);
+    free(packets);
+    free(dsts);
+
+    /* Leaves answer at once */
+
+    a->pending = (size_t)sent;
+
+    if(a->pending == 0 || sn_data_hmap_put(&sns->aggregates, &a->id, &a) != 0) {
+        aggregate_finish(sns, a);
+        return 0;
+    }
+
+    if(sn_data_hmap_size(&sns->aggregates) == 1) {
+        sn_util_closure_init_curried_once(&closure, on_aggregate_timer, sns);
+        sn_io_reactor_timer_start(sns->loop, &sns->aggregate_timer, SN_NODE_AGGREGATE_TICK, SN_NODE_AGGREGATE_TICK, &closure);
+    }
+
+    return 0;
+}
+
+void aggregate_finish(sn_node_t* sns, sn_aggregate_t* a) {
+    unsigned char buf[sizeof(sn_wire_aggregate_msg_t) + sizeof(sn_wire_aggregate_result_t)];
+    sn_wire_aggregate_msg_t* msg = (sn_wire_aggregate_msg_t*)buf;
+    sn_node_aggregate_t result;
+    void* argv[1];
+
+    assert(sns != NULL);
+    assert(a != NULL);
+
+    if(a->parent.is_set) {
+        memset(msg, 0, sizeof(*msg));
+        msg->flags = SN_WIRE_AGGREGATE_RESULT;
+        msg->metric = a->metric;
+        msg->query_id = a->parent_id;
+        memcpy(msg + 1, &a->result, sizeof(a->result));
+
+        sn_node_send_direct(sns, &a->parent.addr, &a->parent.net_addr, SN_WIRE_NET_TYPE_AGGREGATE, sizeof(buf), (const char*)buf);
+    } else {
+        result.count = a->result.count;
+        result.sum = a->result.sum;
+        result.min = a->result.min;
+        result.max = a->result.max;
+        memcpy(result.hist, a->result.hist, sizeof(result.hist));
+
+        argv[0] = &result;
+        sn_util_closure_call(&a->done, 1, argv);
+    }
+
+    free(a->asked);
+    free(a);
+}
+
+void aggregate_record(sn_wire_aggregate_result_t* result, uint64_t value) {
+    unsigned int bits = 0;
+
+    assert(result != NULL);
+
+    while(bits < 64 && (value >> bits) != 0)
+        ++bits;
+
+    ++result->count;
+    result->sum += value;
+    result->min = SN_MIN(result->min, value);
+    result->max = SN_MAX(result->max, value);
+    ++result->hist[SN_MIN(bits, SN_WIRE_AGGREGATE_BUCKETS - 1)];
+}
+
+void aggregate_merge(sn_wire_aggregate_result_t* result, const sn_wire_aggregate_result_t* other) {
+    size_t i;
+
+    assert(result != NULL);
+    assert(other != NULL);
+
+    result->count += other->count;
+    result->sum += other->sum;
+    result->min = SN_MIN(result->min, other->min);
+    result->max = SN_MAX(result->max, other->max);
+
+    for(i = 0; i < SN_WIRE_AGGREGATE_BUCKETS; ++i)
+        result->hist[i] += other->hist[i];
+}
+
+uint64_t aggregate_value(sn_node_t* sns, uint8_t metric) {
+    assert(sns != NULL);
+
+    switch(metric) {
+        case SN_NODE_METRIC_NODES:
+            return 1;
+        case SN_NODE_METRIC_RECEIVED:
+            return sns->stats.received;
+        case SN_NODE_METRIC_FORWARDED:
+            return sns->stats.forward_ns.count;
+        case SN_NODE_METRIC_KERNEL_DROPS:
+            return sns->stats.kernel_drops;
+        case SN_NODE_METRIC_QUEUE_NS:
+            return sns->stats.queue_ns.max;
+        default:
+            return 0;
+    }
+}
+
+void on_aggregate_timer(int argc, void* argv[]) {
+    sn_data_vec_t expired;
+    sn_aggregate_t* a;
+    sn_node_t* sns;
+    uint64_t now;
+    size_t iter = 0, i;
+
+    assert(argc == 2);
+
+    sns = (sn_node_t*)argv[0];
+    now = sn_util_time_ms();
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    /* Subtrees not answered in time are left out */
+
+    if(sn_data_vec_init(&expired, sizeof(sn_aggregate_t*)) == 0) {
+        while(sn_data_hmap_next(&sns->aggregates, &iter, NULL, &a) == 0)
+            if(a->deadline <= now)
+                sn_data_vec_push(&expired, &a);
+
+        for(i = 0; sn_data_vec_at(&expired, i, &a) == 0; ++i) {
+            sn_data_hmap_remove(&sns->aggregates, &a->id, NULL);
+            aggregate_finish(sns, a);
+        }
+
+        sn_data_vec_destroy(&expired);
+    }
+
+    if(sn_data_hmap_size(&sns->aggregates) == 0)
+        sn_io_reactor_timer_stop(sns->loop, &sns->aggregate_timer);
+
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+int store_request(sn_node_t* sns, uint8_t op, const sn_net_addr_t* key, size_t len, const char* value, uint64_t timeout_ms, const sn_util_closure_t* done) {
+    sn_wire_store_msg_t* msg;
+    sn_store_req_t* req;
+    sn_util_closure_t closure;
+    uint32_t reply_id;
+    int ret;
+
+    assert(sns != NULL);
+    assert(key != NULL);
+    assert(value != NULL || len == 0);
+    assert(done != NULL);
+
+    if(len > SN_NET_PACKET_MAX_LEN - sizeof(*msg))
+        return -1;
+
+    if((req = (sn_store_req_t*)malloc(sizeof(sn_store_req_t))) == NULL)
+        return -1;
+
+    if((msg = (sn_wire_store_msg_t*)malloc(sizeof(*msg) + len)) == NULL) {
+        free(req);
+        return -1;
+    }
+
+    req->op = op;
+    req->key = *key;
+    req->done = *done;
+    reply_id = sn_node_new_reply_id(sns);
+
+    memset(msg, 0, sizeof(*msg));
+    msg->op = op;
+    msg->reply_to = reply_id;
+    sn_net_addr_ser(key, &msg->key);
+    memcpy(msg + 1, value, len);
+
+    /* Registered before sending, we may answer ourselves */
+
+    sn_util_closure_init_curried_once(&closure, on_store_reply, req);
+
+    if(sn_node_register_reply(sns, reply_id, &closure, 1, timeout_ms) != 0) {
+        free(req);
+        free(msg);
+        return -1;
+    }
+
+    ret = sn_node_send_typed(sns, key, SN_WIRE_NET_TYPE_STORE, sizeof(*msg) + len, (const char*)msg);
+
+    free(msg);
+
+    /* Unless the listener was already called, which then freed the request */
+
+    if(ret != 0 && sn_node_unregister_reply(sns, reply_id) == 0) {
+        free(req);
+        return -1;
+    }
+
+    return 0;
+}
+
+int store_answer(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* rem_addr, uint8_t op, uint32_t reply_to, const sn_net_addr_t* key, uint64_t version, size_t len, const char* value) {
+    sn_wire_store_msg_t* msg;
+    int ret;
+
+    assert(sns != NULL);
+    assert(dst != NULL);
+    assert(key != NULL);
+    assert(value != NULL || len == 0);
+
+    if((msg = (sn_wire_store_msg_t*)malloc(sizeof(*msg) + len)) == NULL)
+        return -1;
+
+    memset(msg, 0, sizeof(*msg));
+    msg->op = op;
+    msg->reply_to = reply_to;
+    msg->version = version;
+    sn_net_addr_ser(key, &msg->key);
+    memcpy(msg + 1, value, len);
+
+    /* Back through the node that handed us the request, routed from there */
+
+    if(rem_addr != NULL)
+        ret = sn_node_send_direct(sns, dst, rem_addr, SN_WIRE_NET_TYPE_STORE, sizeof(*msg) + len, (const char*)msg);
+    else
+        ret = sn_node_send_typed_locked(sns, dst, SN_WIRE_NET_TYPE_STORE, sizeof(*msg) + len, (const char*)msg);
+
+    free(msg);
+
+    return ret;
+}
+
+void store_replicate(sn_node_t* sns, const sn_net_addr_t* key, const sn_data_store_item_t* item) {
+    const sn_net_entry_t* e;
+    int i, side;
+
+    assert(sns != NULL);
+    assert(key != NULL);
+    assert(item != NULL);
+
+    for(side = -1; side <= 1; side += 2) {
+        for(i = 1; i <= SN_NODE_STORE_REPLICAS; ++i) {
+            e = sn_net_router_leafset_get(&sns->router, side*i);
+
+            if(e == NULL || !e->is_set)
+                break;
+
+            if(store_answer(sns, &e->addr, &e->net_addr, SN_WIRE_STORE_REPLICA, 0, key, item->version, item->len, item->value) == 0)
+                ++sns->stats.store_replicas;
+        }
+    }
+}
+
+int store_replicates(sn_node_t* sns, const sn_net_addr_t* key) {
+    const sn_net_entry_t* near = sn_net_router_leafset_get(&sns->router, -SN_NODE_STORE_REPLICAS);
+    const sn_net_entry_t* far = sn_net_router_leafset_get(&sns->router, -SN_NODE_STORE_REPLICAS - 1);
+    sn_net_addr_t bound;
+
+    /*
+    Keys owned by us or by the SN_NODE_STORE_REPLICAS closest nodes on each side, bounded by the
+    midpoints with the next ones. Sides short of them end at the end of the keyspace.
+    */
+
+    if(near->is_set && far->is_set) {
+        sync_midpoint(&far->addr, &near->addr, &bound);
+
+        if(sn_net_addr_cmp(key, &bound) < 0)
+            return 0;
+    }
+
+    near = sn_net_router_leafset_get(&sns->router, SN_NODE_STORE_REPLICAS);
+    far = sn_net_router_leafset_get(&sns->router, SN_NODE_STORE_REPLICAS + 1);
+
+    if(near->is_set && far->is_set) {
+        sync_midpoint(&near->addr, &far->addr, &bound);
+
+        if(sn_net_addr_cmp(key, &bound) > 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+int store_neighbor(sn_node_t* sns, const sn_net_addr_t* addr) {
+    const sn_net_entry_t* e;
+    int p;
+
+    for(p = -SN_NET_ROUTER_LEAFSET_SIZE; p <= SN_NET_ROUTER_LEAFSET_SIZE; ++p) {
+        if(p != 0 && (e = sn_net_router_leafset_get(&sns->router, p))->is_set && sn_net_addr_cmp(&e->addr, addr) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+void on_store_reply(int argc, void* argv[]) {
+    const sn_wire_store_msg_t* msg;
+    sn_store_req_t* req;
+    sn_net_addr_t key;
+    unsigned long long len = 0;
+    uint64_t version = 0;
+    const char* value = NULL;
+    void* done_argv[3];
+
+    assert(argc == 4);
+
+    req = (sn_store_req_t*)argv[0];
+    msg = (const sn_wire_store_msg_t*)argv[1];
+
+    /* Timeouts, malformed answers and answers about another key look the same to the caller */
+
+    if(msg != NULL && *(unsigned long long*)argv[2] >= sizeof(*msg) &&
+            sn_net_addr_deser(&key, &msg->key) == 0 && sn_net_addr_cmp(&key, &req->key) == 0) {
+        version = msg->version;
+
+        if(req->op == SN_WIRE_STORE_GET && msg->op == SN_WIRE_STORE_VALUE) {
+            value = (const char*)(msg + 1);
+            len = *(unsigned long long*)argv[2] - sizeof(*msg);
+        } else if(req->op != SN_WIRE_STORE_PUT || msg->op != SN_WIRE_STORE_ACK) {
+            msg = NULL;
+        }
+    } else {
+        msg = NULL;
+    }
+
+    if(req->op == SN_WIRE_STORE_PUT) {
+        done_argv[0] = msg != NULL ? &version : NULL;
+        sn_util_closure_call(&req->done, 1, done_argv);
+    } else {
+        done_argv[0] = (void*)value;
+        done_argv[1] = &len;
+        done_argv[2] = value != NULL ? &version : NULL;
+        sn_util_closure_call(&req->done, 3, done_argv);
+    }
+
+    free(req);
+}
+
+int store_keep(sn_node_t* sns, const sn_net_addr_t* key, const char* value, size_t len, uint64_t version) {
+    unsigned char old_digest[SN_DATA_MERKLE_DIGEST_LEN], digest[SN_DATA_MERKLE_DIGEST_LEN];
+    sn_data_store_item_t old;
+    int found;
+
+    assert(sns != NULL);
+    assert(key != NULL);
+
+    /* The tree follows the store, the replaced version is toggled out of it */
+
+    if((found = sn_data_store_get(&sns->store, key, &old) == 0))
+        sn_data_merkle_item(key->key, SN_NET_ADDR_LEN, old.version, old.value, old.len, old_digest);
+
+    if(sn_data_store_put(&sns->store, key, value, len, version) != 0)
+        return -1;
+
+    sn_data_merkle_item(key->key, SN_NET_ADDR_LEN, version, value, len, digest);
+
+    if(found && sn_data_merkle_toggle(&sns->merkle, key->key, old_digest) != 0)
+        return -1;
+
+    return sn_data_merkle_toggle(&sns->merkle, key->key, digest);
+}
+
+int store_order(uint64_t version, const unsigned char* digest, uint64_t other_version, const unsigned char* other_digest) {
+    assert(digest != NULL);
+    assert(other_digest != NULL);
+
+    /* Versions first, their value digests break ties the same way everywhere */
+
+    if(version != other_version)
+        return version < other_version ? -1 : 1;
+
+    return memcmp(digest, other_digest, SN_DATA_MERKLE_DIGEST_LEN);
+}
+
+int sync_start(sn_node_t* sns) {
+    const sn_net_entry_t* left = sn_net_router_leafset_get(&sns->router, -1);
+    const sn_net_entry_t* right = sn_net_router_leafset_get(&sns->router, 1);
+    unsigned char raw[SN_NET_ADDR_LEN];
+    sn_net_addr_t lo, hi, bottom, top;
+    sn_wire_sync_digest_t root;
+    const sn_net_entry_t* e;
+    int i, side, ret = 0;
+
+    assert(sns != NULL);
+
+    memset(raw, 0, sizeof(raw));
+    sn_net_addr_init(&bottom, raw);
+    memset(raw, 0xff, sizeof(raw));
+    sn_net_addr_init(&top, raw);
+
+    /* We own the keys closer to us than to our closest neighbors */
+
+    if(left->is_set)
+        sync_midpoint(&left->addr, &sns->self, &lo);
+    else
+        lo = bottom;
+
+    if(right->is_set)
+        sync_midpoint(&sns->self, &right->addr, &hi);
+    else
+        hi = top;
+
+    memset(&root, 0, sizeof(root));
+
+    for(side = -1; side <= 1; side += 2) {
+        for(i = 1; i <= SN_NODE_STORE_REPLICAS; ++i) {
+            e = sn_net_router_leafset_get(&sns->router, side*i);
+
+            if(!e->is_set)
+                break;
+
+            /* Ranges wrapping around the keyspace are reconciled in two */
+
+            if(sn_net_addr_cmp(&lo, &hi) <= 0) {
+                sync_digest(sns, 0, 0, &lo, &hi, root.digest);
+                ret |= sync_send(sns, &e->addr, &e->net_addr, SN_WIRE_SYNC_DIGESTS, &lo, &hi, &root, sizeof(root), 1);
+            } else {
+                sync_digest(sns, 0, 0, &lo, &top, root.digest);
+                ret |= sync_send(sns, &e->addr, &e->net_addr, SN_WIRE_SYNC_DIGESTS, &lo, &top, &root, sizeof(root), 1);
+                sync_digest(sns, 0, 0, &bottom, &hi, root.digest);
+                ret |= sync_send(sns, &e->addr, &e->net_addr, SN_WIRE_SYNC_DIGESTS, &bottom, &hi, &root, sizeof(root), 1);
+            }
+        }
+    }
+
+    return ret;
+}
+
+void sync_tick(sn_node_t* sns, uint64_t now) {
+    assert(sns != NULL);
+
+    if(now < sns->sync_next)
+        return;
+
+    sns->sync_next = now + SN_NODE_SYNC_PERIOD;
+    sync_start(sns);
+}
+
+int sync_send(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* net_addr, uint8_t op, const sn_net_addr_t* lo, const sn_net_addr_t* hi, const void* entries, size_t entry_size, size_t count) {
+    const size_t max = (SN_NET_PACKET_MAX_LEN - sizeof(sn_wire_sync_header_t))/entry_size;
+    sn_wire_sync_header_t* header;
+    size_t sent = 0, n;
+    char* buf;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(entries != NULL || count == 0);
+
+    if((buf = (char*)malloc(SN_NET_PACKET_MAX_LEN)) == NULL)
+        return -1;
+
+    header = (sn_wire_sync_header_t*)buf;
+    memset(header, 0, sizeof(*header));
+    header->op = op;
+    sn_net_addr_ser(lo, &header->lo);
+    sn_net_addr_ser(hi, &header->hi);
+
+    /* As many entries per packet as fit, empty lists are sent too */
+
+    do {
+        n = SN_MIN(count - sent, max);
+        header->count = (uint16_t)n;
+        memcpy(header + 1, (const char*)entries + sent*entry_size, n*entry_size);
+
+        if(sn_node_send_direct(sns, dst, net_addr, SN_WIRE_NET_TYPE_SYNC, sizeof(*header) + n*entry_size, buf) != 0)
+            ret = -1;
+        else if(op == SN_WIRE_SYNC_DIGESTS)
+            sns->stats.sync_digests += n;
+
+        sent += n;
+    } while(sent < count);
+
+    free(buf);
+
+    return ret;
+}
+
+int sync_digests(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, const sn_net_addr_t* lo, const sn_net_addr_t* hi, const sn_wire_sync_digest_t* digests, size_t count) {
+    unsigned char mine[SN_DATA_MERKLE_DIGEST_LEN];
+    sn_data_vec_t children, leaves;
+    sn_wire_sync_digest_t d, child;
+    sn_net_addr_t span_lo, span_hi;
+    uint32_t c;
+    size_t i;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(digests != NULL || count == 0);
+
+    if(sn_data_vec_init(&children, sizeof(sn_wire_sync_digest_t)) != 0)
+        return -1;
+
+    if(sn_data_vec_init(&leaves, sizeof(uint32_t)) != 0) {
+        sn_data_vec_destroy(&children);
+        return -1;
+    }
+
+    memset(&child, 0, sizeof(child));
+
+    for(i = 0; i < count; ++i) {
+        memcpy(&d, &digests[i], sizeof(d));
+
+        if(d.level > SN_DATA_MERKLE_DEPTH || (uint64_t)d.index >> 4*d.level != 0)
+            continue;
+
+        if(!sync_span(d.level, d.index, lo, hi, &span_lo, &span_hi))
+            continue;
+
+        sync_digest(sns, d.level, d.index, lo, hi, mine);
+
+        if(memcmp(mine, d.digest, sizeof(mine)) == 0)
+            continue;
+
+        if(d.level == SN_DATA_MERKLE_DEPTH) {
+            sn_data_vec_push(&leaves, &d.index);
+            continue;
+        }
+
+        for(c = 0; c < SN_DATA_MERKLE_FANOUT; ++c) {
+            child.level = d.level + 1;
+            child.index = d.index*SN_DATA_MERKLE_FANOUT + c;
+
+            if(!sync_span(child.level, child.index, lo, hi, &span_lo, &span_hi))
+                continue;
+
+            sync_digest(sns, child.level, child.index, lo, hi, child.digest);
+            sn_data_vec_push(&children, &child);
+        }
+    }
+
+    if(sn_data_vec_size(&children))
+        ret |= sync_send(sns, src, rem_addr, SN_WIRE_SYNC_DIGESTS, lo, hi, children.vec, sizeof(sn_wire_sync_digest_t), sn_data_vec_size(&children));
+
+    if(sn_data_vec_size(&leaves))
+        ret |= sync_list(sns, src, rem_addr, lo, hi, &leaves);
+
+    sn_data_vec_destroy(&children);
+    sn_data_vec_destroy(&leaves);
+
+    return ret;
+}
+
+void sync_digest(sn_node_t* sns, unsigned int level, uint32_t index, const sn_net_addr_t* lo, const sn_net_addr_t* hi, unsigned char* out) {
+    unsigned char children[SN_DATA_MERKLE_FANOUT][SN_DATA_MERKLE_DIGEST_LEN];
+    unsigned char digest[SN_DATA_MERKLE_DIGEST_LEN], zero[SN_DATA_MERKLE_DIGEST_LEN];
+    sn_data_store_item_t item;
+    sn_net_addr_t key, span_lo, span_hi;
+    size_t iter = 0, i;
+
+    assert(sns != NULL);
+    assert(out != NULL);
+
+    memset(out, 0, SN_DATA_MERKLE_DIGEST_LEN);
+
+    if(!sync_span(level, index, lo, hi, &span_lo, &span_hi))
+        return;
+
+    /* Nodes inside the range have their digest kept, the ones straddling it are hashed the same way over its keys alone */
+
+    if(sync_inside(level, index, lo, hi)) {
+        sn_data_merkle_digest(&sns->merkle, level, index, out);
+        return;
+    }
+
+    if(level == SN_DATA_MERKLE_DEPTH) {
+        while(sn_data_store_next(&sns->store, &iter, &key, &item) == 0) {
+            if(sn_net_addr_cmp(&key, &span_lo) < 0 || sn_net_addr_cmp(&key, &span_hi) > 0)
+                continue;
+
+            sn_data_merkle_item(key.key, SN_NET_ADDR_LEN, item.version, item.value, item.len, digest);
+
+            for(i = 0; i < SN_DATA_MERKLE_DIGEST_LEN; ++i)
+                out[i] ^= digest[i];
+        }
+
+        return;
+    }
+
+    memset(zero, 0, sizeof(zero));
+
+    for(i = 0; i < SN_DATA_MERKLE_FANOUT; ++i)
+        sync_digest(sns, level + 1, index*SN_DATA_MERKLE_FANOUT + (uint32_t)i, lo, hi, children[i]);
+
+    for(i = 0; i < SN_DATA_MERKLE_FANOUT && memcmp(children[i], zero, sizeof(zero)) == 0; ++i);
+
+    if(i < SN_DATA_MERKLE_FANOUT)
+        crypto_generichash(out, SN_DATA_MERKLE_DIGEST_LEN, &children[0][0], sizeof(children), NULL, 0);
+}
+
+int sync_list(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, const sn_net_addr_t* lo, const sn_net_addr_t* hi, sn_data_vec_t* leaves) {
+    const size_t max = (SN_NET_PACKET_MAX_LEN - sizeof(sn_wire_sync_header_t))/sizeof(sn_wire_sync_item_t);
+    sn_wire_sync_item_t* items;
+    sn_data_store_item_t item;
+    sn_data_hmap_t wanted;
+    sn_data_vec_t found;
+    sn_wire_sync_item_t entry;
+    sn_net_addr_t key, span_lo, span_hi, chunk_lo, chunk_hi;
+    uint32_t leaf;
+    size_t iter = 0, i, next = 0, end, n;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(leaves != NULL);
+
+    if(sn_data_hmap_init(&wanted, sizeof(uint32_t), 0) != 0)
+        return -1;
+
+    if(sn_data_vec_init(&found, sizeof(sn_wire_sync_item_t)) != 0) {
+        sn_data_hmap_destroy(&wanted);
+        return -1;
+    }
+
+    for(i = 0; sn_data_vec_at(leaves, i, &leaf) == 0; ++i)
+        sn_data_hmap_put(&wanted, &leaf, &leaf);
+
+    /* A single pass over the store, keys sorted so each leaf is a run */
+
+    while(sn_data_store_next(&sns->store, &iter, &key, &item) == 0) {
+        if(sn_net_addr_cmp(&key, lo) < 0 || sn_net_addr_cmp(&key, hi) > 0)
+            continue;
+
+        leaf = sn_data_merkle_index(key.key, SN_DATA_MERKLE_DEPTH);
+
+        if(sn_data_hmap_get(&wanted, &leaf, NULL) != 0)
+            continue;
+
+        sn_net_addr_ser(&key, &entry.key);
+        entry.version = item.version;
+        sn_data_merkle_item(key.key, SN_NET_ADDR_LEN, item.version, item.value, item.len, entry.digest);
+        sn_data_vec_push(&found, &entry);
+    }
+
+    items = (sn_wire_sync_item_t*)found.vec;
+    qsort(items, sn_data_vec_size(&found), sizeof(sn_wire_sync_item_t), sync_item_cmp);
+    qsort(leaves->vec, sn_data_vec_size(leaves), sizeof(uint32_t), sync_leaf_cmp);
+
+    /* Every leaf gets a list, even an empty one, chunks covering consecutive spans */
+
+    for(i = 0; sn_data_vec_at(leaves, i, &leaf) == 0; ++i) {
+        sync_span(SN_DATA_MERKLE_DEPTH, leaf, lo, hi, &span_lo, &span_hi);
+
+        for(end = next; end < sn_data_vec_size(&found) && sn_data_merkle_index(items[end].key.key, SN_DATA_MERKLE_DEPTH) == leaf; ++end);
+
+        chunk_lo = span_lo;
+
+        do {
+            n = SN_MIN(end - next, max);
+
+            if(next + n < end) {
+                sn_net_addr_deser(&chunk_hi, &items[next + n - 1].key);
+            } else {
+                chunk_hi = span_hi;
+            }
+
+            ret |= sync_send(sns, src, rem_addr, SN_WIRE_SYNC_ITEMS, &chunk_lo, &chunk_hi, &items[next], sizeof(sn_wire_sync_item_t), n);
+
+            sync_successor(&chunk_hi, &chunk_lo);
+            next += n;
+        } while(next < end);
+    }
+
+    sn_data_vec_destroy(&found);
+    sn_data_hmap_destroy(&wanted);
+
+    return ret;
+}
+
+int sync_items(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, const sn_net_addr_t* lo, const sn_net_addr_t* hi, const sn_wire_sync_item_t* items, size_t count) {
+    unsigned char digest[SN_DATA_MERKLE_DIGEST_LEN];
+    sn_data_store_item_t item;
+    sn_data_hmap_t remote;
+    sn_data_vec_t want;
+    sn_wire_sync_item_t entry;
+    sn_net_addr_t key;
+    size_t iter = 0, i;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(items != NULL || count == 0);
+
+    if(sn_data_hmap_init(&remote, sizeof(sn_net_addr_t), sizeof(sn_wire_sync_item_t)) != 0)
+        return -1;
+
+    if(sn_data_vec_init(&want, sizeof(sn_net_addr_ser_t)) != 0) {
+        sn_data_hmap_destroy(&remote);
+        return -1;
+    }
+
+    /* Theirs we lack or have older */
+
+    for(i = 0; i < count; ++i) {
+        memcpy(&entry, &items[i], sizeof(entry));
+
+        if(sn_net_addr_deser(&key, &entry.key) != 0 || sn_net_addr_cmp(&key, lo) < 0 || sn_net_addr_cmp(&key, hi) > 0)
+            continue;
+
+        sn_data_hmap_put(&remote, &key, &entry);
+
+        if(sn_data_store_get(&sns->store, &key, &item) != 0) {
+            sn_data_vec_push(&want, &entry.key);
+            continue;
+        }
+
+        sn_data_merkle_item(key.key, SN_NET_ADDR_LEN, item.version, item.value, item.len, digest);
+
+        if(store_order(item.version, digest, entry.version, entry.digest) < 0)
+            sn_data_vec_push(&want, &entry.key);
+    }
+
+    /* Ours they lack or have older */
+
+    while(sn_data_store_next(&sns->store, &iter, &key, &item) == 0) {
+        if(sn_net_addr_cmp(&key, lo) < 0 || sn_net_addr_cmp(&key, hi) > 0)
+            continue;
+
+        sn_data_merkle_item(key.key, SN_NET_ADDR_LEN, item.version, item.value, item.len, digest);
+
+        if(sn_data_hmap_get(&remote, &key, &entry) == 0 && store_order(entry.version, entry.digest, item.version, digest) >= 0)
+            continue;
+
+        if(store_answer(sns, src, rem_addr, SN_WIRE_STORE_REPLICA, 0, &key, item.version, item.len, item.value) == 0)
+            ++sns->stats.sync_items;
+        else
+            ret = -1;
+    }
+
+    if(sn_data_vec_size(&want))
+        ret |= sync_send(sns, src, rem_addr, SN_WIRE_SYNC_WANT, lo, hi, want.vec, sizeof(sn_net_addr_ser_t), sn_data_vec_size(&want));
+
+    sn_data_vec_destroy(&want);
+    sn_data_hmap_destroy(&remote);
+
+    return ret;
+}
+
+int sync_want(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, const sn_net_addr_ser_t* keys, size_t count) {
+    sn_data_store_item_t item;
+    sn_net_addr_ser_t ser;
+    sn_net_addr_t key;
+    size_t i;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(keys != NULL || count == 0);
+
+    for(i = 0; i < count; ++i) {
+        memcpy(&ser, &keys[i], sizeof(ser));
+
+        if(sn_net_addr_deser(&key, &ser) != 0 || sn_data_store_get(&sns->store, &key, &item) != 0)
+            continue;
+
+        if(store_answer(sns, src, rem_addr, SN_WIRE_STORE_REPLICA, 0, &key, item.version, item.len, item.value) == 0)
+            ++sns->stats.sync_items;
+        else
+            ret = -1;
+    }
+
+    return ret;
+}
+
+int sync_span(unsigned int level, uint32_t index, const sn_net_addr_t* lo, const sn_net_addr_t* hi, sn_net_addr_t* out_lo, sn_net_addr_t* out_hi) {
+    unsigned char first[SN_NET_ADDR_LEN], last[SN_NET_ADDR_LEN];
+    unsigned char digit;
+    unsigned int d;
+
+    /* Keys starting with the node digits, clipped to the range */
+
+    memset(first, 0, sizeof(first));
+    memset(last, 0xff, sizeof(last));
+
+    for(d = 0; d < level; ++d) {
+        digit = (unsigned char)((index >> 4*(level - 1 - d)) & 0x0f);
+
+        if(d%2 == 0) {
+            first[d/2] = (unsigned char)((first[d/2] & 0x0f) | digit << 4);
+            last[d/2] = (unsigned char)((last[d/2] & 0x0f) | digit << 4);
+        } else {
+            first[d/2] = (unsigned char)((first[d/2] & 0xf0) | digit);
+            last[d/2] = (unsigned char)((last[d/2] & 0xf0) | digit);
+        }
+    }
+
+    sn_net_addr_init(out_lo, first);
+    sn_net_addr_init(out_hi, last);
+
+    if(sn_net_addr_cmp(out_lo, hi) > 0 || sn_net_addr_cmp(lo, out_hi) > 0)
+        return 0;
+
+    if(sn_net_addr_cmp(out_lo, lo) < 0)
+        *out_lo = *lo;
+
+    if(sn_net_addr_cmp(out_hi, hi) > 0)
+        *out_hi = *hi;
+
+    return 1;
+}
+
+int sync_inside(unsigned int level, uint32_t index, const sn_net_addr_t* lo, const sn_net_addr_t* hi) {
+    sn_net_addr_t span_lo, span_hi, unclipped_lo, unclipped_hi;
+    unsigned char raw[SN_NET_ADDR_LEN];
+
+    memset(raw, 0, sizeof(raw));
+    sn_net_addr_init(&unclipped_lo, raw);
+    memset(raw, 0xff, sizeof(raw));
+    sn_net_addr_init(&unclipped_hi, raw);
+
+    /* Clipping to the whole keyspace gives the full span */
+
+    sync_span(level, index, &unclipped_lo, &unclipped_hi, &span_lo, &span_hi);
+
+    return sn_net_addr_cmp(lo, &span_lo) <= 0 && sn_net_addr_cmp(&span_hi, hi) <= 0;
+}
+
+void sync_midpoint(const sn_net_addr_t* a, const sn_net_addr_t* b, sn_net_addr_t* out) {
+    unsigned char dist[SN_NET_ADDR_LEN], mid[SN_NET_ADDR_LEN];
+    int i, borrow = 0, carry = 0, v;
+
+    /* a + (b - a)/2, going up from a and wrapping around */
+
+    for(i = SN_NET_ADDR_LEN - 1; i >= 0; --i) {
+        v = b->key[i] - a->key[i] - borrow;
+        borrow = v < 0;
+        dist[i] = (unsigned char)(v & 0xff);
+    }
+
+    for(i = SN_NET_ADDR_LEN - 1; i >= 0; --i)
+        dist[i] = (unsigned char)(dist[i] >> 1 | (i > 0 ? (dist[i - 1] & 1) << 7 : 0));
+
+    for(i = SN_NET_ADDR_LEN - 1; i >= 0; --i) {
+        v = a->key[i] + dist[i] + carry;
+        carry = v >> 8;
+        mid[i] = (unsigned char)(v & 0xff);
+    }
+
+    sn_net_addr_init(out, mid);
+}
+
+void sync_successor(const sn_net_addr_t* addr, sn_net_addr_t* out) {
+    unsigned char raw[SN_NET_ADDR_LEN];
+    int i;
+
+    memcpy(raw, addr->key, sizeof(raw));
+
+    for(i = SN_NET_ADDR_LEN - 1; i >= 0 && ++raw[i] == 0; --i);
+
+    sn_net_addr_init(out, raw);
+}
+
+int sync_item_cmp(const void* a, const void* b) {
+    return memcmp(((const sn_wire_sync_item_t*)a)->key.key, ((const sn_wire_sync_item_t*)b)->key.key, SN_NET_ADDR_LEN);
+}
+
+int sync_leaf_cmp(const void* a, const void* b) {
+    uint32_t la = *(const uint32_t*)a, lb = *(const uint32_t*)b;
+
+    return la < lb ? -1 : la > lb;
+}
+
+int object_request(sn_node_t* sns, sn_object_req_t* req, const sn_net_addr_t* key, const char* msgs, size_t count, size_t msg_len, uint64_t timeout_ms) {
+    sn_util_closure_t closure;
+    size_t i;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(req != NULL);
+    assert(key != NULL);
+    assert(msgs != NULL);
+
+    req->sns = sns;
+    req->stored = 0;
+    req->answers = 0;
+    req->pieces = 0;
+
+    /* Answered many times, the listener is removed once we have enough */
+
+    sn_util_closure_init_curried_once(&closure, on_object_reply, req);
+
+    if(sn_node_register_reply(sns, req->reply_id, &closure, 0, timeout_ms) != 0) {
+        free(req);
+        return -1;
+    }
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    /* Messages take their slot up to the end of their part */
+
+    for(i = 0; i < count && ret == 0; ++i)
+        ret = object_queue(sns, key, NULL, sizeof(sn_wire_object_msg_t) + object_part_len((const sn_wire_object_msg_t*)(msgs + i*msg_len)), msgs + i*msg_len);
+
+    pthread_mutex_unlock(&sns->task_mut);
+
+    /* Unless the listener was already called for good, which then freed the request */
+
+    if(ret != 0 && sn_node_unregister_reply(sns, req->reply_id) == 0) {
+        free(req);
+        return -1;
+    }
+
+    return 0;
+}
+
+int object_send(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* net_addr, const sn_wire_object_msg_t* header, uint8_t op, unsigned int index, size_t len, const char* fragment) {
+    sn_wire_object_msg_t* msg;
+    int ret;
+
+    assert(sns != NULL);
+    assert(dst != NULL);
+    assert(header != NULL);
+    assert(fragment != NULL || len == 0);
+
+    if((msg = (sn_wire_object_msg_t*)malloc(sizeof(*msg) + len)) == NULL)
+        return -1;
+
+    *msg = *header;
+    msg->op = op;
+    msg->index = (uint8_t)index;
+    memcpy(msg + 1, fragment, len);
+
+    ret = object_queue(sns, dst, net_addr, sizeof(*msg) + len, (const char*)msg);
+
+    free(msg);
+
+    return ret;
+}
+
+int object_queue(sn_node_t* sns, const sn_net_addr_t* dst, const sn_io_naddr_t* net_addr, size_t len, const char* payload) {
+    sn_util_closure_t closure;
+    sn_object_out_t out;
+
+    assert(sns != NULL);
+    assert(dst != NULL);
+    assert(payload != NULL);
+
+    if((out.packet = sn_net_packet_pack(dst, &sns->self, SN_WIRE_NET_TYPE_OBJECT, len, payload)) == NULL)
+        return -1;
+
+    if(sns->sign)
+        sn_net_packet_sign(out.packet, &sns->sk);
+
+    /* Straight to the holders, routed to the owner and the origin */
+
+    out.direct = net_addr != NULL;
+
+    if(net_addr != NULL)
+        out.net_addr = *net_addr;
+
+    if(sn_data_vec_push(&sns->object_out, &out) != 0) {
+        free(out.packet);
+        return -1;
+    }
+
+    if(sn_data_vec_size(&sns->object_out) - sns->object_out_next == 1) {
+        sn_util_closure_init_curried_once(&closure, on_object_timer, sns);
+        sn_io_reactor_timer_start(sns->loop, &sns->object_timer, 0, SN_NODE_OBJECT_TICK, &closure);
+    }
+
+    return 0;
+}
+
+void on_object_timer(int argc, void* argv[]) {
+    sn_object_out_t out;
+    sn_node_t* sns;
+    size_t sent;
+    uint8_t ttl;
+    int ret;
+
+    assert(argc == 2);
+
+    sns = (sn_node_t*)argv[0];
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    /* In order, so the MISSING ending an answer follows its fragments. Local deliveries may queue more */
+
+    for(sent = 0; sent < SN_NODE_OBJECT_BURST && sn_data_vec_at(&sns->object_out, sns->object_out_next, &out) == 0; ++sent) {
+        ttl = out.packet->header.ttl;
+        errno = 0;
+
+        if(out.direct)
+            ret = sn_net_packet_send(out.packet, sns->socket, &out.net_addr);
+        else
+            ret = forward(sns, out.packet, NULL);
+
+        /* A full socket has the packet wait for the next burst */
+
+        if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            out.packet->header.ttl = ttl;
+            break;
+        }
+
+        ++sns->object_out_next;
+        free(out.packet);
+    }
+
+    if(sns->object_out_next == sn_data_vec_size(&sns->object_out)) {
+        while(sn_data_vec_remove_at(&sns->object_out, sn_data_vec_size(&sns->object_out) - 1, NULL) == 0)
+            ;
+
+        sns->object_out_next = 0;
+        sn_io_reactor_timer_stop(sns->loop, &sns->object_timer);
+        sn_io_reactor_timer_stop(sns->loop, &sns->reply_timer);
+    }
+
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+int object_position(unsigned int index) {
+    /* The first fragment on the owner, then alternately right and left: +1, -1, +2, -2... */
+
+    return index == 0 ? 0 : (int)(index + 1)/2*(index%2 ? 1 : -1);
+}
+
+const sn_net_entry_t* object_place(sn_node_t* sns, const sn_net_addr_t* key, unsigned int index) {
+    const sn_net_entry_t *e, *owner;
+    sn_net_addr_t best, dist;
+    int p, at = 0;
+
+    assert(sns != NULL);
+    assert(key != NULL);
+
+    /* Placed around the key owner as we see it, so any holder finds where its fragments go */
+
+    owner = sn_net_router_leafset_get(&sns->router, 0);
+    sn_net_addr_dist(&owner->addr, key, &best);
+
+    for(p = -SN_NET_ROUTER_LEAFSET_SIZE; p <= SN_NET_ROUTER_LEAFSET_SIZE; ++p) {
+        e = sn_net_router_leafset_get(&sns->router, p);
+
+        if(p == 0 || !e->is_set)
+            continue;
+
+        sn_net_addr_dist(&e->addr, key, &dist);
+
+        if(sn_net_addr_cmp(&dist, &best) < 0) {
+            best = dist;
+            owner = e;
+            at = p;
+        }
+    }
+
+    /* Past the leafset or on an unset entry the owner keeps the fragment */
+
+    p = at + object_position(index);
+    e = p >= -SN_NET_ROUTER_LEAFSET_SIZE && p <= SN_NET_ROUTER_LEAFSET_SIZE ? sn_net_router_leafset_get(&sns->router, p) : NULL;
+
+    if(e == NULL || !e->is_set)
+        e = owner;
+
+    return e == sn_net_router_leafset_get(&sns->router, 0) ? NULL : e;
+}
+
+size_t object_parts(const sn_wire_object_msg_t* msg) {
+    size_t frag_len;
+
+    assert(msg != NULL);
+
+    frag_len = ((size_t)msg->len + msg->data - 1)/msg->data;
+
+    return frag_len ? (frag_len + SN_NODE_OBJECT_PART_MAX - 1)/SN_NODE_OBJECT_PART_MAX : 1;
+}
+
+size_t object_part_len(const sn_wire_object_msg_t* msg) {
+    size_t frag_len;
+
+    assert(msg != NULL);
+
+    frag_len = ((size_t)msg->len + msg->data - 1)/msg->data;
+
+    if((size_t)msg->part*SN_NODE_OBJECT_PART_MAX >= frag_len)
+        return 0;
+
+    return SN_MIN(SN_NODE_OBJECT_PART_MAX, frag_len - (size_t)msg->part*SN_NODE_OBJECT_PART_MAX);
+}
+
+int object_keep(sn_node_t* sns, const sn_wire_object_msg_t* msg, size_t len) {
+    sn_data_store_item_t item;
+    sn_fragment_key_t key;
+
+    assert(sns != NULL);
+    assert(msg != NULL);
+
+    memset(&key, 0, sizeof(key));
+    key.index = msg->index;
+    key.part = msg->part;
+
+    if(sn_net_addr_deser(&key.key, &msg->key) != 0)
+        return -1;
+
+    /* Kept whole, the header has what answering needs. Parts already held or overtaken on the way are dropped */
+
+    if(sn_data_store_get(&sns->fragments, &key, &item) == 0 && item.version >= msg->version)
+        return 0;
+
+    if(sn_data_store_put(&sns->fragments, &key, (const char*)msg, sizeof(*msg) + len, msg->version) != 0)
+        return -1;
+
+    return 1;
+}
+
+int object_whole(sn_node_t* sns, const sn_wire_object_msg_t* msg) {
+    sn_data_store_item_t item;
+    sn_fragment_key_t key;
+    size_t parts = object_parts(msg);
+
+    assert(sns != NULL);
+
+    memset(&key, 0, sizeof(key));
+    key.index = msg->index;
+
+    if(sn_net_addr_deser(&key.key, &msg->key) != 0)
+        return 0;
+
+    for(key.part = 0; key.part < parts; ++key.part)
+        if(sn_data_store_get(&sns->fragments, &key, &item) != 0 || item.version != msg->version)
+            return 0;
+
+    /* Parts of an older and longer version are left over */
+
+    for(; key.part < SN_NODE_OBJECT_PARTS; ++key.part)
+        if(sn_data_store_get(&sns->fragments, &key, &item) == 0 && item.version < msg->version)
+            sn_data_store_remove(&sns->fragments, &key);
+
+    return 1;
+}
+
+void object_tick(sn_node_t* sns) {
+    sn_wire_object_msg_t header;
+    const sn_net_entry_t* e;
+    sn_data_store_item_t item;
+    sn_fragment_key_t* moved;
+    size_t iter = 0, count = 0, i;
+
+    assert(sns != NULL);
+
+    /* Fragments follow the leafset, moved to where a put now places them */
+
+    if(sns->fragments_version == sn_net_router_version(&sns->router))
+        return;
+
+    if((moved = (sn_fragment_key_t*)malloc((sn_data_store_size(&sns->fragments) + 1)*sizeof(sn_fragment_key_t))) == NULL)
+        return;
+
+    sns->fragments_version = sn_net_router_version(&sns->router);
+
+    while(sn_data_store_next(&sns->fragments, &iter, &moved[count], &item) == 0) {
+        if(item.len < sizeof(header) || (e = object_place(sns, &moved[count].key, moved[count].index)) == NULL)
+            continue;
+
+        /* Sent with no one to answer, only what left is forgotten */
+
+        memcpy(&header, item.value, sizeof(header));
+        header.reply_to = 0;
+
+        if(object_send(sns, &e->addr, &e->net_addr, &header, SN_WIRE_OBJECT_PLACE, header.index, item.len - sizeof(header), item.value + sizeof(header)) == 0)
+            ++count;
+    }
+
+    for(i = 0; i < count; ++i)
+        sn_data_store_remove(&sns->fragments, &moved[i]);
+
+    free(moved);
+}
+
+int object_gather(sn_node_t* sns, const sn_wire_object_msg_t* msg) {
+    const sn_net_entry_t* e;
+    sn_net_addr_t key;
+    unsigned int i;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(msg != NULL);
+
+    if(sn_net_addr_deser(&key, &msg->key) != 0)
+        return -1;
+
+    /* Every place asked once per fragment, each ask ends with a MISSING */
+
+    for(i = 0; i < (unsigned int)msg->data + msg->parity; ++i) {
+        if((e = object_place(sns, &key, i)) != NULL)
+            ret |= object_send(sns, &e->addr, &e->net_addr, msg, SN_WIRE_OBJECT_GATHER, i, 0, NULL);
+        else
+            ret |= object_lookup(sns, msg);
+    }
+
+    return ret;
+}
+
+int object_lookup(sn_node_t* sns, const sn_wire_object_msg_t* msg) {
+    sn_wire_object_msg_t answer;
+    sn_data_store_item_t item;
+    sn_fragment_key_t key;
+    sn_net_addr_t origin;
+    size_t parts, p;
+    int ret = 0;
+
+    assert(sns != NULL);
+    assert(msg != NULL);
+
+    memset(&key, 0, sizeof(key));
+
+    if(sn_net_addr_deser(&key.key, &msg->key) != 0 || sn_net_addr_deser(&origin, &msg->origin) != 0)
+        return -1;
+
+    /* Whatever fragments of the key we hold, wherever the leafset placed them */
+
+    for(key.index = 0; key.index < (uint32_t)msg->data + msg->parity; ++key.index) {
+        key.part = 0;
+
+        if(sn_data_store_get(&sns->fragments, &key, &item) != 0 || item.len < sizeof(answer))
+            continue;
+
+        memcpy(&answer, item.value, sizeof(answer));
+
+        if(!object_whole(sns, &answer))
+            continue;
+
+        parts = object_parts(&answer);
+
+        for(p = 0; p < parts; ++p) {
+            key.part = (uint32_t)p;
+
+            if(sn_data_store_get(&sns->fragments, &key, &item) != 0 || item.len < sizeof(answer))
+                break;
+
+            /* Version, length and part are the stored ones, the rest the request's */
+
+            memcpy(&answer, item.value, sizeof(answer));
+            answer.reply_to = msg->reply_to;
+            answer.origin = msg->origin;
+
+            ret |= object_send(sns, &origin, NULL, &answer, SN_WIRE_OBJECT_FRAGMENT, key.index, item.len - sizeof(answer), item.value + sizeof(answer));
+        }
+    }
+
+    return ret | object_send(sns, &origin, NULL, msg, SN_WIRE_OBJECT_MISSING, msg->index, 0, NULL);
+}
+
+int object_piece(sn_object_req_t* req, const sn_wire_object_msg_t* msg, size_t len) {
+    const sn_data_erasure_t* code = &req->sns->code;
+    sn_object_piece_t* p = NULL;
+    size_t frag_len, parts, i;
+
+    assert(req != NULL);
+    assert(msg != NULL);
+
+    if(msg->data != code->data || msg->parity != code->parity || msg->index >= code->data + code->parity || msg->len > SN_NODE_OBJECT_MAX_LEN)
+        return -1;
+
+    parts = object_parts(msg);
+
+    if(msg->part >= parts || len != object_part_len(msg))
+        return -1;
+
+    for(i = 0; i < req->pieces && p == NULL; ++i)
+        if(req->piece[i].version == msg->version && req->piece[i].index == msg->index)
+            p = &req->piece[i];
+
+    /* Parts are put in place as they come, duplicates dropped */
+
+    if(p == NULL) {
+        if(req->pieces == SN_NODE_OBJECT_DATA + SN_NODE_OBJECT_PARITY)
+            return -1;
+
+        frag_len = ((size_t)msg->len + code->data - 1)/code->data;
+        p = &req->piece[req->pieces];
+
+        if((p->bytes = (unsigned char*)malloc(frag_len + 1)) == NULL)
+            return -1;
+
+        p->version = msg->version;
+        p->len = msg->len;
+        p->index = msg->index;
+        p->parts = 0;
+        ++req->pieces;
+    } else if(p->len != msg->len || (p->parts & (UINT32_C(1) << msg->part))) {
+        return -1;
+    }
+
+    memcpy(p->bytes + (size_t)msg->part*SN_NODE_OBJECT_PART_MAX, msg + 1, len);
+    p->parts |= UINT32_C(1) << msg->part;
+
+    return object_piece_whole(p) ? 0 : 1;
+}
+
+int object_piece_whole(const sn_object_piece_t* p) {
+    size_t frag_len, parts;
+
+    assert(p != NULL);
+
+    frag_len = ((size_t)p->len + SN_NODE_OBJECT_DATA - 1)/SN_NODE_OBJECT_DATA;
+    parts = frag_len ? (frag_len + SN_NODE_OBJECT_PART_MAX - 1)/SN_NODE_OBJECT_PART_MAX : 1;
+
+    return p->parts == (parts == 32 ? UINT32_MAX : (UINT32_C(1) << parts) - 1);
+}
+
+size_t object_count(const sn_object_req_t* req, uint64_t version) {
+    size_t i, n = 0;
+
+    assert(req != NULL);
+
+    for(i = 0; i < req->pieces; ++i)
+        n += req->piece[i].version == version && object_piece_whole(&req->piece[i]);
+
+    return n;
+}
+
+void object_decode(sn_object_req_t* req, uint64_t version) {
+    const unsigned int k = SN_NODE_OBJECT_DATA;
+    const unsigned char* fragments[SN_NODE_OBJECT_DATA];
+    unsigned char* out[SN_NODE_OBJECT_DATA];
+    unsigned int indexes[SN_NODE_OBJECT_DATA];
+    unsigned char* value;
+    uint32_t len = 0;
+    size_t frag_len, i;
+    unsigned int n = 0, parity = 0;
+
+    assert(req != NULL);
+
+    for(i = 0; i < req->pieces && n < k; ++i) {
+        if(req->piece[i].version == version && object_piece_whole(&req->piece[i])) {
+            fragments[n] = req->piece[i].bytes;
+            indexes[n] = req->piece[i].index;
+            len = req->piece[i].len;
+            parity += indexes[n] >= k;
+            ++n;
+        }
+    }
+
+    assert(n == k);
+
+    frag_len = (len + k - 1)/k;
+
+    if((value = (unsigned char*)malloc(k*frag_len + 1)) == NULL) {
+        object_finish(req, NULL, 0, NULL);
+        return;
+    }
+
+    for(i = 0; i < k; ++i)
+        out[i] = value + i*frag_len;
+
+    if(sn_data_erasure_decode(&req->sns->code, fragments, indexes, out, frag_len) != 0) {
+        object_finish(req, NULL, 0, NULL);
+    } else {
+        if(parity > 0)
+            ++req->sns->stats.object_decodes;
+
+        object_finish(req, (const char*)value, len, &version);
+    }
+
+    free(value);
+}
+
+void object_finish(sn_object_req_t* req, const char* value, unsigned long long len, const uint64_t* version) {
+    void* done_argv[3];
+    size_t i;
+
+    assert(req != NULL);
+
+    if(req->op == SN_WIRE_OBJECT_STORE) {
+        done_argv[0] = (void*)version;
+        sn_util_closure_call(&req->done, 1, done_argv);
+    } else {
+        done_argv[0] = (void*)value;
+        done_argv[1] = &len;
+        done_argv[2] = (void*)version;
+        sn_util_closure_call(&req->done, 3, done_argv);
+    }
+
+    for(i = 0; i < req->pieces; ++i)
+        free(req->piece[i].bytes);
+
+    free(req);
+}
+
+void on_object_reply(int argc, void* argv[]) {
+    const sn_wire_object_msg_t* msg;
+    sn_object_req_t* req;
+    unsigned long long len;
+
+    assert(argc == 4);
+
+    req = (sn_object_req_t*)argv[0];
+    msg = (const sn_wire_object_msg_t*)argv[1];
+    len = *(unsigned long long*)argv[2];
+
+    /* Timed out, the listener is already gone */
+
+    if(msg == NULL) {
+        object_finish(req, NULL, 0, NULL);
+        return;
+    }
+
+    if(len < sizeof(*msg))
+        return;
+
+    if(req->op == SN_WIRE_OBJECT_STORE) {
+        if(msg->op != SN_WIRE_OBJECT_STORED || msg->version != req->version || msg->index >= SN_NODE_OBJECT_DATA + SN_NODE_OBJECT_PARITY)
+            return;
+
+        /* Done once every fragment is stored whole */
+
+        req->stored |= UINT32_C(1) << msg->index;
+
+        if(req->stored != (UINT32_C(1) << (SN_NODE_OBJECT_DATA + SN_NODE_OBJECT_PARITY)) - 1)
+            return;
+
+        sn_node_unregister_reply(req->sns, req->reply_id);
+        object_finish(req, NULL, 0, &req->version);
+        return;
+    }
+
+    /* The fastest whole fragments of a version make the object, every holder done without it makes none */
+
+    if(msg->op == SN_WIRE_OBJECT_FRAGMENT) {
+        if(object_piece(req, msg, len - sizeof(*msg)) == 0 && object_count(req, msg->version) == SN_NODE_OBJECT_DATA) {
+            sn_node_unregister_reply(req->sns, req->reply_id);
+            object_decode(req, msg->version);
+        }
+
+        return;
+    }
+
+    if(msg->op != SN_WIRE_OBJECT_MISSING || ++req->answers < SN_NODE_OBJECT_DATA + SN_NODE_OBJECT_PARITY)
+        return;
+
+    sn_node_unregister_reply(req->sns, req->reply_id);
+    object_finish(req, NULL, 0, NULL);
+}
+
+int repair_start(sn_node_t* sns, unsigned int level, unsigned int column, const sn_net_addr_t* dead, uint64_t now) {
+    uint16_t slot = (uint16_t)(level*SN_NET_ROUTER_COLUMNS + column);
+    sn_repair_t repair;
+
+    assert(sns != NULL);
+    assert(dead != NULL);
+
+    /* Coalesced with the repair already running */
+
+    if(sn_data_hmap_get(&sns->repairs, &slot, NULL) == 0)
+        return 0;
+
+    if(sn_data_hmap_size(&sns->repairs) >= SN_NODE_REPAIR_MAX_PENDING)
+        return -1;
+
+    repair.dead = *dead;
+    repair.attempts = 0;
+
+    repair_round(sns, slot, &repair, now);
+
+    return sn_data_hmap_put(&sns->repairs, &slot, &repair);
+}
+
+void repair_round(sn_node_t* sns, uint16_t slot, sn_repair_t* repair, uint64_t now) {
+    sn_wire_repair_msg_t msg;
+    unsigned int level = slot/SN_NET_ROUTER_COLUMNS, l, c;
+    size_t skip, asked = 0;
+
+    assert(sns != NULL);
+    assert(repair != NULL);
+
+    msg.reply_to = sns->repair_reply_id;
+    msg.level = (uint8_t)level;
+    msg.column = (uint8_t)(slot%SN_NET_ROUTER_COLUMNS);
+    msg.reserved = 0;
+
+    /*
+    Nodes on the same row share level nibbles with us, and the ones on the next row one more,
+    so their [level][column] entries are valid for us. Each round asks different ones.
+    */
+
+    skip = repair->attempts*SN_NODE_REPAIR_FANOUT;
+
+    for(l = level; l <= level + 1 && l < SN_NET_ROUTER_LEVELS && asked < SN_NODE_REPAIR_FANOUT; ++l) {
+        for(c = 0; c < SN_NET_ROUTER_COLUMNS && asked < SN_NODE_REPAIR_FANOUT; ++c) {
+            const sn_net_entry_t* e = sn_net_router_table_get(&sns->router, l, c);
+
+            if(!e->is_set || sn_net_addr_cmp(&e->addr, &repair->dead) == 0)
+                continue;
+
+            if(skip) {
+                --skip;
+                continue;
+            }
+
+            sn_node_send_direct(sns, &e->addr, &e->net_addr, SN_WIRE_NET_TYPE_REPAIR, sizeof(msg), (const char*)&msg);
+            ++asked;
+        }
+    }
+
+    repair->last = now;
+    ++repair->attempts;
+}
+
+void repair_tick(sn_node_t* sns, uint64_t now) {
+    sn_data_vec_t done;
+    sn_repair_t repair;
+    uint16_t slot;
+    size_t iter = 0;
+
+    assert(sns != NULL);
+
+    if(sn_data_hmap_size(&sns->repairs) == 0 || sn_data_vec_init(&done, sizeof(uint16_t)) != 0)
+        return;
+
+    while(sn_data_hmap_next(&sns->repairs, &iter, &slot, &repair) == 0) {
+        if(now - repair.last < SN_NODE_REPAIR_INTERVAL)
+            continue;
+
+        /* Filled by other means(an announce) or given up on, joins fill it later */
+
+        if(sn_net_router_table_get(&sns->router, slot/SN_NET_ROUTER_COLUMNS, slot%SN_NET_ROUTER_COLUMNS)->is_set ||
+                repair.attempts >= SN_NODE_REPAIR_ATTEMPTS) {
+            sn_data_vec_push(&done, &slot);
+            continue;
+        }
+
+        repair_round(sns, slot, &repair, now);
+        sn_data_hmap_put(&sns->repairs, &slot, &repair);
+    }
+
+    for(iter = 0; sn_data_vec_at(&done, iter, &slot) == 0; ++iter)
+        sn_data_hmap_remove(&sns->repairs, &slot, NULL);
+
+    sn_data_vec_destroy(&done);
+}
+
+void on_repair_reply(int argc, void* argv[]) {
+    const sn_wire_repair_reply_header_t* header;
+    const sn_net_router_query_ser_t* query;
+    sn_repair_t repair;
+    sn_net_entry_t e;
+    sn_node_t* sns;
+    unsigned long long len;
+    unsigned int level;
+    unsigned char column;
+    uint16_t slot;
+
+    assert(argc == 4);
+
+    sns = (sn_node_t*)argv[0];
+
+    if(argv[1] == NULL)
+        return;
+
+    header = (const sn_wire_repair_reply_header_t*)argv[1];
+    query = (const sn_net_router_query_ser_t*)(header + 1);
+    len = *(unsigned long long*)argv[2];
+
+    if(len < sizeof(*header) + sizeof(*query) + sizeof(sn_net_router_entry_ser_t) || query->entries_len != 1 ||
+            header->level >= SN_NET_ROUTER_LEVELS || header->column >= SN_NET_ROUTER_COLUMNS)
+        return;
+
+    slot = (uint16_t)(header->level*SN_NET_ROUTER_COLUMNS + header->column);
+
+    if(sn_data_hmap_get(&sns->repairs, &slot, &repair) != 0 || sn_net_entry_deser(&e, &query->entries[0].entry) != 0)
+        return;
+
+    /* Later answers for the slot find it repaired */
+
+    if(sn_net_addr_cmp(&e.addr, &repair.dead) == 0 || sn_net_addr_cmp(&e.addr, &sns->self) == 0)
+        return;
+
+    sn_net_addr_index(&sns->self, &e.addr, &level, &column);
+
+    if(level != header->level || column != header->column)
+        return;
+
+    sn_data_hmap_remove(&sns->repairs, &slot, NULL);
+
+    if(!sn_net_router_table_get(&sns->router, level, column)->is_set) {
+        sn_node_add_route_locked(sns, &e.addr, &e.net_addr);
+        ++sns->stats.repairs;
+    }
+}
+
+void reply_sweep(sn_node_t* sns, uint64_t now) {
+    sn_data_vec_t expired;
+    sn_reply_sub_t sub;
+    size_t i;
+
+    assert(sns != NULL);
+
+    if(sn_data_vec_init(&expired, sizeof(sn_reply_sub_t)) != 0)
+        return;
+
+    pthread_mutex_lock(&sns->reply_mut);
+
+    for(i = 0; sn_data_vec_at(&sns->reply_vec, i, &sub) == 0;) {
+        if(sub.deadline && sub.deadline <= now) {
+            sn_data_vec_remove_at(&sns->reply_vec, i, NULL);
+
+            /* Out of memory to defer it, called right away and the scan starts over */
+
+            if(sn_data_vec_push(&expired, &sub) != 0) {
+                pthread_mutex_unlock(&sns->reply_mut);
+                reply_expire(&sub);
+                pthread_mutex_lock(&sns->reply_mut);
+                i = 0;
+            }
+        } else {
+            ++i;
+        }
+    }
+
+    /* Rearmed to the earliest listener left */
+
+    sns->reply_next = 0;
+
+    for(i = 0; sn_data_vec_at(&sns->reply_vec, i, &sub) == 0; ++i)
+        if(sub.deadline && (sns->reply_next == 0 || sub.deadline < sns->reply_next))
+            sns->reply_next = sub.deadline;
+
+    if(sns->reply_next != 0)
+        reply_arm(sns, sns->reply_next, now);
+
+    pthread_mutex_unlock(&sns->reply_mut);
+
+    /* Timeouts are called without the lock so listeners can register again */
+
+    for(i = 0; sn_data_vec_at(&expired, i, &sub) == 0; ++i)
+        reply_expire(&sub);
+
+    sn_data_vec_destroy(&expired);
+}
+
+void reply_expire(sn_reply_sub_t* sub) {
+    unsigned long long zero_len = 0;
+    void* argv[] = { NULL, &zero_len, NULL };
+
+    assert(sub != NULL);
+
+    sn_util_closure_call(&sub->closure, 3, argv);
+}
+
+void reply_arm(sn_node_t* sns, uint64_t next, uint64_t now) {
+    sn_util_closure_t closure;
+
+    assert(sns != NULL);
+
+    sns->reply_next = next;
+
+    sn_util_closure_init_curried_once(&closure, on_reply_timer, sns);
+    sn_io_reactor_timer_start(sns->loop, &sns->reply_timer, next > now ? next - now : 0, 0, &closure);
+}
+
+void on_reply_timer(int argc, void* argv[]) {
+    sn_node_t* sns;
+
+    assert(argc == 2);
+
+    sns = (sn_node_t*)argv[0];
+
+    /* Like the maintenance sweep, so listeners time out under task_mut */
+
+    pthread_mutex_lock(&sns->task_mut);
+    reply_sweep(sns, sn_util_time_ms());
+    pthread_mutex_unlock(&sns->task_mut);
+}
+
+/*Deliver handlers*/
+
+int upcall_wrapper(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
+    assert(sns != NULL);
+    assert(packet != NULL);
+    assert(rem_addr != NULL);
+
+    return sn_node_upcall(sns, packet->payload, packet->header.len);
+}
+
+/*Async send*/
+
+void send_async_signed(int argc, void* argv[]) {
+    sn_send_async_t* ctx;
+    sn_net_packet_t* packet;
+    int status;
+
+    assert(argc == 2);
+
+    ctx = (sn_send_async_t*)argv[0];
+    packet = (sn_net_packet_t*)argv[1];
+
+    assert(ctx != NULL);
+    assert(packet != NULL);
+
+    /* Signer threads route like callers do, with the loop closures held off */
+
+    pthread_mutex_lock(&ctx->sns->task_mut);
+    status = forward(ctx->sns, packet, NULL) == -1 ? -1 : 0;
+    pthread_mutex_unlock(&ctx->sns->task_mut);
+
+    free(packet);
+
+    if(ctx->has_done) {
+        void* done_argv[] = { &status };
+
+        sn_util_closure_call(&ctx->done, 1, done_argv);
+    }
+
+    free(ctx);
+}
+
+/*Join*/
+
+void on_join_reply(int argc, void* argv[]) {
+    sn_join_t* join;
+    const sn_wire_join_reply_header_t* header;
+    const sn_net_router_query_ser_t* query;
+    unsigned long long len;
+    sn_node_t* sns;
+    uint32_t i;
+    int h;
+
+    assert(argc == 4);
+
+    join = (sn_join_t*)argv[0];
+    sns = join->sns;
+
+    if(argv[1] == NULL) {
+        join_finish(join, -1);
+        return;
+    }
+
+    header = (const sn_wire_join_reply_header_t*)argv[1];
+    query = (const sn_net_router_query_ser_t*)(header + 1);
+    len = *(unsigned long long*)argv[2];
+
+    if(len < sizeof(*header) + sizeof(*query) ||
+            query->entries_len > (len - sizeof(*header) - sizeof(*query))/sizeof(sn_net_router_entry_ser_t) ||
+            header->hop >= SN_NET_PACKET_DEFAULT_TTL || header->parts == 0)
+        return;
+
+    for(i = 0; i < query->entries_len; ++i) {
+        sn_net_entry_t e;
+
+        if(sn_net_entry_deser(&e, &query->entries[i].entry) != 0 || !e.is_set ||
+                sn_net_addr_cmp(&e.addr, &sns->self) == 0)
+            continue;
+
+        sn_node_add_route_locked(sns, &e.addr, &e.net_addr);
+    }
+
+    join->expected[header->hop] = header->parts;
+
+    if(join->received[header->hop] < header->parts)
+        ++join->received[header->hop];
+
+    if(header->flags & SN_WIRE_JOIN_REPLY_ROOT)
+        join->hops = SN_MIN(header->hops, SN_NET_PACKET_DEFAULT_TTL - 1);
+
+    /* Done once every node on the route sent all its replies */
+
+    if(join->hops < 0)
+        return;
+
+    for(h = 0; h <= join->hops; ++h)
+        if(join->expected[h] == 0 || join->received[h] < join->expected[h])
+            return;
+
+    join_announce(sns);
+
+    /* Only called from the node loop, no reply for this listener is being handled */
+
+    sn_node_unregister_reply(sns, join->reply_id);
+    join_finish(join, 1);
+}
+
+void join_finish(sn_join_t* join, int status) {
+    assert(join != NULL);
+
+    /* join is freed by sn_node_join as soon as it sees the status */
+
+    pthread_mutex_lock(&join->mut);
+    join->status = status;
+    pthread_cond_signal(&join->cond);
+    pthread_mutex_unlock(&join->mut);
+}
+
+void join_announce(sn_node_t* sns) {
+    sn_wire_announce_msg_t msg;
+    unsigned int l, c;
+    int p;
+
+    assert(sns != NULL);
+
+    if(sn_io_naddr_ser(&sns->router.self.net_addr, &msg.net_addr) != 0)
+        return;
+
+    for(l = 0; l < SN_NET_ROUTER_LEVELS; ++l) {
+        for(c = 0; c < SN_NET_ROUTER_COLUMNS; ++c) {
+            const sn_net_entry_t* e = sn_net_router_table_get(&sns->router, l, c);
+
+            if(e->is_set)
+                sn_node_send_direct(sns, &e->addr, &e->net_addr, SN_WIRE_NET_TYPE_ANNOUNCE, sizeof(msg), (const char*)&msg);
+        }
+    }
+
+    /* Leafset entries not already told through the table */
+
+    for(p = -SN_NET_ROUTER_LEAFSET_SIZE; p <= SN_NET_ROUTER_LEAFSET_SIZE; ++p) {
+        const sn_net_entry_t* e = sn_net_router_leafset_get(&sns->router, p);
+        unsigned char column;
+
+        if(p == 0 || !e->is_set)
+            continue;
+
+        sn_net_addr_index(&sns->self, &e->addr, &l, &column);
+
+        if(l < SN_NET_ROUTER_LEVELS && sn_net_entry_equals(sn_net_router_table_get(&sns->router, l, column), e))
             continue;
 
-        if(sns->check_sign && sn_net_packet_check_sign(packet) != 0) {
-            char rem_addr_str[SN_IO_NADDR_PRINTABLE_LEN];
-            char packet_str[SN_NET_PACKET_PRINTABLE_LEN];
+        sn_node_send_direct(sns, &e->addr, &e->net_addr, SN_WIRE_NET_TYPE_ANNOUNCE, sizeof(msg), (const char*)&msg);
+    }
+}
+
+void learn_observe(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, uint8_t ttl) {
+    sn_wire_ping_msg_t ping;
+    sn_learn_t learn;
+    unsigned int level;
+    unsigned char column;
+    uint16_t slot;
+
+    assert(sns != NULL);
+    assert(src != NULL);
+    assert(rem_addr != NULL);
+
+    /*
+    The network address of the source is only known when the packet came straight from it,
+    sent directly or routed by it in one hop
+    */
+
+    if(ttl < SN_NET_PACKET_DEFAULT_TTL - 1 || sns->learn_budget == 0 || sn_net_addr_cmp(src, &sns->self) == 0)
+        return;
 
-            sn_io_naddr_to_str(&rem_addr, rem_addr_str);
+    sn_net_addr_index(&sns->self, src, &level, &column);
 
-            sn_net_packet_header_to_str(packet, packet_str);
+    if(level >= SN_NET_ROUTER_LEVELS || sn_net_router_table_get(&sns->router, level, column)->is_set)
+        return;
 
-            sn_node_log(sns,
-                "Bad signed msg:\n"
-                "sent from %s\n"
-                "%s"
-                "REJECTED\n",
-                rem_addr_str, packet_str);
-            continue;
+    slot = (uint16_t)(level*SN_NET_ROUTER_COLUMNS + column);
+
+    if(sn_data_hmap_get(&sns->learning, &slot, NULL) == 0 || sn_data_hmap_size(&sns->learning) >= SN_NODE_LEARN_MAX_PENDING)
+        return;
+
+    /* Verified with a direct ping before being trusted, the content tells the slot */
+
+    learn.addr = *src;
+    learn.net_addr = *rem_addr;
+    learn.sent = sn_util_time_ms();
+    memcpy(learn.cnt, &slot, sizeof(slot));
+    randombytes_buf(learn.cnt + sizeof(slot), sizeof(learn.cnt) - sizeof(slot));
+
+    ping.reply_to = sns->learn_reply_id;
+    memcpy(ping.cnt, learn.cnt, sizeof(ping.cnt));
+
+    --sns->learn_budget;
+
+    if(sn_node_send_direct(sns, src, rem_addr, SN_WIRE_NET_TYPE_PING, sizeof(ping), (const char*)&ping) == 0)
+        sn_data_hmap_put(&sns->learning, &slot, &learn);
+}
+
+void learn_tick(sn_node_t* sns, uint64_t now) {
+    sn_data_vec_t expired;
+    sn_learn_t learn;
+    uint16_t slot;
+    size_t iter = 0;
+
+    assert(sns != NULL);
+
+    sns->learn_budget = SN_NODE_LEARN_RATE;
+
+    if(sn_data_hmap_size(&sns->learning) == 0 || sn_data_vec_init(&expired, sizeof(uint16_t)) != 0)
+        return;
+
+    while(sn_data_hmap_next(&sns->learning, &iter, &slot, &learn) == 0) {
+        if(now - learn.sent >= SN_NODE_LEARN_TIMEOUT)
+            sn_data_vec_push(&expired, &slot);
+    }
+
+    for(iter = 0; sn_data_vec_at(&expired, iter, &slot) == 0; ++iter)
+        sn_data_hmap_remove(&sns->learning, &slot, NULL);
+
+    sn_data_vec_destroy(&expired);
+}
+
+void on_learn_reply(int argc, void* argv[]) {
+    sn_learn_t learn;
+    sn_node_t* sns;
+    uint16_t slot;
+
+    assert(argc == 4);
+
+    sns = (sn_node_t*)argv[0];
+
+    if(argv[1] == NULL || *(unsigned long long*)argv[2] != SN_WIRE_PING_MSG_CONTENT || argv[3] == NULL)
+        return;
+
+    memcpy(&slot, argv[1], sizeof(slot));
+
+    /* Only the node itself proves it is where we pinged it, a relay may have replayed its packets */
+
+    if(sn_data_hmap_get(&sns->learning, &slot, &learn) != 0 || memcmp(learn.cnt, argv[1], sizeof(learn.cnt)) != 0 ||
+            sn_net_addr_cmp(&learn.addr, (const sn_net_addr_t*)argv[3]) != 0)
+        return;
+
+    sn_data_hmap_remove(&sns->learning, &slot, NULL);
+
+    if(!sn_net_router_table_get(&sns->router, slot/SN_NET_ROUTER_COLUMNS, slot%SN_NET_ROUTER_COLUMNS)->is_set) {
+        sn_node_add_route_locked(sns, &learn.addr, &learn.net_addr);
+        ++sns->stats.learned;
+    }
+}
+
+int shortcut_nexthop(sn_node_t* sns, const sn_net_addr_t* dst, sn_net_entry_t* nexthop) {
+    sn_shortcut_t sc;
+    int ret = -1;
+
+    assert(sns != NULL);
+    assert(dst != NULL);
+    assert(nexthop != NULL);
+
+    pthread_mutex_lock(&sns->shortcut_mut);
+
+    if(sns->shortcut) {
+        ++sns->stats.shortcut_lookups;
+
+        if(sn_data_hmap_get(&sns->shortcuts, dst, &sc) == 0 && sc.usable && sc.expires > sn_util_time_ms()) {
+            /* Already a neighbor, nothing saved */
+
+            if(sn_net_addr_cmp(&nexthop->addr, dst) != 0) {
+                nexthop->addr = *dst;
+                nexthop->net_addr = sc.net_addr;
+
+                ++sns->stats.shortcut_hits;
+
+                if(sc.hops > 1)
+                    sns->stats.shortcut_hops_saved += sc.hops - 1;
+
+                ret = 0;
+            }
         }
+    }
 
-        forward(sns, packet, &rem_addr);
+    pthread_mutex_unlock(&sns->shortcut_mut);
 
-        free(packet);
-    } while(1);
+    return ret;
+}
 
-    return sns;
+void shortcut_drop(sn_node_t* sns, const sn_net_addr_t* dst) {
+    assert(sns != NULL);
+    assert(dst != NULL);
+
+    pthread_mutex_lock(&sns->shortcut_mut);
+    sn_data_hmap_remove(&sns->shortcuts, dst, NULL);
+    pthread_mutex_unlock(&sns->shortcut_mut);
 }
 
-/*Deliver handlers*/
+void shortcut_heard(sn_node_t* sns, const sn_net_addr_t* src, const sn_io_naddr_t* rem_addr, uint64_t now) {
+    sn_net_entry_t nexthop;
+    sn_shortcut_t sc;
+    int known;
 
-int upcall_wrapper(sn_node_t* sns, const sn_net_packet_t* packet, const sn_io_naddr_t* rem_addr) {
     assert(sns != NULL);
-    assert(packet != NULL);
+    assert(src != NULL);
     assert(rem_addr != NULL);
 
-    return sn_node_upcall(sns, packet->payload, packet->header.len);
+    pthread_mutex_lock(&sns->shortcut_mut);
+
+    if(!sns->shortcut || sn_net_addr_cmp(src, &sns->self) == 0) {
+        pthread_mutex_unlock(&sns->shortcut_mut);
+        return;
+    }
+
+    known = sn_data_hmap_get(&sns->shortcuts, src, &sc) == 0;
+
+    if(!known) {
+        /* Neighbors need no shortcut */
+
+        sn_node_nexthop(sns, src, &nexthop);
+
+        if(!nexthop.is_set || sn_net_addr_cmp(&nexthop.addr, src) == 0 || sn_data_hmap_size(&sns->shortcuts) >= SN_NODE_SHORTCUT_MAX) {
+            pthread_mutex_unlock(&sns->shortcut_mut);
+            return;
+        }
+
+        sc.offered = 0;
+        sc.hops = 0;
+    }
+
+    sc.net_addr = *rem_addr;
+    sc.expires = now + SN_NODE_SHORTCUT_TTL;
+    sc.usable = 1;
+
+    sn_data_hmap_put(&sns->shortcuts, src, &sc);
+
+    pthread_mutex_unlock(&sns->shortcut_mut);
+}
+
+void shortcut_offer(sn_node_t* sns, const sn_net_packet_t* packet) {
+    sn_wire_shortcut_msg_t msg;
+    const sn_io_naddr_t* self_net = &sns->router.self.net_addr;
+    sn_net_addr_t src;
+    sn_shortcut_t sc;
+    uint64_t now;
+    unsigned int hops;
+
+    assert(sns != NULL);
+    assert(packet != NULL);
+
+    /* Our own forward took the last one */
+
+    hops = SN_NET_PACKET_DEFAULT_TTL - 1 - packet->header.ttl;
+
+    if(hops < 2 || sns->shortcut_budget == 0)
+        return;
+
+    /* Nothing to offer with a wildcard address */
+
+    if(self_net->sa_family == AF_INET && ((const struct sockaddr_in*)self_net)->sin_addr.s_addr == htonl(INADDR_ANY))
+        return;
+
+    sn_net_packet_get_src(packet, &src);
+    now = sn_util_time_ms();
+
+    pthread_mutex_lock(&sns->shortcut_mut);
+
+    if(!sns->shortcut || sn_net_addr_cmp(&src, &sns->self) == 0) {
+        pthread_mutex_unlock(&sns->shortcut_mut);
+        return;
+    }
+
+    if(sn_data_hmap_get(&sns->shortcuts, &src, &sc) != 0) {
+        if(sn_data_hmap_size(&sns->shortcuts) >= SN_NODE_SHORTCUT_MAX) {
+            pthread_mutex_unlock(&sns->shortcut_mut);
+            return;
+        }
+
+        memset(&sc, 0, sizeof(sc));
+    } else if(now - sc.offered < SN_NODE_SHORTCUT_OFFER_INTERVAL) {
+        pthread_mutex_unlock(&sns->shortcut_mut);
+        return;
+    }
+
+    /* Kept until the source answers straight or the offer is old */
+
+    sc.offered = now;
+
+    if(!sc.usable)
+        sc.expires = now + SN_NODE_SHORTCUT_OFFER_INTERVAL;
+
+    sn_data_hmap_put(&sns->shortcuts, &src, &sc);
+
+    pthread_mutex_unlock(&sns->shortcut_mut);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.hops = (uint8_t)SN_MIN(hops, UINT8_MAX);
+
+    if(sn_io_naddr_ser(self_net, &msg.net_addr) != 0)
+        return;
+
+    --sns->shortcut_budget;
+
+    sn_node_send_typed_locked(sns, &src, SN_WIRE_NET_TYPE_SHORTCUT, sizeof(msg), (const char*)&msg);
+}
+
+void shortcut_sweep(sn_node_t* sns, uint64_t now) {
+    sn_data_vec_t expired;
+    sn_net_addr_t addr;
+    sn_shortcut_t sc;
+    size_t iter = 0;
+
+    assert(sns != NULL);
+
+    sns->shortcut_budget = SN_NODE_SHORTCUT_OFFER_RATE;
+
+    pthread_mutex_lock(&sns->shortcut_mut);
+
+    if(sn_data_hmap_size(&sns->shortcuts) && sn_data_vec_init(&expired, sizeof(sn_net_addr_t)) == 0) {
+        while(sn_data_hmap_next(&sns->shortcuts, &iter, &addr, &sc) == 0) {
+            if(sc.expires <= now)
+                sn_data_vec_push(&expired, &addr);
+        }
+
+        for(iter = 0; sn_data_vec_at(&expired, iter, &addr) == 0; ++iter)
+            sn_data_hmap_remove(&sns->shortcuts, &addr, NULL);
+
+        sn_data_vec_destroy(&expired);
+    }
+
+    pthread_mutex_unlock(&sns->shortcut_mut);
+}
+
+void on_hedge_timer(int argc, void* argv[]) {
+    sn_data_vec_t done;
+    sn_net_entry_t alt;
+    sn_net_addr_t dst;
+    sn_hedge_t hedge;
+    sn_node_t* sns;
+    uint64_t now;
+    uint32_t id;
+    size_t iter = 0;
+
+    assert(argc == 2);
+
+    sns = (sn_node_t*)argv[0];
+    now = sn_util_time_ms();
+
+    if(sn_data_vec_init(&done, sizeof(uint32_t)) != 0)
+        return;
+
+    /* The routes are read under task_mut, like sn_node_send_hedged sends the first copy */
+
+    pthread_mutex_lock(&sns->task_mut);
+    pthread_mutex_lock(&sns->hedge_mut);
+
+    while(sn_data_hmap_next(&sns->hedges, &iter, &id, &hedge) == 0) {
+        if(hedge.packet == NULL || hedge.deadline > now)
+            continue;
+
+        /* Second copy through the best other route, still closer to the destination */
+
+        sn_net_packet_get_dst(hedge.packet, &dst);
+        sns->geometry->nexthop_alt(sns->geometry_state, &dst, &hedge.primary, &alt);
+
+        if(alt.is_set) {
+            hedge.packet->header.ttl--;
+
+            if(node_send_nexthop(sns, hedge.packet, &dst, &alt) == 0)
+                ++sns->stats.hedges_sent;
+        }
+
+        free(hedge.packet);
+        hedge.packet = NULL;
+
+        /* Kept for the reply latency */
+
+        if(hedge.reply_id)
+            sn_data_hmap_put(&sns->hedges, &id, &hedge);
+        else
+            sn_data_vec_push(&done, &id);
+    }
+
+    for(iter = 0; sn_data_vec_at(&done, iter, &id) == 0; ++iter)
+        sn_data_hmap_remove(&sns->hedges, &id, NULL);
+
+    hedge_arm(sns, now);
+
+    pthread_mutex_unlock(&sns->hedge_mut);
+    pthread_mutex_unlock(&sns->task_mut);
+
+    sn_data_vec_destroy(&done);
+}
+
+void hedge_arm(sn_node_t* sns, uint64_t now) {
+    sn_util_closure_t closure;
+    sn_hedge_t hedge;
+    uint64_t next = UINT64_MAX;
+    size_t iter = 0;
+
+    assert(sns != NULL);
+
+    while(sn_data_hmap_next(&sns->hedges, &iter, NULL, &hedge) == 0) {
+        if(hedge.packet != NULL && hedge.deadline < next)
+            next = hedge.deadline;
+    }
+
+    if(next == UINT64_MAX)
+        return;
+
+    sn_util_closure_init_curried_once(&closure, on_hedge_timer, sns);
+    sn_io_reactor_timer_start(sns->loop, &sns->hedge_timer, next > now ? next - now : 0, 0, &closure);
+}
+
+void hedge_settle(sn_node_t* sns, uint32_t reply_id) {
+    sn_hedge_t hedge;
+    uint64_t delay;
+
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->hedge_mut);
+
+    if(sn_data_hmap_remove(&sns->hedges, &reply_id, &hedge) != 0) {
+        pthread_mutex_unlock(&sns->hedge_mut);
+        return;
+    }
+
+    if(hedge.packet != NULL) {
+        free(hedge.packet);
+        ++sns->stats.hedges_avoided;
+    }
+
+    /* The delay follows a high quantile of the recent reply latencies */
+
+    sn_util_hist_record(&sns->hedge_rtt, sn_util_time_ns() - hedge.sent_ns);
+
+    if(sns->hedge_rtt.count >= SN_NODE_HEDGE_MIN_SAMPLES && sns->hedge_rtt.count%SN_NODE_HEDGE_MIN_SAMPLES == 0) {
+        delay = sn_util_hist_quantile(&sns->hedge_rtt, SN_NODE_HEDGE_QUANTILE)/1000000 + 1;
+        sns->hedge_delay = SN_MIN(SN_MAX(delay, SN_NODE_HEDGE_MIN_DELAY), SN_NODE_HEDGE_MAX_DELAY);
+
+        if(sns->hedge_rtt.count >= SN_NODE_HEDGE_WINDOW)
+            sn_util_hist_init(&sns->hedge_rtt);
+    }
+
+    pthread_mutex_unlock(&sns->hedge_mut);
+}
+
+void hedge_sweep(sn_node_t* sns, uint64_t now) {
+    sn_data_vec_t expired;
+    sn_hedge_t hedge;
+    uint32_t id;
+    size_t iter = 0;
+
+    assert(sns != NULL);
+
+    pthread_mutex_lock(&sns->hedge_mut);
+
+    /* Replies never coming */
+
+    if(sn_data_hmap_size(&sns->hedges) && sn_data_vec_init(&expired, sizeof(uint32_t)) == 0) {
+        while(sn_data_hmap_next(&sns->hedges, &iter, &id, &hedge) == 0) {
+            if(hedge.packet == NULL && now - hedge.sent_ns/1000000 >= SN_NODE_HEDGE_REPLY_WAIT)
+                sn_data_vec_push(&expired, &id);
+        }
+
+        for(iter = 0; sn_data_vec_at(&expired, iter, &id) == 0; ++iter)
+            sn_data_hmap_remove(&sns->hedges, &id, NULL);
+
+        sn_data_vec_destroy(&expired);
+    }
+
+    pthread_mutex_unlock(&sns->hedge_mut);
+}
+
+void lookup_add(sn_lookup_t* lookup, const sn_net_entry_t* e) {
+    sn_net_addr_t dist;
+    size_t i;
+
+    assert(lookup != NULL);
+    assert(e != NULL);
+
+    if(!e->is_set || sn_net_addr_cmp(&e->addr, &lookup->sns->self) == 0 || lookup_find(lookup, &e->addr) != NULL)
+        return;
+
+    sn_net_addr_dist(&e->addr, &lookup->target, &dist);
+
+    /* A full shortlist drops its furthest contact not being asked, their answers find them there */
+
+    if(lookup->contacts_len == SN_NODE_LOOKUP_SHORTLIST) {
+        for(i = SN_NODE_LOOKUP_SHORTLIST; i > 0 && lookup->contacts[i - 1].state == LOOKUP_ASKED; --i);
+
+        if(i == 0 || sn_net_addr_cmp(&dist, &lookup->contacts[i - 1].dist) >= 0)
+            return;
+
+        for(; i < SN_NODE_LOOKUP_SHORTLIST; ++i)
+            lookup->contacts[i - 1] = lookup->contacts[i];
+
+        --lookup->contacts_len;
+    }
+
+    /* Sorted insertion */
+
+    for(i = lookup->contacts_len; i > 0 && sn_net_addr_cmp(&dist, &lookup->contacts[i - 1].dist) < 0; --i)
+        lookup->contacts[i] = lookup->contacts[i - 1];
+
+    lookup->contacts[i].entry = *e;
+    lookup->contacts[i].dist = dist;
+    lookup->contacts[i].asked = 0;
+    lookup->contacts[i].state = LOOKUP_NEW;
+
+    ++lookup->contacts_len;
+}
+
+sn_lookup_contact_t* lookup_find(sn_lookup_t* lookup, const sn_net_addr_t* addr) {
+    size_t i;
+
+    for(i = 0; i < lookup->contacts_len; ++i) {
+        if(sn_net_addr_cmp(&lookup->contacts[i].entry.addr, addr) == 0)
+            return &lookup->contacts[i];
+    }
+
+    return NULL;
+}
+
+void lookup_step(sn_lookup_t* lookup, uint64_t now) {
+    sn_node_t* sns = lookup->sns;
+    sn_util_closure_t closure;
+    sn_wire_lookup_msg_t msg;
+    sn_lookup_rpc_t* rpc;
+    size_t i;
+
+    assert(lookup != NULL);
+
+    if(lookup->finished)
+        return;
+
+    if(now >= lookup->deadline) {
+        lookup_finish(lookup, NULL);
+        return;
+    }
+
+    /* Slow contacts stop counting as in flight, their listeners wait for late answers until the deadline */
+
+    for(i = 0; i < lookup->contacts_len; ++i) {
+        sn_lookup_contact_t* c = &lookup->contacts[i];
+
+        if(c->state == LOOKUP_ASKED && now - c->asked >= SN_NODE_LOOKUP_RPC_TIMEOUT) {
+            c->state = LOOKUP_FAILED;
+            --lookup->in_flight;
+        }
+    }
+
+    /* The closest contacts not asked yet */
+
+    sn_net_addr_ser(&lookup->target, &msg.target);
+
+    for(i = 0; i < lookup->contacts_len && lookup->in_flight < lookup->alpha; ++i) {
+        sn_lookup_contact_t* c = &lookup->contacts[i];
+
+        if(c->state != LOOKUP_NEW || (rpc = (sn_lookup_rpc_t*)malloc(sizeof(sn_lookup_rpc_t))) == NULL)
+            continue;
+
+        if(sn_data_vec_push(&lookup->rpcs, &rpc) != 0) {
+            free(rpc);
+            continue;
+        }
+
+        rpc->lookup = lookup;
+        rpc->entry = c->entry;
+        rpc->reply_id = msg.reply_to = sn_node_new_reply_id(sns);
+        rpc->waiting = 0;
+
+        sn_util_closure_init_curried_once(&closure, on_lookup_reply, rpc);
+
+        if(sn_node_register_reply(sns, msg.reply_to, &closure, 1, lookup->deadline - now) != 0)
+            continue;
+
+        rpc->waiting = 1;
+        ++lookup->listeners;
+        c->state = LOOKUP_ASKED;
+        c->asked = now;
+        ++lookup->in_flight;
+        ++lookup->queries;
+
+        sn_node_send_direct(sns, &c->entry.addr, &c->entry.net_addr, SN_WIRE_NET_TYPE_LOOKUP, sizeof(msg), (const char*)&msg);
+    }
+
+    /* Nobody else to ask */
+
+    if(lookup->in_flight == 0)
+        lookup_finish(lookup, NULL);
+}
+
+void lookup_finish(sn_lookup_t* lookup, const sn_net_entry_t* owner) {
+    void* argv[] = { (void*)owner, &lookup->queries };
+
+    lookup->finished = 1;
+
+    sn_util_closure_call(&lookup->done, 2, argv);
+}
+
+void lookup_free(sn_lookup_t* lookup) {
+    sn_lookup_rpc_t* rpc;
+    size_t i;
+
+    for(i = 0; sn_data_vec_at(&lookup->rpcs, i, &rpc) == 0; ++i)
+        free(rpc);
+
+    sn_data_vec_destroy(&lookup->rpcs);
+    free(lookup);
+}
+
+void on_lookup_reply(int argc, void* argv[]) {
+    const sn_wire_lookup_reply_header_t* header;
+    const sn_net_router_query_ser_t* query;
+    sn_lookup_rpc_t* rpc;
+    sn_lookup_t* lookup;
+    sn_lookup_contact_t* c;
+    sn_net_entry_t e;
+    unsigned long long len;
+    uint32_t i;
+
+    assert(argc == 4);
+
+    rpc = (sn_lookup_rpc_t*)argv[0];
+    lookup = rpc->lookup;
+    c = lookup_find(lookup, &rpc->entry.addr);
+
+    rpc->waiting = 0;
+    --lookup->listeners;
+
+    /* Timed out, or answered by someone else than the contact asked */
+
+    if(argv[1] == NULL || argv[3] == NULL || sn_net_addr_cmp((const sn_net_addr_t*)argv[3], &rpc->entry.addr) != 0) {
+        if(c != NULL && c->state == LOOKUP_ASKED) {
+            c->state = LOOKUP_FAILED;
+            --lookup->in_flight;
+        }
+
+        lookup_step(lookup, sn_util_time_ms());
+        return;
+    }
+
+    header = (const sn_wire_lookup_reply_header_t*)argv[1];
+    query = (const sn_net_router_query_ser_t*)(header + 1);
+    len = *(unsigned long long*)argv[2];
+
+    if(c != NULL && c->state == LOOKUP_ASKED)
+        --lookup->in_flight;
+
+    if(c != NULL)
+        c->state = LOOKUP_ANSWERED;
+
+    if(!lookup->finished && len >= sizeof(*header) + sizeof(*query) &&
+            len >= sizeof(*header) + sizeof(*query) + query->entries_len*sizeof(sn_net_router_entry_ser_t)) {
+        if(header->flags & SN_WIRE_LOOKUP_REPLY_OWNER) {
+            lookup_finish(lookup, &rpc->entry);
+        } else {
+            for(i = 0; i < query->entries_len; ++i) {
+                if(sn_net_entry_deser(&e, &query->entries[i].entry) == 0)
+                    lookup_add(lookup, &e);
+            }
+        }
+    }
+
+    lookup_step(lookup, sn_util_time_ms());
 }
 
+void on_lookup_timer(int argc, void* argv[]) {
+    sn_node_t* sns;
+    sn_lookup_t* lookup;
+    uint64_t now;
+    size_t i;
+
+    assert(argc == 2);
+
+    sns = (sn_node_t*)argv[0];
+    now = sn_util_time_ms();
+
+    pthread_mutex_lock(&sns->task_mut);
+
+    for(i = 0; sn_data_vec_at(&sns->lookups, i, &lookup) == 0;) {
+        lookup_step(lookup, now);
+
+        /* Freed once no listener can call into it, the ones still waiting are not needed anymore */
+
+        if(lookup->finished) {
+            sn_lookup_rpc_t* rpc;
+            size_t j;
+
+            for(j = 0; sn_data_vec_at(&lookup->rpcs, j, &rpc) == 0; ++j) {
+                if(rpc->waiting && sn_node_unregister_reply(sns, rpc->reply_id) == 0) {
+                    rpc->waiting = 0;
+                    --lookup->listeners;
+                }
+            }
+        }
+
+        if(lookup->finished && lookup->listeners == 0) {
+            sn_data_vec_remove_at(&sns->lookups, i, NULL);
+            lookup_free(lookup);
+        } else {
+            ++i;
+        }
+    }
+
+    if(sn_data_vec_size(&sns->lookups) == 0)
+        sn_io_reactor_timer_stop(sns->loop, &sns->lookup_timer);
+
+    pthread_mutex_unlock(&sns->task_mut);
+}
@@ -0,0 +1,93 @@
+#include "util/hist.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SN_UTIL_HIST_SUB (1 << SN_UTIL_HIST_SUB_BITS)
+
+size_t hist_index(uint64_t value);
+uint64_t hist_lower(size_t idx);
+
+void sn_util_hist_init(sn_util_hist_t* h) {
+    assert(h != NULL);
+
+    memset(h, 0, sizeof(sn_util_hist_t));
+}
+
+void sn_util_hist_record(sn_util_hist_t* h, uint64_t value) {
+    assert(h != NULL);
+
+    ++h->buckets[hist_index(value)];
+    ++h->count;
+    h->sum += value;
+
+    if(value > h->max)
+        h->max = value;
+}
+
+void sn_util_hist_merge(sn_util_hist_t* h, const sn_util_hist_t* other) {
+    size_t i;
+
+    assert(h != NULL);
+    assert(other != NULL);
+
+    for(i = 0; i < SN_UTIL_HIST_BUCKETS; ++i)
+        h->buckets[i] += other->buckets[i];
+
+    h->count += other->count;
+    h->sum += other->sum;
+
+    if(other->max > h->max)
+        h->max = other->max;
+}
+
+uint64_t sn_util_hist_quantile(const sn_util_hist_t* h, double q) {
+    uint64_t rank, seen = 0;
+    size_t i;
+
+    assert(h != NULL);
+
+    if(h->count == 0)
+        return 0;
+
+    q = q < 0.0 ? 0.0 : (q > 1.0 ? 1.0 : q);
+    rank = (uint64_t)(q*(double)(h->count - 1));
+
+    for(i = 0; i < SN_UTIL_HIST_BUCKETS; ++i) {
+        seen += h->buckets[i];
+
+        if(seen > rank)
+            return hist_lower(i);
+    }
+
+    return h->max;
+}
+
+/*Private functions*/
+
+size_t hist_index(uint64_t value) {
+    unsigned int exp;
+
+    /* Values under SN_UTIL_HIST_SUB are exact, the rest are bucketed by exponent and top bits */
+
+    if(value < SN_UTIL_HIST_SUB)
+        return (size_t)value;
+
+    exp = 63 - (unsigned int)__builtin_clzll(value);
+
+    return ((size_t)(exp - SN_UTIL_HIST_SUB_BITS + 1) << SN_UTIL_HIST_SUB_BITS) +
+        (size_t)((value >> (exp - SN_UTIL_HIST_SUB_BITS)) & (SN_UTIL_HIST_SUB - 1));
+}
+
+uint64_t hist_lower(size_t idx) {
+    unsigned int exp;
+
+    if(idx < SN_UTIL_HIST_SUB)
+        return (uint64_t)idx;
+
+    exp = (unsigned int)(idx >> SN_UTIL_HIST_SUB_BITS) + SN_UTIL_HIST_SUB_BITS - 1;
+
+    return ((uint64_t)SN_UTIL_HIST_SUB + (idx & (SN_UTIL_HIST_SUB - 1))) << (exp - SN_UTIL_HIST_SUB_BITS);
+}
@@ -0,0 +1,23 @@
+#include "util/time.h"
+
+#include <time.h>
+
+uint64_t sn_util_time_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t sn_util_time_ms(void) {
+    return sn_util_time_ns()/1000000ull;
+}
+
+uint64_t sn_util_time_real_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
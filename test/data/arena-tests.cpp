@@ -0,0 +1,42 @@
+#include "../catch.hpp"
+
+#include "data/arena.h"
+
+#include <stdint.h>
+#include <string.h>
+
+TEST_CASE("data/arena: Allocating small and large blocks", "[data_arena]") {
+    sn_data_arena_t a;
+    char* small[1000];
+    char* large;
+    char* last;
+    size_t i;
+
+    sn_data_arena_init(&a);
+
+    for(i = 0; i < 1000; ++i) {
+        REQUIRE((small[i] = (char*)sn_data_arena_alloc(&a, 97 + i%8)) != NULL);
+        REQUIRE(((uintptr_t)small[i] & 7) == 0);
+        memset(small[i], (int)(i & 0xff), 97);
+    }
+
+    REQUIRE(sn_data_arena_used(&a) == 1000*104);
+    REQUIRE(a.reserved >= sn_data_arena_used(&a));
+
+    /* Large blocks do not waste the chunk being filled */
+
+    last = (char*)sn_data_arena_alloc(&a, 8);
+    REQUIRE((large = (char*)sn_data_arena_alloc(&a, 3*SN_DATA_ARENA_CHUNK)) != NULL);
+    memset(large, 0xaa, 3*SN_DATA_ARENA_CHUNK);
+    REQUIRE((char*)sn_data_arena_alloc(&a, 8) == last + 8);
+
+    for(i = 0; i < 1000; ++i)
+        REQUIRE(small[i][96] == (char)(i & 0xff));
+
+    REQUIRE(sn_data_arena_alloc(&a, 0) != NULL);
+
+    sn_data_arena_destroy(&a);
+
+    REQUIRE(sn_data_arena_used(&a) == 0);
+    REQUIRE(a.head == NULL);
+}
@@ -0,0 +1,81 @@
+#include "../catch.hpp"
+
+#include "data/cache.h"
+
+#include <string.h>
+
+TEST_CASE("data/cache: Expiring and versioning values", "[data_cache]") {
+    sn_data_cache_t cache;
+    sn_data_cache_item_t item;
+    unsigned int key = 1;
+
+    REQUIRE(sn_data_cache_init(&cache, sizeof(key), 4) == 0);
+
+    REQUIRE(sn_data_cache_put(&cache, &key, "Hola", 5, 2, 100) == 0);
+    REQUIRE(sn_data_cache_get(&cache, &key, 99, &item) == 0);
+    REQUIRE(item.len == 5);
+    REQUIRE(item.version == 2);
+    REQUIRE(strcmp(item.value, "Hola") == 0);
+
+    /* Older versions are ignored, newer ones replace it */
+
+    REQUIRE(sn_data_cache_put(&cache, &key, "Old", 4, 1, 200) == 0);
+    REQUIRE(sn_data_cache_get(&cache, &key, 99, &item) == 0);
+    REQUIRE(item.version == 2);
+
+    REQUIRE(sn_data_cache_put(&cache, &key, "A longer value", 15, 3, 200) == 0);
+    REQUIRE(sn_data_cache_get(&cache, &key, 150, &item) == 0);
+    REQUIRE(item.version == 3);
+    REQUIRE(strcmp(item.value, "A longer value") == 0);
+
+    /* Expired values are gone */
+
+    REQUIRE(sn_data_cache_get(&cache, &key, 200, &item) == -1);
+    REQUIRE(sn_data_cache_size(&cache) == 0);
+
+    REQUIRE(sn_data_cache_put(&cache, &key, "", 0, 4, 300) == 0);
+    REQUIRE(sn_data_cache_get(&cache, &key, 0, &item) == 0);
+    REQUIRE(item.len == 0);
+
+    REQUIRE(sn_data_cache_remove(&cache, &key) == 0);
+    REQUIRE(sn_data_cache_remove(&cache, &key) == -1);
+    REQUIRE(sn_data_cache_get(&cache, &key, 0, NULL) == -1);
+
+    sn_data_cache_destroy(&cache);
+}
+
+TEST_CASE("data/cache: Evicting by CLOCK", "[data_cache]") {
+    sn_data_cache_t cache;
+    unsigned int key;
+
+    REQUIRE(sn_data_cache_init(&cache, sizeof(key), 8) == 0);
+
+    for(key = 0; key < 8; ++key)
+        REQUIRE(sn_data_cache_put(&cache, &key, "v", 1, 1, 1000) == 0);
+
+    /* Values read since the hand passed get a second chance */
+
+    for(key = 0; key < 8; key += 2)
+        REQUIRE(sn_data_cache_get(&cache, &key, 0, NULL) == 0);
+
+    for(key = 8; key < 12; ++key)
+        REQUIRE(sn_data_cache_put(&cache, &key, "v", 1, 1, 1000) == 0);
+
+    REQUIRE(sn_data_cache_size(&cache) == 8);
+
+    for(key = 0; key < 12; ++key)
+        REQUIRE((sn_data_cache_get(&cache, &key, 0, NULL) == 0) == (key%2 == 0 || key >= 8));
+
+    /* Once every value was read, the hand clears them all and evicts where it started */
+
+    key = 12;
+    REQUIRE(sn_data_cache_put(&cache, &key, "v", 1, 1, 1000) == 0);
+    REQUIRE(sn_data_cache_size(&cache) == 8);
+
+    for(key = 0; key < 1000; ++key)
+        sn_data_cache_put(&cache, &key, "v", 1, 1, 1000);
+
+    REQUIRE(sn_data_cache_size(&cache) == 8);
+
+    sn_data_cache_destroy(&cache);
+}
@@ -0,0 +1,114 @@
+#include "../catch.hpp"
+
+#include "data/erasure.h"
+
+#include <string.h>
+
+#define ERASURE_TEST_LEN 1013
+
+static void erasure_fill(unsigned char* frags, unsigned int data, size_t len) {
+    size_t i;
+
+    for(i = 0; i < data*len; ++i)
+        frags[i] = (unsigned char)(i*131 + (i >> 7));
+}
+
+TEST_CASE("data/erasure: Decoding from any data fragments", "[data_erasure]") {
+    static unsigned char frags[6][ERASURE_TEST_LEN], out[4][ERASURE_TEST_LEN];
+    const unsigned char* data[4];
+    unsigned char* parity[2];
+    unsigned char* outs[4];
+    const unsigned char* got[4];
+    unsigned int indexes[4];
+    sn_data_erasure_t code;
+    unsigned int mask, i, n, decoded = 0;
+
+    REQUIRE(sn_data_erasure_init(&code, 4, 2) == 0);
+
+    erasure_fill(&frags[0][0], 4, ERASURE_TEST_LEN);
+
+    for(i = 0; i < 4; ++i) {
+        data[i] = frags[i];
+        outs[i] = out[i];
+    }
+
+    for(i = 0; i < 2; ++i)
+        parity[i] = frags[4 + i];
+
+    sn_data_erasure_encode(&code, data, parity, ERASURE_TEST_LEN);
+
+    /* Every choice of 4 out of the 6 fragments, in any order */
+
+    for(mask = 0; mask < 64; ++mask) {
+        for(i = 0, n = 0; i < 6; ++i)
+            n += (mask >> i) & 1;
+
+        if(n != 4)
+            continue;
+
+        for(i = 6, n = 0; i-- > 0;) {
+            if(mask & (1u << i)) {
+                indexes[n] = i;
+                got[n++] = frags[i];
+            }
+        }
+
+        memset(out, 0, sizeof(out));
+        REQUIRE(sn_data_erasure_decode(&code, got, indexes, outs, ERASURE_TEST_LEN) == 0);
+
+        for(i = 0; i < 4; ++i)
+            REQUIRE(memcmp(out[i], frags[i], ERASURE_TEST_LEN) == 0);
+
+        ++decoded;
+    }
+
+    REQUIRE(decoded == 15);
+
+    /* The same fragment twice and fragments out of the code are refused */
+
+    indexes[0] = indexes[1] = 4;
+    REQUIRE(sn_data_erasure_decode(&code, got, indexes, outs, ERASURE_TEST_LEN) == -1);
+
+    indexes[0] = 0;
+    indexes[1] = 6;
+    REQUIRE(sn_data_erasure_decode(&code, got, indexes, outs, ERASURE_TEST_LEN) == -1);
+
+    REQUIRE(sn_data_erasure_init(&code, 0, 2) == -1);
+    REQUIRE(sn_data_erasure_init(&code, SN_DATA_ERASURE_MAX_DATA + 1, 2) == -1);
+}
+
+TEST_CASE("data/erasure: Kernels agree", "[data_erasure]") {
+    static unsigned char frags[16][ERASURE_TEST_LEN], parity[SN_DATA_ERASURE_KERNELS][4][ERASURE_TEST_LEN];
+    const unsigned char* data[16];
+    unsigned char* parities[4];
+    sn_data_erasure_t code;
+    int kernel, kernels = 0;
+    unsigned int i;
+
+    REQUIRE(sn_data_erasure_init(&code, 16, 4) == 0);
+    REQUIRE(sn_data_erasure_set_kernel(&code, SN_DATA_ERASURE_KERNELS) == -1);
+
+    erasure_fill(&frags[0][0], 16, ERASURE_TEST_LEN);
+
+    for(i = 0; i < 16; ++i)
+        data[i] = frags[i];
+
+    /* Lengths that are not a multiple of the vector width go through the scalar tail */
+
+    for(kernel = 0; kernel < SN_DATA_ERASURE_KERNELS; ++kernel) {
+        if(sn_data_erasure_set_kernel(&code, kernel) != 0)
+            continue;
+
+        for(i = 0; i < 4; ++i)
+            parities[i] = parity[kernel][i];
+
+        sn_data_erasure_encode(&code, data, parities, ERASURE_TEST_LEN);
+
+        if(kernel > 0)
+            REQUIRE(memcmp(parity[kernel], parity[0], sizeof(parity[0])) == 0);
+
+        ++kernels;
+    }
+
+    REQUIRE(kernels >= 1);
+}
@@ -0,0 +1,65 @@
+#include "../catch.hpp"
+
+#include "data/hmap.h"
+
+TEST_CASE("data/hmap: Putting, getting and removing", "[data_hmap]") {
+    sn_data_hmap_t m;
+    int key, value, out = 0;
+
+    REQUIRE(sn_data_hmap_init(&m, sizeof(int), sizeof(int)) == 0);
+
+    for(key = 0; key < 1000; ++key) {
+        value = key*3;
+        REQUIRE(sn_data_hmap_put(&m, &key, &value) == 0);
+    }
+
+    REQUIRE(sn_data_hmap_size(&m) == 1000);
+
+    key = 42;
+    value = 7;
+    REQUIRE(sn_data_hmap_put(&m, &key, &value) == 0);
+    REQUIRE(sn_data_hmap_size(&m) == 1000);
+    REQUIRE(sn_data_hmap_get(&m, &key, &out) == 0);
+    REQUIRE(out == 7);
+
+    for(key = 0; key < 1000; key += 2)
+        REQUIRE(sn_data_hmap_remove(&m, &key, NULL) == 0);
+
+    REQUIRE(sn_data_hmap_size(&m) == 500);
+
+    for(key = 0; key < 1000; ++key) {
+        if(key%2 == 0) {
+            REQUIRE(sn_data_hmap_get(&m, &key, &out) == -1);
+        } else {
+            REQUIRE(sn_data_hmap_get(&m, &key, &out) == 0);
+            REQUIRE(out == key*3);
+        }
+    }
+
+    key = 1001;
+    REQUIRE(sn_data_hmap_remove(&m, &key, NULL) == -1);
+
+    sn_data_hmap_destroy(&m);
+}
+
+TEST_CASE("data/hmap: Iterating", "[data_hmap]") {
+    sn_data_hmap_t m;
+    size_t iter = 0;
+    int key, value, sum = 0, count = 0;
+
+    REQUIRE(sn_data_hmap_init(&m, sizeof(int), sizeof(int)) == 0);
+
+    for(key = 1; key <= 20; ++key)
+        REQUIRE(sn_data_hmap_put(&m, &key, &key) == 0);
+
+    while(sn_data_hmap_next(&m, &iter, &key, &value) == 0) {
+        REQUIRE(key == value);
+        sum += key;
+        ++count;
+    }
+
+    REQUIRE(count == 20);
+    REQUIRE(sum == 210);
+
+    sn_data_hmap_destroy(&m);
+}
@@ -0,0 +1,102 @@
+#include "../catch.hpp"
+
+#include "data/merkle.h"
+
+#include <string.h>
+
+static void merkle_key(unsigned char key[32], unsigned int i) {
+    memset(key, 0, 32);
+    key[0] = (unsigned char)(i*37);
+    key[1] = (unsigned char)(i*101 >> 3);
+    key[2] = (unsigned char)i;
+    key[31] = (unsigned char)(i >> 8);
+}
+
+static void merkle_toggle(sn_data_merkle_t* tree, unsigned int i, uint64_t version) {
+    unsigned char key[32], digest[SN_DATA_MERKLE_DIGEST_LEN];
+
+    merkle_key(key, i);
+    sn_data_merkle_item(key, sizeof(key), version, "value", 5, digest);
+    REQUIRE(sn_data_merkle_toggle(tree, key, digest) == 0);
+}
+
+TEST_CASE("data/merkle: Indexing key prefixes", "[data_merkle]") {
+    unsigned char key[32];
+
+    memset(key, 0, sizeof(key));
+    key[0] = 0xa3;
+    key[1] = 0x5c;
+
+    REQUIRE(sn_data_merkle_index(key, 0) == 0);
+    REQUIRE(sn_data_merkle_index(key, 1) == 0xa);
+    REQUIRE(sn_data_merkle_index(key, 2) == 0xa3);
+    REQUIRE(sn_data_merkle_index(key, 4) == 0xa35c);
+}
+
+TEST_CASE("data/merkle: Comparing trees top-down", "[data_merkle]") {
+    sn_data_merkle_t a, b;
+    unsigned char da[SN_DATA_MERKLE_DIGEST_LEN], db[SN_DATA_MERKLE_DIGEST_LEN], zero[SN_DATA_MERKLE_DIGEST_LEN];
+    unsigned char key[32];
+    unsigned int i, level, differing;
+    uint32_t index, child;
+
+    memset(zero, 0, sizeof(zero));
+
+    REQUIRE(sn_data_merkle_init(&a) == 0);
+    REQUIRE(sn_data_merkle_init(&b) == 0);
+
+    /* Same items in another order */
+
+    for(i = 0; i < 500; ++i)
+        merkle_toggle(&a, i, 1);
+
+    for(i = 500; i > 0; --i)
+        merkle_toggle(&b, i - 1, 1);
+
+    sn_data_merkle_digest(&a, 0, 0, da);
+    sn_data_merkle_digest(&b, 0, 0, db);
+    REQUIRE(memcmp(da, zero, sizeof(da)) != 0);
+    REQUIRE(memcmp(da, db, sizeof(da)) == 0);
+
+    /* A newer version of a single item shows up on a single path */
+
+    merkle_toggle(&b, 123, 1);
+    merkle_toggle(&b, 123, 2);
+
+    merkle_key(key, 123);
+    index = 0;
+
+    for(level = 0; level < SN_DATA_MERKLE_DEPTH; ++level) {
+        sn_data_merkle_digest(&a, level, index, da);
+        sn_data_merkle_digest(&b, level, index, db);
+        REQUIRE(memcmp(da, db, sizeof(da)) != 0);
+
+        for(child = 0, differing = 0; child < SN_DATA_MERKLE_FANOUT; ++child) {
+            sn_data_merkle_digest(&a, level + 1, index*SN_DATA_MERKLE_FANOUT + child, da);
+            sn_data_merkle_digest(&b, level + 1, index*SN_DATA_MERKLE_FANOUT + child, db);
+            differing += memcmp(da, db, sizeof(da)) != 0;
+        }
+
+        REQUIRE(differing == 1);
+        index = sn_data_merkle_index(key, level + 1);
+    }
+
+    merkle_toggle(&b, 123, 2);
+    merkle_toggle(&b, 123, 1);
+
+    sn_data_merkle_digest(&a, 0, 0, da);
+    sn_data_merkle_digest(&b, 0, 0, db);
+    REQUIRE(memcmp(da, db, sizeof(da)) == 0);
+
+    /* Emptied trees take no memory */
+
+    for(i = 0; i < 500; ++i)
+        merkle_toggle(&a, i, 1);
+
+    sn_data_merkle_digest(&a, 0, 0, da);
+    REQUIRE(memcmp(da, zero, sizeof(da)) == 0);
+    REQUIRE(sn_data_hmap_size(&a.nodes) == 0);
+
+    sn_data_merkle_destroy(&a);
+    sn_data_merkle_destroy(&b);
+}
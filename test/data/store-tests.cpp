@@ -0,0 +1,84 @@
+#include "../catch.hpp"
+
+#include "data/store.h"
+
+#include <stdio.h>
+#include <string.h>
+
+TEST_CASE("data/store: Putting, getting and removing", "[data_store]") {
+    sn_data_store_t s;
+    sn_data_store_item_t item;
+    char value[32];
+    int key;
+
+    REQUIRE(sn_data_store_init(&s, sizeof(int)) == 0);
+
+    for(key = 0; key < 1000; ++key) {
+        snprintf(value, sizeof(value), "value %d", key);
+        REQUIRE(sn_data_store_put(&s, &key, value, strlen(value), 1) == 0);
+    }
+
+    REQUIRE(sn_data_store_size(&s) == 1000);
+
+    key = 42;
+    REQUIRE(sn_data_store_put(&s, &key, "replaced", 8, 2) == 0);
+    REQUIRE(sn_data_store_size(&s) == 1000);
+    REQUIRE(sn_data_store_get(&s, &key, &item) == 0);
+    REQUIRE(item.len == 8);
+    REQUIRE(item.version == 2);
+    REQUIRE(memcmp(item.value, "replaced", 8) == 0);
+
+    key = 8;
+    REQUIRE(sn_data_store_put(&s, &key, NULL, 0, 3) == 0);
+    REQUIRE(sn_data_store_get(&s, &key, &item) == 0);
+    REQUIRE(item.len == 0);
+
+    for(key = 0; key < 1000; key += 2)
+        REQUIRE(sn_data_store_remove(&s, &key) == 0);
+
+    REQUIRE(sn_data_store_size(&s) == 500);
+    REQUIRE(sn_data_store_remove(&s, &key) == -1);
+
+    for(key = 1; key < 1000; key += 2) {
+        snprintf(value, sizeof(value), "value %d", key);
+        REQUIRE(sn_data_store_get(&s, &key, &item) == 0);
+        REQUIRE(item.len == strlen(value));
+        REQUIRE(memcmp(item.value, value, item.len) == 0);
+    }
+
+    sn_data_store_destroy(&s);
+}
+
+TEST_CASE("data/store: Compacting replaced values", "[data_store]") {
+    sn_data_store_t s;
+    sn_data_store_item_t item;
+    char value[256];
+    size_t iter = 0;
+    int key, round, count = 0;
+
+    REQUIRE(sn_data_store_init(&s, sizeof(int)) == 0);
+
+    /* 100 live values of 256 bytes, rewritten 100 times */
+
+    for(round = 0; round < 100; ++round) {
+        for(key = 0; key < 100; ++key) {
+            memset(value, round + key, sizeof(value));
+            REQUIRE(sn_data_store_put(&s, &key, value, sizeof(value), (uint64_t)round) == 0);
+        }
+    }
+
+    REQUIRE(sn_data_arena_used(&s.arena) <= 2*s.live + SN_DATA_ARENA_CHUNK);
+    REQUIRE(s.live == 100*sizeof(value));
+
+    while(sn_data_store_next(&s, &iter, &key, &item) == 0) {
+        REQUIRE(item.len == sizeof(value));
+        REQUIRE(item.version == 99);
+        REQUIRE(item.value[0] == (char)(99 + key));
+        REQUIRE(item.value[255] == (char)(99 + key));
+        ++count;
+    }
+
+    REQUIRE(count == 100);
+
+    sn_data_store_destroy(&s);
+}
@@ -14,3 +14,21 @@ TEST_CASE("NAddr from string and to string again", "[io_naddr]") {
 
     REQUIRE(strcmp(orig, reco) == 0);
 }
+
+TEST_CASE("NAddr serialized and deserialized again", "[io_naddr]") {
+    sn_io_naddr_t addr, reco;
+    sn_io_naddr_ser_t ser;
+
+    SECTION("INET keeps the port") {
+        REQUIRE(sn_io_naddr_ipv4(&addr, "6.7.33.4", 7777) == 0);
+    }
+
+    SECTION("LOCAL") {
+        REQUIRE(sn_io_naddr_local(&addr, "_sock") == 0);
+    }
+
+    REQUIRE(sn_io_naddr_ser(&addr, &ser) == 0);
+    REQUIRE(sn_io_naddr_deser(&reco, &ser) == 0);
+
+    REQUIRE(sn_io_naddr_cmp(&addr, &reco) == 0);
+}
@@ -0,0 +1,168 @@
+#include "../catch.hpp"
+
+#include <io/reactor.h>
+#include <io/sock.h>
+
+#include <pthread.h>
+#include <string.h>
+
+static void* run_reactor(void* arg) {
+    sn_io_reactor_run((sn_io_reactor_t*)arg);
+    return NULL;
+}
+
+static void record(int argc, void* argv[]) {
+    int* log = (int*)argv[0];
+    int value = (int)(size_t)argv[1];
+
+    (void)argc;
+
+    log[++log[0]] = value;
+}
+
+static void stop_after(int argc, void* argv[]) {
+    sn_io_reactor_t* r = (sn_io_reactor_t*)argv[0];
+    int* count = (int*)argv[1];
+
+    REQUIRE(argc >= 2);
+
+    if(--*count == 0)
+        sn_io_reactor_stop(r);
+}
+
+static void drain_and_stop(int argc, void* argv[]) {
+    sn_io_reactor_t* r = (sn_io_reactor_t*)argv[0];
+    sn_io_reactor_source_t* src = (sn_io_reactor_source_t*)argv[1];
+    char buf[16];
+
+    REQUIRE(argc == 2);
+
+    REQUIRE(sn_io_sock_recv(src->fd, buf, sizeof(buf), NULL) == 5);
+    REQUIRE(strcmp(buf, "Hola") == 0);
+
+    sn_io_reactor_stop(r);
+}
+
+TEST_CASE("Reactor runs timers in deadline order", "[reactor]") {
+    sn_io_reactor_t r;
+    sn_io_reactor_timer_t t1, t2, t3;
+    sn_util_closure_t c;
+    int log[8] = { 0 };
+    int stop_count = 1;
+    void* argv[2];
+
+    REQUIRE(sn_io_reactor_init(&r) == 0);
+
+    sn_io_reactor_timer_init(&t1);
+    sn_io_reactor_timer_init(&t2);
+    sn_io_reactor_timer_init(&t3);
+
+    argv[0] = log;
+    argv[1] = (void*)(size_t)2;
+    sn_util_closure_init_curried(&c, record, 2, argv);
+    REQUIRE(sn_io_reactor_timer_start(&r, &t2, 20, 0, &c) == 0);
+
+    argv[1] = (void*)(size_t)1;
+    sn_util_closure_init_curried(&c, record, 2, argv);
+    REQUIRE(sn_io_reactor_timer_start(&r, &t1, 5, 0, &c) == 0);
+
+    argv[0] = &r;
+    argv[1] = &stop_count;
+    sn_util_closure_init_curried(&c, stop_after, 2, argv);
+    REQUIRE(sn_io_reactor_timer_start(&r, &t3, 40, 0, &c) == 0);
+
+    REQUIRE(sn_io_reactor_run(&r) == 0);
+
+    REQUIRE(log[0] == 2);
+    REQUIRE(log[1] == 1);
+    REQUIRE(log[2] == 2);
+
+    sn_io_reactor_destroy(&r);
+}
+
+TEST_CASE("Reactor periodic and stopped timers", "[reactor]") {
+    sn_io_reactor_t r;
+    sn_io_reactor_timer_t periodic, stopped;
+    sn_util_closure_t c;
+    int stop_count = 3;
+    int log[8] = { 0 };
+    void* argv[2];
+
+    REQUIRE(sn_io_reactor_init(&r) == 0);
+
+    sn_io_reactor_timer_init(&periodic);
+    sn_io_reactor_timer_init(&stopped);
+
+    argv[0] = log;
+    argv[1] = (void*)(size_t)7;
+    sn_util_closure_init_curried(&c, record, 2, argv);
+    REQUIRE(sn_io_reactor_timer_start(&r, &stopped, 10, 0, &c) == 0);
+    sn_io_reactor_timer_stop(&r, &stopped);
+
+    argv[0] = &r;
+    argv[1] = &stop_count;
+    sn_util_closure_init_curried(&c, stop_after, 2, argv);
+    REQUIRE(sn_io_reactor_timer_start(&r, &periodic, 5, 5, &c) == 0);
+
+    REQUIRE(sn_io_reactor_run(&r) == 0);
+
+    REQUIRE(stop_count == 0);
+    REQUIRE(log[0] == 0);
+
+    sn_io_reactor_timer_stop(&r, &periodic);
+    sn_io_reactor_destroy(&r);
+}
+
+TEST_CASE("Reactor posts and stops from other threads", "[reactor]") {
+    sn_io_reactor_t r;
+    sn_util_closure_t c;
+    pthread_t thrd;
+    int log[8] = { 0 };
+    void* argv[2];
+
+    REQUIRE(sn_io_reactor_init(&r) == 0);
+    REQUIRE(pthread_create(&thrd, NULL, run_reactor, &r) == 0);
+
+    argv[0] = log;
+    argv[1] = (void*)(size_t)1;
+    sn_util_closure_init_curried(&c, record, 2, argv);
+    REQUIRE(sn_io_reactor_post(&r, &c) == 0);
+
+    argv[1] = (void*)(size_t)2;
+    sn_util_closure_init_curried(&c, record, 2, argv);
+    REQUIRE(sn_io_reactor_post(&r, &c) == 0);
+
+    sn_io_reactor_stop(&r);
+    REQUIRE(pthread_join(thrd, NULL) == 0);
+
+    REQUIRE(log[0] == 2);
+    REQUIRE(log[1] == 1);
+    REQUIRE(log[2] == 2);
+
+    sn_io_reactor_destroy(&r);
+}
+
+TEST_CASE("Reactor watches sockets", "[reactor]") {
+    sn_io_reactor_t r;
+    sn_io_reactor_source_t src;
+    sn_util_closure_t c;
+    sn_io_naddr_t addr;
+    sn_io_sock_t sock;
+
+    REQUIRE(sn_io_reactor_init(&r) == 0);
+
+    sn_io_naddr_local(&addr, "_REACTOR");
+    REQUIRE((sock = sn_io_sock_named(&addr)) != SN_IO_SOCK_INVALID);
+    REQUIRE(sn_io_sock_set_nonblocking(sock, 1) == 0);
+
+    sn_util_closure_init_curried_once(&c, drain_and_stop, &r);
+    REQUIRE(sn_io_reactor_add(&r, &src, sock, &c) == 0);
+
+    REQUIRE(sn_io_sock_send(sock, "Hola", 5, &addr) == 5);
+
+    REQUIRE(sn_io_reactor_run(&r) == 0);
+
+    REQUIRE(sn_io_reactor_remove(&r, &src) == 0);
+    sn_io_reactor_destroy(&r);
+    sn_io_sock_close(sock);
+}
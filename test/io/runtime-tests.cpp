@@ -0,0 +1,97 @@
+#include "../catch.hpp"
+
+#include <io/runtime.h>
+#include <io/sock.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define asm __asm
+#include <mintomic/mintomic.h>
+
+static void drain_count(int argc, void* argv[]) {
+    mint_atomic32_t* count = (mint_atomic32_t*)argv[0];
+    sn_io_reactor_source_t* src = (sn_io_reactor_source_t*)argv[1];
+    char buf[16];
+
+    (void)argc;
+
+    while(sn_io_sock_recv(src->fd, buf, sizeof(buf), NULL) > 0)
+        mint_fetch_add_32_relaxed(count, 1);
+}
+
+static void post_count(int argc, void* argv[]) {
+    (void)argc;
+
+    mint_fetch_add_32_relaxed((mint_atomic32_t*)argv[0], 1);
+}
+
+static int wait_count(mint_atomic32_t* count, uint32_t value) {
+    struct timespec pause = { 0, 1000000 };
+    int i;
+
+    for(i = 0; i < 5000 && mint_load_32_relaxed(count) < value; ++i)
+        nanosleep(&pause, NULL);
+
+    return mint_load_32_relaxed(count) >= value;
+}
+
+TEST_CASE("Runtime workers serve attached sockets", "[runtime]") {
+    sn_io_runtime_t rt;
+    sn_io_reactor_source_t srcs[4];
+    sn_io_naddr_t addrs[4];
+    sn_io_sock_t socks[4];
+    sn_util_closure_t c;
+    mint_atomic32_t count;
+    int i, round;
+
+    REQUIRE(sn_io_runtime_init(&rt, 0) == -1);
+    REQUIRE(sn_io_runtime_init(&rt, 3) == 0);
+
+    mint_store_32_relaxed(&count, 0);
+    sn_util_closure_init_curried_once(&c, drain_count, &count);
+
+    for(i = 0; i < 4; ++i) {
+        char name[16];
+
+        sprintf(name, "_RUNTIME%d", i);
+        sn_io_naddr_local(&addrs[i], name);
+        REQUIRE((socks[i] = sn_io_sock_named(&addrs[i])) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_io_sock_set_nonblocking(socks[i], 1) == 0);
+        REQUIRE(sn_io_runtime_attach(&rt, &srcs[i], socks[i], &c) == 0);
+    }
+
+    SECTION("Every datagram is read once") {
+        /* Rounds keep the local datagram queues short */
+
+        for(round = 0; round < 25; ++round) {
+            for(i = 0; i < 4; ++i)
+                REQUIRE(sn_io_sock_send(socks[i], "Hola", 5, &addrs[(i + 1)%4]) == 5);
+
+            REQUIRE(wait_count(&count, 4*(round + 1)));
+        }
+
+        REQUIRE(mint_load_32_relaxed(&count) == 100);
+    }
+
+    SECTION("Posts run on a worker") {
+        mint_atomic32_t posted;
+
+        mint_store_32_relaxed(&posted, 0);
+        sn_util_closure_init_curried_once(&c, post_count, &posted);
+
+        for(i = 0; i < 10; ++i)
+            REQUIRE(sn_io_reactor_post(sn_io_runtime_reactor(&rt), &c) == 0);
+
+        REQUIRE(wait_count(&posted, 10));
+    }
+
+    for(i = 0; i < 4; ++i) {
+        REQUIRE(sn_io_runtime_detach(&rt, &srcs[i]) == 0);
+        sn_io_sock_close(socks[i]);
+    }
+
+    sn_io_runtime_destroy(&rt);
+}
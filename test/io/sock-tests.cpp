@@ -0,0 +1,73 @@
+#include "../catch.hpp"
+
+#include <io/sock.h>
+#include <util/time.h>
+
+#include <string.h>
+
+TEST_CASE("Sockets report reception info", "[sock]") {
+    sn_io_naddr_t any, dst;
+    sn_io_sock_t rx, tx;
+    sn_io_sock_rx_info_t infos[SN_IO_SOCK_BATCH_LEN];
+    sn_io_sock_rx_info_t info;
+    char data[SN_IO_SOCK_BATCH_LEN][512];
+    void* bufs[SN_IO_SOCK_BATCH_LEN];
+    size_t lens[SN_IO_SOCK_BATCH_LEN];
+    uint64_t before;
+    ssize_t n;
+    int i;
+
+    for(i = 0; i < SN_IO_SOCK_BATCH_LEN; ++i)
+        bufs[i] = data[i];
+
+    REQUIRE(sn_io_naddr_ipv4(&any, "127.0.0.1", 0) == 0);
+    REQUIRE((rx = sn_io_sock_named(&any)) != SN_IO_SOCK_INVALID);
+    REQUIRE((tx = sn_io_sock_named(&any)) != SN_IO_SOCK_INVALID);
+    REQUIRE(sn_io_sock_get_name(rx, &dst) == 0);
+
+    REQUIRE(sn_io_sock_set_rx_info(rx, 1) == 0);
+
+    SECTION("Timestamps") {
+        before = sn_util_time_real_ns();
+
+        REQUIRE(sn_io_sock_send(tx, "Hola", 5, &dst) == 5);
+        REQUIRE(sn_io_sock_send(tx, "Hola", 5, &dst) == 5);
+
+        REQUIRE(sn_io_sock_recv_info(rx, data[0], sizeof(data[0]), NULL, &info) == 5);
+        REQUIRE(info.stamp_ns >= before);
+        REQUIRE(info.stamp_ns <= sn_util_time_real_ns());
+        REQUIRE(info.drops == 0);
+        REQUIRE(info.drops_reported == 0);
+
+        REQUIRE(sn_io_sock_recv_many(rx, bufs, sizeof(data[0]), lens, NULL, infos, SN_IO_SOCK_BATCH_LEN) == 1);
+        REQUIRE(lens[0] == 5);
+        REQUIRE(infos[0].stamp_ns >= info.stamp_ns);
+    }
+
+    SECTION("Drops are counted once the queue overflows") {
+        char payload[512];
+
+        memset(payload, 'x', sizeof(payload));
+
+        REQUIRE(sn_io_sock_set_rcvbuf(rx, 1) == 0);
+
+        for(i = 0; i < 256; ++i)
+            sn_io_sock_send(tx, payload, sizeof(payload), &dst);
+
+        while(sn_io_sock_recv_many(rx, bufs, sizeof(data[0]), lens, NULL, infos, SN_IO_SOCK_BATCH_LEN) > 0);
+
+        /* The running total comes with the datagrams queued after the drops */
+
+        REQUIRE(sn_io_sock_send(tx, "Hola", 5, &dst) == 5);
+
+        n = sn_io_sock_recv_info(rx, data[0], sizeof(data[0]), NULL, &info);
+
+        REQUIRE(n == 5);
+        REQUIRE(info.stamp_ns != 0);
+        REQUIRE(info.drops > 0);
+        REQUIRE(info.drops_reported == 1);
+    }
+
+    sn_io_sock_close(tx);
+    sn_io_sock_close(rx);
+}
@@ -49,6 +49,26 @@ TEST_CASE("Address distance", "[addr]") {
     REQUIRE(sn_net_addr_cmp(&dist, &exp_dist) == 0);
 }
 
+TEST_CASE("Address XOR distance", "[addr]") {
+    sn_net_addr_t addr;
+    sn_net_addr_t addr2;
+    sn_net_addr_t dist;
+    sn_net_addr_t exp_dist;
+    const char hex[] = "0000111122223333444455556666777788889999AAAABBBBCCCCddddeeeeffff";
+    const char hex2[] = "0000111122223333444455556666777788889999AAAABBBBCCCCddddeeeAfffe";
+    const char hex_dist[] = "0000000000000000000000000000000000000000000000000000000000040001";
+
+    sn_net_addr_from_hex(&addr, hex);
+    sn_net_addr_from_hex(&addr2, hex2);
+    sn_net_addr_from_hex(&exp_dist, hex_dist);
+
+    sn_net_addr_xor(&addr, &addr2, &dist);
+    REQUIRE(sn_net_addr_cmp(&dist, &exp_dist) == 0);
+
+    sn_net_addr_xor(&addr2, &addr, &dist);
+    REQUIRE(sn_net_addr_cmp(&dist, &exp_dist) == 0);
+}
+
 TEST_CASE("Address indexing", "[addr]") {
     sn_net_addr_t addr;
     sn_net_addr_t addr2;
@@ -0,0 +1,98 @@
+#include "../catch.hpp"
+
+#include <net/detector.h>
+
+#include <string.h>
+
+TEST_CASE("Failure detection", "[detector]") {
+    sn_net_detector_t d;
+    sn_net_router_t r;
+    sn_net_addr_t self, a1, b2;
+    sn_io_naddr_t self_net, net1, net2, other;
+    sn_data_vec_t probes, dead;
+    sn_net_entry_t e;
+    uint64_t now = 10000;
+
+    sn_net_addr_from_hex(&self, "0a0a");
+    sn_net_addr_from_hex(&a1, "a1");
+    sn_net_addr_from_hex(&b2, "b2");
+    sn_io_naddr_from_str(&self_net, "INET:1.1.1.1:1111");
+    sn_io_naddr_from_str(&net1, "INET:1.1.1.1:1");
+    sn_io_naddr_from_str(&net2, "INET:1.1.1.1:2");
+    sn_io_naddr_from_str(&other, "INET:1.1.1.1:3");
+
+    sn_net_router_init(&r, &self, &self_net);
+    sn_net_router_add(&r, &a1, &net1);
+    sn_net_router_add(&r, &b2, &net2);
+
+    REQUIRE(sn_net_detector_init(&d) == 0);
+    REQUIRE(sn_data_vec_init(&probes, sizeof(sn_net_entry_t)) == 0);
+    REQUIRE(sn_data_vec_init(&dead, sizeof(sn_net_entry_t)) == 0);
+
+    REQUIRE(sn_net_detector_phi(&d, &net1, now) < 0);
+    REQUIRE(sn_net_detector_sync(&d, &r, now) == 0);
+    REQUIRE(sn_net_detector_phi(&d, &net1, now) == 0);
+    REQUIRE(sn_net_detector_phi(&d, &other, now) < 0);
+
+    SECTION("Suspicion grows with silence and heartbeats clear it") {
+        REQUIRE(sn_net_detector_phi(&d, &net1, now + 1000) < sn_net_detector_phi(&d, &net1, now + 2000));
+
+        sn_net_detector_heard(&d, &net1, now + 2000);
+        sn_net_detector_heard(&d, &other, now + 2000);
+
+        REQUIRE(sn_net_detector_phi(&d, &net1, now + 2000) == 0);
+        REQUIRE(sn_net_detector_phi(&d, &other, now + 2000) < 0);
+    }
+
+    SECTION("Frequent heartbeats make silence suspicious sooner") {
+        for(int i = 1; i <= 50; ++i)
+            sn_net_detector_heard(&d, &net1, now + i*10);
+
+        sn_net_detector_heard(&d, &net2, now + 500);
+
+        REQUIRE(sn_net_detector_phi(&d, &net1, now + 1500) > sn_net_detector_phi(&d, &net2, now + 1500));
+        REQUIRE(sn_net_detector_phi(&d, &net1, now + 1500) < 10*SN_NET_DETECTOR_PHI_DEAD);
+    }
+
+    SECTION("Only quiet neighbors are probed, once per interval") {
+        sn_net_detector_heard(&d, &net2, now + 2000);
+
+        REQUIRE(sn_net_detector_check(&d, now + 2500, &probes, &dead) == 0);
+        REQUIRE(sn_data_vec_size(&probes) == 1);
+        REQUIRE(sn_data_vec_at(&probes, 0, &e) == 0);
+        REQUIRE(sn_net_addr_cmp(&e.addr, &a1) == 0);
+
+        REQUIRE(sn_net_detector_check(&d, now + 2600, &probes, &dead) == 0);
+        REQUIRE(sn_data_vec_size(&probes) == 1);
+        REQUIRE(sn_data_vec_size(&dead) == 0);
+    }
+
+    SECTION("Neighbors missing their probes are given up on") {
+        uint64_t t;
+
+        for(t = now; sn_data_vec_size(&dead) == 0 && t < now + 60000; t += 500) {
+            sn_net_detector_heard(&d, &net2, t);
+            REQUIRE(sn_net_detector_check(&d, t, &probes, &dead) == 0);
+        }
+
+        REQUIRE(sn_data_vec_size(&dead) == 1);
+        REQUIRE(sn_data_vec_size(&probes) >= SN_NET_DETECTOR_PROBES);
+        REQUIRE(sn_data_vec_at(&dead, 0, &e) == 0);
+        REQUIRE(sn_net_addr_cmp(&e.addr, &a1) == 0);
+        REQUIRE(sn_net_detector_phi(&d, &net1, t) < 0);
+        REQUIRE(sn_net_detector_phi(&d, &net2, t) < SN_NET_DETECTOR_PHI_PROBE);
+    }
+
+    SECTION("Neighbors removed from the router are forgotten") {
+        sn_net_router_remove(&r, &a1);
+
+        REQUIRE(sn_net_detector_sync(&d, &r, now) == 0);
+        REQUIRE(sn_net_detector_phi(&d, &net1, now) < 0);
+        REQUIRE(sn_net_detector_phi(&d, &net2, now) == 0);
+    }
+
+    sn_data_vec_destroy(&probes);
+    sn_data_vec_destroy(&dead);
+    sn_net_detector_destroy(&d);
+    sn_net_router_destroy(&r);
+}
@@ -0,0 +1,142 @@
+#include "../catch.hpp"
+
+#include <net/geometry.h>
+#include <net/kbucket.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+TEST_CASE("K-bucket XOR routing", "[kbucket]") {
+    sn_net_kbucket_t k;
+    sn_net_addr_t self, a8000, a4000, a4800, a0001, dst;
+    sn_net_entry_t nexthop;
+    sn_io_naddr_t naddr;
+
+    sn_net_addr_from_hex(&self, "0000");
+    sn_net_addr_from_hex(&a8000, "8000");
+    sn_net_addr_from_hex(&a4000, "4000");
+    sn_net_addr_from_hex(&a4800, "4800");
+    sn_net_addr_from_hex(&a0001, "0001");
+    sn_io_naddr_from_str(&naddr, "INET:1.1.1.1:1111");
+
+    sn_net_kbucket_init(&k, &self, &naddr);
+
+    sn_net_addr_from_hex(&dst, "c000");
+    sn_net_kbucket_nexthop(&k, &dst, &nexthop);
+    REQUIRE(nexthop.is_set == 0); //Empty, deliver to self
+
+    sn_net_kbucket_add(&k, &a8000, &naddr);
+    sn_net_kbucket_add(&k, &a4000, &naddr);
+    sn_net_kbucket_add(&k, &a4800, &naddr);
+    sn_net_kbucket_add(&k, &a0001, &naddr);
+    sn_net_kbucket_add(&k, &a0001, &naddr);
+    sn_net_kbucket_add(&k, &self, &naddr);
+
+    REQUIRE(sn_net_kbucket_size(&k) == 4);
+
+    sn_net_kbucket_nexthop(&k, &dst, &nexthop);
+    REQUIRE(nexthop.is_set);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &a8000) == 0);
+
+    sn_net_addr_from_hex(&dst, "4900");
+    sn_net_kbucket_nexthop(&k, &dst, &nexthop);
+    REQUIRE(nexthop.is_set);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &a4800) == 0);
+
+    sn_net_kbucket_nexthop_alt(&k, &dst, &a4800, &nexthop);
+    REQUIRE(nexthop.is_set);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &a4000) == 0);
+
+    /* Contacts sharing more bits with us, but still closer to dst */
+
+    sn_net_addr_from_hex(&dst, "0003");
+    sn_net_kbucket_nexthop(&k, &dst, &nexthop);
+    REQUIRE(nexthop.is_set);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &a0001) == 0);
+
+    sn_net_kbucket_nexthop(&k, &self, &nexthop);
+    REQUIRE(nexthop.is_set == 0);
+
+    sn_net_kbucket_remove(&k, &a4800);
+    sn_net_kbucket_remove(&k, &a4800);
+    REQUIRE(sn_net_kbucket_size(&k) == 3);
+
+    sn_net_addr_from_hex(&dst, "4900");
+    sn_net_kbucket_nexthop(&k, &dst, &nexthop);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &a4000) == 0);
+
+    sn_net_kbucket_nexthop_alt(&k, &dst, &a4000, &nexthop);
+    REQUIRE(nexthop.is_set == 0); //8000 is further than us
+
+    sn_net_kbucket_destroy(&k);
+}
+
+TEST_CASE("K-bucket full buckets", "[kbucket]") {
+    sn_net_kbucket_t k;
+    sn_net_addr_t self, addrs[SN_NET_KBUCKET_K + 1], dst;
+    sn_net_entry_t nexthop;
+    char hex[8];
+    int i;
+
+    sn_net_addr_from_hex(&self, "0000");
+    sn_net_kbucket_init(&k, &self, NULL);
+
+    for(i = 0; i <= SN_NET_KBUCKET_K; ++i) {
+        snprintf(hex, sizeof(hex), "%x", 0x8000 + i*0x100);
+        sn_net_addr_from_hex(&addrs[i], hex);
+        sn_net_kbucket_add(&k, &addrs[i], NULL);
+    }
+
+    /* The newest contact does not fit */
+
+    REQUIRE(sn_net_kbucket_size(&k) == SN_NET_KBUCKET_K);
+
+    sn_net_kbucket_nexthop(&k, &addrs[SN_NET_KBUCKET_K], &nexthop);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &addrs[SN_NET_KBUCKET_K]) != 0);
+
+    sn_net_kbucket_remove(&k, &addrs[0]);
+    sn_net_kbucket_add(&k, &addrs[SN_NET_KBUCKET_K], NULL);
+
+    REQUIRE(sn_net_kbucket_size(&k) == SN_NET_KBUCKET_K);
+
+    sn_net_kbucket_nexthop(&k, &addrs[SN_NET_KBUCKET_K], &nexthop);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &addrs[SN_NET_KBUCKET_K]) == 0);
+
+    sn_net_addr_from_hex(&dst, "0fff");
+    sn_net_kbucket_nexthop(&k, &dst, &nexthop);
+    REQUIRE(nexthop.is_set == 0);
+
+    sn_net_kbucket_destroy(&k);
+}
+
+TEST_CASE("Routing geometries", "[kbucket]") {
+    const sn_net_geometry_t* geometries[] = { &sn_net_geometry_pastry, &sn_net_geometry_kademlia, &sn_net_geometry_onehop };
+    sn_net_addr_t self, near, dst;
+    sn_net_entry_t nexthop;
+    unsigned int i;
+
+    sn_net_addr_from_hex(&self, "1000");
+    sn_net_addr_from_hex(&near, "c000");
+    sn_net_addr_from_hex(&dst, "c001");
+
+    for(i = 0; i < 3; ++i) {
+        void* state = malloc(geometries[i]->state_size);
+
+        REQUIRE(state != NULL);
+
+        geometries[i]->init(state, &self, NULL);
+        geometries[i]->add(state, &near, NULL);
+        geometries[i]->nexthop(state, &dst, &nexthop);
+
+        REQUIRE(nexthop.is_set);
+        REQUIRE(sn_net_addr_cmp(&nexthop.addr, &near) == 0);
+
+        geometries[i]->remove(state, &near);
+        geometries[i]->nexthop(state, &dst, &nexthop);
+
+        REQUIRE(nexthop.is_set == 0);
+
+        geometries[i]->destroy(state);
+        free(state);
+    }
+}
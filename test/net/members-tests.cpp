@@ -0,0 +1,126 @@
+#include "../catch.hpp"
+
+#include <net/members.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+TEST_CASE("Membership owners", "[members]") {
+    sn_net_members_t m;
+    sn_net_addr_t self, a1000, a3000, a8000, af800, dst;
+    sn_net_entry_t nexthop;
+    sn_io_naddr_t naddr;
+    size_t idx;
+
+    sn_net_addr_from_hex(&self, "4000");
+    sn_net_addr_from_hex(&a1000, "1000");
+    sn_net_addr_from_hex(&a3000, "3000");
+    sn_net_addr_from_hex(&a8000, "8000");
+    sn_net_addr_from_hex(&af800, "f800");
+    sn_io_naddr_from_str(&naddr, "INET:1.1.1.1:1111");
+
+    sn_net_members_init(&m, &self, &naddr);
+
+    sn_net_addr_from_hex(&dst, "3100");
+    sn_net_members_nexthop(&m, &dst, &nexthop);
+    REQUIRE(nexthop.is_set == 0); //Alone, deliver to self
+
+    REQUIRE(sn_net_members_add(&m, &a8000, &naddr) == 1);
+    REQUIRE(sn_net_members_add(&m, &af800, &naddr) == 1);
+    REQUIRE(sn_net_members_add(&m, &a1000, &naddr) == 1);
+    REQUIRE(sn_net_members_add(&m, &a3000, &naddr) == 1);
+    REQUIRE(sn_net_members_add(&m, &a3000, &naddr) == 0);
+    REQUIRE(sn_net_members_add(&m, &self, &naddr) == 0);
+
+    REQUIRE(sn_net_members_size(&m) == 4);
+    REQUIRE(sn_net_addr_cmp(&sn_net_members_at(&m, 0)->addr, &a1000) == 0);
+    REQUIRE(sn_net_addr_cmp(&sn_net_members_at(&m, 3)->addr, &af800) == 0);
+    REQUIRE(sn_net_members_at(&m, 4) == NULL);
+
+    REQUIRE(sn_net_members_find(&m, &a8000, &idx) == 0);
+    REQUIRE(idx == 2);
+    REQUIRE(sn_net_members_find(&m, &self, &idx) == -1);
+    REQUIRE(idx == 2);
+
+    sn_net_members_nexthop(&m, &dst, &nexthop);
+    REQUIRE(nexthop.is_set);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &a3000) == 0);
+
+    sn_net_addr_from_hex(&dst, "4100");
+    sn_net_members_nexthop(&m, &dst, &nexthop);
+    REQUIRE(nexthop.is_set == 0);
+
+    /* Around the ring */
+
+    sn_net_addr_from_hex(&dst, "0100");
+    sn_net_members_nexthop(&m, &dst, &nexthop);
+    REQUIRE(nexthop.is_set);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &af800) == 0);
+
+    /* Alternatives must still be closer than us */
+
+    sn_net_addr_from_hex(&dst, "2100");
+    sn_net_members_nexthop_alt(&m, &dst, &a3000, &nexthop);
+    REQUIRE(nexthop.is_set);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &a1000) == 0);
+
+    sn_net_addr_from_hex(&dst, "3100");
+    sn_net_members_nexthop_alt(&m, &dst, &a3000, &nexthop);
+    REQUIRE(nexthop.is_set == 0);
+
+    REQUIRE(sn_net_members_remove(&m, &a3000) == 0);
+    REQUIRE(sn_net_members_remove(&m, &a3000) == -1);
+    REQUIRE(sn_net_members_size(&m) == 3);
+
+    sn_net_members_nexthop(&m, &dst, &nexthop);
+    REQUIRE(nexthop.is_set == 0);
+
+    sn_net_members_destroy(&m);
+}
+
+TEST_CASE("Membership growth", "[members]") {
+    sn_net_members_t m;
+    sn_net_addr_t self, addr;
+    sn_net_entry_t nexthop;
+    char hex[16];
+    size_t i, idx;
+
+    sn_net_addr_from_hex(&self, "00000000");
+    sn_net_members_init(&m, &self, NULL);
+
+    /* Shuffled inserts, members sharing their first bytes too */
+
+    for(i = 1; i <= 1000; ++i) {
+        snprintf(hex, sizeof(hex), "%08x", (unsigned int)((i*7919)%1000 + 1)*0x1001);
+        sn_net_addr_from_hex(&addr, hex);
+        REQUIRE(sn_net_members_add(&m, &addr, NULL) == 1);
+    }
+
+    REQUIRE(sn_net_members_size(&m) == 1000);
+    REQUIRE(sn_net_members_memory(&m) >= 1000*sizeof(sn_net_entry_t));
+
+    for(i = 1; i < 1000; ++i)
+        REQUIRE(sn_net_addr_cmp(&sn_net_members_at(&m, i - 1)->addr, &sn_net_members_at(&m, i)->addr) < 0);
+
+    for(i = 1; i <= 1000; ++i) {
+        snprintf(hex, sizeof(hex), "%08x", (unsigned int)i*0x1001);
+        sn_net_addr_from_hex(&addr, hex);
+
+        REQUIRE(sn_net_members_find(&m, &addr, &idx) == 0);
+        REQUIRE(idx == i - 1);
+
+        sn_net_members_nexthop(&m, &addr, &nexthop);
+        REQUIRE(nexthop.is_set);
+        REQUIRE(sn_net_addr_cmp(&nexthop.addr, &addr) == 0);
+    }
+
+    for(i = 1; i <= 1000; i += 2) {
+        snprintf(hex, sizeof(hex), "%08x", (unsigned int)i*0x1001);
+        sn_net_addr_from_hex(&addr, hex);
+        REQUIRE(sn_net_members_remove(&m, &addr) == 0);
+    }
+
+    REQUIRE(sn_net_members_size(&m) == 500);
+
+    sn_net_members_destroy(&m);
+}
@@ -1,15 +1,188 @@
 #include "../catch.hpp"
 
 #include <sndnet.h>
+#include <net/members.h>
 #include <net/packet.h>
+#include <util/time.h>
 #include <callbacks.h>
 
 #include <stdio.h>
 #include <string.h>
 
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
 #include <unistd.h>
 
+struct reply_wait {
+    pthread_mutex_t mut;
+    pthread_cond_t cond;
+    int replies;
+    int timeouts;
+};
+
+static void on_reply(int argc, void* argv[]) {
+    struct reply_wait* w = (struct reply_wait*)argv[0];
+
+    (void)argc;
+
+    pthread_mutex_lock(&w->mut);
+    if(argv[1] != NULL)
+        ++w->replies;
+    else
+        ++w->timeouts;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->mut);
+}
+
+static void on_async_sent(int argc, void* argv[]) {
+    struct reply_wait* w = (struct reply_wait*)argv[0];
+
+    (void)argc;
+
+    pthread_mutex_lock(&w->mut);
+    if(*(int*)argv[1] == 0)
+        ++w->replies;
+    else
+        ++w->timeouts;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->mut);
+}
+
+struct lookup_wait {
+    struct reply_wait wait;
+    sn_net_addr_t owner;
+    unsigned int queries;
+};
+
+static void on_lookup_done(int argc, void* argv[]) {
+    struct lookup_wait* w = (struct lookup_wait*)argv[0];
+    const sn_net_entry_t* owner = (const sn_net_entry_t*)argv[1];
+
+    (void)argc;
+
+    pthread_mutex_lock(&w->wait.mut);
+    if(owner != NULL) {
+        w->owner = owner->addr;
+        ++w->wait.replies;
+    } else {
+        ++w->wait.timeouts;
+    }
+    w->queries = *(unsigned int*)argv[2];
+    pthread_cond_signal(&w->wait.cond);
+    pthread_mutex_unlock(&w->wait.mut);
+}
+
+struct aggregate_wait {
+    struct reply_wait wait;
+    sn_node_aggregate_t result;
+};
+
+static void on_aggregate_done(int argc, void* argv[]) {
+    struct aggregate_wait* w = (struct aggregate_wait*)argv[0];
+
+    (void)argc;
+
+    pthread_mutex_lock(&w->wait.mut);
+    w->result = *(const sn_node_aggregate_t*)argv[1];
+    ++w->wait.replies;
+    pthread_cond_signal(&w->wait.cond);
+    pthread_mutex_unlock(&w->wait.mut);
+}
+
+struct store_wait {
+    struct reply_wait wait;
+    uint64_t version;
+    char value[64];
+    unsigned long long len;
+    int found;
+};
+
+static void on_put_done(int argc, void* argv[]) {
+    struct store_wait* w = (struct store_wait*)argv[0];
+
+    (void)argc;
+
+    pthread_mutex_lock(&w->wait.mut);
+    w->found = argv[1] != NULL;
+    w->version = argv[1] != NULL ? *(const uint64_t*)argv[1] : 0;
+    ++w->wait.replies;
+    pthread_cond_signal(&w->wait.cond);
+    pthread_mutex_unlock(&w->wait.mut);
+}
+
+static void on_get_done(int argc, void* argv[]) {
+    struct store_wait* w = (struct store_wait*)argv[0];
+
+    (void)argc;
+
+    pthread_mutex_lock(&w->wait.mut);
+    w->found = argv[1] != NULL;
+    w->len = *(unsigned long long*)argv[2];
+    w->version = argv[1] != NULL ? *(const uint64_t*)argv[3] : 0;
+
+    if(argv[1] != NULL && w->len < sizeof(w->value))
+        memcpy(w->value, argv[1], w->len);
+
+    ++w->wait.replies;
+    pthread_cond_signal(&w->wait.cond);
+    pthread_mutex_unlock(&w->wait.mut);
+}
+
+struct object_wait {
+    struct reply_wait wait;
+    uint64_t version;
+    char value[SN_NODE_OBJECT_MAX_LEN];
+    unsigned long long len;
+    int found;
+};
+
+static void on_object_put_done(int argc, void* argv[]) {
+    struct object_wait* w = (struct object_wait*)argv[0];
+
+    (void)argc;
+
+    pthread_mutex_lock(&w->wait.mut);
+    w->found = argv[1] != NULL;
+    w->version = argv[1] != NULL ? *(const uint64_t*)argv[1] : 0;
+    ++w->wait.replies;
+    pthread_cond_signal(&w->wait.cond);
+    pthread_mutex_unlock(&w->wait.mut);
+}
+
+static void on_object_get_done(int argc, void* argv[]) {
+    struct object_wait* w = (struct object_wait*)argv[0];
+
+    (void)argc;
+
+    pthread_mutex_lock(&w->wait.mut);
+    w->found = argv[1] != NULL;
+    w->len = *(unsigned long long*)argv[2];
+    w->version = argv[1] != NULL ? *(const uint64_t*)argv[3] : 0;
+
+    if(argv[1] != NULL && w->len <= sizeof(w->value))
+        memcpy(w->value, argv[1], w->len);
+
+    ++w->wait.replies;
+    pthread_cond_signal(&w->wait.cond);
+    pthread_mutex_unlock(&w->wait.mut);
+}
+
+static int wait_for(struct reply_wait* w, int* counter, int value) {
+    struct timespec deadline;
+    int ret = 0;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += 5;
+
+    pthread_mutex_lock(&w->mut);
+    while(*counter < value && ret == 0)
+        ret = pthread_cond_timedwait(&w->cond, &w->mut, &deadline);
+    pthread_mutex_unlock(&w->mut);
+
+    return *counter >= value;
+}
+
 TEST_CASE("Emulated network #1", "[network]") {
     sn_node_t A, B, C;
     sn_net_addr_t a3f4, b567, b666;
@@ -102,7 +275,2689 @@ TEST_CASE("Emulated network #1", "[network]") {
         sn_io_sock_close(sockTEST);
     }
 
+    SECTION("Forwarding through a busy polling node") {
+        sn_net_addr_t b667;
+        sn_io_naddr_t addrTEST;
+        sn_io_sock_t sockTEST;
+        sn_node_stats_t stats;
+        sn_net_packet_t* msg;
+        int i;
+
+        sn_net_addr_from_hex(&b667, "b667");
+        sn_io_naddr_local(&addrTEST, "_TEST");
+        REQUIRE((sockTEST = sn_io_sock_named(&addrTEST)) != SN_IO_SOCK_INVALID);
+
+        sn_net_router_add(&C.router, &b667, &addrTEST);
+
+        REQUIRE(sn_node_set_busy_poll(&B, 1000) == 0);
+
+        for(i = 0; i < 3; ++i) {
+            REQUIRE(sn_node_send(&A, &b667, 5, "Hola") == 0);
+
+            msg = sn_net_packet_recv(sockTEST, NULL);
+
+            REQUIRE(msg != NULL);
+            REQUIRE(strcmp("Hola", (char*)msg->payload) == 0);
+
+            free(msg);
+
+            /* Idle long enough for B to block again */
+
+            usleep(5000);
+        }
+
+        sn_node_get_stats(&B, &stats);
+
+        REQUIRE(stats.received == 3);
+        REQUIRE(stats.forward_ns.count == 3);
+
+        REQUIRE(sn_node_set_busy_poll(&B, 0) == 0);
+
+        sn_io_sock_close(sockTEST);
+    }
+
+    SECTION("Receive telemetry") {
+        sn_net_addr_t b668;
+        sn_io_naddr_t addrTEST;
+        sn_io_sock_t sockTEST;
+        sn_node_stats_t stats;
+        sn_net_packet_t* msg;
+        int i;
+
+        sn_net_addr_from_hex(&b668, "b668");
+        sn_io_naddr_local(&addrTEST, "_TEST");
+        REQUIRE((sockTEST = sn_io_sock_named(&addrTEST)) != SN_IO_SOCK_INVALID);
+
+        sn_net_router_add(&C.router, &b668, &addrTEST);
+
+        REQUIRE(sn_node_set_rx_telemetry(&B, 1) == 0);
+        sn_node_reset_stats(&B);
+
+        for(i = 0; i < 3; ++i) {
+            REQUIRE(sn_node_send(&A, &b668, 5, "Hola") == 0);
+
+            msg = sn_net_packet_recv(sockTEST, NULL);
+
+            REQUIRE(msg != NULL);
+
+            free(msg);
+        }
+
+        sn_node_get_stats(&B, &stats);
+
+        REQUIRE(stats.received == 3);
+        REQUIRE(stats.queue_ns.count == 3);
+        REQUIRE(stats.kernel_drops == 0);
+
+        REQUIRE(sn_node_set_rx_telemetry(&B, 0) == 0);
+
+        sn_io_sock_close(sockTEST);
+    }
+
+    SECTION("Pinging C from A and waiting for the reply") {
+        struct reply_wait w;
+        sn_util_closure_t closure;
+        sn_wire_ping_msg_t ping;
+
+        pthread_mutex_init(&w.mut, NULL);
+        pthread_cond_init(&w.cond, NULL);
+        w.replies = w.timeouts = 0;
+
+        sn_util_closure_init_curried_once(&closure, on_reply, &w);
+
+        memset(&ping, 0, sizeof(ping));
+        ping.reply_to = sn_node_new_reply_id(&A);
+
+        REQUIRE(sn_node_register_reply(&A, ping.reply_to, &closure, 1, 0) == 0);
+        REQUIRE(sn_node_send_typed(&A, &b666, SN_WIRE_NET_TYPE_PING, sizeof(ping), (const char*)&ping) == 0);
+
+        REQUIRE(wait_for(&w, &w.replies, 1));
+        REQUIRE(sn_node_unregister_reply(&A, ping.reply_to) == -1);
+
+        SECTION("Unanswered listeners time out") {
+            uint64_t start = sn_util_time_ms();
+
+            REQUIRE(sn_node_register_reply(&A, sn_node_new_reply_id(&A), &closure, 1, 10) == 0);
+
+            REQUIRE(wait_for(&w, &w.timeouts, 1));
+
+            /* On their deadline, not on the next maintenance */
+
+            REQUIRE(sn_util_time_ms() - start < 500);
+        }
+
+        pthread_cond_destroy(&w.cond);
+        pthread_mutex_destroy(&w.mut);
+    }
+
+    SECTION("Inserting b667 at C and batch sending to b667 from A") {
+        sn_net_addr_t b667;
+        sn_io_naddr_t addrTEST;
+        sn_io_sock_t sockTEST;
+        sn_node_msg_t msgs[3];
+        const char* payloads[] = { "Uno", "Dos", "Tres" };
+        int i;
+
+        sn_net_addr_from_hex(&b667, "b667");
+        sn_io_naddr_local(&addrTEST, "_TEST");
+        REQUIRE((sockTEST = sn_io_sock_named(&addrTEST)) != SN_IO_SOCK_INVALID);
+
+        sn_net_router_add(&C.router, &b667, &addrTEST);
+
+        for(i = 0; i < 3; ++i) {
+            msgs[i].dst = &b667;
+            msgs[i].type = 0;
+            msgs[i].len = strlen(payloads[i]) + 1;
+            msgs[i].payload = payloads[i];
+        }
+
+        REQUIRE(sn_node_send_many(&A, msgs, 3) == 3);
+
+        SECTION("Receiving all of them at b667") {
+            int seen[3] = { 0, 0, 0 };
+
+            for(i = 0; i < 3; ++i) {
+                sn_net_packet_t* msg;
+                int j;
+
+                msg = sn_net_packet_recv(sockTEST, NULL);
+
+                REQUIRE(msg != NULL);
+
+                for(j = 0; j < 3; ++j)
+                    if(strcmp(payloads[j], (char*)msg->payload) == 0)
+                        ++seen[j];
+
+                free(msg);
+            }
+
+            REQUIRE(seen[0] == 1);
+            REQUIRE(seen[1] == 1);
+            REQUIRE(seen[2] == 1);
+        }
+
+        sn_io_sock_close(sockTEST);
+    }
+
+    SECTION("Inserting b667 at C and sending to b667 from a signing node through its signers") {
+        struct reply_wait w;
+        sn_util_closure_t done;
+        sn_crypto_sign_pubkey_t pk;
+        sn_crypto_sign_key_t sk;
+        sn_node_t S;
+        sn_net_addr_t b667;
+        sn_io_naddr_t addrS, addrTEST;
+        sn_io_sock_t sockS, sockTEST;
+        const char* payloads[] = { "Uno", "Dos", "Tres" };
+        int seen[3] = { 0, 0, 0 };
+        int i, j;
+
+        pthread_mutex_init(&w.mut, NULL);
+        pthread_cond_init(&w.cond, NULL);
+        w.replies = w.timeouts = 0;
+
+        sn_crypto_sign_keypair(&pk, &sk);
+        sn_io_naddr_local(&addrS, "_SIG");
+        REQUIRE((sockS = sn_io_sock_named(&addrS)) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&S, &sk, &pk, sockS, 0) == 0);
+        sn_node_set_log_callback(&S, &silent);
+
+        sn_net_addr_from_hex(&b667, "b667");
+        sn_io_naddr_local(&addrTEST, "_TEST");
+        REQUIRE((sockTEST = sn_io_sock_named(&addrTEST)) != SN_IO_SOCK_INVALID);
+
+        sn_net_router_add(&S.router, &b567, &addrB);
+        sn_net_router_add(&C.router, &b667, &addrTEST);
+
+        sn_util_closure_init_curried_once(&done, on_async_sent, &w);
+
+        REQUIRE(sn_node_set_signers(&A, 2) == -1);
+        REQUIRE(sn_node_set_signers(&S, 2) == 0);
+
+        for(i = 0; i < 3; ++i)
+            REQUIRE(sn_node_send_async(&S, &b667, 0, strlen(payloads[i]) + 1, payloads[i], &done) == 0);
+
+        REQUIRE(wait_for(&w, &w.replies, 3));
+        REQUIRE(w.timeouts == 0);
+
+        for(i = 0; i < 3; ++i) {
+            sn_net_packet_t* msg;
+
+            msg = sn_net_packet_recv(sockTEST, NULL);
+
+            REQUIRE(msg != NULL);
+            REQUIRE(sn_net_packet_check_sign(msg) == 0);
+
+            for(j = 0; j < 3; ++j)
+                if(strcmp(payloads[j], (char*)msg->payload) == 0)
+                    ++seen[j];
+
+            free(msg);
+        }
+
+        REQUIRE(seen[0] == 1);
+        REQUIRE(seen[1] == 1);
+        REQUIRE(seen[2] == 1);
+
+        sn_node_destroy(&S);
+        sn_io_sock_close(sockTEST);
+
+        pthread_cond_destroy(&w.cond);
+        pthread_mutex_destroy(&w.mut);
+    }
+
     sn_node_destroy(&A);
     sn_node_destroy(&B);
     sn_node_destroy(&C);
 }
+
+static int leafset_has(sn_node_t* sns, const sn_net_addr_t* addr) {
+    int p;
+
+    for(p = -SN_NET_ROUTER_LEAFSET_SIZE; p <= SN_NET_ROUTER_LEAFSET_SIZE; ++p) {
+        const sn_net_entry_t* e = sn_net_router_leafset_get(&sns->router, p);
+
+        if(p != 0 && e->is_set && sn_net_addr_cmp(&e->addr, addr) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+TEST_CASE("Emulated network built by joins", "[network][join]") {
+    const char* hexs[] = { "4f5e", "4f12", "a3f4", "b567", "b666", "0a11", "e9e9", "4f5f" };
+    const int n = sizeof(hexs)/sizeof(hexs[0]);
+    sn_node_t nodes[8];
+    sn_net_addr_t addrs[8];
+    sn_io_naddr_t naddrs[8];
+    sn_util_closure_t silent;
+    struct timespec pause = { 0, 1000000 };
+    int i, j, k;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    for(i = 0; i < n; ++i) {
+        char name[8];
+        sn_io_sock_t sock;
+
+        snprintf(name, sizeof(name), "_J%d", i);
+
+        sn_net_addr_from_hex(&addrs[i], hexs[i]);
+        sn_io_naddr_local(&naddrs[i], name);
+
+        REQUIRE((sock = sn_io_sock_named(&naddrs[i])) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&nodes[i], NULL, (sn_crypto_sign_pubkey_t*)&addrs[i], sock, 0) == 0);
+        sn_node_set_log_callback(&nodes[i], &silent);
+    }
+
+    SECTION("Every node ends up knowing every other") {
+        /* Each one through the previous, so routes get longer */
+
+        for(i = 1; i < n; ++i) {
+            REQUIRE(sn_node_join(&nodes[i], &naddrs[i - 1]) == 0);
+
+            /* Announcements are asynchronous */
+
+            for(k = 0; k < 1000; ++k) {
+                int known = 1;
+
+                for(j = 0; j < i; ++j)
+                    if(!leafset_has(&nodes[j], &addrs[i]))
+                        known = 0;
+
+                if(known)
+                    break;
+
+                nanosleep(&pause, NULL);
+            }
+        }
+
+        for(i = 0; i < n; ++i)
+            for(j = 0; j < n; ++j)
+                if(i != j)
+                    REQUIRE(leafset_has(&nodes[i], &addrs[j]));
+
+        SECTION("And routes a ping to it") {
+            struct reply_wait w;
+            sn_util_closure_t closure;
+            sn_wire_ping_msg_t ping;
+
+            pthread_mutex_init(&w.mut, NULL);
+            pthread_cond_init(&w.cond, NULL);
+            w.replies = w.timeouts = 0;
+
+            ping.reply_to = sn_node_new_reply_id(&nodes[n - 1]);
+            memset(ping.cnt, 0, sizeof(ping.cnt));
+
+            sn_util_closure_init_curried_once(&closure, on_reply, &w);
+            REQUIRE(sn_node_register_reply(&nodes[n - 1], ping.reply_to, &closure, 1, 0) == 0);
+
+            REQUIRE(sn_node_send_typed(&nodes[n - 1], &addrs[0], SN_WIRE_NET_TYPE_PING, sizeof(ping), (const char*)&ping) == 0);
+            REQUIRE(wait_for(&w, &w.replies, 1));
+
+            pthread_cond_destroy(&w.cond);
+            pthread_mutex_destroy(&w.mut);
+        }
+    }
+
+    SECTION("Joining through an unreachable gateway times out") {
+        sn_io_naddr_t nowhere;
+
+        sn_io_naddr_local(&nowhere, "_J_NONE");
+
+        REQUIRE(sn_node_join(&nodes[0], &nowhere) == -1);
+    }
+
+    for(i = 0; i < n; ++i)
+        sn_node_destroy(&nodes[i]);
+}
+
+TEST_CASE("Emulated network losing a node", "[network][detector]") {
+    sn_node_t A, B;
+    sn_net_addr_t a3f4, b567, c0de;
+    sn_io_sock_t sockA, sockB;
+    sn_io_naddr_t addrA, addrB, addrDead;
+    sn_util_closure_t silent;
+    sn_node_stats_t stats;
+    unsigned int level;
+    unsigned char column;
+    int i;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&a3f4, "a3f4");
+    sn_net_addr_from_hex(&b567, "b567");
+    sn_net_addr_from_hex(&c0de, "c0de");
+
+    sn_io_naddr_local(&addrA, "_FA");
+    sn_io_naddr_local(&addrB, "_FB");
+    sn_io_naddr_local(&addrDead, "_FDEAD");
+
+    REQUIRE((sockA = sn_io_sock_named(&addrA)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockB = sn_io_sock_named(&addrB)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_at_socket(&A, NULL, (sn_crypto_sign_pubkey_t*)&a3f4, sockA, 0) == 0);
+    REQUIRE(sn_node_at_socket(&B, NULL, (sn_crypto_sign_pubkey_t*)&b567, sockB, 0) == 0);
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+
+    sn_net_router_add(&A.router, &b567, &addrB);
+    sn_net_router_add(&A.router, &c0de, &addrDead);
+    sn_net_router_add(&B.router, &a3f4, &addrA);
+
+    SECTION("The silent neighbor is removed, the quiet one is kept") {
+        sn_net_addr_index(&a3f4, &c0de, &level, &column);
+
+        /* Nothing is sent, liveness comes from the probes alone */
+
+        for(i = 0; i < 300; ++i) {
+            sn_node_get_stats(&A, &stats);
+
+            if(stats.failures)
+                break;
+
+            usleep(50000);
+        }
+
+        REQUIRE(stats.failures == 1);
+        REQUIRE(stats.probes >= SN_NET_DETECTOR_PROBES);
+        REQUIRE(sn_net_router_table_get(&A.router, level, column)->is_set == 0);
+        REQUIRE(leafset_has(&A, &c0de) == 0);
+        REQUIRE(leafset_has(&A, &b567) == 1);
+        REQUIRE(leafset_has(&B, &a3f4) == 1);
+    }
+
+    SECTION("Nothing is removed with failure detection disabled") {
+        sn_node_set_failure_detection(&A, 0);
+
+        usleep(3000000);
+
+        sn_node_get_stats(&A, &stats);
+
+        REQUIRE(stats.probes == 0);
+        REQUIRE(leafset_has(&A, &c0de) == 1);
+    }
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+}
+
+TEST_CASE("Emulated network repairing a table entry", "[network][repair]") {
+    sn_node_t A, B;
+    sn_net_addr_t a3f4, b567, c0de, c111;
+    sn_io_sock_t sockA, sockB;
+    sn_io_naddr_t addrA, addrB, addrDead, addrC;
+    sn_util_closure_t silent;
+    sn_node_stats_t stats;
+    const sn_net_entry_t* e;
+    unsigned int level;
+    unsigned char column;
+    int i;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&a3f4, "a3f4");
+    sn_net_addr_from_hex(&b567, "b567");
+    sn_net_addr_from_hex(&c0de, "c0de");
+    sn_net_addr_from_hex(&c111, "c111");
+
+    sn_io_naddr_local(&addrA, "_PA");
+    sn_io_naddr_local(&addrB, "_PB");
+    sn_io_naddr_local(&addrDead, "_PDEAD");
+    sn_io_naddr_local(&addrC, "_PC");
+
+    REQUIRE((sockA = sn_io_sock_named(&addrA)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockB = sn_io_sock_named(&addrB)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_at_socket(&A, NULL, (sn_crypto_sign_pubkey_t*)&a3f4, sockA, 0) == 0);
+    REQUIRE(sn_node_at_socket(&B, NULL, (sn_crypto_sign_pubkey_t*)&b567, sockB, 0) == 0);
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+    sn_node_set_failure_detection(&A, 0);
+    sn_node_set_failure_detection(&B, 0);
+
+    /* B is on the row of c0de and knows another node fitting its slot */
+
+    sn_net_router_add(&A.router, &b567, &addrB);
+    sn_net_router_add(&A.router, &c0de, &addrDead);
+    sn_net_router_add(&B.router, &a3f4, &addrA);
+    sn_net_router_add(&B.router, &c111, &addrC);
+
+    sn_net_addr_index(&a3f4, &c0de, &level, &column);
+
+    REQUIRE(sn_node_repair(&A, SN_NET_ROUTER_LEVELS, 0, &c0de) == -1);
+    REQUIRE(sn_node_repair(&A, level, column, &c0de) == 0);
+    REQUIRE(sn_node_repair(&A, level, column, &c0de) == 0);
+
+    for(i = 0; i < 100; ++i) {
+        sn_node_get_stats(&A, &stats);
+
+        if(stats.repairs)
+            break;
+
+        usleep(20000);
+    }
+
+    e = sn_net_router_table_get(&A.router, level, column);
+
+    REQUIRE(stats.repairs == 1);
+    REQUIRE(e->is_set);
+    REQUIRE(sn_net_addr_cmp(&e->addr, &c111) == 0);
+    REQUIRE(sn_io_naddr_cmp(&e->net_addr, &addrC) == 0);
+
+    /* The repaired entry is alive, repairs of the old one leave it */
+
+    REQUIRE(sn_node_repair(&A, level, column, &c0de) == 0);
+
+    e = sn_net_router_table_get(&A.router, level, column);
+
+    REQUIRE(e->is_set);
+    REQUIRE(sn_net_addr_cmp(&e->addr, &c111) == 0);
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+}
+
+TEST_CASE("Emulated network learning from traffic", "[network][learn]") {
+    sn_node_t A, B;
+    sn_net_addr_t a3f4, b567;
+    sn_io_sock_t sockA, sockB;
+    sn_io_naddr_t addrA, addrB;
+    sn_util_closure_t silent;
+    sn_node_stats_t stats;
+    const sn_net_entry_t* e;
+    unsigned int level;
+    unsigned char column;
+    int i;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&a3f4, "a3f4");
+    sn_net_addr_from_hex(&b567, "b567");
+
+    sn_io_naddr_local(&addrA, "_LA");
+    sn_io_naddr_local(&addrB, "_LB");
+
+    REQUIRE((sockA = sn_io_sock_named(&addrA)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockB = sn_io_sock_named(&addrB)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_at_socket(&A, NULL, (sn_crypto_sign_pubkey_t*)&a3f4, sockA, 0) == 0);
+    REQUIRE(sn_node_at_socket(&B, NULL, (sn_crypto_sign_pubkey_t*)&b567, sockB, 0) == 0);
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+
+    /* Only B knows the other */
+
+    sn_net_router_add(&B.router, &a3f4, &addrA);
+
+    sn_net_addr_index(&a3f4, &b567, &level, &column);
+
+    SECTION("The sender fills the empty slot once it answers") {
+        sn_node_set_learning(&A, 1);
+
+        REQUIRE(sn_node_send(&B, &a3f4, 5, "Hola") == 0);
+
+        for(i = 0; i < 100; ++i) {
+            sn_node_get_stats(&A, &stats);
+
+            if(stats.learned)
+                break;
+
+            usleep(20000);
+        }
+
+        e = sn_net_router_table_get(&A.router, level, column);
+
+        REQUIRE(stats.learned == 1);
+        REQUIRE(e->is_set);
+        REQUIRE(sn_net_addr_cmp(&e->addr, &b567) == 0);
+        REQUIRE(sn_io_naddr_cmp(&e->net_addr, &addrB) == 0);
+    }
+
+    SECTION("Nothing is learnt from a relay answering for the sender") {
+        sn_io_naddr_t addrRELAY;
+        sn_io_sock_t sockRELAY;
+        sn_net_packet_t* packet;
+        sn_wire_ping_msg_t ping;
+        sn_net_addr_t c000;
+
+        sn_net_addr_from_hex(&c000, "c000");
+        sn_io_naddr_local(&addrRELAY, "_LC");
+        REQUIRE((sockRELAY = sn_io_sock_named(&addrRELAY)) != SN_IO_SOCK_INVALID);
+
+        sn_node_set_learning(&A, 1);
+
+        /* A packet of B replayed in one hop from the relay, which gets the ping and answers it */
+
+        packet = sn_net_packet_pack(&a3f4, &b567, SN_WIRE_NET_TYPE_USER, 5, "Hola");
+        REQUIRE(sn_net_packet_send(packet, sockRELAY, &addrA) == 0);
+        free(packet);
+
+        REQUIRE((packet = sn_net_packet_recv(sockRELAY, NULL)) != NULL);
+        REQUIRE(packet->header.type == SN_WIRE_NET_TYPE_PING);
+        REQUIRE(packet->header.len == sizeof(sn_wire_ping_msg_t));
+
+        memcpy(&ping, packet->payload, sizeof(ping));
+        free(packet);
+
+        packet = sn_net_packet_pack(&a3f4, &c000, SN_WIRE_NET_TYPE_REPLY, sizeof(ping), (const char*)&ping);
+        REQUIRE(sn_net_packet_send(packet, sockRELAY, &addrA) == 0);
+        free(packet);
+
+        usleep(200000);
+
+        sn_node_get_stats(&A, &stats);
+
+        REQUIRE(stats.learned == 0);
+        REQUIRE(sn_net_router_table_get(&A.router, level, column)->is_set == 0);
+
+        sn_io_sock_close(sockRELAY);
+    }
+
+    SECTION("Nothing is learnt with learning disabled") {
+        REQUIRE(sn_node_send(&B, &a3f4, 5, "Hola") == 0);
+
+        usleep(200000);
+
+        sn_node_get_stats(&A, &stats);
+
+        REQUIRE(stats.learned == 0);
+        REQUIRE(sn_net_router_table_get(&A.router, level, column)->is_set == 0);
+    }
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+}
+
+TEST_CASE("Emulated network taking shortcuts", "[network][shortcut]") {
+    sn_node_t A, B, C;
+    sn_net_addr_t a3f4, b567, c0de;
+    sn_io_sock_t sockA, sockB, sockC;
+    sn_io_naddr_t addrA, addrB, addrC;
+    sn_util_closure_t silent;
+    sn_node_stats_t stats;
+    int i;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&a3f4, "a3f4");
+    sn_net_addr_from_hex(&b567, "b567");
+    sn_net_addr_from_hex(&c0de, "c0de");
+
+    sn_io_naddr_local(&addrA, "_SA");
+    sn_io_naddr_local(&addrB, "_SB");
+    sn_io_naddr_local(&addrC, "_SC");
+
+    REQUIRE((sockA = sn_io_sock_named(&addrA)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockB = sn_io_sock_named(&addrB)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockC = sn_io_sock_named(&addrC)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_at_socket(&A, NULL, (sn_crypto_sign_pubkey_t*)&a3f4, sockA, 0) == 0);
+    REQUIRE(sn_node_at_socket(&B, NULL, (sn_crypto_sign_pubkey_t*)&b567, sockB, 0) == 0);
+    REQUIRE(sn_node_at_socket(&C, NULL, (sn_crypto_sign_pubkey_t*)&c0de, sockC, 0) == 0);
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+    sn_node_set_log_callback(&C, &silent);
+    sn_node_set_shortcuts(&A, 1);
+    sn_node_set_shortcuts(&C, 1);
+
+    /* A and C only reach each other through B */
+
+    sn_net_router_add(&A.router, &b567, &addrB);
+    sn_net_router_add(&B.router, &a3f4, &addrA);
+    sn_net_router_add(&B.router, &c0de, &addrC);
+    sn_net_router_add(&C.router, &b567, &addrB);
+
+    /* The first message takes two hops and brings back an offer */
+
+    REQUIRE(sn_node_send(&A, &c0de, 5, "Hola") == 0);
+
+    for(i = 0; i < 100; ++i) {
+        REQUIRE(sn_node_send(&A, &c0de, 5, "Hola") == 0);
+
+        sn_node_get_stats(&A, &stats);
+
+        if(stats.shortcut_hits)
+            break;
+
+        usleep(20000);
+    }
+
+    REQUIRE(stats.shortcut_hits == 1);
+    REQUIRE(stats.shortcut_hops_saved == 1);
+    REQUIRE(stats.shortcut_lookups > stats.shortcut_hits);
+
+    /* C heard straight from A, its answers go straight back */
+
+    for(i = 0; i < 100; ++i) {
+        REQUIRE(sn_node_send(&C, &a3f4, 5, "Hola") == 0);
+
+        sn_node_get_stats(&C, &stats);
+
+        if(stats.shortcut_hits)
+            break;
+
+        usleep(20000);
+    }
+
+    REQUIRE(stats.shortcut_hits == 1);
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+    sn_node_destroy(&C);
+}
+
+TEST_CASE("Emulated network hedging messages", "[network][hedge]") {
+    sn_node_t A, B, D;
+    sn_net_addr_t a3f4, c800, d000, d0ff;
+    sn_io_sock_t sockA, sockB, sockD;
+    sn_io_naddr_t addrA, addrB, addrD, addrSlow;
+    sn_util_closure_t silent;
+    sn_node_stats_t stats;
+    int i;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&a3f4, "a3f4");
+    sn_net_addr_from_hex(&c800, "c800");
+    sn_net_addr_from_hex(&d000, "d000");
+    sn_net_addr_from_hex(&d0ff, "d0ff");
+
+    sn_io_naddr_local(&addrA, "_HA");
+    sn_io_naddr_local(&addrB, "_HB");
+    sn_io_naddr_local(&addrD, "_HD");
+    sn_io_naddr_local(&addrSlow, "_HSLOW");
+
+    REQUIRE((sockA = sn_io_sock_named(&addrA)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockB = sn_io_sock_named(&addrB)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockD = sn_io_sock_named(&addrD)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_at_socket(&A, NULL, (sn_crypto_sign_pubkey_t*)&a3f4, sockA, 0) == 0);
+    REQUIRE(sn_node_at_socket(&B, NULL, (sn_crypto_sign_pubkey_t*)&c800, sockB, 0) == 0);
+    REQUIRE(sn_node_at_socket(&D, NULL, (sn_crypto_sign_pubkey_t*)&d000, sockD, 0) == 0);
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+    sn_node_set_log_callback(&D, &silent);
+    sn_node_set_failure_detection(&A, 0);
+
+    /* The best relay of A never answers, B is the alternative */
+
+    sn_net_router_add(&A.router, &d0ff, &addrSlow);
+    sn_net_router_add(&A.router, &c800, &addrB);
+    sn_net_router_add(&B.router, &d000, &addrD);
+    sn_net_router_add(&D.router, &a3f4, &addrA);
+
+    SECTION("The second copy gets the reply") {
+        struct reply_wait w;
+        sn_util_closure_t closure;
+        sn_wire_ping_msg_t ping;
+        sn_io_sock_t sockSlow;
+
+        /* Read by nobody */
+
+        REQUIRE((sockSlow = sn_io_sock_named(&addrSlow)) != SN_IO_SOCK_INVALID);
+
+        pthread_mutex_init(&w.mut, NULL);
+        pthread_cond_init(&w.cond, NULL);
+        w.replies = w.timeouts = 0;
+
+        sn_util_closure_init_curried_once(&closure, on_reply, &w);
+
+        memset(&ping, 0, sizeof(ping));
+        ping.reply_to = sn_node_new_reply_id(&A);
+
+        REQUIRE(sn_node_register_reply(&A, ping.reply_to, &closure, 1, 0) == 0);
+        REQUIRE(sn_node_send_hedged(&A, &d000, SN_WIRE_NET_TYPE_PING, sizeof(ping), (const char*)&ping, ping.reply_to) == 0);
+
+        REQUIRE(wait_for(&w, &w.replies, 1));
+
+        sn_node_get_stats(&A, &stats);
+
+        REQUIRE(stats.hedges_sent == 1);
+        REQUIRE(stats.hedges_avoided == 0);
+
+        sn_io_sock_close(sockSlow);
+        pthread_cond_destroy(&w.cond);
+        pthread_mutex_destroy(&w.mut);
+    }
+
+    SECTION("Only the first copy is delivered") {
+        /* Both relays reach D now */
+
+        sn_node_t C;
+        sn_io_sock_t sockC;
+
+        REQUIRE((sockC = sn_io_sock_named(&addrSlow)) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&C, NULL, (sn_crypto_sign_pubkey_t*)&d0ff, sockC, 0) == 0);
+        sn_node_set_log_callback(&C, &silent);
+        sn_net_router_add(&C.router, &d000, &addrD);
+
+        REQUIRE(sn_node_send_hedged(&A, &d000, SN_WIRE_NET_TYPE_USER, 5, "Hola", 0) == 0);
+
+        for(i = 0; i < 100; ++i) {
+            sn_node_get_stats(&D, &stats);
+
+            if(stats.duplicates)
+                break;
+
+            usleep(20000);
+        }
+
+        REQUIRE(stats.duplicates == 1);
+
+        sn_node_destroy(&C);
+    }
+
+    REQUIRE(sn_node_send_hedged(&A, &d000, SN_WIRE_NET_TYPE_JOIN, 0, NULL, 0) == -1);
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+    sn_node_destroy(&D);
+}
+
+/* Answers the lookup query read from sock with n made up contacts from first on, which nobody answers */
+static int lookup_answer(sn_io_sock_t sock, const sn_io_naddr_t* asker_addr, unsigned int first, unsigned int n) {
+    unsigned char buf[sizeof(sn_wire_reply_header_t) + sizeof(sn_wire_lookup_reply_header_t) + sizeof(sn_net_router_query_ser_t) +
+                      SN_NET_ROUTER_LEAFSET_SIZE*2*sizeof(sn_net_router_entry_ser_t)];
+    sn_wire_reply_header_t* reply = (sn_wire_reply_header_t*)buf;
+    sn_wire_lookup_reply_header_t* header = (sn_wire_lookup_reply_header_t*)(reply + 1);
+    sn_net_router_query_ser_t* query = (sn_net_router_query_ser_t*)(header + 1);
+    sn_net_packet_t* packet;
+    sn_net_addr_t src, dst;
+    sn_net_entry_t e;
+    char hex[8];
+    unsigned int i;
+    int ret;
+
+    /* Maintenance traffic of the asker is skipped */
+
+    while((packet = sn_net_packet_recv(sock, NULL)) != NULL && packet->header.type != SN_WIRE_NET_TYPE_LOOKUP)
+        free(packet);
+
+    if(packet == NULL)
+        return -1;
+
+    memset(buf, 0, sizeof(buf));
+    reply->reply_id = ((const sn_wire_lookup_msg_t*)packet->payload)->reply_to;
+    sn_net_packet_get_src(packet, &dst);
+    sn_net_packet_get_dst(packet, &src);
+    free(packet);
+
+    e.is_set = 1;
+    sn_io_naddr_local(&e.net_addr, "_INOBODY");
+
+    for(i = 0; i < n; ++i) {
+        snprintf(hex, sizeof(hex), "%04x", first + i);
+        sn_net_addr_from_hex(&e.addr, hex);
+        sn_net_entry_ser(&e, &query->entries[i].entry);
+        query->entries[i].is_table = 1;
+    }
+
+    query->entries_len = n;
+
+    packet = sn_net_packet_pack(&dst, &src, SN_WIRE_NET_TYPE_REPLY, sizeof(*reply) + sizeof(*header) + sizeof(*query) + n*sizeof(sn_net_router_entry_ser_t), (const char*)buf);
+    ret = sn_net_packet_send(packet, sock, asker_addr);
+    free(packet);
+
+    return ret;
+}
+
+TEST_CASE("Emulated network looking up iteratively", "[network][lookup]") {
+    sn_node_t A, B, C, D;
+    sn_net_addr_t n1000, n8000, nc000, ncfff, nd000;
+    sn_io_sock_t sockA, sockB, sockC, sockD, sockSlow;
+    sn_io_naddr_t addrA, addrB, addrC, addrD, addrSlow;
+    sn_util_closure_t silent, closure;
+    struct lookup_wait w;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&n1000, "1000");
+    sn_net_addr_from_hex(&n8000, "8000");
+    sn_net_addr_from_hex(&nc000, "c000");
+    sn_net_addr_from_hex(&ncfff, "cfff");
+    sn_net_addr_from_hex(&nd000, "d000");
+
+    sn_io_naddr_local(&addrA, "_IA");
+    sn_io_naddr_local(&addrB, "_IB");
+    sn_io_naddr_local(&addrC, "_IC");
+    sn_io_naddr_local(&addrD, "_ID");
+    sn_io_naddr_local(&addrSlow, "_ISLOW");
+
+    REQUIRE((sockA = sn_io_sock_named(&addrA)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockB = sn_io_sock_named(&addrB)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockC = sn_io_sock_named(&addrC)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockD = sn_io_sock_named(&addrD)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockSlow = sn_io_sock_named(&addrSlow)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_at_socket(&A, NULL, (sn_crypto_sign_pubkey_t*)&n1000, sockA, 0) == 0);
+    REQUIRE(sn_node_at_socket(&B, NULL, (sn_crypto_sign_pubkey_t*)&n8000, sockB, 0) == 0);
+    REQUIRE(sn_node_at_socket(&C, NULL, (sn_crypto_sign_pubkey_t*)&nc000, sockC, 0) == 0);
+    REQUIRE(sn_node_at_socket(&D, NULL, (sn_crypto_sign_pubkey_t*)&nd000, sockD, 0) == 0);
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+    sn_node_set_log_callback(&C, &silent);
+    sn_node_set_log_callback(&D, &silent);
+    sn_node_set_failure_detection(&A, 0);
+
+    /* The closest contact of A never answers(its socket is read by nobody), B leads to D through C */
+
+    sn_net_router_add(&A.router, &ncfff, &addrSlow);
+    sn_net_router_add(&A.router, &n8000, &addrB);
+    sn_net_router_add(&B.router, &nc000, &addrC);
+    sn_net_router_add(&C.router, &nd000, &addrD);
+
+    pthread_mutex_init(&w.wait.mut, NULL);
+    pthread_cond_init(&w.wait.cond, NULL);
+    w.wait.replies = w.wait.timeouts = 0;
+    w.queries = 0;
+
+    sn_util_closure_init_curried_once(&closure, on_lookup_done, &w);
+
+    SECTION("Routing around the slow contact") {
+        REQUIRE(sn_node_lookup(&A, &nd000, 2, 5000, &closure) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 1));
+
+        REQUIRE(sn_net_addr_cmp(&w.owner, &nd000) == 0);
+        REQUIRE(w.queries >= 3);
+    }
+
+    SECTION("Owned addresses") {
+        REQUIRE(sn_node_lookup(&D, &nd000, 3, 5000, &closure) == 0);
+        REQUIRE(w.wait.replies == 1);
+
+        REQUIRE(sn_net_addr_cmp(&w.owner, &nd000) == 0);
+        REQUIRE(w.queries == 0);
+    }
+
+    SECTION("Nobody answering") {
+        sn_node_t E;
+        sn_io_naddr_t addrE;
+        sn_io_sock_t sockE;
+
+        sn_io_naddr_local(&addrE, "_IE");
+
+        REQUIRE((sockE = sn_io_sock_named(&addrE)) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&E, NULL, (sn_crypto_sign_pubkey_t*)&n1000, sockE, 0) == 0);
+        sn_node_set_log_callback(&E, &silent);
+        sn_net_router_add(&E.router, &ncfff, &addrSlow);
+
+        REQUIRE(sn_node_lookup(&E, &nd000, 3, 5000, &closure) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.timeouts, 1));
+        REQUIRE(w.queries == 1);
+
+        sn_node_destroy(&E);
+    }
+
+    SECTION("Contacts being asked stay on a full shortlist") {
+        const char* hexes[] = { "c000", "c100", "c200" };
+        const char* names[] = { "_IX", "_IY", "_IZ" };
+        sn_io_sock_t socks[3];
+        sn_io_naddr_t naddrs[3];
+        sn_net_addr_t addrs[3];
+        sn_node_t E;
+        sn_io_naddr_t addrE;
+        sn_io_sock_t sockE;
+        uint64_t start;
+        int i;
+
+        sn_io_naddr_local(&addrE, "_IE");
+
+        REQUIRE((sockE = sn_io_sock_named(&addrE)) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&E, NULL, (sn_crypto_sign_pubkey_t*)&n1000, sockE, 0) == 0);
+        sn_node_set_log_callback(&E, &silent);
+        sn_node_set_failure_detection(&E, 0);
+
+        for(i = 0; i < 3; ++i) {
+            sn_net_addr_from_hex(&addrs[i], hexes[i]);
+            sn_io_naddr_local(&naddrs[i], names[i]);
+            REQUIRE((socks[i] = sn_io_sock_named(&naddrs[i])) != SN_IO_SOCK_INVALID);
+            sn_net_router_add(&E.router, &addrs[i], &naddrs[i]);
+        }
+
+        start = sn_util_time_ms();
+
+        REQUIRE(sn_node_lookup(&E, &nd000, 3, 4000, &closure) == 0);
+
+        /* The first two answers fill the shortlist with closer contacts, the third one is still asked */
+
+        REQUIRE(lookup_answer(socks[0], &addrE, 0xd001, 9) == 0);
+        REQUIRE(lookup_answer(socks[1], &addrE, 0xd011, 9) == 0);
+        REQUIRE(lookup_answer(socks[2], &addrE, 0, 0) == 0);
+
+        /* Nobody else answers, the lookup gives up once every contact was asked */
+
+        REQUIRE(wait_for(&w.wait, &w.wait.timeouts, 1));
+        REQUIRE(sn_util_time_ms() - start < 3000);
+        REQUIRE(w.queries > 3);
+
+        sn_node_destroy(&E);
+
+        for(i = 0; i < 3; ++i)
+            sn_io_sock_close(socks[i]);
+    }
+
+    REQUIRE(sn_node_lookup(&A, &nd000, 0, 5000, &closure) == -1);
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+    sn_node_destroy(&C);
+    sn_node_destroy(&D);
+    sn_io_sock_close(sockSlow);
+    pthread_cond_destroy(&w.wait.cond);
+    pthread_mutex_destroy(&w.wait.mut);
+}
+
+TEST_CASE("Emulated network routing by XOR distance", "[network][geometry]") {
+    sn_node_t A, B, C;
+    sn_net_addr_t n1000, n8000, nc001, n6000;
+    sn_io_sock_t sockA, sockB, sockC;
+    sn_io_naddr_t addrA, addrB, addrC;
+    sn_util_closure_t silent;
+    sn_net_entry_t nexthop;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&n1000, "1000");
+    sn_net_addr_from_hex(&n8000, "8000");
+    sn_net_addr_from_hex(&nc001, "c001");
+    sn_net_addr_from_hex(&n6000, "6000");
+
+    sn_io_naddr_local(&addrA, "_GA");
+    sn_io_naddr_local(&addrB, "_GB");
+    sn_io_naddr_local(&addrC, "_GC");
+
+    REQUIRE((sockA = sn_io_sock_named(&addrA)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockB = sn_io_sock_named(&addrB)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockC = sn_io_sock_named(&addrC)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_at_socket(&A, NULL, (sn_crypto_sign_pubkey_t*)&n1000, sockA, 0) == 0);
+    REQUIRE(sn_node_at_socket(&B, NULL, (sn_crypto_sign_pubkey_t*)&n8000, sockB, 0) == 0);
+    REQUIRE(sn_node_at_socket(&C, NULL, (sn_crypto_sign_pubkey_t*)&nc001, sockC, 0) == 0);
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+    sn_node_set_log_callback(&C, &silent);
+
+    /* A only reaches C through B, known before picking the geometry */
+
+    sn_node_add_route(&A, &n8000, &addrB);
+    sn_node_add_route(&B, &nc001, &addrC);
+    sn_node_add_route(&C, &n1000, &addrA);
+
+    SECTION("Owners change with the metric") {
+        /* 6000 is numerically closer to 8000, but shares its first bit with 1000 */
+
+        sn_node_nexthop(&A, &n6000, &nexthop);
+        REQUIRE(nexthop.is_set);
+        REQUIRE(sn_net_addr_cmp(&nexthop.addr, &n8000) == 0);
+
+        sn_node_add_route(&A, &n1000, &addrA);
+
+        REQUIRE(sn_node_set_geometry(&A, &sn_net_geometry_kademlia) == 0);
+
+        sn_node_nexthop(&A, &n6000, &nexthop);
+        REQUIRE(nexthop.is_set == 0);
+
+        /* Routes to ourselves are ignored by every geometry */
+
+        sn_node_add_route(&A, &n1000, &addrA);
+        sn_node_nexthop(&A, &n6000, &nexthop);
+        REQUIRE(nexthop.is_set == 0);
+
+        REQUIRE(sn_node_set_geometry(&A, &sn_net_geometry_pastry) == 0);
+
+        sn_node_nexthop(&A, &n6000, &nexthop);
+        REQUIRE(nexthop.is_set);
+    }
+
+    SECTION("Messages take the XOR route") {
+        struct reply_wait w;
+        sn_util_closure_t closure;
+        sn_wire_ping_msg_t ping;
+
+        REQUIRE(sn_node_set_geometry(&A, &sn_net_geometry_kademlia) == 0);
+        REQUIRE(sn_node_set_geometry(&B, &sn_net_geometry_kademlia) == 0);
+        REQUIRE(sn_node_set_geometry(&C, &sn_net_geometry_kademlia) == 0);
+
+        pthread_mutex_init(&w.mut, NULL);
+        pthread_cond_init(&w.cond, NULL);
+        w.replies = w.timeouts = 0;
+
+        sn_util_closure_init_curried_once(&closure, on_reply, &w);
+
+        memset(&ping, 0, sizeof(ping));
+        ping.reply_to = sn_node_new_reply_id(&A);
+
+        REQUIRE(sn_node_register_reply(&A, ping.reply_to, &closure, 1, 0) == 0);
+        REQUIRE(sn_node_send_typed(&A, &nc001, SN_WIRE_NET_TYPE_PING, sizeof(ping), (const char*)&ping) == 0);
+
+        REQUIRE(wait_for(&w, &w.replies, 1));
+
+        pthread_cond_destroy(&w.cond);
+        pthread_mutex_destroy(&w.mut);
+    }
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+    sn_node_destroy(&C);
+}
+
+static int members_has(sn_node_t* sns, const sn_net_addr_t* addr) {
+    return sn_net_members_find((const sn_net_members_t*)sns->geometry_state, addr, NULL) == 0;
+}
+
+TEST_CASE("Emulated network gossiping membership", "[network][gossip]") {
+    sn_node_t A, B, C;
+    sn_net_addr_t n1000, n8000, nc000, nd000;
+    sn_io_sock_t sockA, sockB, sockC;
+    sn_io_naddr_t addrA, addrB, addrC, addrD;
+    sn_util_closure_t silent;
+    sn_net_entry_t nexthop, d;
+    struct {
+        sn_wire_members_header_t header;
+        sn_wire_members_record_t record;
+    } msg;
+    int i;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&n1000, "1000");
+    sn_net_addr_from_hex(&n8000, "8000");
+    sn_net_addr_from_hex(&nc000, "c000");
+    sn_net_addr_from_hex(&nd000, "d000");
+
+    sn_io_naddr_local(&addrA, "_MA");
+    sn_io_naddr_local(&addrB, "_MB");
+    sn_io_naddr_local(&addrC, "_MC");
+    sn_io_naddr_local(&addrD, "_MD");
+
+    REQUIRE((sockA = sn_io_sock_named(&addrA)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockB = sn_io_sock_named(&addrB)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockC = sn_io_sock_named(&addrC)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_at_socket(&A, NULL, (sn_crypto_sign_pubkey_t*)&n1000, sockA, 0) == 0);
+    REQUIRE(sn_node_at_socket(&B, NULL, (sn_crypto_sign_pubkey_t*)&n8000, sockB, 0) == 0);
+    REQUIRE(sn_node_at_socket(&C, NULL, (sn_crypto_sign_pubkey_t*)&nc000, sockC, 0) == 0);
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+    sn_node_set_log_callback(&C, &silent);
+
+    REQUIRE(sn_node_set_geometry(&A, &sn_net_geometry_onehop) == 0);
+    REQUIRE(sn_node_set_geometry(&B, &sn_net_geometry_onehop) == 0);
+    REQUIRE(sn_node_set_geometry(&C, &sn_net_geometry_onehop) == 0);
+
+    /* A and C only know B, which tells them about each other */
+
+    sn_node_add_route(&A, &n8000, &addrB);
+    sn_node_add_route(&C, &n8000, &addrB);
+    sn_node_add_route(&B, &n1000, &addrA);
+    sn_node_add_route(&B, &nc000, &addrC);
+
+    for(i = 0; i < 100 && !(members_has(&A, &nc000) && members_has(&C, &n1000)); ++i)
+        usleep(50000);
+
+    REQUIRE(members_has(&A, &nc000));
+    REQUIRE(members_has(&C, &n1000));
+
+    /* One hop to every owner */
+
+    sn_node_nexthop(&A, &nd000, &nexthop);
+    REQUIRE(nexthop.is_set);
+    REQUIRE(sn_net_addr_cmp(&nexthop.addr, &nc000) == 0);
+
+    /* A member joining and leaving, heard by A alone */
+
+    d.is_set = 1;
+    d.addr = nd000;
+    d.net_addr = addrD;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.header.records_len = 1;
+    REQUIRE(sn_net_entry_ser(&d, &msg.record.entry) == 0);
+    REQUIRE(sn_node_send_direct(&B, &n1000, &addrA, SN_WIRE_NET_TYPE_MEMBERS, sizeof(msg), (const char*)&msg) == 0);
+
+    for(i = 0; i < 100 && !(members_has(&B, &nd000) && members_has(&C, &nd000)); ++i)
+        usleep(50000);
+
+    REQUIRE(members_has(&A, &nd000));
+    REQUIRE(members_has(&B, &nd000));
+    REQUIRE(members_has(&C, &nd000));
+
+    d.is_set = 0;
+    REQUIRE(sn_net_entry_ser(&d, &msg.record.entry) == 0);
+    REQUIRE(sn_node_send_direct(&B, &n1000, &addrA, SN_WIRE_NET_TYPE_MEMBERS, sizeof(msg), (const char*)&msg) == 0);
+
+    for(i = 0; i < 100 && (members_has(&A, &nd000) || members_has(&B, &nd000) || members_has(&C, &nd000)); ++i)
+        usleep(50000);
+
+    REQUIRE(!members_has(&A, &nd000));
+    REQUIRE(!members_has(&B, &nd000));
+    REQUIRE(!members_has(&C, &nd000));
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+    sn_node_destroy(&C);
+}
+
+static size_t topics_size(sn_node_t* sns) {
+    size_t size;
+
+    pthread_mutex_lock(&sns->task_mut);
+    size = sn_data_hmap_size(&sns->topics);
+    pthread_mutex_unlock(&sns->task_mut);
+
+    return size;
+}
+
+TEST_CASE("Emulated network multicasting to a topic tree", "[network][topic]") {
+    sn_node_t A, B, C, D;
+    sn_net_addr_t n3000, n6000, n9000, nc001, topic;
+    sn_io_sock_t sockA, sockB, sockC, sockD;
+    sn_io_naddr_t addrA, addrB, addrC, addrD;
+    sn_util_closure_t silent, closureA, closureB;
+    sn_node_stats_t stats;
+    struct reply_wait wA, wB;
+    int i;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&n3000, "3000");
+    sn_net_addr_from_hex(&n6000, "6000");
+    sn_net_addr_from_hex(&n9000, "9000");
+    sn_net_addr_from_hex(&nc001, "c001");
+    sn_net_addr_from_hex(&topic, "c000");
+
+    sn_io_naddr_local(&addrA, "_TA");
+    sn_io_naddr_local(&addrB, "_TB");
+    sn_io_naddr_local(&addrC, "_TC");
+    sn_io_naddr_local(&addrD, "_TD");
+
+    REQUIRE((sockA = sn_io_sock_named(&addrA)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockB = sn_io_sock_named(&addrB)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockC = sn_io_sock_named(&addrC)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockD = sn_io_sock_named(&addrD)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_at_socket(&A, NULL, (sn_crypto_sign_pubkey_t*)&n3000, sockA, 0) == 0);
+    REQUIRE(sn_node_at_socket(&B, NULL, (sn_crypto_sign_pubkey_t*)&n6000, sockB, 0) == 0);
+    REQUIRE(sn_node_at_socket(&C, NULL, (sn_crypto_sign_pubkey_t*)&n9000, sockC, 0) == 0);
+    REQUIRE(sn_node_at_socket(&D, NULL, (sn_crypto_sign_pubkey_t*)&nc001, sockD, 0) == 0);
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+    sn_node_set_log_callback(&C, &silent);
+    sn_node_set_log_callback(&D, &silent);
+
+    /* A chain to the root, D owns c000 */
+
+    sn_node_add_route(&A, &n6000, &addrB);
+    sn_node_add_route(&B, &n9000, &addrC);
+    sn_node_add_route(&C, &nc001, &addrD);
+    sn_node_add_route(&D, &n9000, &addrC);
+
+    pthread_mutex_init(&wA.mut, NULL);
+    pthread_cond_init(&wA.cond, NULL);
+    pthread_mutex_init(&wB.mut, NULL);
+    pthread_cond_init(&wB.cond, NULL);
+    wA.replies = wA.timeouts = wB.replies = wB.timeouts = 0;
+
+    sn_util_closure_init_curried_once(&closureA, on_reply, &wA);
+    sn_util_closure_init_curried_once(&closureB, on_reply, &wB);
+
+    /* B subscribes for itself and A, C just relays */
+
+    REQUIRE(sn_node_subscribe(&A, &topic, &closureA) == 0);
+    REQUIRE(sn_node_subscribe(&B, &topic, &closureB) == 0);
+
+    for(i = 0; i < 100 && topics_size(&D) == 0; ++i)
+        usleep(20000);
+
+    REQUIRE(topics_size(&C) == 1);
+    REQUIRE(topics_size(&D) == 1);
+
+    SECTION("Every subscriber gets one copy, every edge carries one") {
+        /* Up the chain only, every node on it is on the tree already */
+
+        REQUIRE(sn_node_publish(&A, &topic, 5, "Hola") == 0);
+
+        REQUIRE(wait_for(&wA, &wA.replies, 1));
+        REQUIRE(wait_for(&wB, &wB.replies, 1));
+
+        sn_node_get_stats(&D, &stats);
+        REQUIRE(stats.tree_copies == 0);
+        sn_node_get_stats(&C, &stats);
+        REQUIRE(stats.tree_copies == 0);
+        sn_node_get_stats(&B, &stats);
+        REQUIRE(stats.tree_copies == 0);
+
+        /* From the root itself, down the chain */
+
+        REQUIRE(sn_node_publish(&D, &topic, 5, "Hola") == 0);
+
+        REQUIRE(wait_for(&wA, &wA.replies, 2));
+        REQUIRE(wait_for(&wB, &wB.replies, 2));
+
+        usleep(50000);
+
+        REQUIRE(wA.replies == 2);
+        REQUIRE(wB.replies == 2);
+
+        sn_node_get_stats(&D, &stats);
+        REQUIRE(stats.tree_copies == 1);
+        sn_node_get_stats(&C, &stats);
+        REQUIRE(stats.tree_copies == 1);
+        sn_node_get_stats(&B, &stats);
+        REQUIRE(stats.tree_copies == 1);
+    }
+
+    SECTION("Copies from anyone but the parent are dropped") {
+        unsigned char buf[sizeof(sn_wire_publish_header_t) + 5];
+        sn_wire_publish_header_t* header = (sn_wire_publish_header_t*)buf;
+        sn_net_packet_t* packet;
+        sn_io_naddr_t addrX;
+        sn_io_sock_t sockX;
+
+        /* D skipping C, B only takes copies from C */
+
+        memset(buf, 0, sizeof(buf));
+        header->flags = SN_WIRE_PUBLISH_DOWN;
+        sn_net_addr_ser(&nc001, &header->publisher);
+        sn_net_addr_ser(&topic, &header->topic);
+        memcpy(header + 1, "Hola", 5);
+
+        REQUIRE(sn_node_send_direct(&D, &topic, &addrB, SN_WIRE_NET_TYPE_PUBLISH, sizeof(buf), (const char*)buf) == 0);
+
+        /* Nor from another socket claiming to be C */
+
+        header->seq = 1;
+
+        sn_io_naddr_local(&addrX, "_TX");
+        REQUIRE((sockX = sn_io_sock_named(&addrX)) != SN_IO_SOCK_INVALID);
+
+        packet = sn_net_packet_pack(&topic, &n9000, SN_WIRE_NET_TYPE_PUBLISH, sizeof(buf), (const char*)buf);
+        REQUIRE(sn_net_packet_send(packet, sockX, &addrB) == 0);
+        free(packet);
+
+        usleep(100000);
+
+        sn_io_sock_close(sockX);
+
+        REQUIRE(wB.replies == 0);
+        REQUIRE(wA.replies == 0);
+    }
+
+    SECTION("Leaving prunes the tree") {
+        REQUIRE(sn_node_unsubscribe(&A, &topic) == 0);
+        REQUIRE(sn_node_unsubscribe(&A, &topic) == -1);
+
+        for(i = 0; i < 100 && topics_size(&A) != 0; ++i)
+            usleep(20000);
+
+        usleep(50000);
+
+        REQUIRE(sn_node_publish(&D, &topic, 5, "Hola") == 0);
+        REQUIRE(wait_for(&wB, &wB.replies, 1));
+
+        sn_node_get_stats(&B, &stats);
+        REQUIRE(stats.tree_copies == 0);
+
+        REQUIRE(sn_node_unsubscribe(&B, &topic) == 0);
+
+        for(i = 0; i < 100 && (topics_size(&C) != 0 || topics_size(&D) != 0); ++i)
+            usleep(20000);
+
+        REQUIRE(topics_size(&C) == 0);
+        REQUIRE(topics_size(&D) == 0);
+        REQUIRE(wA.replies == 0);
+    }
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+    sn_node_destroy(&C);
+    sn_node_destroy(&D);
+
+    pthread_cond_destroy(&wA.cond);
+    pthread_mutex_destroy(&wA.mut);
+    pthread_cond_destroy(&wB.cond);
+    pthread_mutex_destroy(&wB.mut);
+}
+
+TEST_CASE("Emulated network broadcasting over the routing tables", "[network][broadcast]") {
+    const char* hexes[] = { "1000", "2000", "2800", "2c00", "8000", "8100" };
+    const char* names[] = { "_BA", "_BB", "_BC", "_BD", "_BE", "_BF" };
+    const size_t n = 6;
+    sn_node_t nodes[6];
+    sn_net_addr_t addrs[6], lo, hi;
+    sn_io_naddr_t naddrs[6];
+    sn_util_closure_t silent, closures[6];
+    struct reply_wait waits[6];
+    sn_node_stats_t stats;
+    uint64_t copies;
+    size_t i, j;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    for(i = 0; i < n; ++i) {
+        sn_io_sock_t sock;
+
+        sn_net_addr_from_hex(&addrs[i], hexes[i]);
+        sn_io_naddr_local(&naddrs[i], names[i]);
+
+        REQUIRE((sock = sn_io_sock_named(&naddrs[i])) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&nodes[i], NULL, (sn_crypto_sign_pubkey_t*)&addrs[i], sock, 0) == 0);
+        sn_node_set_log_callback(&nodes[i], &silent);
+
+        pthread_mutex_init(&waits[i].mut, NULL);
+        pthread_cond_init(&waits[i].cond, NULL);
+        waits[i].replies = waits[i].timeouts = 0;
+
+        sn_util_closure_init_curried_once(&closures[i], on_reply, &waits[i]);
+        sn_node_set_broadcast_callback(&nodes[i], &closures[i]);
+    }
+
+    /* Everyone knows everyone, but tables keep one node per subtree */
+
+    for(i = 0; i < n; ++i)
+        for(j = 0; j < n; ++j)
+            if(i != j)
+                sn_node_add_route(&nodes[i], &addrs[j], &naddrs[j]);
+
+    SECTION("Every node gets a single copy") {
+        REQUIRE(sn_node_broadcast(&nodes[0], 5, "Hola") == 0);
+
+        for(i = 0; i < n; ++i)
+            REQUIRE(wait_for(&waits[i], &waits[i].replies, 1));
+
+        usleep(50000);
+
+        for(i = 0, copies = 0; i < n; ++i) {
+            REQUIRE(waits[i].replies == 1);
+
+            sn_node_get_stats(&nodes[i], &stats);
+            copies += stats.broadcast_copies;
+        }
+
+        REQUIRE(copies == n - 1);
+    }
+
+    SECTION("Ranges only reach the nodes on them") {
+        sn_net_addr_from_hex(&lo, "2000");
+        sn_net_addr_from_hex(&hi, "2fff");
+
+        REQUIRE(sn_node_multicast_range(&nodes[5], &hi, &lo, 5, "Hola") == -1);
+        REQUIRE(sn_node_multicast_range(&nodes[5], &lo, &hi, 5, "Hola") == 0);
+
+        for(i = 1; i < 4; ++i)
+            REQUIRE(wait_for(&waits[i], &waits[i].replies, 1));
+
+        usleep(50000);
+
+        for(i = 0, copies = 0; i < n; ++i) {
+            REQUIRE(waits[i].replies == (i >= 1 && i < 4 ? 1 : 0));
+
+            sn_node_get_stats(&nodes[i], &stats);
+            copies += stats.broadcast_copies;
+        }
+
+        REQUIRE(copies == 3);
+    }
+
+    for(i = 0; i < n; ++i) {
+        sn_node_destroy(&nodes[i]);
+
+        pthread_cond_destroy(&waits[i].cond);
+        pthread_mutex_destroy(&waits[i].mut);
+    }
+}
+
+TEST_CASE("Emulated network aggregating over the routing tables", "[network][aggregate]") {
+    const char* hexes[] = { "1000", "2000", "2800", "2c00", "8000", "8100" };
+    const char* names[] = { "_QA", "_QB", "_QC", "_QD", "_QE", "_QF" };
+    const size_t n = 6;
+    sn_node_t nodes[6];
+    sn_net_addr_t addrs[6];
+    sn_io_naddr_t naddrs[6];
+    sn_util_closure_t silent, closure;
+    struct aggregate_wait w;
+    sn_node_stats_t stats;
+    size_t i, j, dead = n;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    for(i = 0; i < n; ++i) {
+        sn_io_sock_t sock;
+
+        sn_net_addr_from_hex(&addrs[i], hexes[i]);
+        sn_io_naddr_local(&naddrs[i], names[i]);
+
+        REQUIRE((sock = sn_io_sock_named(&naddrs[i])) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&nodes[i], NULL, (sn_crypto_sign_pubkey_t*)&addrs[i], sock, 0) == 0);
+        sn_node_set_log_callback(&nodes[i], &silent);
+    }
+
+    /* Tables keep the last node added per slot, 2c00 and 8100 answer for their subtrees */
+
+    for(i = 0; i < n; ++i)
+        for(j = 0; j < n; ++j)
+            if(i != j)
+                sn_node_add_route(&nodes[i], &addrs[j], &naddrs[j]);
+
+    pthread_mutex_init(&w.wait.mut, NULL);
+    pthread_cond_init(&w.wait.cond, NULL);
+    w.wait.replies = w.wait.timeouts = 0;
+
+    sn_util_closure_init_curried_once(&closure, on_aggregate_done, &w);
+
+    REQUIRE(sn_node_aggregate(&nodes[0], SN_NODE_METRICS, 1000, &closure) == -1);
+
+    SECTION("Every node is counted once") {
+        REQUIRE(sn_node_aggregate(&nodes[0], SN_NODE_METRIC_NODES, 2000, &closure) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 1));
+
+        REQUIRE(w.result.count == n);
+        REQUIRE(w.result.sum == n);
+        REQUIRE(w.result.min == 1);
+        REQUIRE(w.result.max == 1);
+        REQUIRE(w.result.hist[1] == n);
+
+        /* Only the subtree roots answered the origin */
+
+        sn_node_get_stats(&nodes[0], &stats);
+        REQUIRE(stats.received == 2);
+
+        REQUIRE(sn_node_aggregate(&nodes[3], SN_NODE_METRIC_RECEIVED, 2000, &closure) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 2));
+
+        REQUIRE(w.result.count == n);
+        REQUIRE(w.result.sum > 0);
+        REQUIRE(w.result.min <= w.result.max);
+    }
+
+    SECTION("Silent subtrees are left out once the budget is spent") {
+        sn_io_sock_t silent_sock;
+        uint64_t start;
+
+        sn_node_destroy(&nodes[4]);
+        dead = 4;
+
+        REQUIRE((silent_sock = sn_io_sock_named(&naddrs[4])) != SN_IO_SOCK_INVALID);
+
+        start = sn_util_time_ms();
+
+        REQUIRE(sn_node_aggregate(&nodes[0], SN_NODE_METRIC_NODES, 400, &closure) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 1));
+
+        REQUIRE(sn_util_time_ms() - start >= 400 - 2*SN_NODE_AGGREGATE_HOP_MARGIN);
+        REQUIRE(w.result.count == n - 1);
+
+        sn_io_sock_close(silent_sock);
+
+        /* Unreachable ones are not waited for */
+
+        start = sn_util_time_ms();
+
+        REQUIRE(sn_node_aggregate(&nodes[0], SN_NODE_METRIC_NODES, 2000, &closure) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 2));
+
+        REQUIRE(sn_util_time_ms() - start < 1000);
+        REQUIRE(w.result.count == n - 1);
+    }
+
+    SECTION("Results are taken once from each child asked") {
+        unsigned char buf[sizeof(sn_wire_aggregate_msg_t) + sizeof(sn_wire_aggregate_result_t)];
+        sn_wire_aggregate_msg_t* msg = (sn_wire_aggregate_msg_t*)buf;
+        sn_wire_aggregate_result_t* result = (sn_wire_aggregate_result_t*)(msg + 1);
+        sn_net_packet_t* packet;
+        sn_io_sock_t silent_sock;
+        uint32_t query_id;
+
+        sn_node_destroy(&nodes[4]);
+        dead = 4;
+
+        REQUIRE((silent_sock = sn_io_sock_named(&naddrs[4])) != SN_IO_SOCK_INVALID);
+
+        REQUIRE(sn_node_aggregate(&nodes[0], SN_NODE_METRIC_NODES, 2000, &closure) == 0);
+
+        /* 8100 asks 8000, which answers twice and has 2800 answer too */
+
+        while((packet = sn_net_packet_recv(silent_sock, NULL)) != NULL && packet->header.type != SN_WIRE_NET_TYPE_AGGREGATE)
+            free(packet);
+
+        REQUIRE(packet != NULL);
+        query_id = ((const sn_wire_aggregate_msg_t*)packet->payload)->query_id;
+        free(packet);
+
+        memset(buf, 0, sizeof(buf));
+        msg->flags = SN_WIRE_AGGREGATE_RESULT;
+        msg->query_id = query_id;
+        result->count = 100;
+
+        packet = sn_net_packet_pack(&addrs[5], &addrs[2], SN_WIRE_NET_TYPE_AGGREGATE, sizeof(buf), (const char*)buf);
+        REQUIRE(sn_net_packet_send(packet, silent_sock, &naddrs[5]) == 0);
+        free(packet);
+
+        result->count = 10;
+
+        for(i = 0; i < 2; ++i) {
+            packet = sn_net_packet_pack(&addrs[5], &addrs[4], SN_WIRE_NET_TYPE_AGGREGATE, sizeof(buf), (const char*)buf);
+            REQUIRE(sn_net_packet_send(packet, silent_sock, &naddrs[5]) == 0);
+            free(packet);
+        }
+
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 1));
+        REQUIRE(w.result.count == n - 1 + 10);
+
+        sn_io_sock_close(silent_sock);
+    }
+
+    for(i = 0; i < n; ++i)
+        if(i != dead)
+            sn_node_destroy(&nodes[i]);
+
+    pthread_cond_destroy(&w.wait.cond);
+    pthread_mutex_destroy(&w.wait.mut);
+}
+
+TEST_CASE("Emulated network storing replicated values", "[network][store]") {
+    const char* hexes[] = { "1000", "2000", "3000", "4000", "5000", "6000" };
+    const char* names[] = { "_KA", "_KB", "_KC", "_KD", "_KE", "_KF" };
+    const size_t n = 6;
+    sn_node_t nodes[6];
+    sn_net_addr_t addrs[6], key, missing;
+    sn_io_naddr_t naddrs[6];
+    sn_util_closure_t silent, put_done, get_done;
+    struct store_wait w;
+    sn_node_stats_t stats;
+    uint64_t replicas, version;
+    size_t i, j, dead = n;
+    int tries;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    for(i = 0; i < n; ++i) {
+        sn_io_sock_t sock;
+
+        sn_net_addr_from_hex(&addrs[i], hexes[i]);
+        sn_io_naddr_local(&naddrs[i], names[i]);
+
+        REQUIRE((sock = sn_io_sock_named(&naddrs[i])) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&nodes[i], NULL, (sn_crypto_sign_pubkey_t*)&addrs[i], sock, 0) == 0);
+        sn_node_set_log_callback(&nodes[i], &silent);
+    }
+
+    /* 6000 only knows 2000, its requests go through it */
+
+    for(i = 0; i < n; ++i)
+        for(j = 0; j < n; ++j)
+            if(i != j && (i != 5 || j == 1))
+                sn_node_add_route(&nodes[i], &addrs[j], &naddrs[j]);
+
+    pthread_mutex_init(&w.wait.mut, NULL);
+    pthread_cond_init(&w.wait.cond, NULL);
+    w.wait.replies = w.wait.timeouts = 0;
+
+    sn_util_closure_init_curried_once(&put_done, on_put_done, &w);
+    sn_util_closure_init_curried_once(&get_done, on_get_done, &w);
+
+    /* Owned by 3000, replicated on 1000, 2000, 4000 and 5000 */
+
+    sn_net_addr_from_hex(&key, "3100");
+    sn_net_addr_from_hex(&missing, "3200");
+
+    REQUIRE(sn_node_put(&nodes[3], &key, 5, "Hola", 1000, &put_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 1));
+    REQUIRE(w.found);
+    REQUIRE(w.version > 0);
+    version = w.version;
+
+    for(tries = 0, replicas = 0; tries < 100 && replicas < 4; ++tries) {
+        usleep(10000);
+
+        for(i = 0, replicas = 0; i < n; ++i) {
+            sn_node_get_stats(&nodes[i], &stats);
+
+            if(i != 2)
+                replicas += stats.store_replicas;
+        }
+    }
+
+    REQUIRE(replicas == 4);
+
+    sn_node_get_stats(&nodes[2], &stats);
+    REQUIRE(stats.store_puts == 1);
+    REQUIRE(stats.store_replicas == 4);
+
+    SECTION("Gets are answered by the closest replica") {
+        REQUIRE(sn_node_get(&nodes[5], &key, 1000, &get_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 2));
+        REQUIRE(w.found);
+        REQUIRE(w.len == 5);
+        REQUIRE(w.version == version);
+        REQUIRE(strcmp(w.value, "Hola") == 0);
+
+        sn_node_get_stats(&nodes[1], &stats);
+        REQUIRE(stats.store_gets == 1);
+        sn_node_get_stats(&nodes[2], &stats);
+        REQUIRE(stats.store_gets == 0);
+
+        /* Replicas answer their own gets */
+
+        REQUIRE(sn_node_get(&nodes[4], &key, 1000, &get_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 3));
+        REQUIRE(w.found);
+
+        sn_node_get_stats(&nodes[4], &stats);
+        REQUIRE(stats.store_gets == 1);
+
+        /* Keys not stored get to their owner */
+
+        REQUIRE(sn_node_get(&nodes[5], &missing, 1000, &get_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 4));
+        REQUIRE(!w.found);
+
+        sn_node_get_stats(&nodes[2], &stats);
+        REQUIRE(stats.store_gets == 1);
+    }
+
+    SECTION("Copies kept by former replicas are not served") {
+        const char* closer[] = { "2100", "2200", "2300" };
+        sn_net_addr_t addr;
+        sn_io_naddr_t nobody;
+
+        /* Nodes joining between 2000 and the owner take its place among the replicas */
+
+        sn_io_naddr_local(&nobody, "_KNOBODY");
+        sn_node_set_failure_detection(&nodes[1], 0);
+
+        for(i = 0; i < 3; ++i) {
+            sn_net_addr_from_hex(&addr, closer[i]);
+            sn_node_add_route(&nodes[1], &addr, &nobody);
+        }
+
+        REQUIRE(sn_node_get(&nodes[5], &key, 1000, &get_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 2));
+        REQUIRE(w.found);
+
+        sn_node_get_stats(&nodes[1], &stats);
+        REQUIRE(stats.store_gets == 0);
+        sn_node_get_stats(&nodes[2], &stats);
+        REQUIRE(stats.store_gets == 1);
+    }
+
+    SECTION("Puts replace the value on every replica") {
+        REQUIRE(sn_node_put(&nodes[5], &key, 6, "Adios", 1000, &put_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 2));
+        REQUIRE(w.found);
+        REQUIRE(w.version > version);
+        version = w.version;
+
+        for(tries = 0, replicas = 0; tries < 100 && replicas < 8; ++tries) {
+            usleep(10000);
+
+            for(i = 0, replicas = 0; i < n; ++i) {
+                sn_node_get_stats(&nodes[i], &stats);
+
+                if(i != 2)
+                    replicas += stats.store_replicas;
+            }
+        }
+
+        REQUIRE(replicas == 8);
+
+        REQUIRE(sn_node_get(&nodes[0], &key, 1000, &get_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 3));
+        REQUIRE(w.version == version);
+        REQUIRE(strcmp(w.value, "Adios") == 0);
+    }
+
+    SECTION("Owners taking over a key write over its replicas") {
+        sn_data_store_item_t item;
+        sn_net_addr_t owner_addr;
+        sn_io_naddr_t owner_naddr;
+        sn_io_sock_t sock;
+        sn_node_t owner;
+        char theirs[8], mine[8];
+
+        /* A second put, so the replicas are past the first version */
+
+        REQUIRE(sn_node_put(&nodes[5], &key, 6, "Adios", 1000, &put_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 2));
+        REQUIRE(w.version > version);
+        version = w.version;
+
+        usleep(100000);
+
+        /* 3080 joins closer to the key than 3000, without a copy of it */
+
+        sn_net_addr_from_hex(&owner_addr, "3080");
+        sn_io_naddr_local(&owner_naddr, "_KG");
+
+        REQUIRE((sock = sn_io_sock_named(&owner_naddr)) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&owner, NULL, (sn_crypto_sign_pubkey_t*)&owner_addr, sock, 0) == 0);
+        sn_node_set_log_callback(&owner, &silent);
+
+        for(i = 0; i < n; ++i) {
+            sn_node_add_route(&owner, &addrs[i], &naddrs[i]);
+            sn_node_add_route(&nodes[i], &owner_addr, &owner_naddr);
+        }
+
+        REQUIRE(sn_node_put(&nodes[5], &key, 5, "Nuevo", 1000, &put_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 3));
+        REQUIRE(w.found);
+        REQUIRE(w.version > version);
+
+        usleep(100000);
+
+        /* Reconciled both ways, the acknowledged value stays */
+
+        REQUIRE(sn_node_sync(&nodes[3]) == 0);
+        REQUIRE(sn_node_sync(&owner) == 0);
+        usleep(200000);
+
+        memset(mine, 0, sizeof(mine));
+        memset(theirs, 0, sizeof(theirs));
+
+        pthread_mutex_lock(&owner.task_mut);
+        if(sn_data_store_get(&owner.store, &key, &item) == 0 && item.len == 5)
+            memcpy(mine, item.value, 5);
+        pthread_mutex_unlock(&owner.task_mut);
+
+        pthread_mutex_lock(&nodes[3].task_mut);
+        if(sn_data_store_get(&nodes[3].store, &key, &item) == 0 && item.len == 5)
+            memcpy(theirs, item.value, 5);
+        pthread_mutex_unlock(&nodes[3].task_mut);
+
+        REQUIRE(strcmp(mine, "Nuevo") == 0);
+        REQUIRE(strcmp(theirs, "Nuevo") == 0);
+
+        sn_node_destroy(&owner);
+    }
+
+    SECTION("Replicas come from neighbors for keys they replicate") {
+        const char* srcs[] = { "9000", "3000" };
+        const char* keys[] = { "3100", "0100" };
+        unsigned char buf[sizeof(sn_wire_store_msg_t) + 5];
+        sn_wire_store_msg_t* msg = (sn_wire_store_msg_t*)buf;
+        sn_data_store_item_t item;
+        sn_net_addr_t src, other;
+        sn_net_packet_t* packet;
+        sn_io_naddr_t addrX;
+        sn_io_sock_t sockX;
+        uint64_t received, stored;
+        int kept, taken;
+
+        sn_io_naddr_local(&addrX, "_KX");
+        REQUIRE((sockX = sn_io_sock_named(&addrX)) != SN_IO_SOCK_INVALID);
+
+        /* 9000 is no neighbor of 4000, and 0100 is left to 1000 and 2000 */
+
+        sn_node_get_stats(&nodes[3], &stats);
+        received = stats.received;
+        stored = stats.store_replicas;
+
+        for(i = 0; i < 2; ++i) {
+            sn_net_addr_from_hex(&src, srcs[i]);
+            sn_net_addr_from_hex(&other, keys[i]);
+
+            memset(buf, 0, sizeof(buf));
+            msg->op = SN_WIRE_STORE_REPLICA;
+            msg->version = UINT64_MAX;
+            sn_net_addr_ser(&other, &msg->key);
+            memcpy(msg + 1, "Mala", 5);
+
+            packet = sn_net_packet_pack(&addrs[3], &src, SN_WIRE_NET_TYPE_STORE, sizeof(buf), (const char*)buf);
+            REQUIRE(sn_net_packet_send(packet, sockX, &naddrs[3]) == 0);
+            free(packet);
+        }
+
+        for(tries = 0; tries < 100 && stats.received < received + 2; ++tries) {
+            usleep(10000);
+            sn_node_get_stats(&nodes[3], &stats);
+        }
+
+        REQUIRE(stats.received == received + 2);
+        REQUIRE(stats.store_replicas == stored);
+
+        pthread_mutex_lock(&nodes[3].task_mut);
+        kept = sn_data_store_get(&nodes[3].store, &key, &item) == 0 && item.version == version;
+        taken = sn_data_store_get(&nodes[3].store, &other, NULL) == 0;
+        pthread_mutex_unlock(&nodes[3].task_mut);
+
+        REQUIRE(kept);
+        REQUIRE(!taken);
+
+        sn_io_sock_close(sockX);
+    }
+
+    SECTION("Unanswered requests time out") {
+        sn_io_sock_t silent_sock;
+
+        sn_node_destroy(&nodes[1]);
+        dead = 1;
+
+        REQUIRE((silent_sock = sn_io_sock_named(&naddrs[1])) != SN_IO_SOCK_INVALID);
+
+        REQUIRE(sn_node_get(&nodes[5], &missing, 200, &get_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 2));
+        REQUIRE(!w.found);
+
+        REQUIRE(sn_node_put(&nodes[5], &key, 1, "", 200, &put_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 3));
+        REQUIRE(!w.found);
+
+        sn_io_sock_close(silent_sock);
+    }
+
+    for(i = 0; i < n; ++i)
+        if(i != dead)
+            sn_node_destroy(&nodes[i]);
+
+    pthread_cond_destroy(&w.wait.cond);
+    pthread_mutex_destroy(&w.wait.mut);
+}
+
+TEST_CASE("Emulated network caching hot keys on the path", "[network][cache]") {
+    const char* hexes[] = { "1000", "2000", "3000", "4000", "5000", "6000", "7000", "f000" };
+    const char* names[] = { "_WA", "_WB", "_WC", "_WD", "_WE", "_WF", "_WG", "_WH" };
+    const size_t n = 8;
+    sn_node_t nodes[8];
+    sn_net_addr_t addrs[8], key;
+    sn_io_naddr_t naddrs[8];
+    sn_util_closure_t silent, put_done, get_done;
+    struct store_wait w;
+    sn_node_stats_t stats;
+    uint64_t version;
+    size_t i, j;
+    int tries;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    for(i = 0; i < n; ++i) {
+        sn_io_sock_t sock;
+
+        sn_net_addr_from_hex(&addrs[i], hexes[i]);
+        sn_io_naddr_local(&naddrs[i], names[i]);
+
+        REQUIRE((sock = sn_io_sock_named(&naddrs[i])) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&nodes[i], NULL, (sn_crypto_sign_pubkey_t*)&addrs[i], sock, 0) == 0);
+        sn_node_set_log_callback(&nodes[i], &silent);
+    }
+
+    /* f000 only knows 1000, which is closer to the key but no replica of it */
+
+    for(i = 0; i < n; ++i)
+        for(j = 0; j < n; ++j)
+            if(i != j && (i != 7 || j == 0))
+                sn_node_add_route(&nodes[i], &addrs[j], &naddrs[j]);
+
+    pthread_mutex_init(&w.wait.mut, NULL);
+    pthread_cond_init(&w.wait.cond, NULL);
+    w.wait.replies = w.wait.timeouts = 0;
+
+    sn_util_closure_init_curried_once(&put_done, on_put_done, &w);
+    sn_util_closure_init_curried_once(&get_done, on_get_done, &w);
+
+    /* Owned by 5000, replicated on 3000, 4000, 6000 and 7000 */
+
+    sn_net_addr_from_hex(&key, "5100");
+
+    REQUIRE(sn_node_put(&nodes[4], &key, 5, "Hola", 1000, &put_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 1));
+    REQUIRE(w.version > 0);
+    version = w.version;
+
+    for(tries = 0, stats.store_replicas = 0; tries < 100 && stats.store_replicas < 4; ++tries) {
+        usleep(10000);
+        sn_node_get_stats(&nodes[4], &stats);
+    }
+
+    REQUIRE(stats.store_replicas == 4);
+
+    /* Relays cache nothing until enabled */
+
+    REQUIRE(sn_node_get(&nodes[7], &key, 1000, &get_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 2));
+    REQUIRE(w.found);
+
+    sn_node_get_stats(&nodes[0], &stats);
+    REQUIRE(stats.cache_fills == 0);
+
+    sn_node_set_path_cache(&nodes[0], 1);
+
+    REQUIRE(sn_node_get(&nodes[7], &key, 1000, &get_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 3));
+    REQUIRE(w.found);
+
+    sn_node_get_stats(&nodes[0], &stats);
+    REQUIRE(stats.cache_fills == 1);
+    REQUIRE(stats.cache_hits == 0);
+    sn_node_get_stats(&nodes[4], &stats);
+    REQUIRE(stats.store_gets == 2);
+
+    /* The relay answers the next get itself */
+
+    REQUIRE(sn_node_get(&nodes[7], &key, 1000, &get_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 4));
+    REQUIRE(w.found);
+    REQUIRE(w.len == 5);
+    REQUIRE(w.version == version);
+    REQUIRE(strcmp(w.value, "Hola") == 0);
+
+    sn_node_get_stats(&nodes[0], &stats);
+    REQUIRE(stats.cache_hits == 1);
+    sn_node_get_stats(&nodes[4], &stats);
+    REQUIRE(stats.store_gets == 2);
+
+    SECTION("Puts going through a relay drop its copy") {
+        REQUIRE(sn_node_put(&nodes[7], &key, 6, "Adios", 1000, &put_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 5));
+        REQUIRE(w.version > version);
+        version = w.version;
+
+        REQUIRE(sn_node_get(&nodes[7], &key, 1000, &get_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 6));
+        REQUIRE(w.version == version);
+        REQUIRE(strcmp(w.value, "Adios") == 0);
+
+        sn_node_get_stats(&nodes[0], &stats);
+        REQUIRE(stats.cache_hits == 1);
+        REQUIRE(stats.cache_fills == 2);
+    }
+
+    SECTION("Cached values expire") {
+        usleep(SN_NODE_CACHE_TTL*1000);
+
+        REQUIRE(sn_node_get(&nodes[7], &key, 1000, &get_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 5));
+        REQUIRE(w.found);
+
+        sn_node_get_stats(&nodes[0], &stats);
+        REQUIRE(stats.cache_hits == 1);
+        sn_node_get_stats(&nodes[4], &stats);
+        REQUIRE(stats.store_gets == 3);
+
+        /* The answer refills the copy */
+
+        REQUIRE(sn_node_get(&nodes[7], &key, 1000, &get_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 6));
+        REQUIRE(w.version == version);
+
+        sn_node_get_stats(&nodes[0], &stats);
+        REQUIRE(stats.cache_fills == 2);
+        REQUIRE(stats.cache_hits == 2);
+    }
+
+    SECTION("Values answering no get of the relay are not cached") {
+        unsigned char buf[sizeof(sn_wire_store_msg_t) + 6];
+        sn_wire_store_msg_t* msg = (sn_wire_store_msg_t*)buf;
+        sn_net_packet_t* packet;
+        sn_io_naddr_t addrX;
+        sn_io_sock_t sockX;
+        uint64_t received;
+
+        sn_io_naddr_local(&addrX, "_WX");
+        REQUIRE((sockX = sn_io_sock_named(&addrX)) != SN_IO_SOCK_INVALID);
+
+        /* A newer value going to f000 as if 5000 answered it */
+
+        memset(buf, 0, sizeof(buf));
+        msg->op = SN_WIRE_STORE_VALUE;
+        msg->reply_to = 1;
+        msg->version = UINT64_MAX;
+        sn_net_addr_ser(&key, &msg->key);
+        memcpy(msg + 1, "Mala!", 6);
+
+        sn_node_get_stats(&nodes[0], &stats);
+        received = stats.received;
+
+        packet = sn_net_packet_pack(&addrs[7], &addrs[4], SN_WIRE_NET_TYPE_STORE, sizeof(buf), (const char*)buf);
+        REQUIRE(sn_net_packet_send(packet, sockX, &naddrs[0]) == 0);
+        free(packet);
+
+        for(tries = 0; tries < 100 && stats.received == received; ++tries) {
+            usleep(10000);
+            sn_node_get_stats(&nodes[0], &stats);
+        }
+
+        REQUIRE(stats.cache_fills == 1);
+
+        REQUIRE(sn_node_get(&nodes[7], &key, 1000, &get_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, 5));
+        REQUIRE(w.version == version);
+        REQUIRE(strcmp(w.value, "Hola") == 0);
+
+        sn_io_sock_close(sockX);
+    }
+
+    for(i = 0; i < n; ++i)
+        sn_node_destroy(&nodes[i]);
+
+    pthread_cond_destroy(&w.wait.cond);
+    pthread_mutex_destroy(&w.wait.mut);
+}
+
+static uint64_t digests_sent(sn_node_t* nodes, size_t n) {
+    sn_node_stats_t stats;
+    uint64_t digests = 0;
+    size_t i;
+
+    for(i = 0; i < n; ++i) {
+        sn_node_get_stats(&nodes[i], &stats);
+        digests += stats.sync_digests;
+    }
+
+    return digests;
+}
+
+TEST_CASE("Emulated network reconciling replicas", "[network][sync]") {
+    const char* hexes[] = { "1000", "2000", "3000", "4000", "5000" };
+    const char* names[] = { "_YA", "_YB", "_YC", "_YD", "_YE" };
+    const char* keys[] = { "3100", "3200", "3700", "2100" };
+    const size_t n = 5;
+    sn_node_t nodes[5];
+    sn_net_addr_t addrs[5], key;
+    sn_io_naddr_t naddrs[5];
+    sn_util_closure_t silent, put_done, get_done;
+    struct store_wait w;
+    sn_node_stats_t stats;
+    uint64_t items, replicas, digests, versions[4];
+    size_t i, j;
+    int tries;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    for(i = 0; i < n; ++i) {
+        sn_io_sock_t sock;
+
+        sn_net_addr_from_hex(&addrs[i], hexes[i]);
+        sn_io_naddr_local(&naddrs[i], names[i]);
+
+        REQUIRE((sock = sn_io_sock_named(&naddrs[i])) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&nodes[i], NULL, (sn_crypto_sign_pubkey_t*)&addrs[i], sock, 0) == 0);
+        sn_node_set_log_callback(&nodes[i], &silent);
+    }
+
+    for(i = 0; i < n; ++i)
+        for(j = 0; j < n; ++j)
+            if(i != j)
+                sn_node_add_route(&nodes[i], &addrs[j], &naddrs[j]);
+
+    pthread_mutex_init(&w.wait.mut, NULL);
+    pthread_cond_init(&w.wait.cond, NULL);
+    w.wait.replies = w.wait.timeouts = 0;
+
+    sn_util_closure_init_curried_once(&put_done, on_put_done, &w);
+    sn_util_closure_init_curried_once(&get_done, on_get_done, &w);
+
+    /* Three keys owned by 3000, one by 2000, all replicated on 4000 */
+
+    for(i = 0; i < 4; ++i) {
+        sn_net_addr_from_hex(&key, keys[i]);
+
+        REQUIRE(sn_node_put(&nodes[0], &key, 5, "Hola", 1000, &put_done) == 0);
+        REQUIRE(wait_for(&w.wait, &w.wait.replies, (int)i + 1));
+        REQUIRE(w.found);
+        versions[i] = w.version;
+    }
+
+    for(tries = 0, replicas = 0; tries < 100 && replicas < 4; ++tries) {
+        usleep(10000);
+
+        sn_node_get_stats(&nodes[3], &stats);
+        replicas = stats.store_replicas;
+    }
+
+    REQUIRE(replicas == 4);
+
+    /* Nothing differs, the root digests clipped to the range of 3000 match on its four replicas */
+
+    digests = digests_sent(nodes, n);
+
+    REQUIRE(sn_node_sync(&nodes[2]) == 0);
+    usleep(200000);
+
+    sn_node_get_stats(&nodes[2], &stats);
+    REQUIRE(stats.sync_digests > 0);
+    REQUIRE(stats.sync_items == 0);
+
+    for(i = 0; i < n; ++i) {
+        sn_node_get_stats(&nodes[i], &stats);
+        REQUIRE(stats.sync_items == 0);
+    }
+
+    REQUIRE(digests_sent(nodes, n) - digests == 4);
+
+    /* 4000 comes back empty */
+
+    sn_node_destroy(&nodes[3]);
+
+    {
+        sn_io_sock_t sock;
+
+        REQUIRE((sock = sn_io_sock_named(&naddrs[3])) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&nodes[3], NULL, (sn_crypto_sign_pubkey_t*)&addrs[3], sock, 0) == 0);
+        sn_node_set_log_callback(&nodes[3], &silent);
+
+        for(j = 0; j < n; ++j)
+            if(j != 3)
+                sn_node_add_route(&nodes[3], &addrs[j], &naddrs[j]);
+    }
+
+    REQUIRE(sn_node_sync(&nodes[2]) == 0);
+
+    for(tries = 0, replicas = 0; tries < 100 && replicas < 3; ++tries) {
+        usleep(10000);
+
+        sn_node_get_stats(&nodes[3], &stats);
+        replicas = stats.store_replicas;
+    }
+
+    /* Only the range owned by 3000 is sent, 2100 waits for 2000 */
+
+    usleep(100000);
+
+    sn_node_get_stats(&nodes[3], &stats);
+    REQUIRE(stats.store_replicas == 3);
+
+    sn_node_get_stats(&nodes[2], &stats);
+    REQUIRE(stats.sync_items == 3);
+    items = stats.sync_items;
+
+    sn_net_addr_from_hex(&key, "3700");
+    REQUIRE(sn_node_get(&nodes[3], &key, 1000, &get_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 5));
+    REQUIRE(w.found);
+    REQUIRE(w.version == versions[2]);
+    REQUIRE(strcmp(w.value, "Hola") == 0);
+
+    sn_node_get_stats(&nodes[3], &stats);
+    REQUIRE(stats.store_gets == 1);
+
+    /* Once reconciled, nothing more is sent */
+
+    REQUIRE(sn_node_sync(&nodes[2]) == 0);
+    usleep(200000);
+
+    sn_node_get_stats(&nodes[2], &stats);
+    REQUIRE(stats.sync_items == items);
+
+    REQUIRE(sn_node_sync(&nodes[1]) == 0);
+
+    for(tries = 0, replicas = 0; tries < 100 && replicas < 4; ++tries) {
+        usleep(10000);
+
+        sn_node_get_stats(&nodes[3], &stats);
+        replicas = stats.store_replicas;
+    }
+
+    REQUIRE(replicas == 4);
+
+    /* A replica of 3100 with the same version but another value, one of the two wins on both */
+
+    {
+        unsigned char buf[sizeof(sn_wire_store_msg_t) + 5];
+        sn_wire_store_msg_t* msg = (sn_wire_store_msg_t*)buf;
+        sn_data_store_item_t item;
+        char mine[8], theirs[8];
+        sn_net_packet_t* packet;
+        sn_io_naddr_t addrX;
+        sn_io_sock_t sockX;
+
+        sn_io_naddr_local(&addrX, "_YX");
+        REQUIRE((sockX = sn_io_sock_named(&addrX)) != SN_IO_SOCK_INVALID);
+
+        sn_net_addr_from_hex(&key, "3100");
+
+        memset(buf, 0, sizeof(buf));
+        msg->op = SN_WIRE_STORE_REPLICA;
+        msg->version = versions[0];
+        sn_net_addr_ser(&key, &msg->key);
+        memcpy(msg + 1, "Mala", 5);
+
+        packet = sn_net_packet_pack(&addrs[3], &addrs[2], SN_WIRE_NET_TYPE_STORE, sizeof(buf), (const char*)buf);
+        REQUIRE(sn_net_packet_send(packet, sockX, &naddrs[3]) == 0);
+        free(packet);
+
+        /* Kept by 4000 only if it wins, the loser is replaced on either side */
+
+        usleep(100000);
+
+        REQUIRE(sn_node_sync(&nodes[2]) == 0);
+        usleep(200000);
+
+        memset(mine, 0, sizeof(mine));
+        memset(theirs, 0, sizeof(theirs));
+
+        pthread_mutex_lock(&nodes[2].task_mut);
+        if(sn_data_store_get(&nodes[2].store, &key, &item) == 0 && item.version == versions[0] && item.len == 5)
+            memcpy(mine, item.value, 5);
+        pthread_mutex_unlock(&nodes[2].task_mut);
+
+        pthread_mutex_lock(&nodes[3].task_mut);
+        if(sn_data_store_get(&nodes[3].store, &key, &item) == 0 && item.version == versions[0] && item.len == 5)
+            memcpy(theirs, item.value, 5);
+        pthread_mutex_unlock(&nodes[3].task_mut);
+
+        REQUIRE((strcmp(mine, "Hola") == 0 || strcmp(mine, "Mala") == 0));
+        REQUIRE(strcmp(mine, theirs) == 0);
+
+        /* Once the winner reached the other replicas, the clipped root digests match again */
+
+        REQUIRE(sn_node_sync(&nodes[2]) == 0);
+        usleep(200000);
+
+        digests = digests_sent(nodes, n);
+
+        REQUIRE(sn_node_sync(&nodes[2]) == 0);
+        usleep(200000);
+
+        REQUIRE(digests_sent(nodes, n) - digests == 4);
+
+        sn_io_sock_close(sockX);
+    }
+
+    for(i = 0; i < n; ++i)
+        sn_node_destroy(&nodes[i]);
+
+    pthread_cond_destroy(&w.wait.cond);
+    pthread_mutex_destroy(&w.wait.mut);
+}
+
+TEST_CASE("Emulated network storing erasure coded objects", "[network][object]") {
+    const char* hexes[] = { "1000", "2000", "3000", "4000", "5000", "6000", "7000" };
+    const char* names[] = { "_ZA", "_ZB", "_ZC", "_ZD", "_ZE", "_ZF", "_ZG" };
+    const size_t n = 7;
+    const struct timespec pause = { 0, 1000000 };
+    sn_node_t nodes[7], joined;
+    sn_net_addr_t addrs[7], joined_addr, key, missing;
+    sn_io_naddr_t naddrs[7], joined_naddr;
+    sn_io_sock_t silent_socks[2], joined_sock;
+    sn_util_closure_t silent, put_done, get_done;
+    struct object_wait w;
+    sn_node_stats_t stats;
+    uint64_t fragments, version, moved;
+    char object[20000];
+    size_t i, j, k;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    for(i = 0; i < n; ++i) {
+        sn_io_sock_t sock;
+
+        sn_net_addr_from_hex(&addrs[i], hexes[i]);
+        sn_io_naddr_local(&naddrs[i], names[i]);
+
+        REQUIRE((sock = sn_io_sock_named(&naddrs[i])) != SN_IO_SOCK_INVALID);
+        REQUIRE(sn_node_at_socket(&nodes[i], NULL, (sn_crypto_sign_pubkey_t*)&addrs[i], sock, 0) == 0);
+        sn_node_set_log_callback(&nodes[i], &silent);
+    }
+
+    for(i = 0; i < n; ++i)
+        for(j = 0; j < n; ++j)
+            if(i != j)
+                sn_node_add_route(&nodes[i], &addrs[j], &naddrs[j]);
+
+    pthread_mutex_init(&w.wait.mut, NULL);
+    pthread_cond_init(&w.wait.cond, NULL);
+    w.wait.replies = w.wait.timeouts = 0;
+
+    sn_util_closure_init_curried_once(&put_done, on_object_put_done, &w);
+    sn_util_closure_init_curried_once(&get_done, on_object_get_done, &w);
+
+    for(i = 0; i < sizeof(object); ++i)
+        object[i] = (char)(i*7 + i/251);
+
+    /* Owned by 4000, the fragments on 4000, 5000, 3000, 6000, 2000 and 7000, each in several parts */
+
+    sn_net_addr_from_hex(&key, "4100");
+    sn_net_addr_from_hex(&missing, "4200");
+
+    REQUIRE(sn_node_object_put(&nodes[0], &key, SN_NODE_OBJECT_MAX_LEN + 1, object, 1000, &put_done) == -1);
+
+    REQUIRE(sn_node_object_put(&nodes[0], &key, sizeof(object), object, 1000, &put_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 1));
+    REQUIRE(w.found);
+    version = w.version;
+
+    for(i = 0, fragments = 0; i < n; ++i) {
+        sn_node_get_stats(&nodes[i], &stats);
+        REQUIRE(stats.object_fragments == (i == 0 ? 0u : 1u));
+        fragments += stats.object_fragments;
+    }
+
+    REQUIRE(fragments == SN_NODE_OBJECT_DATA + SN_NODE_OBJECT_PARITY);
+
+    REQUIRE(sn_node_object_get(&nodes[0], &key, 1000, &get_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 2));
+    REQUIRE(w.found);
+    REQUIRE(w.version == version);
+    REQUIRE(w.len == sizeof(object));
+    REQUIRE(memcmp(w.value, object, sizeof(object)) == 0);
+
+    /* Objects not stored are missing from every holder */
+
+    REQUIRE(sn_node_object_get(&nodes[0], &missing, 1000, &get_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 3));
+    REQUIRE(!w.found);
+
+    /* 4800 joins between the owner and its holders, which still answer with the fragments they have */
+
+    sn_net_addr_from_hex(&joined_addr, "4800");
+    sn_io_naddr_local(&joined_naddr, "_ZH");
+
+    REQUIRE((joined_sock = sn_io_sock_named(&joined_naddr)) != SN_IO_SOCK_INVALID);
+    REQUIRE(sn_node_at_socket(&joined, NULL, (sn_crypto_sign_pubkey_t*)&joined_addr, joined_sock, 0) == 0);
+    sn_node_set_log_callback(&joined, &silent);
+
+    for(i = 0; i < n; ++i) {
+        sn_node_add_route(&joined, &addrs[i], &naddrs[i]);
+        sn_node_add_route(&nodes[i], &joined_addr, &joined_naddr);
+    }
+
+    REQUIRE(sn_node_object_get(&nodes[0], &key, 1000, &get_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 4));
+    REQUIRE(w.found);
+    REQUIRE(w.version == version);
+    REQUIRE(w.len == sizeof(object));
+    REQUIRE(memcmp(w.value, object, sizeof(object)) == 0);
+
+    /* Then the fragments move: 5000 to 4800, 6000 to 5000 and 7000 to 6000 */
+
+    for(k = 0, moved = 0; k < 5000 && moved < 3; ++k) {
+        nanosleep(&pause, NULL);
+
+        sn_node_get_stats(&joined, &stats);
+        moved = stats.object_fragments;
+        sn_node_get_stats(&nodes[4], &stats);
+        moved += stats.object_fragments - 1;
+        sn_node_get_stats(&nodes[5], &stats);
+        moved += stats.object_fragments - 1;
+    }
+
+    REQUIRE(moved == 3);
+
+    sn_node_get_stats(&joined, &stats);
+    REQUIRE(stats.object_fragments == 1);
+
+    REQUIRE(sn_node_object_get(&nodes[0], &key, 1000, &get_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 5));
+    REQUIRE(w.found);
+    REQUIRE(w.version == version);
+    REQUIRE(w.len == sizeof(object));
+    REQUIRE(memcmp(w.value, object, sizeof(object)) == 0);
+
+    /* The holders of two data fragments are gone, the parity ones make up for them */
+
+    sn_node_destroy(&nodes[2]);
+    sn_node_destroy(&nodes[4]);
+
+    REQUIRE((silent_socks[0] = sn_io_sock_named(&naddrs[2])) != SN_IO_SOCK_INVALID);
+    REQUIRE((silent_socks[1] = sn_io_sock_named(&naddrs[4])) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_object_get(&nodes[0], &key, 1000, &get_done) == 0);
+    REQUIRE(wait_for(&w.wait, &w.wait.replies, 6));
+    REQUIRE(w.found);
+    REQUIRE(w.version == version);
+    REQUIRE(w.len == sizeof(object));
+    REQUIRE(memcmp(w.value, object, sizeof(object)) == 0);
+
+    sn_node_get_stats(&nodes[0], &stats);
+    REQUIRE(stats.object_decodes >= 1);
+
+    for(i = 0; i < n; ++i)
+        if(i != 2 && i != 4)
+            sn_node_destroy(&nodes[i]);
+
+    sn_node_destroy(&joined);
+
+    sn_io_sock_close(silent_socks[0]);
+    sn_io_sock_close(silent_socks[1]);
+
+    pthread_cond_destroy(&w.wait.cond);
+    pthread_mutex_destroy(&w.wait.mut);
+}
+
+TEST_CASE("Emulated network hosted on a runtime", "[network][runtime]") {
+    sn_io_runtime_t rt;
+    sn_node_t A, B, C;
+    sn_net_addr_t a3f4, b567, b666, b667;
+    sn_io_sock_t sockA, sockB, sockC, sockTEST;
+    sn_io_naddr_t addrA, addrB, addrC, addrTEST;
+    sn_util_closure_t silent;
+    sn_net_packet_t* msg;
+
+    REQUIRE(sn_init() != -1);
+    REQUIRE(sn_io_runtime_init(&rt, 2) == 0);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&a3f4, "a3f4");
+    sn_net_addr_from_hex(&b567, "b567");
+    sn_net_addr_from_hex(&b666, "b666");
+    sn_net_addr_from_hex(&b667, "b667");
+
+    sn_io_naddr_local(&addrA, "_RA");
+    sn_io_naddr_local(&addrB, "_RB");
+    sn_io_naddr_local(&addrC, "_RC");
+    sn_io_naddr_local(&addrTEST, "_RTEST");
+
+    REQUIRE((sockA = sn_io_sock_named(&addrA)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockB = sn_io_sock_named(&addrB)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockC = sn_io_sock_named(&addrC)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockTEST = sn_io_sock_named(&addrTEST)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_at_runtime(&A, &rt, NULL, (sn_crypto_sign_pubkey_t*)&a3f4, sockA, 0) == 0);
+    REQUIRE(sn_node_at_runtime(&B, &rt, NULL, (sn_crypto_sign_pubkey_t*)&b567, sockB, 0) == 0);
+    REQUIRE(sn_node_at_runtime(&C, &rt, NULL, (sn_crypto_sign_pubkey_t*)&b666, sockC, 0) == 0);
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+    sn_node_set_log_callback(&C, &silent);
+
+    sn_net_router_add(&A.router, &b567, &addrB);
+    sn_net_router_add(&B.router, &a3f4, &addrA);
+    sn_net_router_add(&B.router, &b666, &addrC);
+    sn_net_router_add(&C.router, &b567, &addrB);
+    sn_net_router_add(&C.router, &b667, &addrTEST);
+
+    SECTION("Forwarding through hosted nodes") {
+        REQUIRE(sn_node_send(&A, &b667, 5, "Hola") == 0);
+
+        msg = sn_net_packet_recv(sockTEST, NULL);
+
+        REQUIRE(msg != NULL);
+        REQUIRE(strcmp("Hola", (char*)msg->payload) == 0);
+
+        free(msg);
+    }
+
+    SECTION("Pinging C from A and waiting for the reply") {
+        struct reply_wait w;
+        sn_util_closure_t closure;
+        sn_wire_ping_msg_t ping;
+
+        pthread_mutex_init(&w.mut, NULL);
+        pthread_cond_init(&w.cond, NULL);
+        w.replies = w.timeouts = 0;
+
+        sn_util_closure_init_curried_once(&closure, on_reply, &w);
+
+        memset(&ping, 0, sizeof(ping));
+        ping.reply_to = sn_node_new_reply_id(&A);
+
+        REQUIRE(sn_node_register_reply(&A, ping.reply_to, &closure, 1, 0) == 0);
+        REQUIRE(sn_node_send_typed(&A, &b666, SN_WIRE_NET_TYPE_PING, sizeof(ping), (const char*)&ping) == 0);
+
+        REQUIRE(wait_for(&w, &w.replies, 1));
+
+        pthread_cond_destroy(&w.cond);
+        pthread_mutex_destroy(&w.mut);
+    }
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+    sn_node_destroy(&C);
+
+    sn_io_sock_close(sockTEST);
+    sn_io_runtime_destroy(&rt);
+}
+
+static mint_atomic32_t mux_delivered;
+
+static int count_mux_upcall(const unsigned char msg[], unsigned long long msg_len) {
+    (void)msg;
+    (void)msg_len;
+
+    mint_fetch_add_32_relaxed(&mux_delivered, 1);
+
+    return 0;
+}
+
+TEST_CASE("Emulated network of identities sharing a socket", "[network][mux]") {
+    sn_io_runtime_t rt;
+    sn_node_mux_t mux;
+    sn_node_t A, B, C, D;
+    sn_net_addr_t a3f4, b567, b666, b667;
+    sn_io_sock_t sockMUX, sockTEST;
+    sn_io_naddr_t addrMUX, addrTEST;
+    sn_util_closure_t silent;
+
+    REQUIRE(sn_init() != -1);
+    REQUIRE(sn_io_runtime_init(&rt, 2) == 0);
+
+    sn_util_closure_init_curried_once(&silent, sn_silent_log_callback, NULL);
+
+    sn_net_addr_from_hex(&a3f4, "a3f4");
+    sn_net_addr_from_hex(&b567, "b567");
+    sn_net_addr_from_hex(&b666, "b666");
+    sn_net_addr_from_hex(&b667, "b667");
+
+    sn_io_naddr_local(&addrMUX, "_MUX");
+    sn_io_naddr_local(&addrTEST, "_MTEST");
+
+    REQUIRE((sockMUX = sn_io_sock_named(&addrMUX)) != SN_IO_SOCK_INVALID);
+    REQUIRE((sockTEST = sn_io_sock_named(&addrTEST)) != SN_IO_SOCK_INVALID);
+
+    REQUIRE(sn_node_mux_init(&mux, &rt, sockMUX) == 0);
+
+    REQUIRE(sn_node_at_mux(&A, &mux, NULL, (sn_crypto_sign_pubkey_t*)&a3f4, 0) == 0);
+    REQUIRE(sn_node_at_mux(&B, &mux, NULL, (sn_crypto_sign_pubkey_t*)&b567, 0) == 0);
+    REQUIRE(sn_node_at_mux(&C, &mux, NULL, (sn_crypto_sign_pubkey_t*)&b666, 0) == 0);
+    REQUIRE(sn_node_at_mux(&D, &mux, NULL, (sn_crypto_sign_pubkey_t*)&b666, 0) == -1);
+
+    sn_node_set_log_callback(&A, &silent);
+    sn_node_set_log_callback(&B, &silent);
+    sn_node_set_log_callback(&C, &silent);
+
+    sn_net_router_add(&A.router, &b567, &addrMUX);
+    sn_net_router_add(&B.router, &b666, &addrMUX);
+    sn_net_router_add(&C.router, &b667, &addrTEST);
+
+    SECTION("Forwarding through local identities") {
+        sn_net_packet_t* msg;
+
+        REQUIRE(sn_node_send(&A, &b667, 5, "Hola") == 0);
+
+        msg = sn_net_packet_recv(sockTEST, NULL);
+
+        REQUIRE(msg != NULL);
+        REQUIRE(strcmp("Hola", (char*)msg->payload) == 0);
+        REQUIRE(msg->header.ttl == SN_NET_PACKET_DEFAULT_TTL - 3);
+
+        free(msg);
+    }
+
+    SECTION("Demultiplexing received packets by destination") {
+        sn_net_packet_t* packet;
+        struct timespec pause = { 0, 1000000 };
+        int i;
+
+        mint_store_32_relaxed(&mux_delivered, 0);
+        sn_node_set_upcall(&B, count_mux_upcall);
+
+        packet = sn_net_packet_pack(&b567, &b667, 0, 5, "Hola");
+        REQUIRE(packet != NULL);
+        REQUIRE(sn_net_packet_send(packet, sockTEST, &addrMUX) == 0);
+        free(packet);
+
+        for(i = 0; i < 5000 && mint_load_32_relaxed(&mux_delivered) == 0; ++i)
+            nanosleep(&pause, NULL);
+
+        REQUIRE(mint_load_32_relaxed(&mux_delivered) == 1);
+    }
+
+    SECTION("Second copies through local identities") {
+        sn_net_addr_t c000, c0ff;
+        sn_io_naddr_t addrSlow;
+        sn_net_packet_t* packet = NULL;
+        struct timespec pause = { 0, 1000000 };
+        int i;
+
+        sn_net_addr_from_hex(&c000, "c000");
+        sn_net_addr_from_hex(&c0ff, "c0ff");
+        sn_io_naddr_local(&addrSlow, "_MSLOW");
+
+        /* The best relay of A is bound by nobody, B is the alternative */
+
+        sn_node_set_failure_detection(&A, 0);
+        sn_net_router_add(&A.router, &c0ff, &addrSlow);
+        sn_net_router_add(&B.router, &c000, &addrTEST);
+
+        REQUIRE(sn_node_send_hedged(&A, &c000, SN_WIRE_NET_TYPE_USER, 5, "Hola", 0) == 0);
+
+        REQUIRE(sn_io_sock_set_nonblocking(sockTEST, 1) == 0);
+
+        for(i = 0; i < 5000; ++i) {
+            if((packet = sn_net_packet_recv(sockTEST, NULL)) == NULL)
+                nanosleep(&pause, NULL);
+            else if(packet->header.type == SN_WIRE_NET_TYPE_HEDGED)
+                break;
+            else
+                free(packet);
+        }
+
+        REQUIRE(sn_io_sock_set_nonblocking(sockTEST, 0) == 0);
+        REQUIRE(packet != NULL);
+        REQUIRE(packet->header.type == SN_WIRE_NET_TYPE_HEDGED);
+        REQUIRE(strcmp("Hola", (char*)packet->payload + sizeof(sn_wire_hedged_header_t)) == 0);
+
+        free(packet);
+    }
+
+    sn_node_destroy(&A);
+    sn_node_destroy(&B);
+    sn_node_destroy(&C);
+
+    sn_node_mux_destroy(&mux);
+    sn_io_sock_close(sockTEST);
+    sn_io_runtime_destroy(&rt);
+}
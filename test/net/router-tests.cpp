@@ -115,6 +115,18 @@ SCENARIO("inserting into router", "[router]") {
 
             REQUIRE(sn_net_addr_cmp(&res->addr, &addr3333) == 0);
         }
+
+        WHEN("Adding 3333 twice it appears once on the leafset") {
+            sn_net_addr_t addr3333;
+
+            sn_net_addr_from_hex(&addr3333, "3333");
+
+            sn_net_router_add(&r, &addr3333, NULL);
+            sn_net_router_add(&r, &addr3333, NULL);
+
+            REQUIRE(sn_net_router_leafset_get(&r, 1)->is_set);
+            REQUIRE(!sn_net_router_leafset_get(&r, 2)->is_set);
+        }
     }
 
     GIVEN("A router on 1234 with the right leafset filled with 400x addresses") {
@@ -158,6 +170,7 @@ TEST_CASE("Router overwriting", "[router]") {
     sn_net_router_t r;
     sn_net_entry_t e;
     sn_net_entry_t self;
+    sn_net_addr_t other;
 
     self.is_set = 1;
     sn_net_addr_from_hex(&self.addr, "0a0a0a0a");
@@ -178,6 +191,132 @@ TEST_CASE("Router overwriting", "[router]") {
     sn_net_router_leafset_set(&r, -1, &e);
 
     REQUIRE(sn_net_entry_cmp(sn_net_router_leafset_get(&r, -1), &e) == 0);
+
+    /* Removing a node leaves the one holding its table slot there */
+
+    sn_net_addr_from_hex(&other, "a1");
+    sn_net_router_add(&r, &e.addr, &e.net_addr);
+    sn_net_router_remove(&r, &other);
+
+    REQUIRE(sn_net_router_table_get(&r, 0, 10)->is_set);
+    REQUIRE(sn_net_entry_cmp(sn_net_router_table_get(&r, 0, 10), &e) == 0);
+}
+
+TEST_CASE("Router alternative nexthops", "[router]") {
+    sn_net_router_t r;
+    sn_net_addr_t self, dst, near, nearer, far;
+    sn_net_entry_t best, alt;
+    sn_io_naddr_t naddr;
+
+    sn_net_addr_from_hex(&self, "a3f4");
+    sn_net_addr_from_hex(&dst, "d000");
+    sn_net_addr_from_hex(&near, "c800");
+    sn_net_addr_from_hex(&nearer, "d0ff");
+    sn_net_addr_from_hex(&far, "1234");
+    sn_io_naddr_from_str(&naddr, "INET:1.1.1.1:1111");
+
+    sn_net_router_init(&r, &self, &naddr);
+
+    sn_net_router_nexthop_alt(&r, &dst, &nearer, &alt);
+    REQUIRE(alt.is_set == 0);
+
+    sn_net_router_add(&r, &nearer, &naddr);
+    sn_net_router_add(&r, &near, &naddr);
+    sn_net_router_add(&r, &far, &naddr);
+
+    sn_net_router_nexthop(&r, &dst, &best);
+
+    REQUIRE(best.is_set);
+    REQUIRE(sn_net_addr_cmp(&best.addr, &nearer) == 0);
+
+    sn_net_router_nexthop_alt(&r, &dst, &best.addr, &alt);
+
+    REQUIRE(alt.is_set);
+    REQUIRE(sn_net_addr_cmp(&alt.addr, &near) == 0);
+
+    /* Nothing further from the destination than us */
+
+    sn_net_router_remove(&r, &near);
+    sn_net_router_nexthop_alt(&r, &dst, &best.addr, &alt);
+
+    REQUIRE(alt.is_set == 0);
+
+    sn_net_router_destroy(&r);
+}
+
+TEST_CASE("Router broadcast splitting", "[router]") {
+    sn_net_router_t r;
+    sn_net_addr_t self, lo, hi, a888, a4a0, a4f0, a4f5;
+    sn_net_entry_t entries[SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS];
+    uint8_t levels[SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS];
+    sn_io_naddr_t naddr;
+
+    sn_net_addr_from_hex(&self, "4f5e22");
+    sn_net_addr_from_hex(&a888, "888888");
+    sn_net_addr_from_hex(&a4a0, "4a0000");
+    sn_net_addr_from_hex(&a4f0, "4f0000");
+    sn_net_addr_from_hex(&a4f5, "4f5e23");
+    sn_io_naddr_from_str(&naddr, "INET:1.1.1.1:1111");
+
+    sn_net_router_init(&r, &self, &naddr);
+
+    sn_net_router_add(&r, &a888, &naddr);
+    sn_net_router_add(&r, &a4a0, &naddr);
+    sn_net_router_add(&r, &a4f0, &naddr);
+    sn_net_router_add(&r, &a4f5, &naddr);
+
+    sn_net_addr_from_hex(&lo, "0");
+    sn_net_addr_from_hex(&hi, "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+
+    SECTION("Each entry gets the subtree one digit below the level it is on") {
+        REQUIRE(sn_net_router_split(&r, 0, &lo, &hi, entries, levels, SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS) == 4);
+
+        REQUIRE(sn_net_addr_cmp(&entries[0].addr, &a888) == 0);
+        REQUIRE(levels[0] == 1);
+        REQUIRE(sn_net_addr_cmp(&entries[1].addr, &a4a0) == 0);
+        REQUIRE(levels[1] == 2);
+        REQUIRE(sn_net_addr_cmp(&entries[2].addr, &a4f0) == 0);
+        REQUIRE(levels[2] == 3);
+        REQUIRE(sn_net_addr_cmp(&entries[3].addr, &a4f5) == 0);
+        REQUIRE(levels[3] == 6);
+    }
+
+    SECTION("Copies from deeper levels skip the rows above") {
+        REQUIRE(sn_net_router_split(&r, 2, &lo, &hi, entries, levels, SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS) == 2);
+        REQUIRE(sn_net_addr_cmp(&entries[0].addr, &a4f0) == 0);
+        REQUIRE(sn_net_addr_cmp(&entries[1].addr, &a4f5) == 0);
+
+        REQUIRE(sn_net_router_split(&r, 6, &lo, &hi, entries, levels, SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS) == 0);
+    }
+
+    SECTION("Ranges prune the subtrees out of them") {
+        sn_net_addr_from_hex(&lo, "4a");
+        sn_net_addr_from_hex(&hi, "4f5e2");
+
+        REQUIRE(sn_net_router_split(&r, 0, &lo, &hi, entries, levels, SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS) == 2);
+        REQUIRE(sn_net_addr_cmp(&entries[0].addr, &a4a0) == 0);
+        REQUIRE(sn_net_addr_cmp(&entries[1].addr, &a4f0) == 0);
+
+        /* Partly covered subtrees still get their copy */
+
+        sn_net_addr_from_hex(&lo, "8888");
+        sn_net_addr_from_hex(&hi, "8889");
+
+        REQUIRE(sn_net_router_split(&r, 0, &lo, &hi, entries, levels, SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS) == 1);
+        REQUIRE(sn_net_addr_cmp(&entries[0].addr, &a888) == 0);
+
+        sn_net_addr_from_hex(&lo, "4f5e3");
+        sn_net_addr_from_hex(&hi, "4f5eff");
+
+        REQUIRE(sn_net_router_split(&r, 0, &lo, &hi, entries, levels, SN_NET_ROUTER_LEVELS*SN_NET_ROUTER_COLUMNS) == 0);
+    }
+
+    SECTION("Output is bounded") {
+        REQUIRE(sn_net_router_split(&r, 0, &lo, &hi, entries, levels, 1) == 1);
+        REQUIRE(sn_net_addr_cmp(&entries[0].addr, &a888) == 0);
+    }
+
+    sn_net_router_destroy(&r);
 }
 
 TEST_CASE("Router querying", "[router]") {
@@ -232,3 +371,286 @@ TEST_CASE("Router querying", "[router]") {
 
     free(query_res);
 }
+
+TEST_CASE("Router cached rows", "[router]") {
+    sn_net_router_t r;
+    sn_net_entry_t e;
+    sn_net_entry_t self;
+    sn_net_entry_t reco;
+    const sn_net_router_query_ser_t* row;
+    const sn_net_router_query_ser_t* again;
+    size_t len;
+    uint32_t version;
+
+    self.is_set = 1;
+    sn_net_addr_from_hex(&self.addr, "0a0a0a0a");
+    sn_io_naddr_from_str(&self.net_addr, "INET:1.1.1.1:1111");
+
+    sn_net_router_init(&r, &self.addr, &self.net_addr);
+
+    e.is_set = 1;
+    sn_net_addr_from_hex(&e.addr, "abcdef");
+    sn_io_naddr_from_str(&e.net_addr, "INET:5.6.7.8:8765");
+
+    sn_net_router_table_set(&r, 1, 2, &e);
+
+    REQUIRE((row = sn_net_router_cached_row(&r, 1, &len)) != NULL);
+    REQUIRE(row->entries_len == 1);
+    REQUIRE(len == sizeof(sn_net_router_query_ser_t) + sizeof(sn_net_router_entry_ser_t));
+    REQUIRE(row->entries[0].column == 2);
+
+    SECTION("Unchanged rows are not serialized again") {
+        version = sn_net_router_version(&r);
+
+        REQUIRE((again = sn_net_router_cached_row(&r, 1, &len)) == row);
+        REQUIRE(again->entries_len == 1);
+        REQUIRE(sn_net_router_version(&r) == version);
+
+        sn_net_router_table_set(&r, 3, 0, &e);
+
+        REQUIRE(sn_net_router_version(&r) != version);
+        REQUIRE(sn_net_router_cached_row(&r, 1, &len)->entries_len == 1);
+        REQUIRE(sn_net_router_cached_row(&r, 3, &len)->entries_len == 1);
+    }
+
+    SECTION("Changed rows are serialized again") {
+        sn_net_router_table_set(&r, 1, 4, &e);
+
+        REQUIRE((again = sn_net_router_cached_row(&r, 1, &len)) != NULL);
+        REQUIRE(again->entries_len == 2);
+        REQUIRE(again->entries[1].column == 4);
+        REQUIRE(sn_net_entry_deser(&reco, &again->entries[1].entry) == 0);
+        REQUIRE(sn_net_entry_equals(&reco, &e));
+    }
+
+    SECTION("Leafset halves follow the leafset") {
+        REQUIRE(sn_net_router_cached_leafset(&r, 0, &len)->entries_len == 0);
+        REQUIRE(sn_net_router_cached_leafset(&r, 1, &len)->entries_len == 1);
+
+        sn_net_router_leafset_set(&r, -1, &e);
+
+        REQUIRE((again = sn_net_router_cached_leafset(&r, 0, &len)) != NULL);
+        REQUIRE(again->entries_len == 1);
+        REQUIRE(again->entries[0].position == -1);
+        REQUIRE(sn_net_router_cached_leafset(&r, 1, &len)->entries[0].position == 0);
+    }
+
+    REQUIRE(sn_net_router_cached_row(&r, SN_NET_ROUTER_LEVELS, &len) == NULL);
+
+    sn_net_router_destroy(&r);
+}
+
+TEST_CASE("Router queries streamed into buffers", "[router]") {
+    sn_net_router_t r;
+    sn_net_router_cursor_t cur;
+    sn_net_entry_t e;
+    sn_net_entry_t self;
+    sn_net_router_query_ser_t* query_res;
+    unsigned char buf[sizeof(sn_net_router_query_ser_t) + 2*sizeof(sn_net_router_entry_ser_t)];
+    const sn_net_router_query_ser_t* part = (const sn_net_router_query_ser_t*)buf;
+    size_t streamed = 0, parts = 0;
+
+    self.is_set = 1;
+    sn_net_addr_from_hex(&self.addr, "0a0a0a0a");
+    sn_io_naddr_from_str(&self.net_addr, "INET:1.1.1.1:1111");
+
+    sn_net_router_init(&r, &self.addr, &self.net_addr);
+
+    e.is_set = 1;
+    sn_net_addr_from_hex(&e.addr, "abcdef");
+    sn_io_naddr_from_str(&e.net_addr, "INET:5.6.7.8:8765");
+
+    sn_net_router_table_set(&r, 1, 2, &e);
+    sn_net_router_table_set(&r, 1, 4, &e);
+    sn_net_router_table_set(&r, 2, 6, &e);
+    sn_net_router_table_set(&r, 5, 15, &e);
+
+    REQUIRE(sn_net_router_cursor_table(&cur, 6, 5) == -1);
+    REQUIRE(sn_net_router_cursor_leafset(&cur, -SN_NET_ROUTER_LEAFSET_SIZE - 1, 0) == -1);
+
+    SECTION("Small buffers are refused") {
+        REQUIRE(sn_net_router_cursor_table(&cur, 0, 5) == 0);
+        REQUIRE(sn_net_router_query_next(&r, &cur, buf, sizeof(sn_net_router_query_ser_t)) == 0);
+    }
+
+    SECTION("Entries come out in order, as the allocating query") {
+        REQUIRE(sn_net_router_query_table(&r, 0, 5, &query_res));
+        REQUIRE(query_res->entries_len == 4);
+        REQUIRE(sn_net_router_cursor_table(&cur, 0, 5) == 0);
+
+        while(!sn_net_router_cursor_done(&cur)) {
+            size_t len = sn_net_router_query_next(&r, &cur, buf, sizeof(buf));
+
+            REQUIRE(len == sizeof(sn_net_router_query_ser_t) + part->entries_len*sizeof(sn_net_router_entry_ser_t));
+            REQUIRE(part->entries_len > 0);
+
+            for(size_t i = 0; i < part->entries_len; ++i, ++streamed) {
+                REQUIRE(part->entries[i].is_table == 1);
+                REQUIRE(part->entries[i].level == query_res->entries[streamed].level);
+                REQUIRE(part->entries[i].column == query_res->entries[streamed].column);
+            }
+
+            ++parts;
+        }
+
+        /* The last buffer is full, the query ends without an empty part */
+
+        REQUIRE(streamed == 4);
+        REQUIRE(parts == 2);
+
+        free(query_res);
+    }
+
+    SECTION("Leafsets are streamed too") {
+        sn_net_router_leafset_set(&r, -1, &e);
+        sn_net_router_leafset_set(&r, 3, &e);
+
+        REQUIRE(sn_net_router_cursor_leafset(&cur, -3, 3) == 0);
+        REQUIRE(sn_net_router_query_next(&r, &cur, buf, sizeof(buf)));
+        REQUIRE(part->entries_len == 2);
+        REQUIRE(part->entries[0].position == -1);
+        REQUIRE(part->entries[1].position == 0);
+        REQUIRE(!sn_net_router_cursor_done(&cur));
+        REQUIRE(sn_net_router_query_next(&r, &cur, buf, sizeof(buf)));
+        REQUIRE(part->entries_len == 1);
+        REQUIRE(part->entries[0].position == 3);
+        REQUIRE(sn_net_router_cursor_done(&cur));
+    }
+}
+
+TEST_CASE("Router deltas", "[router]") {
+    sn_net_router_t a, b;
+    sn_net_router_delta_cursor_t cur;
+    sn_net_addr_t a_addr, b_addr, addr;
+    sn_io_naddr_t net_addr;
+    unsigned char buf[1000];
+    const sn_net_router_delta_ser_t* delta = (const sn_net_router_delta_ser_t*)buf;
+    const char* peers[] = { "1a", "2b", "3c", "a1", "a2", "0a0b", "0a0a0b", "0a0a0a0b", "0a0a0a0a0b", "ff" };
+    uint32_t version = 0;
+    size_t len, i;
+
+    sn_net_addr_from_hex(&a_addr, "0a0a0a0a");
+    sn_net_addr_from_hex(&b_addr, "0b");
+    sn_io_naddr_from_str(&net_addr, "INET:5.6.7.8:8765");
+
+    sn_net_router_init(&a, &a_addr, &net_addr);
+    sn_net_router_init(&b, &b_addr, &net_addr);
+
+    for(i = 0; i < sizeof(peers)/sizeof(peers[0]); ++i) {
+        sn_net_addr_from_hex(&addr, peers[i]);
+        sn_net_router_add(&a, &addr, &net_addr);
+    }
+
+    sn_net_router_cursor_delta(&a, &cur, 0);
+    len = sn_net_router_delta_next(&a, &cur, buf, sizeof(buf));
+
+    REQUIRE(len > sizeof(sn_net_router_delta_ser_t));
+    REQUIRE(sn_net_router_delta_done(&cur));
+    REQUIRE(delta->version == sn_net_router_version(&a));
+    REQUIRE(sn_net_router_delta_apply(&b, &a_addr, buf, len, &version) == 0);
+    REQUIRE(version == sn_net_router_version(&a));
+
+    for(i = 0; i < sizeof(peers)/sizeof(peers[0]); ++i) {
+        unsigned int level;
+        unsigned char column;
+
+        sn_net_addr_from_hex(&addr, peers[i]);
+        sn_net_addr_index(&b_addr, &addr, &level, &column);
+
+        REQUIRE(sn_net_router_table_get(&b, level, column)->is_set);
+    }
+
+    SECTION("Only changes are sent") {
+        sn_net_router_cursor_delta(&a, &cur, version);
+        REQUIRE(sn_net_router_delta_next(&a, &cur, buf, sizeof(buf)) == sizeof(sn_net_router_delta_ser_t));
+        REQUIRE(delta->records_len == 0);
+
+        sn_net_addr_from_hex(&addr, "1a");
+        sn_net_router_remove(&a, &addr);
+
+        sn_net_router_cursor_delta(&a, &cur, version);
+        len = sn_net_router_delta_next(&a, &cur, buf, sizeof(buf));
+
+        REQUIRE(delta->since == version);
+        REQUIRE(delta->records_len >= 1);
+
+        /* Table records come first, then the leafset it was on */
+
+        REQUIRE(delta->records[0] == (SN_NET_ROUTER_DELTA_TABLE | SN_NET_ROUTER_DELTA_REMOVED));
+
+        REQUIRE(sn_net_router_table_get(&b, 0, 1)->is_set);
+        REQUIRE(sn_net_router_delta_apply(&b, &a_addr, buf, len, NULL) == 0);
+        REQUIRE(sn_net_router_table_get(&b, 0, 1)->is_set == 0);
+    }
+
+    SECTION("Entries added again are no change") {
+        uint32_t b_version = sn_net_router_version(&b);
+        unsigned int l, c;
+
+        for(l = 0; l < SN_NET_ROUTER_LEVELS; ++l) {
+            for(c = 0; c < SN_NET_ROUTER_COLUMNS; ++c) {
+                const sn_net_entry_t* e = sn_net_router_table_get(&a, l, c);
+
+                if(e->is_set)
+                    sn_net_router_add(&a, &e->addr, &e->net_addr);
+            }
+        }
+
+        REQUIRE(sn_net_router_version(&a) == version);
+
+        /* Nor is a delta applied twice, even with entries sharing a slot of ours(a1 and a2) */
+
+        sn_net_router_cursor_delta(&a, &cur, 0);
+        len = sn_net_router_delta_next(&a, &cur, buf, sizeof(buf));
+
+        REQUIRE(sn_net_router_delta_apply(&b, &a_addr, buf, len, NULL) == 0);
+        REQUIRE(sn_net_router_version(&b) == b_version);
+
+        sn_net_router_cursor_delta(&b, &cur, b_version);
+        REQUIRE(sn_net_router_delta_next(&b, &cur, buf, sizeof(buf)) == sizeof(sn_net_router_delta_ser_t));
+    }
+
+    SECTION("Shared key bytes are elided") {
+        sn_net_router_t c;
+
+        sn_net_router_init(&c, &a_addr, &net_addr);
+        sn_net_addr_from_hex(&addr, "0a0a0a0a0b");
+        sn_net_router_add(&c, &addr, &net_addr);
+
+        sn_net_router_cursor_delta(&c, &cur, 0);
+        len = sn_net_router_delta_next(&c, &cur, buf, sizeof(buf));
+
+        REQUIRE(delta->records[3] == 4);
+        REQUIRE(len < sizeof(sn_net_router_delta_ser_t) + 2*(4 + SN_NET_ADDR_LEN + sizeof(sn_io_naddr_ser_t)));
+
+        sn_net_router_destroy(&c);
+    }
+
+    SECTION("Deltas are streamed") {
+        unsigned char small[sizeof(sn_net_router_delta_ser_t) + SN_NET_ROUTER_DELTA_RECORD_MAX];
+        uint32_t records = 0, parts = 0;
+
+        sn_net_router_cursor_delta(&a, &cur, 0);
+
+        while(!sn_net_router_delta_done(&cur)) {
+            len = sn_net_router_delta_next(&a, &cur, small, sizeof(small));
+
+            REQUIRE(len > sizeof(sn_net_router_delta_ser_t));
+            REQUIRE(sn_net_router_delta_apply(&b, &a_addr, small, len, NULL) == 0);
+
+            records += ((const sn_net_router_delta_ser_t*)small)->records_len;
+            ++parts;
+        }
+
+        REQUIRE(records == parts);
+        REQUIRE(sn_net_router_delta_next(&a, &cur, small, sizeof(small) - 1) == 0);
+    }
+
+    SECTION("Truncated deltas are refused") {
+        REQUIRE(sn_net_router_delta_apply(&b, &a_addr, buf, len - 1, NULL) == -1);
+        REQUIRE(sn_net_router_delta_apply(&b, &a_addr, buf, 4, NULL) == -1);
+    }
+
+    sn_net_router_destroy(&a);
+    sn_net_router_destroy(&b);
+}
@@ -0,0 +1,76 @@
+#include "../catch.hpp"
+
+#include <sndnet.h>
+#include <net/signer.h>
+#include <net/packet.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+
+static pthread_mutex_t done_mut = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static int done_bad_argc = 0;
+
+/* Called from the signer threads, checked by the test thread */
+
+static void count_done(int argc, void* argv[]) {
+    pthread_mutex_lock(&done_mut);
+    done_bad_argc += argc != 2;
+    ++*(int*)argv[0];
+    pthread_cond_signal(&done_cond);
+    pthread_mutex_unlock(&done_mut);
+}
+
+TEST_CASE("Signer pool signs packets", "[signer]") {
+    sn_crypto_sign_pubkey_t pk;
+    sn_crypto_sign_key_t sk;
+    sn_net_signer_t signer;
+    sn_net_addr_t dst;
+    sn_net_packet_t* packets[37];
+    int i;
+
+    REQUIRE(sn_init() != -1);
+
+    sn_crypto_sign_keypair(&pk, &sk);
+    sn_net_addr_from_hex(&dst, "abcd");
+
+    for(i = 0; i < 37; ++i) {
+        packets[i] = sn_net_packet_pack(&dst, (sn_net_addr_t*)&pk, 0, 5, "Hola");
+        REQUIRE(packets[i] != NULL);
+    }
+
+    REQUIRE(sn_net_signer_init(&signer, &sk, 0) == -1);
+    REQUIRE(sn_net_signer_init(&signer, &sk, 3) == 0);
+
+    SECTION("Signing a batch") {
+        REQUIRE(sn_net_signer_sign_many(&signer, packets, 37) == 0);
+
+        for(i = 0; i < 37; ++i)
+            REQUIRE(sn_net_packet_check_sign(packets[i]) == 0);
+    }
+
+    SECTION("Signing asynchronously") {
+        sn_util_closure_t done;
+        int done_count = 0;
+
+        sn_util_closure_init_curried_once(&done, count_done, &done_count);
+
+        for(i = 0; i < 37; ++i)
+            REQUIRE(sn_net_signer_submit(&signer, packets[i], &done) == 0);
+
+        pthread_mutex_lock(&done_mut);
+        while(done_count < 37)
+            pthread_cond_wait(&done_cond, &done_mut);
+        pthread_mutex_unlock(&done_mut);
+
+        REQUIRE(done_bad_argc == 0);
+
+        for(i = 0; i < 37; ++i)
+            REQUIRE(sn_net_packet_check_sign(packets[i]) == 0);
+    }
+
+    sn_net_signer_destroy(&signer);
+
+    for(i = 0; i < 37; ++i)
+        free(packets[i]);
+}
@@ -0,0 +1,36 @@
+#include "../catch.hpp"
+
+#include "util/hist.h"
+
+TEST_CASE("util/hist: Quantiles", "[util_hist]") {
+    sn_util_hist_t h, other;
+    uint64_t i;
+
+    sn_util_hist_init(&h);
+
+    REQUIRE(sn_util_hist_quantile(&h, 0.5) == 0);
+
+    for(i = 1; i <= 1000; ++i)
+        sn_util_hist_record(&h, i*1000);
+
+    REQUIRE(h.count == 1000);
+    REQUIRE(h.max == 1000000);
+
+    /* Within a bucket(1/8) below the true value */
+
+    REQUIRE(sn_util_hist_quantile(&h, 0.5) <= 500000);
+    REQUIRE(sn_util_hist_quantile(&h, 0.5) >= 500000 - 500000/8);
+    REQUIRE(sn_util_hist_quantile(&h, 0.99) <= 990000);
+    REQUIRE(sn_util_hist_quantile(&h, 0.99) >= 990000 - 990000/8);
+    REQUIRE(sn_util_hist_quantile(&h, 0.0) == 1000 - 1000%64);
+
+    sn_util_hist_init(&other);
+
+    for(i = 0; i < 7; ++i)
+        sn_util_hist_record(&other, i);
+
+    sn_util_hist_merge(&h, &other);
+
+    REQUIRE(h.count == 1007);
+    REQUIRE(sn_util_hist_quantile(&h, 0.0) == 0);
+}